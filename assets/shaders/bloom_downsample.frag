@@ -0,0 +1,48 @@
+#version 330 core
+layout (location = 0) out vec4 oFragColor;
+
+in VertexData {
+    vec2 uv;
+} i;
+
+uniform sampler2D uSource;
+uniform vec2 uSourceSize;       // size of uSource in texels
+uniform vec2 uSourceRegion;     // only [0, uSourceRegion) texels of uSource are valid
+uniform bool uKarisAverage;     // weigh taps by inverse luminance, keeps single bright pixels from flickering
+
+vec3 sample_source(vec2 texel) {
+    texel = clamp(texel, vec2(0.5), uSourceRegion - 0.5);
+    return textureLod(uSource, texel / uSourceSize, 0).rgb;
+}
+
+float karis_weight(vec3 color) {
+    return 1.0 / (1.0 + dot(color, vec3(0.2126, 0.7152, 0.0722)));
+}
+
+// dual filter downsample, the center tap and four corner taps each average 2x2 texels
+void main() {
+    vec2 position = i.uv * uSourceRegion;
+
+    vec3 taps[5];
+    taps[0] = sample_source(position);
+    taps[1] = sample_source(position + vec2(-1.0, -1.0));
+    taps[2] = sample_source(position + vec2( 1.0, -1.0));
+    taps[3] = sample_source(position + vec2(-1.0,  1.0));
+    taps[4] = sample_source(position + vec2( 1.0,  1.0));
+
+    float weights[5] = float[5](4.0, 1.0, 1.0, 1.0, 1.0);
+    if (uKarisAverage) {
+        for (int t = 0; t < 5; ++t) {
+            weights[t] *= karis_weight(taps[t]);
+        }
+    }
+
+    vec3 color = vec3(0);
+    float total_weight = 0.0;
+    for (int t = 0; t < 5; ++t) {
+        color += taps[t] * weights[t];
+        total_weight += weights[t];
+    }
+
+    oFragColor = vec4(color / total_weight, 1);
+}
@@ -0,0 +1,32 @@
+#version 330 core
+layout (location = 0) out vec4 oFragColor;
+
+in VertexData {
+    vec2 uv;
+} i;
+
+uniform sampler2D uSource;
+uniform vec2 uSourceSize;       // size of uSource in texels
+uniform vec2 uSourceRegion;     // only [0, uSourceRegion) texels of uSource are valid
+
+vec3 sample_source(vec2 texel) {
+    texel = clamp(texel, vec2(0.5), uSourceRegion - 0.5);
+    return textureLod(uSource, texel / uSourceSize, 0).rgb;
+}
+
+// dual filter upsample of the next smaller level, added onto this level with blending
+void main() {
+    vec2 position = i.uv * uSourceRegion;
+
+    vec3 color = vec3(0);
+    color += sample_source(position + vec2(-1.0,  0.0));
+    color += sample_source(position + vec2( 1.0,  0.0));
+    color += sample_source(position + vec2( 0.0, -1.0));
+    color += sample_source(position + vec2( 0.0,  1.0));
+    color += sample_source(position + vec2(-0.5, -0.5)) * 2.0;
+    color += sample_source(position + vec2( 0.5, -0.5)) * 2.0;
+    color += sample_source(position + vec2(-0.5,  0.5)) * 2.0;
+    color += sample_source(position + vec2( 0.5,  0.5)) * 2.0;
+
+    oFragColor = vec4(color / 12.0, 1);
+}
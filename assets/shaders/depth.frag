@@ -0,0 +1,18 @@
+#version 330 core
+// ALPHA_TEST is defined for materials that discard fragments by albedo alpha
+#inject
+
+#ifdef ALPHA_TEST
+in VertexData {
+    vec2 uv;
+} i;
+
+uniform sampler2D uAlbedo;
+#endif
+
+void main() {
+#ifdef ALPHA_TEST
+    // same threshold as material.frag
+    if (texture(uAlbedo, i.uv).a <= 0.1) discard;
+#endif
+}
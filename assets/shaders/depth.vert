@@ -0,0 +1,26 @@
+#version 330 core
+// ALPHA_TEST is defined for materials that discard fragments by albedo alpha
+#inject
+layout (location = 0) in vec3 aPosition;
+#ifdef ALPHA_TEST
+layout (location = 2) in vec2 aUv;
+
+out VertexData {
+    vec2 uv;
+} o;
+#endif
+
+// has to match material.vert exactly, the shading pass tests against this depth with EQUAL
+invariant gl_Position;
+
+uniform mat4 uViewProjectionMatrix;
+uniform mat4 uModelMatrix;
+
+void main() {
+    vec3 position = vec3(uModelMatrix * vec4(aPosition, 1));
+#ifdef ALPHA_TEST
+    o.uv = aUv;
+#endif
+
+    gl_Position = uViewProjectionMatrix * vec4(position, 1);
+}
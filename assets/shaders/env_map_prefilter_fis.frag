@@ -0,0 +1,41 @@
+#version 330 core
+layout (location = 0) out vec3 oFragColor;
+
+// Prefilter with filtered importance sampling: a handful of GGX samples, each reading the mip level of the
+// environment map that matches the solid angle it covers. Samples are generated on the CPU
+
+// must match PREFILTER_MAX_SAMPLES in prefilter_samples.h
+#define MAX_SAMPLES 64
+
+in VertexData {
+    vec3 dir;
+} i;
+
+uniform samplerCube uEnvMap;
+
+layout (std140) uniform PrefilterSamples {
+    // xyz: light direction in tangent space, w: mip level of the environment map to sample
+    vec4 uSamples[MAX_SAMPLES];
+    int uNumSamples;
+    float uInvTotalWeight;
+};
+
+void main() {
+    vec3 N = normalize(i.dir);
+
+    vec3 up = abs(N.z) < 0.999 ? vec3(0, 0, 1) : vec3(1, 0, 0);
+    vec3 tan_x = normalize(cross(up, N));
+    vec3 tan_y = cross(N, tan_x);
+
+    vec3 color = vec3(0);
+    for (int s = 0; s < uNumSamples; ++s) {
+        vec4 smp = uSamples[s];
+        // tangent to world space
+        vec3 L = tan_x * smp.x + tan_y * smp.y + N * smp.z;
+
+        // weighted by NdotL
+        color += textureLod(uEnvMap, L, smp.w).rgb * smp.z;
+    }
+
+    oFragColor = color * uInvTotalWeight;
+}
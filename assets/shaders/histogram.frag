@@ -0,0 +1,10 @@
+#version 330 core
+layout (location = 0) out float oCount;
+
+in VertexData {
+    float weight;
+} i;
+
+void main() {
+    oCount = i.weight;
+}
@@ -0,0 +1,16 @@
+#version 330 core
+#include "histogram_bin.glsl"
+
+out VertexData {
+    float weight;
+} o;
+
+// one point per texel of uLogLuminance, scattered onto its bin and counted with additive blending
+void main() {
+    int width = textureSize(uLogLuminance, 0).x;
+    ivec2 texel = ivec2(gl_VertexID % width, gl_VertexID / width);
+
+    int bin = histogram_bin(texel, o.weight);
+
+    gl_Position = vec4((float(bin) + 0.5) / HISTOGRAM_NUM_BINS * 2.0 - 1.0, 0.0, 0.0, 1.0);
+}
@@ -0,0 +1,17 @@
+// shared by the histogram passes, see AutoExposure
+const int HISTOGRAM_NUM_BINS = 64;  // has to match consts::HISTOGRAM_NUM_BINS
+
+uniform sampler2D uLogLuminance;
+uniform float uMinLogLuminance;
+uniform float uInverseLogLuminanceRange;
+
+// bin of a texel of uLogLuminance and how much it counts, the center of the screen is metered more strongly
+int histogram_bin(ivec2 texel, out float weight) {
+    vec2 size = vec2(textureSize(uLogLuminance, 0));
+    vec2 from_center = (vec2(texel) + 0.5) / size * 2.0 - 1.0;
+    weight = mix(1.0, 0.25, clamp(length(from_center), 0.0, 1.0));
+
+    float log_luminance = texelFetch(uLogLuminance, texel, 0).r;
+    float position = clamp((log_luminance - uMinLogLuminance) * uInverseLogLuminanceRange, 0.0, 1.0);
+    return min(int(position * HISTOGRAM_NUM_BINS), HISTOGRAM_NUM_BINS - 1);
+}
@@ -0,0 +1,19 @@
+#version 330 core
+layout (location = 0) out float oDepth;
+
+uniform sampler2D uSource;
+uniform vec2 uSourceRegion;     // only [0, uSourceRegion) texels of uSource are valid
+
+// each texel keeps the farthest of the 2x2 texels it covers. Levels are rounded up, so the last texel of an odd row
+// or column only covers one, the clamp reads it twice
+void main() {
+    ivec2 base = ivec2(gl_FragCoord.xy) * 2;
+    ivec2 last = ivec2(uSourceRegion) - 1;
+
+    float depth = texelFetch(uSource, min(base, last), 0).r;
+    depth = max(depth, texelFetch(uSource, min(base + ivec2(1, 0), last), 0).r);
+    depth = max(depth, texelFetch(uSource, min(base + ivec2(0, 1), last), 0).r);
+    depth = max(depth, texelFetch(uSource, min(base + ivec2(1, 1), last), 0).r);
+
+    oDepth = depth;
+}
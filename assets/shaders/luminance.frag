@@ -0,0 +1,17 @@
+#version 330 core
+layout (location = 0) out float oLogLuminance;
+
+in VertexData {
+    vec2 uv;
+} i;
+
+uniform sampler2D uImage;
+uniform vec2 uImageRegion;  // part of uImage in uv that was rendered to
+uniform float uLod;         // mip level that is about as large as the target
+
+void main() {
+    vec3 color = textureLod(uImage, i.uv * uImageRegion, uLod).rgb;
+    float luminance = dot(color, vec3(0.2126, 0.7152, 0.0722));
+
+    oLogLuminance = log2(max(luminance, 1e-5));
+}
@@ -1,4 +1,6 @@
 #version 330 core
+// material variant defines, see MaterialVariantFlags
+#inject
 layout (location = 0) out vec4 oFragColor;
 
 const float PI = 3.1415926535897932384626433832795028841971693993751058;
@@ -7,25 +9,66 @@ in VertexData {
     vec3 position;
     vec3 normal;
     vec2 uv;
+#ifdef HAS_NORMAL_MAP
     mat3 tbn;
+#endif
 } i;
 
 uniform struct {
+#ifdef HAS_ALBEDO_MAP
     sampler2D albedo;
+#endif
+#ifdef HAS_NORMAL_MAP
     sampler2D normal;
+#endif
+#ifdef HAS_PACKED_ORM
+    sampler2D metallic_roughness;
+#else
+#ifndef METALLIC_CONST
     sampler2D metallic;
-    float metallic_scale;
+#endif
+#ifndef ROUGHNESS_CONST
     sampler2D roughness;
+#endif
+#endif
+    float metallic_scale;
     float roughness_scale;
 } uMaterial;
 
-uniform samplerCube uDiffuseIrradianceMap;
+// diffuse irradiance as L2 spherical harmonics, already convolved with the cosine lobe and divided by pi
+layout (std140) uniform IrradianceSh {
+    vec4 uIrradianceSh[9];
+};
+
 uniform samplerCube uPrefilteredEnvironmentMap;
 uniform sampler2D uBrdfLut;
 uniform int uNumPrefilteredEnvMipmapLevels;
 
 uniform vec3 uSunDirection;
+uniform vec3 uSunIlluminance;
 uniform vec3 uCameraPosition;
+uniform vec3 uCameraForward;
+
+// clustered lights, see ClusteredLighting. Grid size has to match consts::CLUSTER_GRID_*
+const int CLUSTER_GRID_X = 16;
+const int CLUSTER_GRID_Y = 9;
+const int CLUSTER_GRID_Z = 24;
+
+uniform samplerBuffer uLightData;               // 3 texels per light
+uniform usamplerBuffer uClusterGrid;            // offset and count into uClusterLightIndices per cluster
+uniform usamplerBuffer uClusterLightIndices;
+uniform vec2 uClusterTileScale;                 // clusters per pixel
+uniform float uClusterDepthScale;               // slice = log(depth) * scale + bias
+uniform float uClusterDepthBias;
+
+// sun shadow cascades, see CascadedShadowMaps. Array size has to match consts::MAX_SHADOW_CASCADES
+const int MAX_SHADOW_CASCADES = 4;
+
+uniform sampler2DArrayShadow uShadowMap;
+uniform int uNumShadowCascades;
+uniform mat4 uShadowMatrices[MAX_SHADOW_CASCADES];      // world space to shadow map uv and depth
+uniform float uShadowCascadeFarDepths[MAX_SHADOW_CASCADES];
+uniform float uShadowTexelWorldSizes[MAX_SHADOW_CASCADES];
 
 const vec2 inv_atan = vec2(1.0 / (2 * PI), 1.0 / PI);
 vec2 sample_equirectangular_map(vec3 v) {
@@ -36,6 +79,18 @@ vec2 sample_equirectangular_map(vec3 v) {
     return vec2(uv.x, 1.0 - uv.y);
 }
 
+vec3 sh_irradiance(vec3 n) {
+    return uIrradianceSh[0].rgb * 0.282095
+         + uIrradianceSh[1].rgb * 0.488603 * n.y
+         + uIrradianceSh[2].rgb * 0.488603 * n.z
+         + uIrradianceSh[3].rgb * 0.488603 * n.x
+         + uIrradianceSh[4].rgb * 1.092548 * n.x * n.y
+         + uIrradianceSh[5].rgb * 1.092548 * n.y * n.z
+         + uIrradianceSh[6].rgb * 0.315392 * (3.0 * n.z * n.z - 1.0)
+         + uIrradianceSh[7].rgb * 1.092548 * n.x * n.z
+         + uIrradianceSh[8].rgb * 0.546274 * (n.x * n.x - n.y * n.y);
+}
+
 float ggx_distribution(vec3 N, vec3 H, float roughness) {
     float a = roughness*roughness;
     float a2 = a*a;
@@ -79,9 +134,9 @@ float geometry_smith(vec3 N, vec3 V, vec3 L, float roughness) {
 //---------------
 // calculate brdf with cook-torrance for specular and lambert for diffuse
 //---------------
-vec3 calculate_brdf(vec3 albedo, vec3 N, vec3 V, float metallic, float roughness) {
+vec3 calculate_brdf(vec3 albedo, vec3 N, vec3 V, vec3 L, float metallic, float roughness) {
     vec3 Wo = V;// outgoing light direction
-    vec3 Wi = uSunDirection;// incoming light direction
+    vec3 Wi = L;// incoming light direction
     vec3 H = normalize(V + Wi);// halfway vector
     vec3 F0 = mix(vec3(0.04), albedo, metallic);// material response at normal incidence
 
@@ -100,20 +155,125 @@ vec3 calculate_brdf(vec3 albedo, vec3 N, vec3 V, float metallic, float roughness
     return (Kd * albedo / PI + specular) * Li * max(0, dot(N, Wi));
 }
 
+// offset and count of the light list of the cluster this fragment is in
+uvec2 get_cluster() {
+    float depth = max(dot(i.position - uCameraPosition, uCameraForward), 1e-4);
+    int slice = clamp(int(log(depth) * uClusterDepthScale + uClusterDepthBias), 0, CLUSTER_GRID_Z - 1);
+    ivec2 tile = min(ivec2(gl_FragCoord.xy * uClusterTileScale), ivec2(CLUSTER_GRID_X - 1, CLUSTER_GRID_Y - 1));
+
+    return texelFetch(uClusterGrid, (slice * CLUSTER_GRID_Y + tile.y) * CLUSTER_GRID_X + tile.x).rg;
+}
+
+vec3 calculate_punctual_light(int light, vec3 albedo, vec3 N, vec3 V, float metallic, float roughness) {
+    vec4 position_range = texelFetch(uLightData, light * 3);
+    vec4 color_spot_scale = texelFetch(uLightData, light * 3 + 1);
+    vec4 direction_spot_offset = texelFetch(uLightData, light * 3 + 2);
+
+    vec3 to_light = position_range.xyz - i.position;
+    float distance_squared = max(dot(to_light, to_light), 1e-4);
+    vec3 L = to_light * inversesqrt(distance_squared);
+
+    // inverse square falloff, windowed to reach zero at the range of the light
+    float range_ratio = distance_squared / (position_range.w * position_range.w);
+    float window = clamp(1.0 - range_ratio * range_ratio, 0.0, 1.0);
+    float attenuation = window * window / distance_squared;
+
+    // point lights have a scale of 0 and an offset of 1
+    float spot = clamp(dot(-L, direction_spot_offset.xyz) * color_spot_scale.w + direction_spot_offset.w, 0.0, 1.0);
+    attenuation *= spot * spot;
+
+    return calculate_brdf(albedo, N, V, L, metallic, roughness) * color_spot_scale.rgb * attenuation;
+}
+
+// visibility of the sun, 1 is fully lit
+float sun_shadow(vec3 N) {
+    float depth = dot(i.position - uCameraPosition, uCameraForward);
+
+    int cascade = 0;
+    while (cascade < uNumShadowCascades - 1 && depth > uShadowCascadeFarDepths[cascade]) {
+        ++cascade;
+    }
+    if (depth > uShadowCascadeFarDepths[cascade]) {
+        return 1.0;
+    }
+
+    // push the lookup off the surface by about a texel, more at grazing angles
+    float NdotL = clamp(dot(N, uSunDirection), 0.0, 1.0);
+    float texel_size = uShadowTexelWorldSizes[cascade];
+    vec3 offset_position = i.position + N * texel_size * (1.5 - NdotL) + uSunDirection * texel_size * 0.5;
+    vec3 coords = (uShadowMatrices[cascade] * vec4(offset_position, 1.0)).xyz;
+
+    // casters clamped to the near plane can't shadow anything beyond the far plane
+    if (coords.z >= 1.0) {
+        return 1.0;
+    }
+
+    // 3x3 pcf on top of the hardware bilinear comparison
+    vec2 texel = 1.0 / vec2(textureSize(uShadowMap, 0).xy);
+    float visibility = 0.0;
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            visibility += texture(uShadowMap, vec4(coords.xy + vec2(x, y) * texel, cascade, coords.z));
+        }
+    }
+
+    return visibility / 9.0;
+}
+
 void main() {
+#ifdef HAS_ALBEDO_MAP
+    vec4 albedo_alpha = texture(uMaterial.albedo, i.uv);
+
     // TODO: alpha threshold seems a bit high for test models to work, check out textures
-    if (texture(uMaterial.albedo, i.uv).a <= 0.1) discard;
+    if (albedo_alpha.a <= 0.1) discard;
 
-    vec3 albedo = pow(texture(uMaterial.albedo, i.uv).rgb, vec3(2.2));
+    vec3 albedo = pow(albedo_alpha.rgb, vec3(2.2));
+    float alpha = albedo_alpha.a;
+#else
+    vec3 albedo = vec3(1);
+    float alpha = 1;
+#endif
+
+#ifdef HAS_NORMAL_MAP
     vec3 normal = normalize(i.tbn * (texture(uMaterial.normal, i.uv).rgb * 2 - 1));
+#else
+    vec3 normal = normalize(i.normal);
+#endif
+
     vec3 view_dir = normalize(uCameraPosition - i.position);
+
+#ifdef HAS_PACKED_ORM
+    // occlusion, roughness, metallic
+    vec3 orm = texture(uMaterial.metallic_roughness, i.uv).rgb;
+    float metallic = orm.b * uMaterial.metallic_scale;
+    float roughness = orm.g * uMaterial.roughness_scale;
+#else
+#ifdef METALLIC_CONST
+    float metallic = uMaterial.metallic_scale;
+#else
     float metallic = texture(uMaterial.metallic, i.uv).r * uMaterial.metallic_scale;
+#endif
+#ifdef ROUGHNESS_CONST
+    float roughness = uMaterial.roughness_scale;
+#else
     float roughness = texture(uMaterial.roughness, i.uv).r * uMaterial.roughness_scale;
+#endif
+#endif
 
     vec3 color = vec3(0);
 
     // sun light
-//    color += calculate_brdf(albedo, normal, view_dir, metallic, roughness);
+    if (dot(normal, uSunDirection) > 0.0) {
+        color += calculate_brdf(albedo, normal, view_dir, uSunDirection, metallic, roughness) * uSunIlluminance *
+                 sun_shadow(normalize(i.normal));
+    }
+
+    // punctual lights of the cluster
+    uvec2 cluster = get_cluster();
+    for (uint l = cluster.x; l < cluster.x + cluster.y; ++l) {
+        int light = int(texelFetch(uClusterLightIndices, int(l)).r);
+        color += calculate_punctual_light(light, albedo, normal, view_dir, metallic, roughness);
+    }
 
     // environment
     vec3 N = normal;
@@ -123,7 +283,7 @@ void main() {
 
     // diffuse
     vec3 Kd = (1 - F) * (1 - metallic);
-    vec3 Li = texture(uDiffuseIrradianceMap, N).rgb;
+    vec3 Li = max(vec3(0), sh_irradiance(N));
     vec3 diffuse = Li * albedo * Kd;
 
     // specular, split-sum
@@ -135,5 +295,5 @@ void main() {
 
     color += (diffuse + specular);
 
-    oFragColor = vec4(color, texture(uMaterial.albedo, i.uv).a);
+    oFragColor = vec4(color, alpha);
 }
@@ -1,30 +1,41 @@
 #version 330 core
+// material variant defines, see MaterialVariantFlags
+#inject
 layout (location = 0) in vec3 aPosition;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aUv;
-layout (location = 3) in vec3 aTangent;
-layout (location = 4) in vec3 aBiTangent;
+layout (location = 3) in vec4 aTangent;  // w is the sign of the bi-tangent
 
 out VertexData {
     vec3 position;
     vec3 normal;
     vec2 uv;
+#ifdef HAS_NORMAL_MAP
     mat3 tbn;
+#endif
 } o;
 
+// has to match depth.vert exactly for the depth pre-pass
+invariant gl_Position;
+
 uniform mat4 uViewProjectionMatrix;
 uniform mat4 uModelMatrix;
-uniform mat4 uNormalMatrix;
+uniform mat3 uNormalMatrix;
 
 void main() {
     o.position = vec3(uModelMatrix * vec4(aPosition, 1));
-    o.normal = vec3(uNormalMatrix * vec4(aNormal, 1));
     o.uv = aUv;
 
-    vec3 t = normalize(vec3(uModelMatrix * vec4(aTangent, 0)));
-    vec3 b = normalize(vec3(uModelMatrix * vec4(aBiTangent, 0)));
-    vec3 n = normalize(vec3(uModelMatrix * vec4(aNormal, 0)));
+    vec3 n = normalize(uNormalMatrix * aNormal);
+    o.normal = n;
+
+#ifdef HAS_NORMAL_MAP
+    // the bi-tangent is rebuilt in object space, so mirroring model matrices carry it along
+    vec3 bi_tangent = cross(aNormal, aTangent.xyz) * aTangent.w;
+    vec3 t = normalize(vec3(uModelMatrix * vec4(aTangent.xyz, 0)));
+    vec3 b = normalize(vec3(uModelMatrix * vec4(bi_tangent, 0)));
     o.tbn = mat3(t, b, n);
+#endif
 
     gl_Position = uViewProjectionMatrix * vec4(o.position, 1);
 }
@@ -0,0 +1,11 @@
+#version 330 core
+
+uniform sampler2D uHiZ;
+uniform float uDepth;       // nearest depth of the box
+
+// only fragments where the box could be in front of the farthest depth of the texel count towards the query
+void main() {
+    if (uDepth > texelFetch(uHiZ, ivec2(gl_FragCoord.xy), 0).r) {
+        discard;
+    }
+}
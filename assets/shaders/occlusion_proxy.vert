@@ -0,0 +1,12 @@
+#version 330 core
+
+uniform vec2 uRectMin;      // texels of the depth pyramid level covered by the box, max is exclusive
+uniform vec2 uRectMax;
+uniform vec2 uLevelRegion;  // size of the viewport in texels
+
+// the rectangle edges lie on texel edges, so every covered texel gets exactly one fragment
+void main() {
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    vec2 texel = mix(uRectMin, uRectMax, corner);
+    gl_Position = vec4(texel / uLevelRegion * 2.0 - 1.0, 0.0, 1.0);
+}
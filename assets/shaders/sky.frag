@@ -1,12 +1,23 @@
 #version 330 core
 layout (location = 0) out vec4 oFragColor;
 
+// cosine of the angular radius of the sun disk, larger than the real sun so it covers a few probe texels
+const float SUN_COS_ANGULAR_RADIUS = 0.9994;
+const float SUN_EDGE_SOFTNESS = 0.0002;
+
 in VertexData {
     vec3 dir;
 } i;
 
 uniform samplerCube uEnvMap;
+uniform vec3 uSunDirection;
+uniform vec3 uSunRadiance;
 
 void main() {
-    oFragColor = vec4(texture(uEnvMap, i.dir).rgb, 1);
+    vec3 color = texture(uEnvMap, i.dir).rgb;
+
+    float cos_theta = dot(normalize(i.dir), uSunDirection);
+    color += uSunRadiance * smoothstep(SUN_COS_ANGULAR_RADIUS - SUN_EDGE_SOFTNESS, SUN_COS_ANGULAR_RADIUS, cos_theta);
+
+    oFragColor = vec4(color, 1);
 }
@@ -6,8 +6,100 @@ in VertexData {
 } i;
 
 uniform sampler2D uImage;
+uniform vec2 uImageSize;        // size of uImage in texels
+uniform vec2 uViewportSize;     // the scene covers [0, uViewportSize) texels of uImage
 uniform float uExposure;
 
+// bloom pyramid, see Renderer::renderBloom(). Has to match consts::BLOOM_NUM_MIPS
+const int BLOOM_NUM_MIPS = 6;
+
+uniform bool uBloom;
+uniform sampler2D uBloomTexture;
+uniform vec2 uBloomSize;
+uniform vec2 uBloomRegion;
+uniform float uBloomIntensity;
+
+uniform bool uColorGrading;
+uniform sampler3D uColorGradingLut;
+uniform float uColorGradingLutSize;
+
+uniform bool uDithering;
+
+// bilinear sample that stays inside the rendered region, the rest of the image holds stale pixels
+vec3 sample_region(vec2 texel) {
+    texel = clamp(texel, vec2(0.5), uViewportSize - 0.5);
+    return textureLod(uImage, texel / uImageSize, 0).rgb;
+}
+
+// Catmull-Rom upscale of the rendered region with 9 bilinear taps instead of 16 point taps
+vec3 sample_catmull_rom(vec2 uv) {
+    vec2 position = uv * uViewportSize;
+    vec2 center = floor(position - 0.5) + 0.5;
+    vec2 f = position - center;
+
+    vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+    vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+    vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+    vec2 w3 = f * f * (-0.5 + 0.5 * f);
+
+    // the middle two taps are merged into one bilinear tap
+    vec2 w12 = w1 + w2;
+    vec2 offset12 = w2 / w12;
+
+    vec2 texel0 = center - 1.0;
+    vec2 texel3 = center + 2.0;
+    vec2 texel12 = center + offset12;
+
+    vec3 color = vec3(0);
+    color += sample_region(vec2(texel0.x, texel0.y)) * w0.x * w0.y;
+    color += sample_region(vec2(texel12.x, texel0.y)) * w12.x * w0.y;
+    color += sample_region(vec2(texel3.x, texel0.y)) * w3.x * w0.y;
+    color += sample_region(vec2(texel0.x, texel12.y)) * w0.x * w12.y;
+    color += sample_region(vec2(texel12.x, texel12.y)) * w12.x * w12.y;
+    color += sample_region(vec2(texel3.x, texel12.y)) * w3.x * w12.y;
+    color += sample_region(vec2(texel0.x, texel3.y)) * w0.x * w3.y;
+    color += sample_region(vec2(texel12.x, texel3.y)) * w12.x * w3.y;
+    color += sample_region(vec2(texel3.x, texel3.y)) * w3.x * w3.y;
+
+    // negative lobes can overshoot below zero next to bright pixels
+    return max(color, vec3(0));
+}
+
+// last upsample of the bloom pyramid, done here instead of in another full resolution pass
+vec3 sample_bloom(vec2 uv) {
+    vec2 position = uv * uBloomRegion;
+
+    vec3 color = vec3(0);
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            // 3x3 tent
+            float weight = (2.0 - abs(float(x))) * (2.0 - abs(float(y)));
+            vec2 texel = clamp(position + vec2(x, y), vec2(0.5), uBloomRegion - 0.5);
+            color += textureLod(uBloomTexture, texel / uBloomSize, 0).rgb * weight;
+        }
+    }
+
+    // every level of the pyramid was added onto the first one
+    return color / (16.0 * BLOOM_NUM_MIPS);
+}
+
+// lookup table coordinates address texel centers, so 0 and 1 map to the first and last texel exactly
+vec3 apply_color_grading(vec3 color) {
+    vec3 coords = color * ((uColorGradingLutSize - 1.0) / uColorGradingLutSize) + 0.5 / uColorGradingLutSize;
+    return textureLod(uColorGradingLut, coords, 0).rgb;
+}
+
+float interleaved_gradient_noise(vec2 position) {
+    return fract(52.9829189 * fract(dot(position, vec2(0.06711056, 0.00583715))));
+}
+
+// triangular noise of +-1 step of the 8-bit output, removes banding without a visible noise floor
+vec3 dither(vec3 color) {
+    float noise = interleaved_gradient_noise(gl_FragCoord.xy) +
+                  interleaved_gradient_noise(gl_FragCoord.xy + vec2(47.0, 17.0)) - 1.0;
+    return color + noise / 255.0;
+}
+
 // Narkowicz 2015, "ACES Filmic Tone Mapping Curve"
 vec3 aces(vec3 x) {
     // apply camera exposure
@@ -26,9 +118,21 @@ vec3 aces(vec3 x) {
 }
 
 void main() {
-    vec3 color = texture(uImage, i.uv).rgb;
-    
+    vec3 color = sample_catmull_rom(i.uv);
+
+    if (uBloom) {
+        color = mix(color, sample_bloom(i.uv), uBloomIntensity);
+    }
+
     color = aces(color);
-    
+
+    if (uColorGrading) {
+        color = apply_color_grading(color);
+    }
+
+    if (uDithering) {
+        color = dither(color);
+    }
+
     oFragColor = vec4(color, 1);
 }
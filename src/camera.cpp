@@ -5,13 +5,17 @@ constexpr glm::vec3 Camera::UP;
 
 glm::mat4 Camera::getViewProjectionMatrix() const {
     // TODO: no need to compute this if position etc. hasn't changed
+    return getProjectionMatrix() * getViewMatrix();
+}
+
+glm::mat4 Camera::getViewMatrix() const {
+    return glm::lookAt(m_position, m_position + getForward(), Camera::UP);
+}
 
+glm::mat4 Camera::getProjectionMatrix() const {
     // NOTE: currently, camera is tied to render width and height
     f32 aspectRatio = (f32) core->gameState.renderOptions.width / core->gameState.renderOptions.height;
-
-    glm::mat4 viewMatrix = glm::lookAt(m_position, m_position + getForward(), Camera::UP);
-    glm::mat4 projectionMatrix = glm::perspective(m_fov, aspectRatio, m_nearPlane, m_farPlane);
-    return projectionMatrix * viewMatrix;
+    return glm::perspective(m_fov, aspectRatio, m_nearPlane, m_farPlane);
 }
 
 glm::vec3 Camera::getForward() const {
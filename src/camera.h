@@ -13,6 +13,10 @@ public:
 
     glm::mat4 getViewProjectionMatrix() const;
 
+    glm::mat4 getViewMatrix() const;
+
+    glm::mat4 getProjectionMatrix() const;
+
     glm::vec3 getForward() const;
 
     glm::vec3 getRight() const;
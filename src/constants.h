@@ -5,11 +5,83 @@ namespace consts {
 constexpr const char *APP_NAME = "acorn";
 constexpr u32 OPENGL_VERSION_MAJOR = 3;
 constexpr u32 OPENGL_VERSION_MINOR = 3;
+constexpr const char *CACHE_DIRECTORY = "../cache/";
 
 // Renderer
-constexpr u32 DIFFUSE_IRRADIANCE_TEXTURE_SIZE = 32;
+constexpr u32 ENVIRONMENT_MAP_TEXTURE_SIZE = 512;   // when converted from an equirectangular image
 constexpr u32 PREFILTERED_ENVIRONMENT_MAP_TEXTURE_SIZE = 128;
+constexpr u32 SKY_CAPTURE_TEXTURE_SIZE = 256;
+constexpr u32 IRRADIANCE_SH_READBACK_SIZE = 32;
 constexpr u32 BRDF_LUT_TEXTURE_SIZE = 512;
+
+// Clustered lighting, the view frustum is split into a grid of froxels with exponentially spaced depth slices.
+// Slices cover [CLUSTER_DEPTH_NEAR, CLUSTER_DEPTH_FAR], the first and last ones extend to the camera planes
+constexpr u32 CLUSTER_GRID_X = 16;
+constexpr u32 CLUSTER_GRID_Y = 9;
+constexpr u32 CLUSTER_GRID_Z = 24;
+constexpr f32 CLUSTER_DEPTH_NEAR = 0.1f;
+constexpr f32 CLUSTER_DEPTH_FAR = 500.0f;
+constexpr u32 MAX_LIGHTS = 65535;   // light indices are 16-bit
+
+// Shadows
+constexpr u32 MAX_SHADOW_CASCADES = 4;
+constexpr f32 SHADOW_CACHE_MARGIN = 0.25f;  // cached cascades cover this much more, so they last while moving
+
+// Dynamic resolution, the frame target is allocated at the maximum scale and rendered to in a scaled viewport
+constexpr f32 MAX_RESOLUTION_SCALE = 1.0f;
+constexpr f32 RESOLUTION_SCALE_STEP = 1.0f / 32.0f; // scales are quantized so small jitter doesn't resize
+constexpr f32 DYNAMIC_RESOLUTION_HEADROOM = 0.9f;   // fraction of the frame budget that is aimed for
+
+// Mesh levels of detail, generated at import by simplifying each level to a fraction of the previous one
+constexpr u32 MAX_MESH_LODS = 6;
+constexpr f32 MESH_LOD_REDUCTION = 0.5f;        // fraction of triangles a level is simplified to
+constexpr f32 MESH_LOD_MIN_REDUCTION = 0.85f;   // levels that keep more than this fraction aren't worth it
+constexpr u32 MESH_LOD_MIN_TRIANGLES = 32;
+constexpr f32 MESH_LOD_NORMAL_THRESHOLD = 0.5f; // cosine of the largest normal difference a collapse may smooth over
+constexpr f32 LOD_HYSTERESIS = 0.75f;           // going to a coarser level needs this much of the error threshold
+
+// Meshlets, each level of detail is split into clusters of triangles that are culled on their own
+constexpr u32 MESHLET_MAX_VERTICES = 64;
+constexpr u32 MESHLET_MAX_TRIANGLES = 124;
+constexpr u32 MESHLET_CULL_ENTITIES_PER_JOB = 16;
+
+// Software occlusion culling, the largest meshes are rasterized on the CPU into a small depth buffer. The buffer is
+// split into bins that are rasterized in parallel, and each bin into tiles of the hierarchical depth buffer
+constexpr u32 OCCLUSION_BUFFER_WIDTH = 256;
+constexpr u32 OCCLUSION_BUFFER_HEIGHT = 128;
+constexpr u32 OCCLUSION_BIN_WIDTH = 64;
+constexpr u32 OCCLUSION_BIN_HEIGHT = 32;
+constexpr u32 OCCLUSION_TILE_SIZE = 8;
+constexpr u32 OCCLUSION_MAX_TRIANGLES = 32768;  // occluder triangle budget per frame
+constexpr f32 OCCLUDER_MIN_SCREEN_SIZE = 0.1f;  // smaller meshes don't occlude, radius over half the screen height
+constexpr f32 OCCLUDER_LOD_ERROR_PIXELS = 0.5f; // largest error of an occluder level of detail, in buffer pixels
+
+// GPU occlusion queries, the bounding boxes of large meshes are tested against a hierarchical depth buffer of the
+// frame and the results skip their draws in the next frame with conditional rendering
+constexpr u32 OCCLUSION_HIZ_LEVELS = 6;             // the first level is half resolution
+constexpr u32 OCCLUSION_QUERY_MIN_TRIANGLES = 2048; // smaller meshes are cheaper to draw than to test
+constexpr u32 OCCLUSION_MAX_QUERIES = 1024;         // per frame
+constexpr u32 OCCLUSION_PROXY_MAX_TEXELS = 16;      // proxies are tested on the first level they are this small on
+constexpr f32 OCCLUSION_PROXY_MARGIN_PIXELS = 2.0f; // proxies are grown by this much so that small motion is hidden
+constexpr f32 OCCLUSION_QUERY_MAX_CAMERA_MOVE = 1.0f;       // larger camera moves in a frame discard the results
+constexpr f32 OCCLUSION_QUERY_MAX_CAMERA_TURN = 0.996f;     // cosine of the largest camera turn that keeps them
+
+// Post processing
+constexpr u32 BLOOM_NUM_MIPS = 6;               // levels of the bloom pyramid, the first is half resolution
+constexpr u32 COLOR_GRADING_LUT_SIZE = 32;
+
+// Auto exposure, a histogram of log2 luminance is built from a downsampled copy of the frame
+constexpr u32 LUMINANCE_TEXTURE_SIZE = 64;
+constexpr u32 HISTOGRAM_NUM_BINS = 64;
+constexpr f32 HISTOGRAM_MIN_LOG_LUMINANCE = -10.0f;
+constexpr f32 HISTOGRAM_MAX_LOG_LUMINANCE = 6.0f;
+constexpr f32 AUTO_EXPOSURE_LOW_PERCENTILE = 0.5f;  // darker pixels are ignored when averaging
+constexpr f32 AUTO_EXPOSURE_HIGH_PERCENTILE = 0.95f; // brighter pixels are ignored when averaging
+constexpr f32 AUTO_EXPOSURE_KEY = 0.18f;            // the average luminance is exposed to this value
+
+// Light benchmark
+constexpr u32 LIGHT_BENCHMARK_NUM_LIGHTS = 1000;
+constexpr f32 LIGHT_BENCHMARK_EXTENT = 10.0f;   // half size of the square the lights are spread over
 }
 
 #endif //ACORN_CONSTANTS_H
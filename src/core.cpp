@@ -5,7 +5,8 @@
 static Core core_local;
 Core *core = &core_local;
 
-Core::Core() {
+Core::Core()
+    : programBinaryCache(std::string(consts::CACHE_DIRECTORY) + "shaders/") {
     Log::debug("Core::Core()");
 }
 
@@ -33,6 +34,8 @@ void Core::run() {
             }
     };
 
+    boomBox.isStatic = true;
+    helmet.isStatic = true;
     gameState.scene.addEntity(boomBox);
     gameState.scene.addEntity(helmet);
 
@@ -73,7 +76,9 @@ void Core::run() {
             gameState.camera.addLookRotation(mouseDelta);
         }
 
-        renderer.render();
+        lightBenchmark.update(gameState.scene, dt);
+
+        renderer.render(dt);
 
         debugGui.draw();
     }
@@ -2,11 +2,15 @@
 #define ACORN_CORE_H
 
 #include "config.h"
+#include "job_system.h"
 #include "game_state.h"
 #include "platform.h"
+#include "graphics/program_binary_cache.h"
+#include "graphics/shader_watcher.h"
 #include "graphics/renderer.h"
 #include "resource_manager.h"
 #include "debug_gui.h"
+#include "light_benchmark.h"
 #include <string>
 
 class Core {
@@ -22,10 +26,14 @@ public:
 
     GameState gameState;
     Config config;
+    JobSystem jobSystem;
     Platform platform;
+    ProgramBinaryCache programBinaryCache;
+    ShaderWatcher shaderWatcher;
     Renderer renderer;
     ResourceManager resourceManager;
     DebugGui debugGui;
+    LightBenchmark lightBenchmark;
 };
 
 extern Core *core;
@@ -41,6 +41,22 @@ void DebugGui::draw() {
         ImGui::Text("%.2fms / %.2f FPS", 1000.0f / io.Framerate, io.Framerate);
         ImGui::Text("%d verts", stats.verticesRendered);
         ImGui::Text("%d draw calls", stats.drawCalls);
+        ImGui::Text("%d shader binds, %d material binds, %d material permutations", stats.shaderBinds,
+                    stats.materialBinds, stats.materialPermutations);
+        ImGui::Text("depth pre-pass %.2fms, shading %.2fms", stats.depthPrepassMs, stats.shadingMs);
+        ImGui::Text("overdraw %.2f (%llu samples shaded)", stats.overdraw, (unsigned long long)stats.shadedSamples);
+        ImGui::Checkbox("depth pre-pass", &core->gameState.renderOptions.depthPrepass);
+        ImGui::Text("gpu frame %.2fms, rendering at %dx%d (%.0f%%)", stats.gpuFrameMs, stats.renderWidth,
+                    stats.renderHeight, stats.resolutionScale * 100.0f);
+        ImGui::Checkbox("dynamic resolution", &core->gameState.renderOptions.dynamicResolution);
+        ImGui::SliderFloat("target frame (ms)", &core->gameState.renderOptions.targetFrameMs, 4.0f, 50.0f);
+        ImGui::SliderFloat("min resolution scale", &core->gameState.renderOptions.minResolutionScale, 0.25f, 1.0f);
+        ImGui::Text("%d lights, %d cluster light indices, assigned in %.2fms", stats.lights,
+                    stats.clusterLightIndices, stats.lightAssignmentMs);
+        bool lightBenchmark = core->lightBenchmark.isEnabled();
+        if (ImGui::Checkbox("light benchmark", &lightBenchmark)) {
+            core->lightBenchmark.setEnabled(core->gameState.scene, lightBenchmark);
+        }
         ImGui::Separator();
 
         f32 fov = core->gameState.camera.getFov();
@@ -63,6 +79,80 @@ void DebugGui::draw() {
         if (ImGui::Button("reload shaders")) {
             core->renderer.reloadShaders();
         }
+        ImGui::Separator();
+
+        ImGui::Text("Environment");
+        glm::vec3 sunDirection = core->gameState.scene.sunDirection;
+        if (ImGui::DragFloat3("sun direction", &sunDirection[0], 0.01f) && glm::length(sunDirection) > 0.0f) {
+            core->gameState.scene.sunDirection = glm::normalize(sunDirection);
+        }
+        const char *prefilterModes[] = {"reference", "filtered importance sampling"};
+        s32 prefilterMode = (s32)core->gameState.renderOptions.prefilterMode;
+        if (ImGui::Combo("prefilter mode", &prefilterMode, prefilterModes, IM_ARRAYSIZE(prefilterModes))) {
+            core->gameState.renderOptions.prefilterMode = (PrefilterModeEnum)prefilterMode;
+            core->renderer.requestIblProbeUpdate();
+        }
+        ImGui::SliderFloat("ibl update budget (ms)", &core->gameState.renderOptions.iblUpdateBudgetMs, 0.1f, 8.0f);
+        f32 iblUpdateProgress = core->renderer.getIblProbeUpdateProgress();
+        if (iblUpdateProgress >= 0) {
+            ImGui::ProgressBar(iblUpdateProgress);
+        } else {
+            ImGui::Text("ibl probe up to date");
+        }
+        if (ImGui::Button("update ibl probe")) {
+            core->renderer.updateIblProbe();
+        }
+        ImGui::Separator();
+
+        ImGui::Text("Shadows");
+        RenderOptions &options = core->gameState.renderOptions;
+        s32 numCascades = options.numShadowCascades;
+        if (ImGui::SliderInt("cascades", &numCascades, 1, consts::MAX_SHADOW_CASCADES)) {
+            options.numShadowCascades = numCascades;
+        }
+        const char *shadowMapSizes[] = {"1024", "2048", "4096"};
+        s32 shadowMapSizeIndex = options.shadowMapSize <= 1024 ? 0 : options.shadowMapSize <= 2048 ? 1 : 2;
+        if (ImGui::Combo("resolution", &shadowMapSizeIndex, shadowMapSizes, IM_ARRAYSIZE(shadowMapSizes))) {
+            options.shadowMapSize = 1024u << (u32)shadowMapSizeIndex;
+        }
+        ImGui::SliderFloat("distance", &options.shadowDistance, 5.0f, 200.0f);
+        ImGui::SliderFloat("split lambda", &options.shadowSplitLambda, 0.0f, 1.0f);
+        ImGui::Text("%d shadow passes in %.2fms", stats.shadowPasses, stats.shadowMs);
+        ImGui::Separator();
+
+        ImGui::Text("Level of Detail");
+        ImGui::Checkbox("mesh lods", &options.meshLods);
+        ImGui::SliderFloat("lod error (pixels)", &options.lodErrorPixels, 0.25f, 8.0f);
+        ImGui::Text("%d draw items below full detail", stats.reducedLodItems);
+        ImGui::Checkbox("meshlet culling", &options.meshletCulling);
+        ImGui::Text("%d of %d meshlets culled in %.2fms", stats.meshletsCulled, stats.meshletsTested,
+                    stats.meshletCullingMs);
+        ImGui::Checkbox("occlusion culling", &options.occlusionCulling);
+        ImGui::Text("%d occluders (%d triangles) rasterized in %.2fms", stats.occluders, stats.occluderTriangles,
+                    stats.occluderRasterizationMs);
+        ImGui::Text("%d draw items occluded in %.2fms", stats.occludedItems, stats.occlusionCullingMs);
+        ImGui::Checkbox("gpu occlusion queries", &options.gpuOcclusionQueries);
+        ImGui::Text("%d queries in %.2fms, %d conditional draws", stats.occlusionQueries, stats.occlusionQueryMs,
+                    stats.conditionalDraws);
+        ImGui::Separator();
+
+        ImGui::Text("Post Processing");
+        ImGui::Checkbox("bloom", &options.bloom);
+        ImGui::SliderFloat("bloom intensity", &options.bloomIntensity, 0.0f, 0.5f);
+        ImGui::Checkbox("color grading", &options.colorGrading);
+        ImGui::SliderFloat("saturation", &options.grading.saturation, 0.0f, 2.0f);
+        ImGui::SliderFloat("contrast", &options.grading.contrast, 0.5f, 1.5f);
+        ImGui::SliderFloat("temperature", &options.grading.temperature, -1.0f, 1.0f);
+        ImGui::Checkbox("dithering", &options.dithering);
+        ImGui::Separator();
+
+        ImGui::Text("Auto Exposure");
+        ImGui::Checkbox("auto exposure", &options.autoExposure);
+        ImGui::SliderFloat("compensation (stops)", &options.exposureCompensation, -5.0f, 5.0f);
+        ImGui::SliderFloat("adaptation speed up", &options.adaptationSpeedUp, 0.1f, 10.0f);
+        ImGui::SliderFloat("adaptation speed down", &options.adaptationSpeedDown, 0.1f, 10.0f);
+        ImGui::Text("exposure %.3f, average luminance %.3f, histogram %.2fms", stats.exposure, stats.averageLuminance,
+                    stats.autoExposureMs);
     }
     ImGui::End();
 
@@ -11,6 +11,8 @@ struct Entity {
     Model *model = nullptr;
     Transform transform = {};
     bool active = true;
+    bool isStatic = false;      // static entities don't move, so cached shadow cascades can keep them
+    bool castsShadows = true;
 };
 
 #endif //ACORN_ENTITY_H
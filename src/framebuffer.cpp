@@ -77,6 +77,105 @@ void Framebuffer::attachTexture(const TextureCubemap &texture, u32 target, u32 l
     glBindFramebuffer(GL_FRAMEBUFFER, previouslyBound);
 }
 
+void Framebuffer::attachTextureLayered(const TextureCubemap &texture, u32 level) {
+    m_width = texture.getSideLength();
+    m_height = texture.getSideLength();
+
+    s32 previouslyBound;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previouslyBound);
+
+    bind();
+
+    // Layered framebuffers need every attachment to be layered, so drop the depth renderbuffer
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, 0);
+    glDeleteRenderbuffers(1, &m_depthRenderbuffer);
+    m_depthRenderbuffer = 0;
+
+    // Set texture
+    glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture.getId(), level);
+
+    checkCompleteness();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previouslyBound);
+}
+
+void Framebuffer::attachColorTexture(const Texture2D &texture) {
+    m_width = texture.getWidth();
+    m_height = texture.getHeight();
+
+    s32 previouslyBound;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previouslyBound);
+
+    bind();
+
+    // A leftover renderbuffer of another size would limit the render area
+    if (m_depthRenderbuffer != 0) {
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, 0);
+        glDeleteRenderbuffers(1, &m_depthRenderbuffer);
+        m_depthRenderbuffer = 0;
+    }
+
+    // Set texture
+    glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture.getId(), 0);
+
+    checkCompleteness();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previouslyBound);
+}
+
+void Framebuffer::attachTextures(const Texture2D &color, const Texture2D &depth) {
+    m_width = color.getWidth();
+    m_height = color.getHeight();
+
+    s32 previouslyBound;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previouslyBound);
+
+    bind();
+
+    // Depth comes from the texture, so there is no renderbuffer
+    if (m_depthRenderbuffer != 0) {
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, 0);
+        glDeleteRenderbuffers(1, &m_depthRenderbuffer);
+        m_depthRenderbuffer = 0;
+    }
+
+    // Set textures
+    glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, color.getId(), 0);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depth.getId(), 0);
+
+    checkCompleteness();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previouslyBound);
+}
+
+void Framebuffer::attachDepthTexture(const Texture2DArray &texture, u32 layer) {
+    m_width = texture.getWidth();
+    m_height = texture.getHeight();
+
+    s32 previouslyBound;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previouslyBound);
+
+    bind();
+
+    // Depth comes from the texture, so there is no renderbuffer and no color
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, 0);
+    glDeleteRenderbuffers(1, &m_depthRenderbuffer);
+    m_depthRenderbuffer = 0;
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, 0, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+
+    // Set texture
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture.getId(), 0, layer);
+
+    checkCompleteness();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previouslyBound);
+}
+
 void Framebuffer::setViewport(u32 mip_level) {
     f32 scale = mip_level == 0 ? 1 : std::pow(0.5f, mip_level);
     glViewport(0, 0, (u32)(m_width * scale), (u32)(m_height * scale));
@@ -125,7 +224,10 @@ void Framebuffer::handleRenderbufferCreation() {
     glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, m_width, m_height);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthRenderbuffer);
 
-    // Verify framebuffer completeness
+    checkCompleteness();
+}
+
+void Framebuffer::checkCompleteness() const {
     u32 status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
     if (status != GL_FRAMEBUFFER_COMPLETE) {
         Log::fatal("Framebuffer #%d is incomplete: %d", m_id, status);
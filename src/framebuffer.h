@@ -22,6 +22,26 @@ public:
     /// \param level Mipmap level
     void attachTexture(const TextureCubemap &texture, u32 target, u32 level = 0);
 
+    /// Attach all faces of a cubemap mip level as a layered color attachment, selected with gl_Layer.
+    /// Layered framebuffers have no depth attachment
+    /// \param texture Cubemap texture to attach
+    /// \param level Mipmap level
+    void attachTextureLayered(const TextureCubemap &texture, u32 level = 0);
+
+    /// Attach a 2D texture without a depth renderbuffer, for fullscreen passes
+    /// \param texture 2D texture to attach
+    void attachColorTexture(const Texture2D &texture);
+
+    /// Attach a color texture along with a depth texture of the same size, so depth can be sampled afterwards
+    /// \param color 2D texture to render color to
+    /// \param depth 2D texture with a depth format
+    void attachTextures(const Texture2D &color, const Texture2D &depth);
+
+    /// Attach a layer of a depth texture array as the only attachment, for depth-only rendering
+    /// \param texture Texture array with a depth format
+    /// \param layer Layer to attach
+    void attachDepthTexture(const Texture2DArray &texture, u32 layer);
+
     void setViewport(u32 mip_level = 0);
 
     void bind();
@@ -33,6 +53,8 @@ public:
 private:
     void handleRenderbufferCreation();
 
+    void checkCompleteness() const;
+
     u32 m_id = 0;
     u32 m_depthRenderbuffer = 0;
     u32 m_width = 0;
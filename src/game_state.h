@@ -7,10 +7,47 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 
+/// How the specular environment map is prefiltered
+enum class PrefilterModeEnum : u32 {
+    REFERENCE = 0,                 // 1024 GGX samples of the base level per texel
+    FILTERED_IMPORTANCE_SAMPLING   // few samples with roughness dependent counts, reading lower mip levels
+};
+
+/// Color grading that is baked into a 3D lookup table, applied to display values after tonemapping
+struct ColorGrading {
+    f32 saturation = 1.0f;
+    f32 contrast = 1.0f;
+    f32 temperature = 0.0f;     // white balance in [-1, 1], negative is cooler and positive is warmer
+};
+
 struct RenderOptions {
     u32 width = 800;
     u32 height = 600;
     u32 vsyncNumSwapFrames = 0;
+    PrefilterModeEnum prefilterMode = PrefilterModeEnum::FILTERED_IMPORTANCE_SAMPLING;
+    f32 iblUpdateBudgetMs = 1.0f;   // GPU time per frame spent on time-sliced IBL probe updates
+    bool depthPrepass = true;       // lay down depth first, so the material pass only shades visible fragments
+    u32 shadowMapSize = 2048;       // resolution of each cascade
+    u32 numShadowCascades = 4;      // up to consts::MAX_SHADOW_CASCADES
+    f32 shadowDistance = 60.0f;     // view depth that the last cascade ends at
+    f32 shadowSplitLambda = 0.8f;   // cascade splits blend from uniform (0) to logarithmic (1)
+    bool dynamicResolution = true;  // scale the rendered resolution to keep the GPU frame time on target
+    f32 targetFrameMs = 16.6f;      // GPU frame budget of dynamic resolution
+    f32 minResolutionScale = 0.5f;  // lowest scale of width and height dynamic resolution goes to
+    bool bloom = true;
+    f32 bloomIntensity = 0.04f;     // fraction of the blurred image mixed into the frame
+    bool colorGrading = true;
+    ColorGrading grading;
+    bool dithering = true;          // hide banding of the 8-bit output
+    bool autoExposure = true;       // expose from a luminance histogram instead of the camera exposure
+    f32 exposureCompensation = 0.0f;    // in stops, added to auto exposure
+    f32 adaptationSpeedUp = 3.0f;   // how fast auto exposure adapts to brighter scenes, per second
+    f32 adaptationSpeedDown = 1.0f; // how fast auto exposure adapts to darker scenes, per second
+    bool meshLods = true;           // draw distant meshes with their simplified levels of detail
+    f32 lodErrorPixels = 1.0f;      // how many pixels a level of detail may deviate from full detail on screen
+    bool meshletCulling = true;     // cull meshlets outside of the frustum or facing away from the camera
+    bool occlusionCulling = true;   // cull meshes hidden behind large occluders, rasterized on the CPU
+    bool gpuOcclusionQueries = true;    // skip large meshes whose bounds were hidden last frame on the GPU
 };
 
 struct GameState {
@@ -0,0 +1,207 @@
+#include "auto_exposure.h"
+#include "render_context.h"
+#include "game_state.h"
+#include "constants.h"
+#include "log.h"
+#include <algorithm>
+#include <cmath>
+
+AutoExposure::AutoExposure()
+    : m_luminanceShader("../assets/shaders/fullscreen.vert", "../assets/shaders/luminance.frag"),
+      m_histogramShader("../assets/shaders/histogram.vert", "../assets/shaders/histogram.frag"),
+      m_histogramData(consts::HISTOGRAM_NUM_BINS) {
+    Log::debug("AutoExposure::AutoExposure()");
+
+    // the compute path needs a 4.3 context, which drivers usually hand out even though 3.3 is requested
+    if (gl3wIsSupported(4, 3)) {
+        m_histogramComputeShader.reset(new Shader("../assets/shaders/histogram.comp"));
+    }
+    Log::info("Luminance histogram is built with %s",
+              m_histogramComputeShader ? "a compute shader" : "point scattering and blending");
+
+    m_luminanceTexture.setImage(consts::LUMINANCE_TEXTURE_SIZE, consts::LUMINANCE_TEXTURE_SIZE,
+                                TextureFormatEnum::R16F);
+    m_histogramTexture.setImage(consts::HISTOGRAM_NUM_BINS, 1, TextureFormatEnum::R32F);
+
+    // points are generated from gl_VertexID, there are no attributes
+    glGenVertexArrays(1, &m_pointsVao);
+    if (m_pointsVao == 0) {
+        Log::fatal("Failed to generate auto exposure VAO");
+    }
+
+    glGenBuffers(NUM_READBACKS, m_readbackPbos);
+    for (u32 pbo : m_readbackPbos) {
+        if (pbo == 0) {
+            Log::fatal("Failed to generate histogram readback PBO");
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, consts::HISTOGRAM_NUM_BINS * sizeof(f32), nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+AutoExposure::~AutoExposure() {
+    Log::debug("AutoExposure::~AutoExposure()");
+
+    for (GLsync fence : m_readbackFences) {
+        glDeleteSync(fence);
+    }
+    glDeleteBuffers(NUM_READBACKS, m_readbackPbos);
+    glDeleteVertexArrays(1, &m_pointsVao);
+}
+
+void AutoExposure::update(RenderContext &ctx, const Texture2D &frame, glm::uvec2 region, f32 dt,
+                          const RenderOptions &options) {
+    m_timer.begin();
+
+    // the mip chain is the reduction, the level that is about as large as the luminance texture is sampled
+    frame.generateMipmap();
+    f32 lod = std::max(0.0f, std::log2((f32)std::max(region.x, region.y) / consts::LUMINANCE_TEXTURE_SIZE));
+
+    ctx.setColorRenderTarget(m_luminanceTexture);
+    ctx.setState(RenderStateBuilder()
+                 .setDepthTest(false)
+                 .build());
+
+    m_luminanceShader.bind();
+    m_luminanceShader.setUniform("uImage", frame);
+    m_luminanceShader.setUniform("uImageRegion", glm::vec2(region) / glm::vec2(frame.getWidth(), frame.getHeight()));
+    m_luminanceShader.setUniform("uLod", lod);
+
+    glBindVertexArray(m_pointsVao);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindVertexArray(0);
+
+    buildHistogram(ctx);
+    startReadback();
+
+    m_timer.end();
+
+    finishReadbacks();
+    if (!m_hasTarget) {
+        return;
+    }
+
+    // the first measurement is taken as is, after that the eye adapts exponentially
+    if (!m_adapted) {
+        m_adaptedLogLuminance = m_targetLogLuminance;
+        m_adapted = true;
+    } else {
+        f32 speed = m_targetLogLuminance > m_adaptedLogLuminance ? options.adaptationSpeedUp
+                                                                 : options.adaptationSpeedDown;
+        m_adaptedLogLuminance += (m_targetLogLuminance - m_adaptedLogLuminance) * (1.0f - std::exp(-dt * speed));
+    }
+
+    m_exposure = consts::AUTO_EXPOSURE_KEY / std::exp2(m_adaptedLogLuminance) *
+                 std::exp2(options.exposureCompensation);
+}
+
+void AutoExposure::buildHistogram(RenderContext &ctx) {
+    f32 logLuminanceRange = consts::HISTOGRAM_MAX_LOG_LUMINANCE - consts::HISTOGRAM_MIN_LOG_LUMINANCE;
+    Shader &shader = m_histogramComputeShader ? *m_histogramComputeShader : m_histogramShader;
+
+    shader.bind();
+    shader.setUniform("uLogLuminance", m_luminanceTexture);
+    shader.setUniform("uMinLogLuminance", consts::HISTOGRAM_MIN_LOG_LUMINANCE);
+    shader.setUniform("uInverseLogLuminanceRange", 1.0f / logLuminanceRange);
+
+    if (m_histogramComputeShader) {
+        glBindImageTexture(0, m_histogramTexture.getId(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute(1, 1, 1);
+
+        // the readback goes through glGetTexImage
+        glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+        return;
+    }
+
+    ctx.setColorRenderTarget(m_histogramTexture);
+    ctx.clear(RenderContext::CLEAR_COLOR);
+    ctx.setState(RenderStateBuilder()
+                 .setDepthTest(false)
+                 .setBlendMode(BlendModeEnum::ADDITIVE)
+                 .build());
+
+    glBindVertexArray(m_pointsVao);
+    glDrawArrays(GL_POINTS, 0, consts::LUMINANCE_TEXTURE_SIZE * consts::LUMINANCE_TEXTURE_SIZE);
+    glBindVertexArray(0);
+}
+
+void AutoExposure::startReadback() {
+    // every PBO is still waiting for the GPU, this frame isn't measured
+    if (m_readbackFences[m_nextReadback]) {
+        return;
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, m_readbackPbos[m_nextReadback]);
+    m_histogramTexture.getImage(TextureFormatEnum::R32F, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    m_readbackFences[m_nextReadback] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_nextReadback = (m_nextReadback + 1) % NUM_READBACKS;
+}
+
+void AutoExposure::finishReadbacks() {
+    // the oldest readback is the next one to be reused
+    for (u32 i = 0; i < NUM_READBACKS; ++i) {
+        u32 readback = (m_nextReadback + i) % NUM_READBACKS;
+        if (!m_readbackFences[readback]) {
+            continue;
+        }
+
+        GLenum status = glClientWaitSync(m_readbackFences[readback], 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            break;
+        }
+        glDeleteSync(m_readbackFences[readback]);
+        m_readbackFences[readback] = nullptr;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, m_readbackPbos[readback]);
+        void *data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, m_histogramData.size() * sizeof(f32),
+                                      GL_MAP_READ_BIT);
+        if (data) {
+            std::copy_n((const f32 *)data, m_histogramData.size(), m_histogramData.data());
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+
+            f32 averageLogLuminance;
+            if (computeAverageLogLuminance(m_histogramData.data(), &averageLogLuminance)) {
+                m_targetLogLuminance = averageLogLuminance;
+                m_hasTarget = true;
+            }
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+}
+
+bool AutoExposure::computeAverageLogLuminance(const f32 *histogram, f32 *average_log_luminance) const {
+    f32 total = 0.0f;
+    for (u32 bin = 0; bin < consts::HISTOGRAM_NUM_BINS; ++bin) {
+        total += histogram[bin];
+    }
+
+    // only the part of each bin that lies between the percentiles counts
+    f32 low = total * consts::AUTO_EXPOSURE_LOW_PERCENTILE;
+    f32 high = total * consts::AUTO_EXPOSURE_HIGH_PERCENTILE;
+    f32 binSize = (consts::HISTOGRAM_MAX_LOG_LUMINANCE - consts::HISTOGRAM_MIN_LOG_LUMINANCE) /
+                  consts::HISTOGRAM_NUM_BINS;
+
+    f32 cumulative = 0.0f;
+    f32 weightedSum = 0.0f;
+    f32 weightSum = 0.0f;
+    for (u32 bin = 0; bin < consts::HISTOGRAM_NUM_BINS; ++bin) {
+        f32 weight = std::min(cumulative + histogram[bin], high) - std::max(cumulative, low);
+        cumulative += histogram[bin];
+        if (weight <= 0.0f) {
+            continue;
+        }
+
+        weightedSum += weight * (consts::HISTOGRAM_MIN_LOG_LUMINANCE + (bin + 0.5f) * binSize);
+        weightSum += weight;
+    }
+
+    if (weightSum <= 0.0f) {
+        return false;
+    }
+
+    *average_log_luminance = weightedSum / weightSum;
+    return true;
+}
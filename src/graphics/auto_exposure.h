@@ -0,0 +1,85 @@
+#ifndef ACORN_AUTO_EXPOSURE_H
+#define ACORN_AUTO_EXPOSURE_H
+
+#include "types.h"
+#include "texture.h"
+#include "shader.h"
+#include "gpu_timer.h"
+#include <glm/glm.hpp>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+class RenderContext;
+struct RenderOptions;
+
+/// Exposes the frame from a histogram of its log2 luminance. The frame is reduced with its mip chain into a small
+/// luminance texture, which is scattered into histogram bins with additive blending, or counted by a compute shader
+/// on OpenGL 4.3. The histogram is read back through a ring of PBOs a few frames later, so the CPU never waits
+class AutoExposure {
+public:
+    AutoExposure();
+    ~AutoExposure();
+
+    /// Build the histogram of a frame, collect finished readbacks and adapt the exposure towards them
+    /// \param frame HDR frame, its mipmaps are regenerated
+    /// \param region Size of the rendered part of the frame in texels
+    /// \param dt Seconds since the last update
+    void update(RenderContext &ctx, const Texture2D &frame, glm::uvec2 region, f32 dt, const RenderOptions &options);
+
+    /// Exposure for tonemapping, including the exposure compensation
+    f32 getExposure() const {
+        return m_exposure;
+    }
+
+    /// Average luminance the exposure is adapted to
+    f32 getAverageLuminance() const {
+        return std::exp2(m_adaptedLogLuminance);
+    }
+
+    /// GPU time of the reduction and histogram passes
+    f32 getMilliseconds() {
+        return m_timer.getMilliseconds();
+    }
+
+    bool isComputeSupported() const {
+        return m_histogramComputeShader != nullptr;
+    }
+
+private:
+    /// Count the texels of the luminance texture into m_histogram
+    void buildHistogram(RenderContext &ctx);
+
+    /// Copy m_histogram into the next free PBO, skipped if all of them are still in flight
+    void startReadback();
+
+    /// Take the newest finished readback and use it as the new adaptation target
+    void finishReadbacks();
+
+    /// Average log2 luminance of the histogram between the percentiles
+    /// \return Whether the histogram had anything in that range
+    bool computeAverageLogLuminance(const f32 *histogram, f32 *average_log_luminance) const;
+
+    static constexpr u32 NUM_READBACKS = 3;
+
+    Shader m_luminanceShader;
+    Shader m_histogramShader;
+    std::unique_ptr<Shader> m_histogramComputeShader;
+    Texture2D m_luminanceTexture;
+    Texture2D m_histogramTexture;
+    u32 m_pointsVao = 0;
+
+    u32 m_readbackPbos[NUM_READBACKS] = {};
+    GLsync m_readbackFences[NUM_READBACKS] = {};
+    u32 m_nextReadback = 0;
+    std::vector<f32> m_histogramData;
+
+    GpuTimer m_timer;
+    bool m_hasTarget = false;
+    bool m_adapted = false;
+    f32 m_targetLogLuminance = 0.0f;
+    f32 m_adaptedLogLuminance = 0.0f;
+    f32 m_exposure = 1.0f;
+};
+
+#endif //ACORN_AUTO_EXPOSURE_H
@@ -0,0 +1,195 @@
+#include "cascaded_shadow_maps.h"
+#include "camera.h"
+#include "game_state.h"
+#include "shader.h"
+#include "log.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+CascadedShadowMaps::CascadedShadowMaps() {
+    Log::debug("CascadedShadowMaps::CascadedShadowMaps()");
+}
+
+void CascadedShadowMaps::update(const Camera &camera, glm::vec3 sun_direction, const RenderOptions &options,
+                                const std::vector<DrawEntity> &entities, u32 static_version) {
+    m_passes.clear();
+    m_numCascades = glm::clamp(options.numShadowCascades, 1u, consts::MAX_SHADOW_CASCADES);
+
+    // a moved sun or static caster invalidates every cache
+    bool invalidateCaches = sun_direction != m_sunDirection || static_version != m_staticVersion;
+    m_sunDirection = sun_direction;
+    m_staticVersion = static_version;
+
+    if (m_shadowMap.getWidth() != options.shadowMapSize) {
+        m_shadowMap.setImage(options.shadowMapSize, options.shadowMapSize, 2 * consts::MAX_SHADOW_CASCADES,
+                             TextureFormatEnum::DEPTH32F);
+        invalidateCaches = true;
+    }
+
+    if (invalidateCaches) {
+        for (Cascade &cascade : m_cascades) {
+            cascade.cacheValid = false;
+            cascade.layerMatchesCache = false;
+        }
+    }
+
+    // only the rotation of the light matters, cascades are positioned by their projection
+    glm::vec3 up = std::abs(sun_direction.y) > 0.99f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+    m_lightView = glm::lookAt(glm::vec3(0), -sun_direction, up);
+
+    // light space bounds of every entity, all cascades test against these
+    m_entities = &entities;
+    m_casterMin.resize(entities.size());
+    m_casterMax.resize(entities.size());
+    glm::mat3 rotation = glm::mat3(m_lightView);
+    glm::mat3 absRotation = glm::mat3(glm::abs(rotation[0]), glm::abs(rotation[1]), glm::abs(rotation[2]));
+    for (u32 i = 0; i < entities.size(); ++i) {
+        glm::vec3 center = rotation * ((entities[i].boundsMin + entities[i].boundsMax) * 0.5f);
+        glm::vec3 extent = absRotation * ((entities[i].boundsMax - entities[i].boundsMin) * 0.5f);
+        m_casterMin[i] = center - extent;
+        m_casterMax[i] = center + extent;
+    }
+
+    // practical split scheme, blending logarithmic and uniform splits
+    f32 nearPlane = camera.getNearPlane();
+    f32 farPlane = std::max(options.shadowDistance, nearPlane * 2.0f);
+    for (u32 i = 0; i <= m_numCascades; ++i) {
+        f32 fraction = (f32)i / m_numCascades;
+        f32 logSplit = nearPlane * std::pow(farPlane / nearPlane, fraction);
+        f32 uniformSplit = nearPlane + (farPlane - nearPlane) * fraction;
+        m_splitDepths[i] = glm::mix(uniformSplit, logSplit, options.shadowSplitLambda);
+    }
+
+    // slices of the frustum are bounded by spheres, which don't change size when the camera turns
+    f32 aspectRatio = (f32)options.width / options.height;
+    f32 diagonalSlope = std::tan(camera.getFov() * 0.5f) * std::sqrt(1.0f + aspectRatio * aspectRatio);
+    f32 slopeSquared = diagonalSlope * diagonalSlope;
+
+    for (u32 c = 0; c < m_numCascades; ++c) {
+        Cascade &cascade = m_cascades[c];
+        f32 sliceNear = m_splitDepths[c];
+        f32 sliceFar = m_splitDepths[c + 1];
+
+        f32 centerDepth, radius;
+        if (slopeSquared >= (sliceFar - sliceNear) / (sliceFar + sliceNear)) {
+            centerDepth = sliceFar;
+            radius = sliceFar * diagonalSlope;
+        } else {
+            centerDepth = 0.5f * (sliceFar + sliceNear) * (1.0f + slopeSquared);
+            radius = 0.5f * std::sqrt((sliceFar - sliceNear) * (sliceFar - sliceNear) +
+                                      2.0f * (sliceFar * sliceFar + sliceNear * sliceNear) * slopeSquared +
+                                      (sliceFar + sliceNear) * (sliceFar + sliceNear) * slopeSquared * slopeSquared);
+        }
+        glm::vec3 center = camera.getPosition() + camera.getForward() * centerDepth;
+
+        // the near cascade has the most detail and is rendered every frame
+        if (c == 0) {
+            cascade.viewProjection = getCascadeViewProjection(center, radius);
+            cascade.texelWorldSize = 2.0f * radius / options.shadowMapSize;
+            collectCasters(center, radius, true, &addPass(c, -1, cascade.viewProjection).casters);
+            collectCasters(center, radius, false, &m_passes.back().casters);
+            continue;
+        }
+
+        // re-render the cache if it doesn't cover this frame's slice anymore
+        u32 cacheLayer = consts::MAX_SHADOW_CASCADES + c;
+        bool cacheCovers = glm::length(center - cascade.cacheCenter) + radius <= cascade.cacheRadius;
+        if (!cascade.cacheValid || !cacheCovers) {
+            cascade.cacheCenter = center;
+            cascade.cacheRadius = radius * (1.0f + consts::SHADOW_CACHE_MARGIN);
+            cascade.cacheValid = true;
+            cascade.layerMatchesCache = false;
+            cascade.viewProjection = getCascadeViewProjection(cascade.cacheCenter, cascade.cacheRadius);
+            cascade.texelWorldSize = 2.0f * cascade.cacheRadius / options.shadowMapSize;
+
+            collectCasters(cascade.cacheCenter, cascade.cacheRadius, true,
+                           &addPass(cacheLayer, -1, cascade.viewProjection).casters);
+        }
+
+        // dynamic casters go on top of a copy of the cache, which is skipped if the layer already is one
+        std::vector<u32> dynamicCasters;
+        collectCasters(cascade.cacheCenter, cascade.cacheRadius, false, &dynamicCasters);
+        if (!dynamicCasters.empty() || !cascade.layerMatchesCache) {
+            addPass(c, cacheLayer, cascade.viewProjection).casters = std::move(dynamicCasters);
+            cascade.layerMatchesCache = m_passes.back().casters.empty();
+        }
+    }
+}
+
+void CascadedShadowMaps::beginPass(const ShadowPass &pass) {
+    m_framebuffer.attachDepthTexture(m_shadowMap, pass.layer);
+
+    if (pass.copyFromLayer >= 0) {
+        m_copyFramebuffer.attachDepthTexture(m_shadowMap, pass.copyFromLayer);
+        m_copyFramebuffer.blit(m_framebuffer, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    }
+
+    m_framebuffer.bind();
+    m_framebuffer.setViewport();
+
+    if (pass.copyFromLayer < 0) {
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+}
+
+void CascadedShadowMaps::bindTextures(Shader &shader) const {
+    shader.setUniform("uShadowMap", m_shadowMap);
+}
+
+void CascadedShadowMaps::setUniforms(Shader &shader) const {
+    // maps world space to shadow map texture coordinates and depth
+    glm::mat4 bias = glm::translate(glm::mat4(1), glm::vec3(0.5f)) * glm::scale(glm::mat4(1), glm::vec3(0.5f));
+
+    shader.setUniform("uNumShadowCascades", (s32)m_numCascades);
+    for (u32 c = 0; c < m_numCascades; ++c) {
+        std::string index = "[" + std::to_string(c) + "]";
+        shader.setUniform("uShadowMatrices" + index, bias * m_cascades[c].viewProjection);
+        shader.setUniform("uShadowCascadeFarDepths" + index, m_splitDepths[c + 1]);
+        shader.setUniform("uShadowTexelWorldSizes" + index, m_cascades[c].texelWorldSize);
+    }
+}
+
+glm::mat4 CascadedShadowMaps::getCascadeViewProjection(glm::vec3 center, f32 radius) const {
+    // moving the projection in whole texels keeps the rasterization of static casters the same
+    glm::vec3 lightCenter = glm::vec3(m_lightView * glm::vec4(center, 1));
+    f32 texelSize = 2.0f * radius / m_shadowMap.getWidth();
+    lightCenter.x = std::floor(lightCenter.x / texelSize) * texelSize;
+    lightCenter.y = std::floor(lightCenter.y / texelSize) * texelSize;
+
+    // casters between the sun and the sphere are drawn with depth clamping, so the depth range only has to cover
+    // the sphere itself
+    glm::mat4 projection = glm::ortho(lightCenter.x - radius, lightCenter.x + radius,
+                                      lightCenter.y - radius, lightCenter.y + radius,
+                                      -(lightCenter.z + radius), -(lightCenter.z - radius));
+    return projection * m_lightView;
+}
+
+void CascadedShadowMaps::collectCasters(glm::vec3 center, f32 radius, bool static_casters,
+                                        std::vector<u32> *casters) const {
+    glm::vec3 lightCenter = glm::vec3(m_lightView * glm::vec4(center, 1));
+
+    for (u32 i = 0; i < m_entities->size(); ++i) {
+        const DrawEntity &entity = (*m_entities)[i];
+        if (!entity.castsShadows || entity.isStatic != static_casters) {
+            continue;
+        }
+
+        // the light looks down -z, so anything with a larger z is closer to the sun
+        const glm::vec3 &min = m_casterMin[i];
+        const glm::vec3 &max = m_casterMax[i];
+        if (max.x < lightCenter.x - radius || min.x > lightCenter.x + radius ||
+            max.y < lightCenter.y - radius || min.y > lightCenter.y + radius ||
+            max.z < lightCenter.z - radius) {
+            continue;
+        }
+
+        casters->push_back(i);
+    }
+}
+
+ShadowPass &CascadedShadowMaps::addPass(u32 layer, s32 copy_from_layer, const glm::mat4 &view_projection) {
+    m_passes.push_back({layer, copy_from_layer, view_projection, {}});
+    return m_passes.back();
+}
@@ -0,0 +1,90 @@
+#ifndef ACORN_CASCADED_SHADOW_MAPS_H
+#define ACORN_CASCADED_SHADOW_MAPS_H
+
+#include "types.h"
+#include "constants.h"
+#include "draw_item.h"
+#include "texture.h"
+#include "framebuffer.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+class Camera;
+class Shader;
+struct RenderOptions;
+
+/// Rendering of a layer of the shadow map array
+struct ShadowPass {
+    u32 layer;
+    s32 copyFromLayer;          // layer to start from, or -1 to start from a cleared layer
+    glm::mat4 viewProjection;
+    std::vector<u32> casters;   // indices of draw entities to render
+};
+
+/// Cascaded shadow maps for the sun. Cascades are bounded by spheres around slices of the view frustum and snapped
+/// to texels, so they don't shimmer when the camera moves or turns. All but the first cascade render static casters
+/// into a cache layer that is kept until the sun or static geometry changes, or the camera leaves the cached area.
+/// Dynamic casters are drawn on top of a copy of the cache every frame
+class CascadedShadowMaps {
+public:
+    CascadedShadowMaps();
+
+    /// Fit the cascades to a camera and work out which layers have to be rendered this frame
+    void update(const Camera &camera, glm::vec3 sun_direction, const RenderOptions &options,
+                const std::vector<DrawEntity> &entities, u32 static_version);
+
+    /// Get the passes found by the last update
+    const std::vector<ShadowPass> &getPasses() const {
+        return m_passes;
+    }
+
+    /// Bind the layer of a pass for rendering and fill it with the starting depth
+    void beginPass(const ShadowPass &pass);
+
+    /// Bind the shadow map to a shader
+    void bindTextures(Shader &shader) const;
+
+    /// Set the cascade matrices and split depths of a shader
+    void setUniforms(Shader &shader) const;
+
+private:
+    struct Cascade {
+        glm::mat4 viewProjection = glm::mat4(1);
+        f32 texelWorldSize = 0;
+
+        // sphere that the cache layer was rendered for
+        glm::vec3 cacheCenter = glm::vec3(0);
+        f32 cacheRadius = 0;
+        bool cacheValid = false;
+        bool layerMatchesCache = false;     // no dynamic casters were drawn over the copy of the cache
+    };
+
+    /// Build a texel snapped projection of a sphere in light space
+    glm::mat4 getCascadeViewProjection(glm::vec3 center, f32 radius) const;
+
+    /// Get the draw entities that can cast shadows into a sphere
+    void collectCasters(glm::vec3 center, f32 radius, bool static_casters, std::vector<u32> *casters) const;
+
+    ShadowPass &addPass(u32 layer, s32 copy_from_layer, const glm::mat4 &view_projection);
+
+    Texture2DArray m_shadowMap;     // cascades followed by their cache layers
+    Framebuffer m_framebuffer;
+    Framebuffer m_copyFramebuffer;
+
+    Cascade m_cascades[consts::MAX_SHADOW_CASCADES];
+    f32 m_splitDepths[consts::MAX_SHADOW_CASCADES + 1] = {};
+    u32 m_numCascades = 0;
+
+    glm::mat4 m_lightView = glm::mat4(1);
+    glm::vec3 m_sunDirection = glm::vec3(0);
+    u32 m_staticVersion = ~0u;
+
+    // light space bounding boxes of the draw entities, updated every frame
+    const std::vector<DrawEntity> *m_entities = nullptr;
+    std::vector<glm::vec3> m_casterMin;
+    std::vector<glm::vec3> m_casterMax;
+
+    std::vector<ShadowPass> m_passes;
+};
+
+#endif //ACORN_CASCADED_SHADOW_MAPS_H
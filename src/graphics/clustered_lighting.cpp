@@ -0,0 +1,241 @@
+#include "clustered_lighting.h"
+#include "core.h"
+#include "shader.h"
+#include "constants.h"
+#include "log.h"
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define ACORN_CLUSTER_SSE
+#include <emmintrin.h>
+#endif
+
+// Padding lanes are placed so far away that they never touch a cluster
+constexpr f32 PADDING_DISTANCE = 1e18f;
+
+ClusteredLighting::ClusteredLighting()
+    : m_slices(consts::CLUSTER_GRID_Z),
+      m_clusterGrid(consts::CLUSTER_GRID_X * consts::CLUSTER_GRID_Y * consts::CLUSTER_GRID_Z) {
+    Log::debug("ClusteredLighting::ClusteredLighting()");
+
+    // shaders may sample the buffers before the first update
+    m_lightDataBuffer.setData(TextureFormatEnum::RGBA32F, nullptr, 0);
+    m_clusterGridBuffer.setData(TextureFormatEnum::RG32UI, m_clusterGrid.data(),
+                                m_clusterGrid.size() * sizeof(glm::uvec2));
+    m_clusterLightIndicesBuffer.setData(TextureFormatEnum::R16UI, nullptr, 0);
+}
+
+void ClusteredLighting::update(const Camera &camera, const std::vector<Light> &lights) {
+    auto startTime = std::chrono::steady_clock::now();
+
+    if (lights.size() > consts::MAX_LIGHTS) {
+        static bool warned = false;
+        if (!warned) {
+            Log::warn("Scene has %d lights, only the first %d are shaded", lights.size(), consts::MAX_LIGHTS);
+            warned = true;
+        }
+    }
+    m_numLights = std::min<u32>(lights.size(), consts::MAX_LIGHTS);
+
+    glm::mat4 view = camera.getViewMatrix();
+    glm::mat4 projection = camera.getProjectionMatrix();
+    f32 nearPlane = camera.getNearPlane();
+    f32 farPlane = camera.getFarPlane();
+    m_cameraForward = camera.getForward();
+
+    // pack shading data and find bounding spheres in view space
+    m_bounds.resize(m_numLights);
+    m_lightData.resize(m_numLights * 3);
+    for (u32 i = 0; i < m_numLights; ++i) {
+        const Light &light = lights[i];
+
+        glm::vec3 center = light.position;
+        f32 radius = light.range;
+        f32 spotScale = 0.0f;
+        f32 spotOffset = 1.0f;
+
+        if (light.type == LightTypeEnum::SPOT) {
+            f32 cosOuter = std::cos(light.outerConeAngle);
+            f32 cosInner = std::cos(light.innerConeAngle);
+            spotScale = 1.0f / std::max(0.001f, cosInner - cosOuter);
+            spotOffset = -cosOuter * spotScale;
+
+            // tightest sphere around the cone, wide cones are bounded by their cap
+            if (light.outerConeAngle > glm::quarter_pi<f32>()) {
+                center = light.position + light.direction * cosOuter * light.range;
+                radius = std::sin(light.outerConeAngle) * light.range;
+            } else {
+                radius = light.range / (2.0f * cosOuter);
+                center = light.position + light.direction * radius;
+            }
+        }
+
+        m_lightData[i * 3 + 0] = glm::vec4(light.position, light.range);
+        m_lightData[i * 3 + 1] = glm::vec4(light.color, spotScale);
+        m_lightData[i * 3 + 2] = glm::vec4(light.direction, spotOffset);
+
+        glm::vec3 viewCenter = glm::vec3(view * glm::vec4(center, 1));
+        m_bounds[i] = glm::vec4(viewCenter.x, viewCenter.y, -viewCenter.z, radius);
+    }
+
+    // slices are independent, so each one is assigned as a job
+    core->jobSystem.parallelFor(consts::CLUSTER_GRID_Z, 1, [&](u32 begin, u32 end) {
+        for (u32 z = begin; z < end; ++z) {
+            assignSlice(z, projection, nearPlane, farPlane);
+        }
+    });
+
+    // concatenate light lists of all slices
+    m_clusterLightIndices.clear();
+    for (u32 z = 0; z < consts::CLUSTER_GRID_Z; ++z) {
+        const Slice &slice = m_slices[z];
+        u32 base = m_clusterLightIndices.size();
+        for (u32 i = 0; i < slice.clusters.size(); ++i) {
+            m_clusterGrid[z * consts::CLUSTER_GRID_X * consts::CLUSTER_GRID_Y + i] =
+                glm::uvec2(base + slice.clusters[i].x, slice.clusters[i].y);
+        }
+        m_clusterLightIndices.insert(m_clusterLightIndices.end(), slice.indices.begin(), slice.indices.end());
+    }
+
+    m_lightDataBuffer.setData(TextureFormatEnum::RGBA32F, m_lightData.data(),
+                              m_lightData.size() * sizeof(glm::vec4));
+    m_clusterGridBuffer.setData(TextureFormatEnum::RG32UI, m_clusterGrid.data(),
+                                m_clusterGrid.size() * sizeof(glm::uvec2));
+    m_clusterLightIndicesBuffer.setData(TextureFormatEnum::R16UI, m_clusterLightIndices.data(),
+                                        m_clusterLightIndices.size() * sizeof(u16));
+
+    std::chrono::duration<f32, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+    m_updateMilliseconds = elapsed.count();
+}
+
+void ClusteredLighting::bindTextures(Shader &shader) const {
+    shader.setUniform("uLightData", m_lightDataBuffer);
+    shader.setUniform("uClusterGrid", m_clusterGridBuffer);
+    shader.setUniform("uClusterLightIndices", m_clusterLightIndicesBuffer);
+}
+
+void ClusteredLighting::setUniforms(Shader &shader, u32 viewport_width, u32 viewport_height) const {
+    // slice = log(depth) * scale + bias, the inverse of getSliceDepth()
+    f32 depthScale = consts::CLUSTER_GRID_Z / std::log(consts::CLUSTER_DEPTH_FAR / consts::CLUSTER_DEPTH_NEAR);
+    f32 depthBias = -std::log(consts::CLUSTER_DEPTH_NEAR) * depthScale;
+
+    shader.setUniform("uClusterTileScale", glm::vec2((f32)consts::CLUSTER_GRID_X / viewport_width,
+                                                     (f32)consts::CLUSTER_GRID_Y / viewport_height));
+    shader.setUniform("uClusterDepthScale", depthScale);
+    shader.setUniform("uClusterDepthBias", depthBias);
+    shader.setUniform("uCameraForward", m_cameraForward);
+}
+
+void ClusteredLighting::assignSlice(u32 z, const glm::mat4 &projection, f32 near_plane, f32 far_plane) {
+    Slice &slice = m_slices[z];
+    f32 sliceNear = getSliceDepth(z, near_plane, far_plane);
+    f32 sliceFar = getSliceDepth(z + 1, near_plane, far_plane);
+
+    // only lights that overlap the depth range of the slice have to be tested against its clusters
+    slice.centerX.clear();
+    slice.centerY.clear();
+    slice.centerZ.clear();
+    slice.radius.clear();
+    slice.lightIndices.clear();
+    for (u32 i = 0; i < m_numLights; ++i) {
+        const glm::vec4 &bounds = m_bounds[i];
+        if (bounds.z + bounds.w < sliceNear || bounds.z - bounds.w > sliceFar) {
+            continue;
+        }
+
+        slice.centerX.push_back(bounds.x);
+        slice.centerY.push_back(bounds.y);
+        slice.centerZ.push_back(bounds.z);
+        slice.radius.push_back(bounds.w);
+        slice.lightIndices.push_back(i);
+    }
+
+    while (slice.lightIndices.size() % 4 != 0) {
+        slice.centerX.push_back(PADDING_DISTANCE);
+        slice.centerY.push_back(PADDING_DISTANCE);
+        slice.centerZ.push_back(PADDING_DISTANCE);
+        slice.radius.push_back(0.0f);
+        slice.lightIndices.push_back(0);
+    }
+
+    u32 numCandidates = slice.lightIndices.size();
+    f32 invProjectionX = 1.0f / projection[0][0];
+    f32 invProjectionY = 1.0f / projection[1][1];
+
+    slice.clusters.resize(consts::CLUSTER_GRID_X * consts::CLUSTER_GRID_Y);
+    slice.indices.clear();
+
+    for (u32 y = 0; y < consts::CLUSTER_GRID_Y; ++y) {
+        // a view space point at depth d projects to ndc * d / projection scale
+        f32 ndcMinY = -1.0f + 2.0f * y / consts::CLUSTER_GRID_Y;
+        f32 ndcMaxY = -1.0f + 2.0f * (y + 1) / consts::CLUSTER_GRID_Y;
+        f32 minY = std::min(ndcMinY * sliceNear, ndcMinY * sliceFar) * invProjectionY;
+        f32 maxY = std::max(ndcMaxY * sliceNear, ndcMaxY * sliceFar) * invProjectionY;
+
+        for (u32 x = 0; x < consts::CLUSTER_GRID_X; ++x) {
+            f32 ndcMinX = -1.0f + 2.0f * x / consts::CLUSTER_GRID_X;
+            f32 ndcMaxX = -1.0f + 2.0f * (x + 1) / consts::CLUSTER_GRID_X;
+            f32 minX = std::min(ndcMinX * sliceNear, ndcMinX * sliceFar) * invProjectionX;
+            f32 maxX = std::max(ndcMaxX * sliceNear, ndcMaxX * sliceFar) * invProjectionX;
+
+            u32 offset = slice.indices.size();
+            u32 i = 0;
+
+#ifdef ACORN_CLUSTER_SSE
+            // sphere against AABB for 4 lights at a time
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 boxMinX = _mm_set1_ps(minX);
+            const __m128 boxMaxX = _mm_set1_ps(maxX);
+            const __m128 boxMinY = _mm_set1_ps(minY);
+            const __m128 boxMaxY = _mm_set1_ps(maxY);
+            const __m128 boxMinZ = _mm_set1_ps(sliceNear);
+            const __m128 boxMaxZ = _mm_set1_ps(sliceFar);
+
+            for (; i < numCandidates; i += 4) {
+                __m128 cx = _mm_loadu_ps(&slice.centerX[i]);
+                __m128 cy = _mm_loadu_ps(&slice.centerY[i]);
+                __m128 cz = _mm_loadu_ps(&slice.centerZ[i]);
+                __m128 r = _mm_loadu_ps(&slice.radius[i]);
+
+                __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(boxMinX, cx), _mm_sub_ps(cx, boxMaxX)), zero);
+                __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(boxMinY, cy), _mm_sub_ps(cy, boxMaxY)), zero);
+                __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(boxMinZ, cz), _mm_sub_ps(cz, boxMaxZ)), zero);
+                __m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+                                                    _mm_mul_ps(dz, dz));
+
+                u32 mask = _mm_movemask_ps(_mm_cmple_ps(distanceSquared, _mm_mul_ps(r, r)));
+                for (u32 lane = 0; mask != 0; ++lane, mask >>= 1u) {
+                    if (mask & 1u) {
+                        slice.indices.push_back(slice.lightIndices[i + lane]);
+                    }
+                }
+            }
+#endif
+
+            for (; i < numCandidates; ++i) {
+                f32 dx = std::max(std::max(minX - slice.centerX[i], slice.centerX[i] - maxX), 0.0f);
+                f32 dy = std::max(std::max(minY - slice.centerY[i], slice.centerY[i] - maxY), 0.0f);
+                f32 dz = std::max(std::max(sliceNear - slice.centerZ[i], slice.centerZ[i] - sliceFar), 0.0f);
+                if (dx * dx + dy * dy + dz * dz <= slice.radius[i] * slice.radius[i]) {
+                    slice.indices.push_back(slice.lightIndices[i]);
+                }
+            }
+
+            slice.clusters[y * consts::CLUSTER_GRID_X + x] = glm::uvec2(offset, slice.indices.size() - offset);
+        }
+    }
+}
+
+f32 ClusteredLighting::getSliceDepth(u32 z, f32 near_plane, f32 far_plane) {
+    if (z == 0) {
+        return near_plane;
+    }
+    if (z >= consts::CLUSTER_GRID_Z) {
+        return far_plane;
+    }
+    f32 depthRatio = consts::CLUSTER_DEPTH_FAR / consts::CLUSTER_DEPTH_NEAR;
+    return consts::CLUSTER_DEPTH_NEAR * std::pow(depthRatio, (f32)z / consts::CLUSTER_GRID_Z);
+}
@@ -0,0 +1,82 @@
+#ifndef ACORN_CLUSTERED_LIGHTING_H
+#define ACORN_CLUSTERED_LIGHTING_H
+
+#include "types.h"
+#include "light.h"
+#include "texture.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+class Camera;
+class Shader;
+
+/// Assigns punctual lights to a froxel grid of the view frustum on the CPU every frame, so shading only has to loop
+/// over the lights of the cluster a fragment is in. Light data, the grid and the light lists are read by
+/// material.frag from texture buffers
+class ClusteredLighting {
+public:
+    ClusteredLighting();
+
+    /// Assign lights to clusters for a camera and upload the results
+    void update(const Camera &camera, const std::vector<Light> &lights);
+
+    /// Bind the texture buffers to a shader that shades with clustered lights
+    void bindTextures(Shader &shader) const;
+
+    /// Set the grid parameters of a shader that shades with clustered lights
+    void setUniforms(Shader &shader, u32 viewport_width, u32 viewport_height) const;
+
+    u32 getNumLights() const {
+        return m_numLights;
+    }
+
+    /// Total length of all cluster light lists
+    u32 getNumLightIndices() const {
+        return m_clusterLightIndices.size();
+    }
+
+    /// CPU time of the last update, including the upload
+    f32 getUpdateMilliseconds() const {
+        return m_updateMilliseconds;
+    }
+
+private:
+    /// Light list of a depth slice and the lights that could touch it, one per slice so slices can be assigned on
+    /// different threads without sharing anything
+    struct Slice {
+        // candidate bounding spheres in view space with positive depth, structure of arrays padded to 4
+        std::vector<f32> centerX;
+        std::vector<f32> centerY;
+        std::vector<f32> centerZ;
+        std::vector<f32> radius;
+        std::vector<u16> lightIndices;
+
+        // (offset into indices, count) per cluster, offsets are relative to this slice
+        std::vector<glm::uvec2> clusters;
+        std::vector<u16> indices;
+    };
+
+    /// Assign candidates of a slice to its clusters
+    void assignSlice(u32 z, const glm::mat4 &projection, f32 near_plane, f32 far_plane);
+
+    /// Depth of the near side of a slice, z == CLUSTER_GRID_Z gives the far side of the last one
+    static f32 getSliceDepth(u32 z, f32 near_plane, f32 far_plane);
+
+    // bounding spheres of all lights, xyz is the view space position with positive depth and w is the radius
+    std::vector<glm::vec4> m_bounds;
+    std::vector<Slice> m_slices;
+
+    std::vector<glm::vec4> m_lightData;
+    std::vector<glm::uvec2> m_clusterGrid;
+    std::vector<u16> m_clusterLightIndices;
+
+    TextureBuffer m_lightDataBuffer;
+    TextureBuffer m_clusterGridBuffer;
+    TextureBuffer m_clusterLightIndicesBuffer;
+
+    glm::vec3 m_cameraForward = glm::vec3(0, 0, -1);
+    u32 m_numLights = 0;
+    f32 m_updateMilliseconds = 0;
+};
+
+#endif //ACORN_CLUSTERED_LIGHTING_H
@@ -0,0 +1,36 @@
+#ifndef ACORN_DRAW_ITEM_H
+#define ACORN_DRAW_ITEM_H
+
+#include "types.h"
+#include "mesh.h"
+#include <glm/glm.hpp>
+
+/// A node of an active entity to draw this frame, with the meshes the node places
+struct DrawEntity {
+    glm::mat4 modelMatrix;  // transform of the entity and the node
+    glm::mat3 normalMatrix; // inverse transpose of the model matrix, keeps normals right under non-uniform scale
+    glm::vec3 boundsMin;    // world space bounding box
+    glm::vec3 boundsMax;
+    u32 sceneIndex;         // index of the entity in the scene
+    u32 sceneItemOffset;    // number of draw items of the nodes of the same entity before this one
+    u32 firstItem;          // draw items of the meshes of the node
+    u32 numItems;
+    bool isStatic;
+    bool castsShadows;
+    bool occluded;          // hidden from the camera by software occlusion culling
+};
+
+/// A mesh to draw this frame
+struct DrawItem {
+    const Mesh *mesh;
+    u32 entityIndex;
+    u32 lod;                // level of detail the mesh is drawn at
+    u32 firstRange;         // index ranges of the visible meshlets, see Renderer::cullMeshlets()
+    u32 numRanges;
+    glm::vec3 boundsMin;    // world space bounding box
+    glm::vec3 boundsMax;
+    bool occluded;          // hidden from the camera by software occlusion culling
+    u32 occlusionQuery;     // query of last frame that decides whether it's drawn, 0 to draw it unconditionally
+};
+
+#endif //ACORN_DRAW_ITEM_H
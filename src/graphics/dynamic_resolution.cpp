@@ -0,0 +1,50 @@
+#include "dynamic_resolution.h"
+#include "game_state.h"
+#include "constants.h"
+#include "log.h"
+#include <algorithm>
+#include <cmath>
+
+// smoothing of the desired scale, going down reacts within a frame or two and going up takes about a second
+constexpr f32 SCALE_DOWN_RATE = 0.5f;
+constexpr f32 SCALE_UP_RATE = 0.05f;
+
+DynamicResolution::DynamicResolution() {
+    Log::debug("DynamicResolution::DynamicResolution()");
+}
+
+void DynamicResolution::addMeasurement(f32 gpu_frame_ms, u32 rendered_width, const RenderOptions &options) {
+    m_gpuFrameMs = gpu_frame_ms;
+    if (gpu_frame_ms <= 0.0f || rendered_width == 0) {
+        return;
+    }
+
+    // cost is mostly proportional to the number of pixels, so the scale that would have hit the budget follows
+    // from the scale the measured frame had rather than the current one
+    f32 measuredScale = (f32)rendered_width / options.width;
+    f32 budgetMs = options.targetFrameMs * consts::DYNAMIC_RESOLUTION_HEADROOM;
+    f32 scale = measuredScale * std::sqrt(budgetMs / gpu_frame_ms);
+
+    f32 rate = scale < m_desiredScale ? SCALE_DOWN_RATE : SCALE_UP_RATE;
+    m_desiredScale += (scale - m_desiredScale) * rate;
+    m_desiredScale = glm::clamp(m_desiredScale, options.minResolutionScale, consts::MAX_RESOLUTION_SCALE);
+}
+
+void DynamicResolution::update(const RenderOptions &options) {
+    if (!options.dynamicResolution) {
+        m_desiredScale = consts::MAX_RESOLUTION_SCALE;
+    }
+
+    // the desired scale has to move a whole step away before the scale follows, so it doesn't flip back and forth
+    // around a step boundary
+    f32 steps = m_desiredScale / consts::RESOLUTION_SCALE_STEP;
+    f32 quantized = (m_desiredScale >= m_scale ? std::floor(steps) : std::ceil(steps)) * consts::RESOLUTION_SCALE_STEP;
+    if (quantized > m_scale || m_desiredScale < m_scale - consts::RESOLUTION_SCALE_STEP) {
+        m_scale = quantized;
+    }
+    m_scale = glm::clamp(m_scale, std::min(options.minResolutionScale, consts::MAX_RESOLUTION_SCALE),
+                         consts::MAX_RESOLUTION_SCALE);
+
+    m_width = std::max(1u, (u32)std::lround(options.width * m_scale));
+    m_height = std::max(1u, (u32)std::lround(options.height * m_scale));
+}
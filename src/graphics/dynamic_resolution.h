@@ -0,0 +1,45 @@
+#ifndef ACORN_DYNAMIC_RESOLUTION_H
+#define ACORN_DYNAMIC_RESOLUTION_H
+
+#include "types.h"
+
+struct RenderOptions;
+
+/// Picks the resolution the scene is rendered at from measured GPU frame times. Drops quickly when a frame goes
+/// over budget and recovers slowly, so load spikes don't turn into oscillation
+class DynamicResolution {
+public:
+    DynamicResolution();
+
+    /// Feed a finished GPU frame time measurement
+    /// \param rendered_width Width the measured frame was rendered at, measurements arrive a few frames late
+    void addMeasurement(f32 gpu_frame_ms, u32 rendered_width, const RenderOptions &options);
+
+    /// Update the viewport size for the next frame
+    void update(const RenderOptions &options);
+
+    f32 getScale() const {
+        return m_scale;
+    }
+
+    u32 getWidth() const {
+        return m_width;
+    }
+
+    u32 getHeight() const {
+        return m_height;
+    }
+
+    f32 getGpuFrameMs() const {
+        return m_gpuFrameMs;
+    }
+
+private:
+    f32 m_scale = 1.0f;
+    f32 m_desiredScale = 1.0f;
+    f32 m_gpuFrameMs = 0.0f;
+    u32 m_width = 0;
+    u32 m_height = 0;
+};
+
+#endif //ACORN_DYNAMIC_RESOLUTION_H
@@ -0,0 +1,727 @@
+#include "gltf.h"
+#include "core.h"
+#include "json.h"
+#include "mapped_file.h"
+#include "log.h"
+#include "utils.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+namespace gltf {
+
+namespace {
+
+constexpr u32 GLB_MAGIC = 0x46546c67;       // "glTF"
+constexpr u32 GLB_CHUNK_JSON = 0x4e4f534a;  // "JSON"
+constexpr u32 GLB_CHUNK_BIN = 0x004e4942;   // "BIN\0"
+constexpr u32 GLB_HEADER_SIZE = 12;
+constexpr u32 GLB_CHUNK_HEADER_SIZE = 8;
+
+// accessor component types
+constexpr u32 COMPONENT_BYTE = 5120;
+constexpr u32 COMPONENT_UNSIGNED_BYTE = 5121;
+constexpr u32 COMPONENT_SHORT = 5122;
+constexpr u32 COMPONENT_UNSIGNED_SHORT = 5123;
+constexpr u32 COMPONENT_UNSIGNED_INT = 5125;
+constexpr u32 COMPONENT_FLOAT = 5126;
+
+// primitive modes
+constexpr u32 MODE_TRIANGLES = 4;
+constexpr u32 MODE_TRIANGLE_STRIP = 5;
+constexpr u32 MODE_TRIANGLE_FAN = 6;
+
+/// Bytes of a buffer, mapped from a file or decoded from a data uri
+struct Buffer {
+    const u8 *data;
+    u64 size;
+};
+
+/// Elements of an accessor in a buffer
+struct AccessorView {
+    const u8 *data;     // first element, null if the accessor has no buffer view and is all zeros
+    u32 count;
+    u32 stride;
+    u32 componentType;
+    u32 numComponents;
+    bool normalized;
+};
+
+struct Asset {
+    JsonValue json;
+    std::string directory;
+    MappedFile file;
+    std::vector<MappedFile> bufferFiles;
+    std::vector<std::vector<u8>> decodedBuffers;
+    std::vector<Buffer> buffers;
+    std::vector<Material> materials;
+    std::vector<bool> materialLoaded;
+    std::vector<std::vector<u32>> meshPrimitives;
+    std::vector<bool> meshLoaded;
+    bool warnedEmbeddedImages = false;
+};
+
+/// Get an index into an array of the asset, out of range if the value isn't one
+u32 get_index(const JsonValue &value) {
+    f64 number = value.getNumber(-1.0);
+    return number >= 0.0 ? (u32)number : ~0u;
+}
+
+u32 read_u32(const u8 *data) {
+    return (u32)data[0] | ((u32)data[1] << 8u) | ((u32)data[2] << 16u) | ((u32)data[3] << 24u);
+}
+
+/// Relative uris may have percent-encoded characters
+std::string decode_uri(const std::string &uri) {
+    std::string decoded;
+    decoded.reserve(uri.size());
+    for (u64 i = 0; i < uri.size(); ++i) {
+        if (uri[i] == '%' && i + 2 < uri.size() && std::isxdigit(uri[i + 1]) && std::isxdigit(uri[i + 2])) {
+            decoded.push_back((char)std::stoi(uri.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        } else {
+            decoded.push_back(uri[i]);
+        }
+    }
+    return decoded;
+}
+
+bool decode_base64(const char *text, u64 length, std::vector<u8> *bytes) {
+    bytes->clear();
+    bytes->reserve(length / 4 * 3);
+
+    u32 bits = 0;
+    u32 numBits = 0;
+    for (u64 i = 0; i < length && text[i] != '='; ++i) {
+        char c = text[i];
+        u32 value;
+        if (c >= 'A' && c <= 'Z') {
+            value = c - 'A';
+        } else if (c >= 'a' && c <= 'z') {
+            value = c - 'a' + 26;
+        } else if (c >= '0' && c <= '9') {
+            value = c - '0' + 52;
+        } else if (c == '+') {
+            value = 62;
+        } else if (c == '/') {
+            value = 63;
+        } else {
+            return false;
+        }
+
+        bits = (bits << 6u) | value;
+        numBits += 6;
+        if (numBits >= 8) {
+            numBits -= 8;
+            bytes->push_back((u8)(bits >> numBits));
+        }
+    }
+    return true;
+}
+
+/// Find the buffers of the asset, external ones are mapped and embedded ones decoded
+bool load_buffers(Asset *asset, const u8 *glb_binary, u64 glb_binary_size) {
+    const JsonValue &buffers = asset->json["buffers"];
+    asset->bufferFiles.reserve(buffers.size());
+    asset->decodedBuffers.reserve(buffers.size());
+
+    for (u32 b = 0; b < buffers.size(); ++b) {
+        const JsonValue &buffer = buffers[b];
+        u64 byteLength = (u64)buffer["byteLength"].getNumber();
+        Buffer result = {};
+
+        if (!buffer.has("uri")) {
+            // only the first buffer of a .glb file may be its binary chunk
+            if (b != 0 || !glb_binary) {
+                Log::warn("glTF buffer %d has no data", b);
+                return false;
+            }
+            result = {glb_binary, glb_binary_size};
+        } else {
+            const std::string &uri = buffer["uri"].getString();
+            if (uri.compare(0, 5, "data:") == 0) {
+                u64 comma = uri.find(";base64,");
+                if (comma == std::string::npos) {
+                    Log::warn("glTF buffer %d has a data uri that isn't base64", b);
+                    return false;
+                }
+                asset->decodedBuffers.emplace_back();
+                std::vector<u8> &bytes = asset->decodedBuffers.back();
+                if (!decode_base64(uri.data() + comma + 8, uri.size() - comma - 8, &bytes)) {
+                    Log::warn("glTF buffer %d has invalid base64 data", b);
+                    return false;
+                }
+                result = {bytes.data(), bytes.size()};
+            } else {
+                asset->bufferFiles.emplace_back();
+                MappedFile &file = asset->bufferFiles.back();
+                if (!file.open(asset->directory + decode_uri(uri))) {
+                    return false;
+                }
+                result = {file.getData(), file.getSize()};
+            }
+        }
+
+        if (result.size < byteLength) {
+            Log::warn("glTF buffer %d is smaller than its byteLength", b);
+            return false;
+        }
+        asset->buffers.push_back(result);
+    }
+
+    return true;
+}
+
+u32 get_component_size(u32 component_type) {
+    switch (component_type) {
+        case COMPONENT_BYTE:
+        case COMPONENT_UNSIGNED_BYTE:
+            return 1;
+        case COMPONENT_SHORT:
+        case COMPONENT_UNSIGNED_SHORT:
+            return 2;
+        case COMPONENT_UNSIGNED_INT:
+        case COMPONENT_FLOAT:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+u32 get_num_components(const std::string &type) {
+    if (type == "SCALAR") {
+        return 1;
+    } else if (type == "VEC2") {
+        return 2;
+    } else if (type == "VEC3") {
+        return 3;
+    } else if (type == "VEC4") {
+        return 4;
+    }
+    return 0;
+}
+
+/// Find the elements of an accessor and check that they are inside of their buffer
+bool get_accessor_view(const Asset &asset, const JsonValue &index, AccessorView *view) {
+    const JsonValue &accessor = asset.json["accessors"][get_index(index)];
+    if (!accessor.isObject()) {
+        Log::warn("glTF accessor %d doesn't exist", (s32)index.getNumber(-1.0));
+        return false;
+    }
+    if (accessor.has("sparse")) {
+        Log::warn("Sparse glTF accessors aren't supported");
+        return false;
+    }
+
+    view->count = (u32)accessor["count"].getNumber();
+    view->componentType = (u32)accessor["componentType"].getNumber();
+    view->numComponents = get_num_components(accessor["type"].getString());
+    view->normalized = accessor["normalized"].getBool();
+    u32 elementSize = get_component_size(view->componentType) * view->numComponents;
+    if (elementSize == 0) {
+        Log::warn("glTF accessor has an unsupported type");
+        return false;
+    }
+
+    // accessors without a buffer view are zero
+    if (!accessor.has("bufferView")) {
+        view->data = nullptr;
+        view->stride = elementSize;
+        return true;
+    }
+
+    const JsonValue &bufferView = asset.json["bufferViews"][get_index(accessor["bufferView"])];
+    u32 bufferIndex = get_index(bufferView["buffer"]);
+    if (!bufferView.isObject() || bufferIndex >= asset.buffers.size()) {
+        Log::warn("glTF accessor has an invalid buffer view");
+        return false;
+    }
+
+    const Buffer &buffer = asset.buffers[bufferIndex];
+    u64 viewOffset = (u64)bufferView["byteOffset"].getNumber();
+    u64 viewLength = (u64)bufferView["byteLength"].getNumber();
+    u64 accessorOffset = (u64)accessor["byteOffset"].getNumber();
+    view->stride = (u32)bufferView["byteStride"].getNumber(elementSize);
+
+    u64 accessedLength = view->count == 0 ? 0 : (u64)(view->count - 1) * view->stride + elementSize;
+    if (viewOffset + viewLength > buffer.size || accessorOffset + accessedLength > viewLength) {
+        Log::warn("glTF accessor reaches past the end of its buffer");
+        return false;
+    }
+
+    view->data = buffer.data + viewOffset + accessorOffset;
+    return true;
+}
+
+f32 read_component(const u8 *data, u32 component_type, bool normalized) {
+    switch (component_type) {
+        case COMPONENT_FLOAT: {
+            f32 value;
+            std::memcpy(&value, data, sizeof(value));
+            return value;
+        }
+        case COMPONENT_BYTE: {
+            s8 value = (s8)data[0];
+            return normalized ? std::max(value / 127.0f, -1.0f) : value;
+        }
+        case COMPONENT_UNSIGNED_BYTE:
+            return normalized ? data[0] / 255.0f : data[0];
+        case COMPONENT_SHORT: {
+            s16 value;
+            std::memcpy(&value, data, sizeof(value));
+            return normalized ? std::max(value / 32767.0f, -1.0f) : value;
+        }
+        case COMPONENT_UNSIGNED_SHORT: {
+            u16 value;
+            std::memcpy(&value, data, sizeof(value));
+            return normalized ? value / 65535.0f : value;
+        }
+        default:
+            return (f32)read_u32(data);
+    }
+}
+
+/// Read an attribute into a strided destination, like a member of an array of vertices
+/// \param count Number of elements the accessor must have
+bool read_floats(const Asset &asset, const JsonValue &index, u32 num_components, u32 count, void *out,
+                 u32 out_stride) {
+    AccessorView view;
+    if (!get_accessor_view(asset, index, &view)) {
+        return false;
+    }
+    if (view.numComponents != num_components || view.count != count) {
+        Log::warn("glTF attribute has %d elements of %d components instead of %d of %d", view.count,
+                  view.numComponents, count, num_components);
+        return false;
+    }
+
+    u8 *destination = (u8 *)out;
+    if (!view.data) {
+        for (u32 i = 0; i < count; ++i) {
+            std::memset(destination + (u64)i * out_stride, 0, num_components * sizeof(f32));
+        }
+        return true;
+    }
+
+    // floats have the layout of the destination already
+    if (view.componentType == COMPONENT_FLOAT) {
+        for (u32 i = 0; i < count; ++i) {
+            std::memcpy(destination + (u64)i * out_stride, view.data + (u64)i * view.stride,
+                        num_components * sizeof(f32));
+        }
+        return true;
+    }
+
+    u32 componentSize = get_component_size(view.componentType);
+    for (u32 i = 0; i < count; ++i) {
+        const u8 *element = view.data + (u64)i * view.stride;
+        f32 *values = (f32 *)(destination + (u64)i * out_stride);
+        for (u32 c = 0; c < num_components; ++c) {
+            values[c] = read_component(element + c * componentSize, view.componentType, view.normalized);
+        }
+    }
+    return true;
+}
+
+bool read_indices(const Asset &asset, const JsonValue &index, std::vector<u32> *indices) {
+    AccessorView view;
+    if (!get_accessor_view(asset, index, &view)) {
+        return false;
+    }
+    if (view.numComponents != 1 || view.componentType == COMPONENT_FLOAT || !view.data) {
+        Log::warn("glTF indices have an invalid type");
+        return false;
+    }
+
+    indices->resize(view.count);
+
+    // tightly packed 32-bit indices are the index buffer already
+    if (view.componentType == COMPONENT_UNSIGNED_INT && view.stride == sizeof(u32)) {
+        std::memcpy(indices->data(), view.data, (u64)view.count * sizeof(u32));
+        return true;
+    }
+
+    for (u32 i = 0; i < view.count; ++i) {
+        (*indices)[i] = (u32)read_component(view.data + (u64)i * view.stride, view.componentType, false);
+    }
+    return true;
+}
+
+/// Get the texture of a texture info object of a material
+Texture *get_texture(Asset *asset, const JsonValue &texture_info, Texture *fallback) {
+    if (!texture_info.isObject()) {
+        return fallback;
+    }
+
+    const JsonValue &texture = asset->json["textures"][get_index(texture_info["index"])];
+    const JsonValue &image = asset->json["images"][get_index(texture["source"])];
+    const std::string &uri = image["uri"].getString();
+    if (uri.empty() || uri.compare(0, 5, "data:") == 0) {
+        if (!asset->warnedEmbeddedImages) {
+            Log::warn("Images embedded in glTF assets aren't supported, their textures are left out");
+            asset->warnedEmbeddedImages = true;
+        }
+        return fallback;
+    }
+
+    return core->resourceManager.getTexture(asset->directory + decode_uri(uri));
+}
+
+/// Get a material, they are created the first time a primitive uses them
+const Material &get_material(Asset *asset, const JsonValue &index) {
+    u32 numMaterials = asset->json["materials"].size();
+    if (asset->materials.empty()) {
+        // the last one is the default material of primitives without one
+        asset->materials.resize(numMaterials + 1);
+        asset->materialLoaded.resize(numMaterials + 1, false);
+    }
+
+    u32 m = get_index(index);
+    if (m >= numMaterials) {
+        m = numMaterials;
+    }
+    if (asset->materialLoaded[m]) {
+        return asset->materials[m];
+    }
+
+    Texture *white = core->resourceManager.getBuiltInTexture(BuiltInTextureEnum::WHITE);
+    Texture *normal = core->resourceManager.getBuiltInTexture(BuiltInTextureEnum::NORMAL);
+    const JsonValue &material = asset->json["materials"][m];
+    const JsonValue &pbr = material["pbrMetallicRoughness"];
+
+    Material &result = asset->materials[m];
+    result.albedoTexture = get_texture(asset, pbr["baseColorTexture"], white);
+    result.normalTexture = get_texture(asset, material["normalTexture"], normal);
+    result.metallicTexture = white;
+    result.metallicScale = (f32)pbr["metallicFactor"].getNumber(1.0);
+    result.roughnessTexture = white;
+    result.roughnessScale = (f32)pbr["roughnessFactor"].getNumber(1.0);
+    result.doubleSided = material["doubleSided"].getBool();
+
+    // metallic and roughness share a texture, see MATERIAL_HAS_PACKED_ORM
+    if (pbr["metallicRoughnessTexture"].isObject()) {
+        result.metallicRoughnessTexture = get_texture(asset, pbr["metallicRoughnessTexture"], white);
+    }
+
+    asset->materialLoaded[m] = true;
+    return result;
+}
+
+glm::mat4 get_local_matrix(const JsonValue &node) {
+    const JsonValue &matrix = node["matrix"];
+    if (matrix.size() == 16) {
+        glm::mat4 result;
+        for (u32 i = 0; i < 16; ++i) {
+            result[i / 4][i % 4] = (f32)matrix[i].getNumber();
+        }
+        return result;
+    }
+
+    const JsonValue &t = node["translation"];
+    const JsonValue &r = node["rotation"];
+    const JsonValue &s = node["scale"];
+    glm::vec3 translation = glm::vec3((f32)t[0u].getNumber(), (f32)t[1].getNumber(), (f32)t[2].getNumber());
+    glm::quat rotation = glm::quat((f32)r[3].getNumber(1.0), (f32)r[0u].getNumber(), (f32)r[1].getNumber(),
+                                   (f32)r[2].getNumber());
+    glm::vec3 scale = glm::vec3((f32)s[0u].getNumber(1.0), (f32)s[1].getNumber(1.0), (f32)s[2].getNumber(1.0));
+
+    return glm::translate(glm::mat4(1), translation) * glm::mat4_cast(rotation) * glm::scale(glm::mat4(1), scale);
+}
+
+/// Flat normals, glTF wants them for primitives without normals. Vertices are split so triangles don't share any
+void generate_flat_normals(std::vector<Vertex> *vertices, std::vector<u32> *indices) {
+    std::vector<Vertex> split(indices->size());
+    for (u32 i = 0; i + 2 < indices->size(); i += 3) {
+        for (u32 k = 0; k < 3; ++k) {
+            split[i + k] = (*vertices)[(*indices)[i + k]];
+        }
+
+        glm::vec3 normal = glm::cross(split[i + 1].position - split[i].position,
+                                      split[i + 2].position - split[i].position);
+        f32 length = glm::length(normal);
+        normal = length > 0.0f ? normal / length : glm::vec3(0, 1, 0);
+        for (u32 k = 0; k < 3; ++k) {
+            split[i + k].normal = normal;
+        }
+    }
+
+    for (u32 i = 0; i < indices->size(); ++i) {
+        (*indices)[i] = i;
+    }
+    *vertices = std::move(split);
+}
+
+/// Turn strips and fans into lists
+void triangulate(u32 mode, std::vector<u32> *indices) {
+    if (mode == MODE_TRIANGLES) {
+        return;
+    }
+
+    std::vector<u32> list;
+    for (u32 i = 2; i < indices->size(); ++i) {
+        if (mode == MODE_TRIANGLE_FAN) {
+            list.insert(list.end(), {(*indices)[0], (*indices)[i - 1], (*indices)[i]});
+        } else if (i % 2 == 0) {
+            list.insert(list.end(), {(*indices)[i - 2], (*indices)[i - 1], (*indices)[i]});
+        } else {
+            list.insert(list.end(), {(*indices)[i - 1], (*indices)[i - 2], (*indices)[i]});
+        }
+    }
+    *indices = std::move(list);
+}
+
+bool load_primitive(Asset *asset, const JsonValue &primitive, MeshData *result) {
+    u32 mode = (u32)primitive["mode"].getNumber(MODE_TRIANGLES);
+    const JsonValue &attributes = primitive["attributes"];
+
+    AccessorView positions;
+    if (!get_accessor_view(*asset, attributes["POSITION"], &positions)) {
+        return false;
+    }
+
+    std::vector<Vertex> &vertices = result->vertices;
+    u32 numVertices = positions.count;
+    if (numVertices == 0) {
+        return true;
+    }
+    vertices.assign(numVertices, Vertex{});
+
+    // attributes are read straight into the vertices
+    if (!read_floats(*asset, attributes["POSITION"], 3, numVertices, &vertices[0].position, sizeof(Vertex))) {
+        return false;
+    }
+
+    bool hasNormals = attributes.has("NORMAL");
+    if (hasNormals && !read_floats(*asset, attributes["NORMAL"], 3, numVertices, &vertices[0].normal,
+                                   sizeof(Vertex))) {
+        return false;
+    }
+
+    if (attributes.has("TEXCOORD_0")) {
+        if (!read_floats(*asset, attributes["TEXCOORD_0"], 2, numVertices, &vertices[0].uv, sizeof(Vertex))) {
+            return false;
+        }
+
+        // glTF uvs start at the top of images, which are loaded bottom up
+        for (Vertex &vertex : vertices) {
+            vertex.uv.y = 1.0f - vertex.uv.y;
+        }
+    }
+
+    // glTF tangents have the sign of the bi-tangent in w, just like the vertices
+    bool hasTangents = attributes.has("TANGENT");
+    if (hasTangents && !read_floats(*asset, attributes["TANGENT"], 4, numVertices, &vertices[0].tangent,
+                                    sizeof(Vertex))) {
+        return false;
+    }
+
+    std::vector<u32> &indices = result->indices;
+    if (primitive.has("indices")) {
+        if (!read_indices(*asset, primitive["indices"], &indices)) {
+            return false;
+        }
+    } else {
+        indices.resize(numVertices);
+        for (u32 i = 0; i < numVertices; ++i) {
+            indices[i] = i;
+        }
+    }
+
+    for (u32 index : indices) {
+        if (index >= numVertices) {
+            Log::warn("glTF primitive has an index past its vertices");
+            return false;
+        }
+    }
+
+    triangulate(mode, &indices);
+    indices.resize(indices.size() / 3 * 3);
+
+    if (!hasNormals) {
+        // tangents are ignored without normals
+        generate_flat_normals(&vertices, &indices);
+        hasTangents = false;
+    }
+    if (!hasTangents) {
+        utils::generate_tangents(&vertices, &indices);
+    }
+
+    result->material = get_material(asset, primitive["material"]);
+    return true;
+}
+
+/// Get the primitives of a mesh, they are loaded the first time a node uses it and shared by the nodes after that
+/// \param mesh_primitives Set to the indices of the primitives of the mesh
+bool get_mesh(Asset *asset, u32 mesh_index, std::vector<MeshData> *primitives,
+              const std::vector<u32> **mesh_primitives) {
+    const JsonValue &mesh = asset->json["meshes"][mesh_index];
+    if (!mesh.isObject()) {
+        return false;
+    }
+
+    if (asset->meshLoaded.empty()) {
+        asset->meshLoaded.resize(asset->json["meshes"].size(), false);
+        asset->meshPrimitives.resize(asset->json["meshes"].size());
+    }
+
+    *mesh_primitives = &asset->meshPrimitives[mesh_index];
+    if (asset->meshLoaded[mesh_index]) {
+        return true;
+    }
+    asset->meshLoaded[mesh_index] = true;
+
+    const JsonValue &meshPrimitives = mesh["primitives"];
+    for (u32 p = 0; p < meshPrimitives.size(); ++p) {
+        const JsonValue &primitive = meshPrimitives[p];
+        u32 mode = (u32)primitive["mode"].getNumber(MODE_TRIANGLES);
+        if (mode != MODE_TRIANGLES && mode != MODE_TRIANGLE_STRIP && mode != MODE_TRIANGLE_FAN) {
+            // points and lines
+            continue;
+        }
+
+        primitives->emplace_back();
+        if (!load_primitive(asset, primitive, &primitives->back())) {
+            return false;
+        }
+        if (primitives->back().indices.empty()) {
+            primitives->pop_back();
+        } else {
+            asset->meshPrimitives[mesh_index].push_back(primitives->size() - 1);
+        }
+    }
+    return true;
+}
+
+/// Load the nodes of the default scene depth first, so parents come before their children, and the meshes they use
+bool load_scene(Asset *asset, std::vector<MeshData> *primitives, std::vector<NodeData> *nodes) {
+    const JsonValue &json = asset->json;
+    const JsonValue &jsonNodes = json["nodes"];
+    const std::vector<u32> *meshPrimitives;
+
+    // without a scene there is nothing to place the meshes, each one is loaded as it is under one root
+    if (!json.has("scenes")) {
+        nodes->push_back(NodeData{-1, glm::mat4(1), {}, ""});
+        for (u32 m = 0; m < json["meshes"].size(); ++m) {
+            if (!get_mesh(asset, m, primitives, &meshPrimitives)) {
+                return false;
+            }
+            nodes->back().meshes.insert(nodes->back().meshes.end(), meshPrimitives->begin(), meshPrimitives->end());
+        }
+        return true;
+    }
+
+    // node index and the index its parent was given in the flattened hierarchy
+    const JsonValue &scene = json["scenes"][(u32)json["scene"].getNumber(0)];
+    std::vector<std::pair<u32, s32>> stack;
+    for (u32 i = scene["nodes"].size(); i > 0; --i) {
+        stack.emplace_back(get_index(scene["nodes"][i - 1]), -1);
+    }
+
+    // a valid hierarchy visits every node at most once, more means there is a cycle
+    u32 numVisited = 0;
+    while (!stack.empty()) {
+        u32 nodeIndex = stack.back().first;
+        s32 parent = stack.back().second;
+        stack.pop_back();
+
+        const JsonValue &node = jsonNodes[nodeIndex];
+        if (!node.isObject() || ++numVisited > jsonNodes.size()) {
+            Log::warn("glTF scene has an invalid node hierarchy");
+            return false;
+        }
+
+        s32 flatIndex = (s32)nodes->size();
+        nodes->push_back(NodeData{parent, get_local_matrix(node), {}, node["name"].getString()});
+        if (node.has("mesh")) {
+            if (!get_mesh(asset, get_index(node["mesh"]), primitives, &meshPrimitives)) {
+                return false;
+            }
+            nodes->back().meshes = *meshPrimitives;
+        }
+
+        const JsonValue &children = node["children"];
+        for (u32 c = children.size(); c > 0; --c) {
+            stack.emplace_back(get_index(children[c - 1]), flatIndex);
+        }
+    }
+
+    return true;
+}
+
+}
+
+bool is_gltf_path(const std::string &path) {
+    return utils::has_extension(path, ".gltf") || utils::has_extension(path, ".glb");
+}
+
+bool load(const std::string &path, std::vector<MeshData> *primitives, std::vector<NodeData> *nodes) {
+    primitives->clear();
+    nodes->clear();
+
+    Asset asset;
+    asset.directory = path.substr(0, path.find_last_of('/') + 1);
+    if (!asset.file.open(path)) {
+        return false;
+    }
+
+    // a .glb file is a header, the JSON chunk and an optional binary chunk
+    const u8 *data = asset.file.getData();
+    u64 size = asset.file.getSize();
+    const char *jsonText = (const char *)data;
+    u64 jsonLength = size;
+    const u8 *binary = nullptr;
+    u64 binarySize = 0;
+
+    if (size >= GLB_HEADER_SIZE && read_u32(data) == GLB_MAGIC) {
+        if (read_u32(data + 4) != 2 || size < GLB_HEADER_SIZE + GLB_CHUNK_HEADER_SIZE ||
+            read_u32(data + GLB_HEADER_SIZE + 4) != GLB_CHUNK_JSON) {
+            Log::warn("'%s' isn't a valid glTF 2.0 binary file", path.c_str());
+            return false;
+        }
+
+        jsonLength = read_u32(data + GLB_HEADER_SIZE);
+        jsonText = (const char *)(data + GLB_HEADER_SIZE + GLB_CHUNK_HEADER_SIZE);
+        u64 binaryChunk = GLB_HEADER_SIZE + GLB_CHUNK_HEADER_SIZE + jsonLength;
+        if (binaryChunk > size) {
+            Log::warn("'%s' has a truncated JSON chunk", path.c_str());
+            return false;
+        }
+
+        if (binaryChunk + GLB_CHUNK_HEADER_SIZE <= size && read_u32(data + binaryChunk + 4) == GLB_CHUNK_BIN) {
+            binarySize = std::min<u64>(read_u32(data + binaryChunk), size - binaryChunk - GLB_CHUNK_HEADER_SIZE);
+            binary = data + binaryChunk + GLB_CHUNK_HEADER_SIZE;
+        }
+    }
+
+    if (!json::parse(jsonText, jsonLength, &asset.json)) {
+        Log::warn("Failed to parse the JSON of '%s'", path.c_str());
+        return false;
+    }
+
+    if (asset.json["asset"]["version"].getString().compare(0, 2, "2.") != 0) {
+        Log::warn("'%s' isn't glTF 2.0", path.c_str());
+        return false;
+    }
+
+    // quantized attributes are read like any other normalized integers
+    const JsonValue &extensionsRequired = asset.json["extensionsRequired"];
+    for (u32 i = 0; i < extensionsRequired.size(); ++i) {
+        const std::string &extension = extensionsRequired[i].getString();
+        if (extension != "KHR_mesh_quantization") {
+            Log::warn("'%s' requires the unsupported extension %s", path.c_str(), extension.c_str());
+            return false;
+        }
+    }
+
+    if (!load_buffers(&asset, binary, binarySize) || !load_scene(&asset, primitives, nodes)) {
+        primitives->clear();
+        nodes->clear();
+        return false;
+    }
+
+    return true;
+}
+
+}
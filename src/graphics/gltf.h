@@ -0,0 +1,20 @@
+#ifndef ACORN_GLTF_H
+#define ACORN_GLTF_H
+
+#include "types.h"
+#include "mesh.h"
+#include <string>
+#include <vector>
+
+namespace gltf {
+/// Whether a path has a .gltf or .glb extension
+bool is_gltf_path(const std::string &path);
+
+/// Load the triangle primitives and node hierarchy of the default scene of a .gltf file with its buffers, or of a
+/// binary .glb file. Primitives stay in the space of their mesh and are loaded once no matter how many nodes use it.
+/// Files are memory mapped and accessors are read straight out of them
+/// \return Whether the asset could be loaded, failures and unsupported features are logged as warnings
+bool load(const std::string &path, std::vector<MeshData> *primitives, std::vector<NodeData> *nodes);
+}
+
+#endif //ACORN_GLTF_H
@@ -0,0 +1,63 @@
+#include "gpu_sample_counter.h"
+#include "log.h"
+#include <GL/gl3w.h>
+
+GpuSampleCounter::GpuSampleCounter() {
+    Log::debug("GpuSampleCounter::GpuSampleCounter()");
+    glGenQueries(NUM_QUERIES, m_queries);
+    if (m_queries[0] == 0) {
+        Log::fatal("Failed to create GpuSampleCounter queries");
+    }
+}
+
+GpuSampleCounter::~GpuSampleCounter() {
+    Log::debug("GpuSampleCounter::~GpuSampleCounter()");
+    glDeleteQueries(NUM_QUERIES, m_queries);
+}
+
+void GpuSampleCounter::begin() {
+    poll();
+
+    // all queries are still in flight, skip this count instead of waiting
+    if (m_inFlight[m_next]) {
+        return;
+    }
+
+    glBeginQuery(GL_SAMPLES_PASSED, m_queries[m_next]);
+    m_counting = true;
+}
+
+void GpuSampleCounter::end() {
+    if (!m_counting) {
+        return;
+    }
+
+    glEndQuery(GL_SAMPLES_PASSED);
+    m_inFlight[m_next] = true;
+    m_next = (m_next + 1) % NUM_QUERIES;
+    m_counting = false;
+}
+
+u64 GpuSampleCounter::getSamples() {
+    poll();
+    return m_lastSamples;
+}
+
+void GpuSampleCounter::poll() {
+    // the oldest query is the next one to be reused
+    for (u32 i = 0; i < NUM_QUERIES; ++i) {
+        u32 query = (m_next + i) % NUM_QUERIES;
+        if (!m_inFlight[query]) {
+            continue;
+        }
+
+        s32 available = 0;
+        glGetQueryObjectiv(m_queries[query], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            break;
+        }
+
+        glGetQueryObjectui64v(m_queries[query], GL_QUERY_RESULT, &m_lastSamples);
+        m_inFlight[query] = false;
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef ACORN_GPU_SAMPLE_COUNTER_H
+#define ACORN_GPU_SAMPLE_COUNTER_H
+
+#include "types.h"
+
+/// Counts the samples that pass the depth test in a range of commands with occlusion queries. Like GpuTimer, results
+/// are read back a few frames later without stalling and counters can't be nested
+class GpuSampleCounter {
+public:
+    GpuSampleCounter();
+    ~GpuSampleCounter();
+
+    /// Start counting. Ignored if every query is still waiting for results
+    void begin();
+
+    /// Stop counting
+    void end();
+
+    /// Get the newest finished count
+    u64 getSamples();
+
+private:
+    /// Collect results of finished queries, oldest first
+    void poll();
+
+    static constexpr u32 NUM_QUERIES = 4;
+
+    u32 m_queries[NUM_QUERIES] = {};
+    bool m_inFlight[NUM_QUERIES] = {};
+    u32 m_next = 0;
+    bool m_counting = false;
+
+    u64 m_lastSamples = 0;
+};
+
+#endif //ACORN_GPU_SAMPLE_COUNTER_H
@@ -0,0 +1,107 @@
+#include "gpu_timer.h"
+#include "log.h"
+#include <GL/gl3w.h>
+
+GpuTimer::GpuTimer(GpuTimerModeEnum mode)
+    : m_mode(mode) {
+    Log::debug("GpuTimer::GpuTimer()");
+    glGenQueries(NUM_QUERIES, m_queries);
+    if (m_mode == GpuTimerModeEnum::TIMESTAMPS) {
+        glGenQueries(NUM_QUERIES, m_endQueries);
+    }
+    if (m_queries[0] == 0 || (m_mode == GpuTimerModeEnum::TIMESTAMPS && m_endQueries[0] == 0)) {
+        Log::fatal("Failed to create GpuTimer queries");
+    }
+}
+
+GpuTimer::~GpuTimer() {
+    Log::debug("GpuTimer::~GpuTimer()");
+    glDeleteQueries(NUM_QUERIES, m_queries);
+    if (m_mode == GpuTimerModeEnum::TIMESTAMPS) {
+        glDeleteQueries(NUM_QUERIES, m_endQueries);
+    }
+}
+
+void GpuTimer::begin(u64 user_data) {
+    poll();
+
+    // all queries are still in flight, skip this measurement instead of waiting
+    if (m_inFlight[m_next]) {
+        return;
+    }
+
+    m_userData[m_next] = user_data;
+    if (m_mode == GpuTimerModeEnum::TIMESTAMPS) {
+        glQueryCounter(m_queries[m_next], GL_TIMESTAMP);
+    } else {
+        glBeginQuery(GL_TIME_ELAPSED, m_queries[m_next]);
+    }
+    m_recording = true;
+}
+
+void GpuTimer::end() {
+    if (!m_recording) {
+        return;
+    }
+
+    if (m_mode == GpuTimerModeEnum::TIMESTAMPS) {
+        glQueryCounter(m_endQueries[m_next], GL_TIMESTAMP);
+    } else {
+        glEndQuery(GL_TIME_ELAPSED);
+    }
+    m_inFlight[m_next] = true;
+    m_next = (m_next + 1) % NUM_QUERIES;
+    m_recording = false;
+}
+
+bool GpuTimer::popResult(f32 *milliseconds, u64 *user_data) {
+    poll();
+
+    if (!m_hasNewResult) {
+        return false;
+    }
+
+    *milliseconds = m_lastMilliseconds;
+    if (user_data) {
+        *user_data = m_lastUserData;
+    }
+    m_hasNewResult = false;
+    return true;
+}
+
+f32 GpuTimer::getMilliseconds() {
+    poll();
+    return m_lastMilliseconds;
+}
+
+void GpuTimer::poll() {
+    // the oldest query is the next one to be reused
+    for (u32 i = 0; i < NUM_QUERIES; ++i) {
+        u32 query = (m_next + i) % NUM_QUERIES;
+        if (!m_inFlight[query]) {
+            continue;
+        }
+
+        // the end timestamp finishes last
+        bool timestamps = m_mode == GpuTimerModeEnum::TIMESTAMPS;
+        s32 available = 0;
+        glGetQueryObjectiv(timestamps ? m_endQueries[query] : m_queries[query], GL_QUERY_RESULT_AVAILABLE,
+                           &available);
+        if (!available) {
+            break;
+        }
+
+        u64 nanoseconds = 0;
+        glGetQueryObjectui64v(m_queries[query], GL_QUERY_RESULT, &nanoseconds);
+        if (timestamps) {
+            u64 endNanoseconds = 0;
+            glGetQueryObjectui64v(m_endQueries[query], GL_QUERY_RESULT, &endNanoseconds);
+            nanoseconds = endNanoseconds - nanoseconds;
+        }
+        m_inFlight[query] = false;
+
+        m_lastMilliseconds = nanoseconds / 1000000.0f;
+        m_lastUserData = m_userData[query];
+        m_hasNewResult = true;
+    }
+}
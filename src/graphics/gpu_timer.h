@@ -0,0 +1,51 @@
+#ifndef ACORN_GPU_TIMER_H
+#define ACORN_GPU_TIMER_H
+
+#include "types.h"
+
+/// How a GpuTimer measures its range
+enum class GpuTimerModeEnum {
+    ELAPSED = 0,    // one GL_TIME_ELAPSED query, these can't overlap
+    TIMESTAMPS      // timestamps at begin and end, can enclose elapsed timers
+};
+
+/// Measures the GPU time of a range of commands with timer queries. Results are read back a few frames later
+/// without stalling. Only one elapsed timer can be recording at a time, they can't be nested
+class GpuTimer {
+public:
+    explicit GpuTimer(GpuTimerModeEnum mode = GpuTimerModeEnum::ELAPSED);
+    ~GpuTimer();
+
+    /// Start recording. Ignored if every query is still waiting for results
+    /// \param user_data Value that is returned along with the result of this measurement
+    void begin(u64 user_data = 0);
+
+    /// Stop recording
+    void end();
+
+    /// Get the newest finished measurement if one finished since the last call
+    bool popResult(f32 *milliseconds, u64 *user_data = nullptr);
+
+    /// Get the newest finished measurement in milliseconds
+    f32 getMilliseconds();
+
+private:
+    /// Collect results of finished queries, oldest first
+    void poll();
+
+    static constexpr u32 NUM_QUERIES = 4;
+
+    GpuTimerModeEnum m_mode;
+    u32 m_queries[NUM_QUERIES] = {};
+    u32 m_endQueries[NUM_QUERIES] = {};     // only used for timestamps
+    u64 m_userData[NUM_QUERIES] = {};
+    bool m_inFlight[NUM_QUERIES] = {};
+    u32 m_next = 0;
+    bool m_recording = false;
+
+    f32 m_lastMilliseconds = 0;
+    u64 m_lastUserData = 0;
+    bool m_hasNewResult = false;
+};
+
+#endif //ACORN_GPU_TIMER_H
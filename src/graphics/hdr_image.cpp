@@ -0,0 +1,416 @@
+#include "hdr_image.h"
+#include "core.h"
+#include "utils.h"
+#include "log.h"
+#include <glm/gtc/constants.hpp>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define ACORN_HDR_SSE
+#include <emmintrin.h>
+#endif
+
+// Number of rows that are converted or resampled in a single job
+constexpr u32 ROWS_PER_JOB = 16;
+
+/// Read a line without the newline, advancing offset past it
+static bool read_line(const std::vector<u8> &bytes, u64 *offset, std::string *line) {
+    line->clear();
+    while (*offset < bytes.size()) {
+        char c = (char)bytes[(*offset)++];
+        if (c == '\n') {
+            return true;
+        }
+        line->push_back(c);
+    }
+    return false;
+}
+
+/// Parse the text header and resolution line, leaving offset at the start of the pixel data
+static const char *parse_header(const std::vector<u8> &bytes, u64 *offset, u32 *width, u32 *height) {
+    std::string line;
+    if (!read_line(bytes, offset, &line) || line.compare(0, 2, "#?") != 0) {
+        return "not a Radiance HDR file";
+    }
+
+    // variables until an empty line
+    while (true) {
+        if (!read_line(bytes, offset, &line)) {
+            return "unexpected end of header";
+        }
+        if (line.empty()) {
+            break;
+        }
+        if (line.compare(0, 7, "FORMAT=") == 0 && line != "FORMAT=32-bit_rle_rgbe") {
+            return "unsupported pixel format, only RGBE is supported";
+        }
+    }
+
+    s32 w, h;
+    if (!read_line(bytes, offset, &line) || std::sscanf(line.c_str(), "-Y %d +X %d", &h, &w) != 2) {
+        return "unsupported image orientation, only -Y +X is supported";
+    }
+    if (w <= 0 || h <= 0) {
+        return "invalid image size";
+    }
+
+    *width = w;
+    *height = h;
+    return nullptr;
+}
+
+/// Decode scanlines that are either flat or adaptive run length encoded per channel
+static const char *decode_scanlines(const u8 *data, u64 size, u32 width, u32 height, u8 *rgbe) {
+    u64 offset = 0;
+    for (u32 y = 0; y < height; ++y) {
+        u8 *row = rgbe + (u64)y * width * 4;
+
+        bool isRunLengthEncoded = width >= 8 && width < 0x8000 && offset + 4 <= size &&
+                                  data[offset] == 2 && data[offset + 1] == 2 && !(data[offset + 2] & 0x80);
+        if (!isRunLengthEncoded) {
+            // flat pixels for the rest of the image
+            u64 remaining = (u64)(height - y) * width * 4;
+            if (offset + remaining > size) {
+                return "unexpected end of pixel data";
+            }
+            std::memcpy(row, data + offset, remaining);
+            return nullptr;
+        }
+
+        u32 scanlineWidth = ((u32)data[offset + 2] << 8u) | data[offset + 3];
+        if (scanlineWidth != width) {
+            return "scanline width does not match image width";
+        }
+        offset += 4;
+
+        // each channel is stored separately as a sequence of runs and literals
+        for (u32 c = 0; c < 4; ++c) {
+            u32 x = 0;
+            while (x < width) {
+                if (offset >= size) {
+                    return "unexpected end of pixel data";
+                }
+
+                u32 count = data[offset++];
+                if (count > 128) {
+                    count -= 128;
+                    if (count > width - x || offset >= size) {
+                        return "invalid run";
+                    }
+                    u8 value = data[offset++];
+                    for (; count > 0; --count) {
+                        row[(x++) * 4 + c] = value;
+                    }
+                } else {
+                    if (count == 0 || count > width - x || offset + count > size) {
+                        return "invalid literal run";
+                    }
+                    for (; count > 0; --count) {
+                        row[(x++) * 4 + c] = data[offset++];
+                    }
+                }
+            }
+        }
+    }
+
+    return nullptr;
+}
+
+/// Load a file and decode it into RGBE pixels
+static bool load_rgbe(const std::string &path, std::vector<u8> *rgbe, u32 *width, u32 *height) {
+    std::vector<u8> bytes;
+    if (!utils::load_file_to_bytes(path, &bytes)) {
+        Log::warn("Failed to open HDR image '%s'", path.c_str());
+        return false;
+    }
+
+    u64 offset = 0;
+    const char *error = parse_header(bytes, &offset, width, height);
+    if (!error) {
+        rgbe->resize((u64)*width * *height * 4);
+        error = decode_scanlines(bytes.data() + offset, bytes.size() - offset, *width, *height, rgbe->data());
+    }
+
+    if (error) {
+        Log::warn("Failed to decode HDR image '%s': %s", path.c_str(), error);
+        return false;
+    }
+
+    return true;
+}
+
+static f32 rgbe_pixel_scale(u8 exponent) {
+    // mantissas are 8 bit fixed point, no bias is added to match stb_image
+    return exponent == 0 ? 0.0f : std::ldexp(1.0f, (s32)exponent - (128 + 8));
+}
+
+static u16 float_to_half_scalar(f32 value) {
+    u32 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    u32 sign = (bits >> 16u) & 0x8000u;
+    bits &= 0x7fffffffu;
+
+    u32 half;
+    if (bits >= 0x47800000u) {
+        // too large for a half, inf or nan
+        half = bits > 0x7f800000u ? 0x7e00u : 0x7c00u;
+    } else if (bits < 0x38800000u) {
+        // subnormal half, adding 0.5 lets the float addition do the rounding
+        f32 magic;
+        std::memcpy(&magic, &bits, sizeof(magic));
+        magic += 0.5f;
+        std::memcpy(&half, &magic, sizeof(half));
+        half -= 0x3f000000u;
+    } else {
+        // rebias exponent and round mantissa to nearest even
+        u32 mantissaOdd = (bits >> 13u) & 1u;
+        half = (bits + 0xc8000fffu + mantissaOdd) >> 13u;
+    }
+
+    return (u16)(half | sign);
+}
+
+#ifdef ACORN_HDR_SSE
+/// Convert 4 floats to halves in the low 16 bits of each lane, same rounding as float_to_half_scalar.
+/// Based on "float->half variants" by Fabian Giesen
+static __m128i float_to_half_sse(__m128 values) {
+    const __m128i infinityAsFloat = _mm_set1_epi32(0x7f800000);
+    const __m128i halfMax = _mm_set1_epi32(0x47800000);
+    const __m128i minNormal = _mm_set1_epi32(0x38800000);
+    const __m128i subnormalMagic = _mm_set1_epi32(0x3f000000);
+    const __m128i normalBias = _mm_set1_epi32((s32)0xc8000fffu);
+    const __m128i nanBit = _mm_set1_epi32(0x200);
+    const __m128i infinityAsHalf = _mm_set1_epi32(0x7c00);
+
+    __m128 sign = _mm_and_ps(values, _mm_castsi128_ps(_mm_set1_epi32((s32)0x80000000u)));
+    __m128 absValues = _mm_xor_ps(values, sign);
+    __m128i absBits = _mm_castps_si128(absValues);
+
+    __m128i isNan = _mm_cmpgt_epi32(absBits, infinityAsFloat);
+    __m128i isRegular = _mm_cmpgt_epi32(halfMax, absBits);
+    __m128i isSubnormal = _mm_cmpgt_epi32(minNormal, absBits);
+
+    __m128i infOrNan = _mm_or_si128(_mm_and_si128(isNan, nanBit), infinityAsHalf);
+
+    __m128i subnormal = _mm_sub_epi32(
+        _mm_castps_si128(_mm_add_ps(absValues, _mm_castsi128_ps(subnormalMagic))), subnormalMagic);
+
+    __m128i mantissaOdd = _mm_srai_epi32(_mm_slli_epi32(absBits, 31 - 13), 31);
+    __m128i normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(absBits, normalBias), mantissaOdd), 13);
+
+    __m128i finite = _mm_or_si128(_mm_and_si128(isSubnormal, subnormal), _mm_andnot_si128(isSubnormal, normal));
+    __m128i half = _mm_or_si128(_mm_and_si128(isRegular, finite), _mm_andnot_si128(isRegular, infOrNan));
+
+    return _mm_or_si128(half, _mm_srli_epi32(_mm_castps_si128(sign), 16));
+}
+
+/// Pack the halves of two vectors into 8 u16 lanes
+static __m128i pack_halves(__m128i a, __m128i b) {
+    // there is no unsigned 32 -> 16 bit pack in SSE2, sign extend so the signed saturating pack keeps the bits
+    a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+    b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+    return _mm_packs_epi32(a, b);
+}
+
+/// Decode 4 RGBE pixels into one vector of (r, g, b, garbage) per pixel
+static void decode_rgbe_sse(const u8 *rgbe, __m128 pixels[4]) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i exponentBias = _mm_set1_epi32(128 + 8 - 127);
+
+    __m128i bytes = _mm_loadu_si128((const __m128i *)rgbe);
+    __m128i low = _mm_unpacklo_epi8(bytes, zero);
+    __m128i high = _mm_unpackhi_epi8(bytes, zero);
+    __m128i ints[4] = {
+        _mm_unpacklo_epi16(low, zero),
+        _mm_unpackhi_epi16(low, zero),
+        _mm_unpacklo_epi16(high, zero),
+        _mm_unpackhi_epi16(high, zero)
+    };
+
+    for (u32 i = 0; i < 4; ++i) {
+        // build 2^(e - 136) directly from exponent bits, tiny exponents and e = 0 flush to zero
+        __m128i exponent = _mm_sub_epi32(_mm_shuffle_epi32(ints[i], _MM_SHUFFLE(3, 3, 3, 3)), exponentBias);
+        exponent = _mm_and_si128(exponent, _mm_cmpgt_epi32(exponent, zero));
+        __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(exponent, 23));
+
+        pixels[i] = _mm_mul_ps(_mm_cvtepi32_ps(ints[i]), scale);
+    }
+}
+#endif
+
+namespace hdr {
+void rgbe_to_half(const u8 *rgbe, u16 *rgb, u32 num_pixels) {
+    u32 i = 0;
+
+#ifdef ACORN_HDR_SSE
+    alignas(16) u16 halves[16];
+    for (; i + 4 <= num_pixels; i += 4) {
+        __m128 pixels[4];
+        decode_rgbe_sse(rgbe + i * 4, pixels);
+
+        _mm_store_si128((__m128i *)halves,
+                        pack_halves(float_to_half_sse(pixels[0]), float_to_half_sse(pixels[1])));
+        _mm_store_si128((__m128i *)(halves + 8),
+                        pack_halves(float_to_half_sse(pixels[2]), float_to_half_sse(pixels[3])));
+
+        // drop the fourth lane of every pixel
+        u16 *out = rgb + i * 3;
+        for (u32 p = 0; p < 4; ++p) {
+            std::memcpy(out + p * 3, halves + p * 4, 3 * sizeof(u16));
+        }
+    }
+#endif
+
+    for (; i < num_pixels; ++i) {
+        const u8 *pixel = rgbe + i * 4;
+        f32 scale = rgbe_pixel_scale(pixel[3]);
+        for (u32 c = 0; c < 3; ++c) {
+            rgb[i * 3 + c] = float_to_half_scalar(pixel[c] * scale);
+        }
+    }
+}
+
+void rgbe_to_float(const u8 *rgbe, f32 *rgb, u32 num_pixels) {
+    u32 i = 0;
+
+#ifdef ACORN_HDR_SSE
+    alignas(16) f32 lanes[4];
+    for (; i + 4 <= num_pixels; i += 4) {
+        __m128 pixels[4];
+        decode_rgbe_sse(rgbe + i * 4, pixels);
+
+        // the garbage lane of a pixel is overwritten by the next one, the last one can't write past the end
+        f32 *out = rgb + i * 3;
+        _mm_storeu_ps(out, pixels[0]);
+        _mm_storeu_ps(out + 3, pixels[1]);
+        _mm_storeu_ps(out + 6, pixels[2]);
+        _mm_store_ps(lanes, pixels[3]);
+        std::memcpy(out + 9, lanes, 3 * sizeof(f32));
+    }
+#endif
+
+    for (; i < num_pixels; ++i) {
+        const u8 *pixel = rgbe + i * 4;
+        f32 scale = rgbe_pixel_scale(pixel[3]);
+        for (u32 c = 0; c < 3; ++c) {
+            rgb[i * 3 + c] = pixel[c] * scale;
+        }
+    }
+}
+
+void float_to_half(const f32 *values, u16 *halves, u32 count) {
+    u32 i = 0;
+
+#ifdef ACORN_HDR_SSE
+    for (; i + 8 <= count; i += 8) {
+        __m128i low = float_to_half_sse(_mm_loadu_ps(values + i));
+        __m128i high = float_to_half_sse(_mm_loadu_ps(values + i + 4));
+        _mm_storeu_si128((__m128i *)(halves + i), pack_halves(low, high));
+    }
+#endif
+
+    for (; i < count; ++i) {
+        halves[i] = float_to_half_scalar(values[i]);
+    }
+}
+
+bool load_image(const std::string &path, HdrImage *image) {
+    std::vector<u8> rgbe;
+    if (!load_rgbe(path, &rgbe, &image->width, &image->height)) {
+        return false;
+    }
+
+    image->pixels.resize((u64)image->width * image->height * 3);
+    rgbe_to_half(rgbe.data(), image->pixels.data(), image->width * image->height);
+    return true;
+}
+
+bool load_cubemap_faces(const char *const paths[6], HdrImage faces[6]) {
+    bool loaded[6] = {};
+    core->jobSystem.parallelFor(6, 1, [&](u32 begin, u32 end) {
+        for (u32 face = begin; face < end; ++face) {
+            loaded[face] = load_image(paths[face], &faces[face]);
+        }
+    });
+
+    for (u32 face = 0; face < 6; ++face) {
+        if (!loaded[face]) {
+            return false;
+        }
+        if (faces[face].width != faces[face].height || faces[face].width != faces[0].width) {
+            Log::warn("Cubemap face '%s' is not square or has a different size than the other faces", paths[face]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool load_equirectangular_as_cubemap(const std::string &path, u32 side_length, HdrImage faces[6]) {
+    u32 width, height;
+    std::vector<u8> rgbe;
+    if (!load_rgbe(path, &rgbe, &width, &height)) {
+        return false;
+    }
+
+    // resampling needs full precision
+    std::vector<f32> equirect((u64)width * height * 3);
+    core->jobSystem.parallelFor(height, ROWS_PER_JOB, [&](u32 begin, u32 end) {
+        u64 offset = (u64)begin * width;
+        rgbe_to_float(rgbe.data() + offset * 4, equirect.data() + offset * 3, (end - begin) * width);
+    });
+
+    for (u32 face = 0; face < 6; ++face) {
+        faces[face].width = side_length;
+        faces[face].height = side_length;
+        faces[face].pixels.resize((u64)side_length * side_length * 3);
+    }
+
+    // bilinearly sample the texel centers of every face, with the same mapping as sample_equirectangular_map in
+    // material.frag, wrapping horizontally
+    auto fetch = [&](s32 x, s32 y) {
+        x = (x % (s32)width + (s32)width) % (s32)width;
+        y = glm::clamp(y, 0, (s32)height - 1);
+        const f32 *p = equirect.data() + ((u64)y * width + x) * 3;
+        return glm::vec3(p[0], p[1], p[2]);
+    };
+
+    core->jobSystem.parallelFor(6 * side_length, ROWS_PER_JOB, [&](u32 begin, u32 end) {
+        std::vector<f32> row(side_length * 3);
+
+        for (u32 faceRow = begin; faceRow < end; ++faceRow) {
+            u32 face = faceRow / side_length;
+            u32 y = faceRow % side_length;
+            f32 t = 2.0f * (y + 0.5f) / side_length - 1.0f;
+
+            for (u32 x = 0; x < side_length; ++x) {
+                f32 s = 2.0f * (x + 0.5f) / side_length - 1.0f;
+                glm::vec3 dir = glm::normalize(utils::cubemap_face_direction(face, s, t));
+
+                f32 u = std::atan2(dir.z, dir.x) / (2.0f * glm::pi<f32>()) + 0.5f;
+                f32 v = 0.5f - std::asin(glm::clamp(dir.y, -1.0f, 1.0f)) / glm::pi<f32>();
+
+                f32 px = u * width - 0.5f;
+                f32 py = v * height - 0.5f;
+                s32 x0 = (s32)std::floor(px);
+                s32 y0 = (s32)std::floor(py);
+                f32 fx = px - x0;
+                f32 fy = py - y0;
+
+                glm::vec3 color = glm::mix(glm::mix(fetch(x0, y0), fetch(x0 + 1, y0), fx),
+                                           glm::mix(fetch(x0, y0 + 1), fetch(x0 + 1, y0 + 1), fx), fy);
+                row[x * 3 + 0] = color.x;
+                row[x * 3 + 1] = color.y;
+                row[x * 3 + 2] = color.z;
+            }
+
+            float_to_half(row.data(), faces[face].pixels.data() + (u64)y * side_length * 3, side_length * 3);
+        }
+    });
+
+    return true;
+}
+}
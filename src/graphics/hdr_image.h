@@ -0,0 +1,39 @@
+#ifndef ACORN_HDR_IMAGE_H
+#define ACORN_HDR_IMAGE_H
+
+#include "types.h"
+#include <string>
+#include <vector>
+
+/// RGB image with half float channels, rows go from top to bottom
+struct HdrImage {
+    u32 width = 0;
+    u32 height = 0;
+    std::vector<u16> pixels;
+};
+
+namespace hdr {
+/// Decode a Radiance .hdr (RGBE) file into half floats
+/// \return Whether the file could be loaded, failures are logged as warnings
+bool load_image(const std::string &path, HdrImage *image);
+
+/// Decode six cubemap face images in parallel on the job system
+/// \param paths Face paths, same order as GL_TEXTURE_CUBE_MAP_POSITIVE_X + face
+/// \return Whether all faces could be loaded and are square images of the same size
+bool load_cubemap_faces(const char *const paths[6], HdrImage faces[6]);
+
+/// Decode an equirectangular .hdr file and resample it into cubemap faces on the job system
+/// \param side_length Side length of each resulting face
+bool load_equirectangular_as_cubemap(const std::string &path, u32 side_length, HdrImage faces[6]);
+
+/// Convert RGBE pixels into RGB half floats
+void rgbe_to_half(const u8 *rgbe, u16 *rgb, u32 num_pixels);
+
+/// Convert RGBE pixels into RGB floats
+void rgbe_to_float(const u8 *rgbe, f32 *rgb, u32 num_pixels);
+
+/// Convert floats into half floats, rounding to nearest even
+void float_to_half(const f32 *values, u16 *halves, u32 count);
+}
+
+#endif //ACORN_HDR_IMAGE_H
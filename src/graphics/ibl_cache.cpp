@@ -0,0 +1,107 @@
+#include "ibl_cache.h"
+#include "utils.h"
+#include "log.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// Bump whenever the layout of the cache file changes
+constexpr u32 IBL_CACHE_MAGIC = 0x4c424941; // "AIBL"
+constexpr u32 IBL_CACHE_VERSION = 3;
+
+constexpr TextureFormatEnum BRDF_LUT_FORMAT = TextureFormatEnum::RG16F;
+constexpr TextureFormatEnum CUBEMAP_FORMAT = TextureFormatEnum::RGB16F;
+
+struct IblCacheHeader {
+    u32 magic;
+    u32 version;
+    u64 key;
+};
+
+static u64 get_level_size(u32 side_length, u32 level, TextureFormatEnum format) {
+    u64 levelSideLength = std::max(1u, side_length >> level);
+    return levelSideLength * levelSideLength * utils::get_format_pixel_size(format);
+}
+
+static u64 get_cache_size(const Texture2D &brdf_lut, const TextureCubemap &prefiltered_env,
+                          u32 num_prefiltered_env_levels) {
+    u64 size = sizeof(IblCacheHeader) + sizeof(ShCoefficients);
+    size += (u64)brdf_lut.getWidth() * brdf_lut.getHeight() * utils::get_format_pixel_size(BRDF_LUT_FORMAT);
+    for (u32 level = 0; level < num_prefiltered_env_levels; ++level) {
+        size += 6 * get_level_size(prefiltered_env.getSideLength(), level, CUBEMAP_FORMAT);
+    }
+    return size;
+}
+
+IblCache::IblCache(const std::string &path)
+    : m_path(path) {}
+
+bool IblCache::load(u64 key, Texture2D &brdf_lut, TextureCubemap &prefiltered_env, u32 num_prefiltered_env_levels,
+                    ShCoefficients *irradiance_sh) const {
+    std::vector<u8> bytes;
+    if (!utils::load_file_to_bytes(m_path, &bytes)) {
+        Log::debug("No IBL cache found at '%s'", m_path.c_str());
+        return false;
+    }
+
+    u64 expectedSize = get_cache_size(brdf_lut, prefiltered_env, num_prefiltered_env_levels);
+    if (bytes.size() != expectedSize) {
+        Log::info("IBL cache '%s' has an unexpected size, regenerating", m_path.c_str());
+        return false;
+    }
+
+    IblCacheHeader header = {};
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (header.magic != IBL_CACHE_MAGIC || header.version != IBL_CACHE_VERSION || header.key != key) {
+        Log::info("IBL cache '%s' is stale, regenerating", m_path.c_str());
+        return false;
+    }
+
+    u8 *current = bytes.data() + sizeof(header);
+
+    std::memcpy(irradiance_sh, current, sizeof(ShCoefficients));
+    current += sizeof(ShCoefficients);
+
+    brdf_lut.setImage(brdf_lut.getWidth(), brdf_lut.getHeight(), BRDF_LUT_FORMAT, current);
+    current += (u64)brdf_lut.getWidth() * brdf_lut.getHeight() * utils::get_format_pixel_size(BRDF_LUT_FORMAT);
+
+    for (u32 level = 0; level < num_prefiltered_env_levels; ++level) {
+        for (u32 face = 0; face < 6; ++face) {
+            prefiltered_env.setFaceImage(face, level, CUBEMAP_FORMAT, current);
+            current += get_level_size(prefiltered_env.getSideLength(), level, CUBEMAP_FORMAT);
+        }
+    }
+
+    Log::info("Loaded IBL precomputation from cache '%s'", m_path.c_str());
+    return true;
+}
+
+void IblCache::store(u64 key, const Texture2D &brdf_lut, const TextureCubemap &prefiltered_env,
+                     u32 num_prefiltered_env_levels, const ShCoefficients &irradiance_sh) const {
+    std::vector<u8> bytes(get_cache_size(brdf_lut, prefiltered_env, num_prefiltered_env_levels));
+
+    IblCacheHeader header = {IBL_CACHE_MAGIC, IBL_CACHE_VERSION, key};
+    std::memcpy(bytes.data(), &header, sizeof(header));
+
+    u8 *current = bytes.data() + sizeof(header);
+
+    std::memcpy(current, &irradiance_sh, sizeof(ShCoefficients));
+    current += sizeof(ShCoefficients);
+
+    brdf_lut.getImage(BRDF_LUT_FORMAT, current);
+    current += (u64)brdf_lut.getWidth() * brdf_lut.getHeight() * utils::get_format_pixel_size(BRDF_LUT_FORMAT);
+
+    for (u32 level = 0; level < num_prefiltered_env_levels; ++level) {
+        for (u32 face = 0; face < 6; ++face) {
+            prefiltered_env.getFaceImage(face, level, CUBEMAP_FORMAT, current);
+            current += get_level_size(prefiltered_env.getSideLength(), level, CUBEMAP_FORMAT);
+        }
+    }
+
+    if (!utils::write_bytes_to_file(m_path, bytes.data(), bytes.size())) {
+        Log::warn("Failed to write IBL cache '%s'", m_path.c_str());
+        return;
+    }
+
+    Log::info("Wrote IBL precomputation to cache '%s'", m_path.c_str());
+}
@@ -0,0 +1,27 @@
+#ifndef ACORN_IBL_CACHE_H
+#define ACORN_IBL_CACHE_H
+
+#include "types.h"
+#include "texture.h"
+#include "spherical_harmonics.h"
+#include <string>
+
+/// On-disk cache for the results of image based lighting precomputation
+class IblCache {
+public:
+    explicit IblCache(const std::string &path);
+
+    /// Try to load cached results into textures that are already allocated with the expected sizes
+    /// \return Whether the cache existed and was created with the same key
+    bool load(u64 key, Texture2D &brdf_lut, TextureCubemap &prefiltered_env, u32 num_prefiltered_env_levels,
+              ShCoefficients *irradiance_sh) const;
+
+    /// Write the results of precomputation to the cache, replacing whatever was there before
+    void store(u64 key, const Texture2D &brdf_lut, const TextureCubemap &prefiltered_env,
+               u32 num_prefiltered_env_levels, const ShCoefficients &irradiance_sh) const;
+
+private:
+    std::string m_path;
+};
+
+#endif //ACORN_IBL_CACHE_H
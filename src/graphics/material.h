@@ -7,6 +7,21 @@
 
 // TODO: if we decide to stream textures or something, we will want a better handle for textures
 
+/// Optional features of material.frag. The variant key of a material has the flags of the features it needs, so
+/// materials with built-in textures don't pay for sampling them
+enum MaterialVariantFlags : u32 {
+    MATERIAL_HAS_ALBEDO_MAP   = (1u << 0u),
+    MATERIAL_HAS_NORMAL_MAP   = (1u << 1u),
+    MATERIAL_HAS_PACKED_ORM   = (1u << 2u), // metallic and roughness come from one glTF style texture
+    MATERIAL_METALLIC_CONST   = (1u << 3u), // metallic is just the scale
+    MATERIAL_ROUGHNESS_CONST  = (1u << 4u), // roughness is just the scale
+};
+
+/// Shader keywords for each MaterialVariantFlags bit, in order
+constexpr const char *MATERIAL_VARIANT_KEYWORDS[] = {
+    "HAS_ALBEDO_MAP", "HAS_NORMAL_MAP", "HAS_PACKED_ORM", "METALLIC_CONST", "ROUGHNESS_CONST"
+};
+
 struct Material {
     Texture *albedoTexture = nullptr;
     Texture *normalTexture = nullptr;
@@ -16,6 +31,20 @@ struct Material {
 
     Texture *roughnessTexture = nullptr;
     f32 roughnessScale = 1.0f;
+
+    /// Occlusion, roughness and metallic in the red, green and blue channels. Replaces the metallic and roughness
+    /// textures if set
+    Texture *metallicRoughnessTexture = nullptr;
+
+    /// Back faces are visible, so meshlets facing away from the camera can't be culled
+    bool doubleSided = false;
+
+    bool operator==(const Material &other) const {
+        return albedoTexture == other.albedoTexture && normalTexture == other.normalTexture &&
+               metallicTexture == other.metallicTexture && metallicScale == other.metallicScale &&
+               roughnessTexture == other.roughnessTexture && roughnessScale == other.roughnessScale &&
+               metallicRoughnessTexture == other.metallicRoughnessTexture && doubleSided == other.doubleSided;
+    }
 };
 
 #endif //ACORN_MATERIAL_H
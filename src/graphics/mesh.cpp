@@ -2,8 +2,36 @@
 #include "log.h"
 #include <GL/gl3w.h>
 
-Mesh::Mesh(const std::vector<Vertex> &vertices, Material material)
-    : m_numVertices(vertices.size()), m_material(material) {
+/// Built-in textures are constant, so there is no need to sample them
+static u32 get_material_variant_key(const Material &material) {
+    Texture *white = core->resourceManager.getBuiltInTexture(BuiltInTextureEnum::WHITE);
+    Texture *normal = core->resourceManager.getBuiltInTexture(BuiltInTextureEnum::NORMAL);
+
+    u32 key = 0;
+    if (material.albedoTexture != white) {
+        key |= MATERIAL_HAS_ALBEDO_MAP;
+    }
+    if (material.normalTexture != normal) {
+        key |= MATERIAL_HAS_NORMAL_MAP;
+    }
+    if (material.metallicRoughnessTexture) {
+        key |= MATERIAL_HAS_PACKED_ORM;
+    } else {
+        if (material.metallicTexture == white) {
+            key |= MATERIAL_METALLIC_CONST;
+        }
+        if (material.roughnessTexture == white) {
+            key |= MATERIAL_ROUGHNESS_CONST;
+        }
+    }
+    return key;
+}
+
+Mesh::Mesh(const std::vector<Vertex> &vertices, const std::vector<u32> &indices, const std::vector<MeshLod> &lods,
+           Meshlets meshlets, Material material)
+    : m_numVertices(vertices.size()), m_lods(lods), m_meshlets(std::move(meshlets)), m_indices(indices),
+      m_material(material), m_materialId(core->resourceManager.getMaterialId(material)),
+      m_materialVariantKey(get_material_variant_key(material)) {
     // Find min and max
     for (auto &v : vertices) {
         m_min = glm::min(m_min, v.position);
@@ -39,36 +67,91 @@ Mesh::Mesh(const std::vector<Vertex> &vertices, Material material)
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void *) offsetof(Vertex, uv));
 
     glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void *) offsetof(Vertex, tangent));
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void *) offsetof(Vertex, tangent));
+
+    // every level of detail is a range of one index buffer
+    glGenBuffers(1, &m_ibo);
+    if (m_ibo == 0) {
+        Log::fatal("Failed to generate ibo for mesh");
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(u32), indices.data(), GL_STATIC_DRAW);
+
+    // depth-only passes fetch a third of the data from their own stream
+    m_positions.resize(vertices.size());
+    for (u32 i = 0; i < vertices.size(); ++i) {
+        m_positions[i] = vertices[i].position;
+    }
 
-    glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void *) offsetof(Vertex, biTangent));
+    glGenVertexArrays(1, &m_positionVao);
+    if (m_positionVao == 0) {
+        Log::fatal("Failed to generate position vao for mesh");
+    }
+
+    glBindVertexArray(m_positionVao);
+
+    glGenBuffers(1, &m_positionVbo);
+    if (m_positionVbo == 0) {
+        Log::fatal("Failed to generate position vbo for mesh");
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, m_positionVbo);
+    glBufferData(GL_ARRAY_BUFFER, m_positions.size() * sizeof(glm::vec3), m_positions.data(), GL_STATIC_DRAW);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), nullptr);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
 
     glBindVertexArray(0);
 
-    Log::debug("Mesh::Mesh(%d vertices, mat) - #%d", vertices.size(), m_vao);
+    Log::debug("Mesh::Mesh(%d vertices, %d indices, %d lods, %d meshlets, mat) - #%d", vertices.size(),
+               indices.size(), lods.size(), m_meshlets.size(), m_vao);
 }
 
 Mesh::Mesh(Mesh &&other) noexcept
     : m_vao(other.m_vao),
       m_vbo(other.m_vbo),
+      m_positionVao(other.m_positionVao),
+      m_positionVbo(other.m_positionVbo),
+      m_ibo(other.m_ibo),
       m_numVertices(other.m_numVertices),
+      m_lods(std::move(other.m_lods)),
+      m_meshlets(std::move(other.m_meshlets)),
+      m_positions(std::move(other.m_positions)),
+      m_indices(std::move(other.m_indices)),
       m_material(other.m_material),
+      m_materialId(other.m_materialId),
+      m_materialVariantKey(other.m_materialVariantKey),
       m_min(other.m_min),
       m_max(other.m_max) {
     other.m_vao = 0;
     other.m_vbo = 0;
+    other.m_positionVao = 0;
+    other.m_positionVbo = 0;
+    other.m_ibo = 0;
 }
 
 Mesh &Mesh::operator=(Mesh &&other) noexcept {
     m_vao = other.m_vao;
     m_vbo = other.m_vbo;
+    m_positionVao = other.m_positionVao;
+    m_positionVbo = other.m_positionVbo;
+    m_ibo = other.m_ibo;
     m_numVertices = other.m_numVertices;
+    m_lods = std::move(other.m_lods);
+    m_meshlets = std::move(other.m_meshlets);
+    m_positions = std::move(other.m_positions);
+    m_indices = std::move(other.m_indices);
     m_material = other.m_material;
+    m_materialId = other.m_materialId;
+    m_materialVariantKey = other.m_materialVariantKey;
     m_min = other.m_min;
     m_max = other.m_max;
     other.m_vao = 0;
     other.m_vbo = 0;
+    other.m_positionVao = 0;
+    other.m_positionVbo = 0;
+    other.m_ibo = 0;
     return *this;
 }
 
@@ -76,9 +159,29 @@ Mesh::~Mesh() {
     Log::debug("Mesh::~Mesh() - %d", m_vao);
     glDeleteVertexArrays(1, &m_vao);
     glDeleteBuffers(1, &m_vbo);
+    glDeleteVertexArrays(1, &m_positionVao);
+    glDeleteBuffers(1, &m_positionVbo);
+    glDeleteBuffers(1, &m_ibo);
 }
 
-void Mesh::draw() const {
+void Mesh::draw(u32 lod) const {
     glBindVertexArray(m_vao);
-    glDrawArrays(GL_TRIANGLES, 0, m_numVertices);
+    glDrawElements(GL_TRIANGLES, m_lods[lod].numIndices, GL_UNSIGNED_INT,
+                   (const void *) (m_lods[lod].firstIndex * sizeof(u32)));
+}
+
+void Mesh::drawPositions(u32 lod) const {
+    glBindVertexArray(m_positionVao);
+    glDrawElements(GL_TRIANGLES, m_lods[lod].numIndices, GL_UNSIGNED_INT,
+                   (const void *) (m_lods[lod].firstIndex * sizeof(u32)));
+}
+
+void Mesh::drawRanges(const s32 *counts, const void *const *offsets, u32 num_ranges) const {
+    glBindVertexArray(m_vao);
+    glMultiDrawElements(GL_TRIANGLES, counts, GL_UNSIGNED_INT, offsets, num_ranges);
+}
+
+void Mesh::drawPositionRanges(const s32 *counts, const void *const *offsets, u32 num_ranges) const {
+    glBindVertexArray(m_positionVao);
+    glMultiDrawElements(GL_TRIANGLES, counts, GL_UNSIGNED_INT, offsets, num_ranges);
 }
@@ -5,30 +5,149 @@
 #include "material.h"
 #include "vertex.h"
 #include <glm/glm.hpp>
+#include <string>
 #include <vector>
 
+/// A range of the index buffer of a mesh that draws it at one level of detail
+struct MeshLod {
+    u32 firstIndex;
+    u32 numIndices;
+    f32 error;      // how far the surface deviates from the full detail level at most, in object space
+    u32 firstMeshlet;
+    u32 numMeshlets;    // 0 if the level isn't split into meshlets
+};
+
+/// Clusters of neighbouring triangles that are culled on their own, each one a contiguous range of the index buffer.
+/// Structure of arrays, so the bounds of several meshlets can be tested at once
+struct Meshlets {
+    std::vector<u32> firstIndex;
+    std::vector<u32> numIndices;
+
+    // object space bounding sphere
+    std::vector<f32> centerX;
+    std::vector<f32> centerY;
+    std::vector<f32> centerZ;
+    std::vector<f32> radius;
+
+    // cone around the triangle normals, cutoff is the sine of its half angle or 1 if it can't be backface culled
+    std::vector<f32> coneX;
+    std::vector<f32> coneY;
+    std::vector<f32> coneZ;
+    std::vector<f32> coneCutoff;
+
+    u32 size() const {
+        return firstIndex.size();
+    }
+};
+
+/// Vertices, triangle list and material of a mesh that was imported but not uploaded yet
+struct MeshData {
+    std::vector<Vertex> vertices;
+    std::vector<u32> indices;
+    Material material;
+};
+
+/// A node of an imported hierarchy. Nodes are sorted so parents come before their children
+struct NodeData {
+    s32 parent;                 // -1 for roots
+    glm::mat4 localTransform;   // relative to the parent
+    std::vector<u32> meshes;    // indices of the imported meshes the node places, shared by other nodes as instances
+    std::string name;
+};
+
 class Mesh {
 public:
-    Mesh(const std::vector<Vertex> &vertices, Material material);
+    /// \param indices Triangle lists of all levels of detail, which share the vertices
+    /// \param lods Ranges of indices, from full detail to the coarsest level
+    /// \param meshlets Meshlets of the levels of detail, see MeshLod::firstMeshlet
+    Mesh(const std::vector<Vertex> &vertices, const std::vector<u32> &indices, const std::vector<MeshLod> &lods,
+         Meshlets meshlets, Material material);
     Mesh(Mesh &&other) noexcept;
     Mesh &operator=(Mesh &&other) noexcept;
     ~Mesh();
 
-    void draw() const;
+    void draw(u32 lod = 0) const;
+
+    /// Draw from a tightly packed stream of only positions, for depth-only passes
+    void drawPositions(u32 lod = 0) const;
+
+    /// Draw several ranges of the index buffer with one call
+    /// \param counts Number of indices of each range
+    /// \param offsets Byte offset into the index buffer of each range
+    void drawRanges(const s32 *counts, const void *const *offsets, u32 num_ranges) const;
+
+    /// Draw several ranges of the index buffer from the position stream, see drawRanges()
+    void drawPositionRanges(const s32 *counts, const void *const *offsets, u32 num_ranges) const;
 
     const Material &getMaterial() const {
         return m_material;
     }
 
+    /// Get the id of the material in the material registry, meshes with identical materials share it
+    u32 getMaterialId() const {
+        return m_materialId;
+    }
+
+    /// Get the MaterialVariantFlags needed to render the material
+    u32 getMaterialVariantKey() const {
+        return m_materialVariantKey;
+    }
+
     u32 getNumVertices() const {
         return m_numVertices;
     }
 
+    /// Get the number of indices drawn at a level of detail
+    u32 getNumIndices(u32 lod = 0) const {
+        return m_lods[lod].numIndices;
+    }
+
+    u32 getNumLods() const {
+        return m_lods.size();
+    }
+
+    const MeshLod &getLod(u32 lod) const {
+        return m_lods[lod];
+    }
+
+    const Meshlets &getMeshlets() const {
+        return m_meshlets;
+    }
+
+    /// Get a CPU copy of the vertex positions, for software rasterization
+    const std::vector<glm::vec3> &getPositions() const {
+        return m_positions;
+    }
+
+    /// Get a CPU copy of the index buffer, for software rasterization
+    const std::vector<u32> &getIndices() const {
+        return m_indices;
+    }
+
+    /// Get the minimum corner of the local space bounding box
+    glm::vec3 getMin() const {
+        return m_min;
+    }
+
+    /// Get the maximum corner of the local space bounding box
+    glm::vec3 getMax() const {
+        return m_max;
+    }
+
 private:
     u32 m_vao = 0;
     u32 m_vbo = 0;
+    u32 m_positionVao = 0;
+    u32 m_positionVbo = 0;
+    u32 m_ibo = 0;
     u32 m_numVertices = 0;
+    std::vector<MeshLod> m_lods;
+    Meshlets m_meshlets;
+    std::vector<glm::vec3> m_positions;
+    std::vector<u32> m_indices;
     Material m_material;
+    u32 m_materialId = 0;
+    u32 m_materialVariantKey = 0;
     glm::vec3 m_min = glm::vec3(INFINITY);
     glm::vec3 m_max = glm::vec3(-INFINITY);
 };
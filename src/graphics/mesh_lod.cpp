@@ -0,0 +1,324 @@
+#include "mesh_lod.h"
+#include "constants.h"
+#include "log.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace mesh_lod {
+
+namespace {
+
+/// Sum of squared distances to a set of planes, weighted by triangle area. Q(p) = p^T A p + 2 b^T p + c
+struct Quadric {
+    f64 a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+    f64 b0 = 0, b1 = 0, b2 = 0;
+    f64 c = 0;
+    f64 weight = 0;
+
+    void addPlane(glm::vec3 normal, f32 distance, f32 plane_weight) {
+        f64 x = normal.x, y = normal.y, z = normal.z, d = distance, w = plane_weight;
+        a00 += w * x * x;
+        a01 += w * x * y;
+        a02 += w * x * z;
+        a11 += w * y * y;
+        a12 += w * y * z;
+        a22 += w * z * z;
+        b0 += w * x * d;
+        b1 += w * y * d;
+        b2 += w * z * d;
+        c += w * d * d;
+        weight += w;
+    }
+
+    void add(const Quadric &other) {
+        a00 += other.a00;
+        a01 += other.a01;
+        a02 += other.a02;
+        a11 += other.a11;
+        a12 += other.a12;
+        a22 += other.a22;
+        b0 += other.b0;
+        b1 += other.b1;
+        b2 += other.b2;
+        c += other.c;
+        weight += other.weight;
+    }
+
+    /// Weighted sum of squared distances at a point
+    f64 evaluate(glm::vec3 p) const {
+        f64 x = p.x, y = p.y, z = p.z;
+        f64 result = a00 * x * x + a11 * y * y + a22 * z * z +
+                     2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+                     2.0 * (b0 * x + b1 * y + b2 * z) + c;
+        return std::max(result, 0.0);
+    }
+};
+
+struct Collapse {
+    u32 from;
+    u32 to;
+    f32 error;  // mean squared distance
+};
+
+struct PositionHash {
+    size_t operator()(const glm::vec3 &p) const {
+        // -0 and 0 compare equal, adding 0 turns -0 into 0 so they hash the same too
+        glm::vec3 normalized = p + glm::vec3(0.0f);
+        u32 bits[3];
+        std::memcpy(bits, &normalized, sizeof(bits));
+        return bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u;
+    }
+};
+
+u64 edge_key(u32 a, u32 b) {
+    return a < b ? ((u64)a << 32u) | b : ((u64)b << 32u) | a;
+}
+
+glm::vec3 triangle_normal(glm::vec3 a, glm::vec3 b, glm::vec3 c) {
+    return glm::cross(b - a, c - a);
+}
+
+}
+
+std::vector<u32> simplify(const std::vector<Vertex> &vertices, const std::vector<u32> &indices,
+                          u32 target_num_indices, f32 max_error, f32 *result_error) {
+    *result_error = 0.0f;
+    u32 numVertices = vertices.size();
+
+    // vertices with the same position are welded for topology, copies of a position are attribute seams
+    std::vector<u32> positionIds(numVertices);
+    std::vector<u32> positionCounts;
+    {
+        std::unordered_map<glm::vec3, u32, PositionHash> ids;
+        for (u32 v = 0; v < numVertices; ++v) {
+            auto it = ids.find(vertices[v].position);
+            if (it == ids.end()) {
+                it = ids.emplace(vertices[v].position, (u32)positionCounts.size()).first;
+                positionCounts.push_back(0);
+            }
+            positionIds[v] = it->second;
+        }
+    }
+
+    std::vector<bool> used(numVertices, false);
+    for (u32 index : indices) {
+        if (!used[index]) {
+            used[index] = true;
+            ++positionCounts[positionIds[index]];
+        }
+    }
+
+    std::vector<bool> locked(numVertices, false);
+    for (u32 v = 0; v < numVertices; ++v) {
+        locked[v] = used[v] && positionCounts[positionIds[v]] > 1;
+    }
+
+    // edges with one triangle are open borders, edges with more are non-manifold, neither can be collapsed over
+    {
+        std::unordered_map<u64, u32> edgeTriangles;
+        for (u32 t = 0; t < indices.size(); t += 3) {
+            for (u32 e = 0; e < 3; ++e) {
+                ++edgeTriangles[edge_key(positionIds[indices[t + e]], positionIds[indices[t + (e + 1) % 3]])];
+            }
+        }
+        for (u32 t = 0; t < indices.size(); t += 3) {
+            for (u32 e = 0; e < 3; ++e) {
+                u32 a = indices[t + e];
+                u32 b = indices[t + (e + 1) % 3];
+                if (edgeTriangles[edge_key(positionIds[a], positionIds[b])] != 2) {
+                    locked[a] = true;
+                    locked[b] = true;
+                }
+            }
+        }
+    }
+
+    // plane quadrics of the triangles around each vertex
+    std::vector<Quadric> quadrics(numVertices);
+    for (u32 t = 0; t < indices.size(); t += 3) {
+        glm::vec3 p0 = vertices[indices[t]].position;
+        glm::vec3 normal = triangle_normal(p0, vertices[indices[t + 1]].position, vertices[indices[t + 2]].position);
+        f32 doubleArea = glm::length(normal);
+        if (doubleArea <= 0.0f) {
+            continue;
+        }
+        normal /= doubleArea;
+
+        for (u32 i = 0; i < 3; ++i) {
+            quadrics[indices[t + i]].addPlane(normal, -glm::dot(normal, p0), doubleArea * 0.5f);
+        }
+    }
+
+    std::vector<u32> result = indices;
+    std::vector<u32> adjacencyOffsets(numVertices + 1);
+    std::vector<u32> adjacency;
+    std::vector<Collapse> collapses;
+    std::vector<u32> remap(numVertices);
+    std::vector<bool> touched(numVertices);
+    f64 maxErrorSquared = (f64)max_error * max_error;
+
+    // each pass collapses a set of independent edges in order of their error, then rebuilds the triangles
+    while (result.size() > target_num_indices) {
+        // triangles around each vertex
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (u32 index : result) {
+            ++adjacencyOffsets[index + 1];
+        }
+        for (u32 v = 0; v < numVertices; ++v) {
+            adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+        }
+        adjacency.resize(result.size());
+        std::vector<u32> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (u32 i = 0; i < result.size(); ++i) {
+            adjacency[fill[result[i]]++] = i / 3;
+        }
+
+        collapses.clear();
+        for (u32 t = 0; t < result.size(); t += 3) {
+            for (u32 e = 0; e < 3; ++e) {
+                u32 a = result[t + e];
+                u32 b = result[t + (e + 1) % 3];
+                for (u32 direction = 0; direction < 2; ++direction, std::swap(a, b)) {
+                    if (locked[a]) {
+                        continue;
+                    }
+
+                    Quadric quadric = quadrics[a];
+                    quadric.add(quadrics[b]);
+                    f64 error = quadric.evaluate(vertices[b].position) / std::max(quadric.weight, 1e-12);
+                    collapses.push_back({a, b, (f32)error});
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse &lhs, const Collapse &rhs) {
+            return lhs.error < rhs.error;
+        });
+
+        for (u32 v = 0; v < numVertices; ++v) {
+            remap[v] = v;
+        }
+        std::fill(touched.begin(), touched.end(), false);
+
+        // every collapse removes about two triangles, no more than needed are done
+        u32 numTriangles = result.size() / 3;
+        u32 targetTriangles = target_num_indices / 3;
+        u32 removedTriangles = 0;
+        u32 numCollapses = 0;
+
+        for (const Collapse &collapse : collapses) {
+            if (numTriangles - removedTriangles <= targetTriangles || collapse.error > maxErrorSquared) {
+                break;
+            }
+
+            u32 a = collapse.from;
+            u32 b = collapse.to;
+            if (touched[a] || touched[b]) {
+                continue;
+            }
+
+            // vertices with differing normals sit on a crease, merging them would smooth it away
+            if (glm::dot(vertices[a].normal, vertices[b].normal) < consts::MESH_LOD_NORMAL_THRESHOLD) {
+                continue;
+            }
+
+            // moving a onto b must not flip any of the remaining triangles around a
+            glm::vec3 target = vertices[b].position;
+            bool flips = false;
+            u32 degenerate = 0;
+            for (u32 i = adjacencyOffsets[a]; i < adjacencyOffsets[a + 1] && !flips; ++i) {
+                const u32 *triangle = &result[adjacency[i] * 3];
+                glm::vec3 p[3];
+                glm::vec3 moved[3];
+                bool hasB = false;
+                for (u32 k = 0; k < 3; ++k) {
+                    p[k] = vertices[triangle[k]].position;
+                    moved[k] = triangle[k] == a ? target : p[k];
+                    hasB = hasB || positionIds[triangle[k]] == positionIds[b];
+                }
+
+                if (hasB) {
+                    ++degenerate;
+                    continue;
+                }
+
+                glm::vec3 before = triangle_normal(p[0], p[1], p[2]);
+                glm::vec3 after = triangle_normal(moved[0], moved[1], moved[2]);
+                flips = glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after);
+            }
+            if (flips) {
+                continue;
+            }
+
+            remap[a] = b;
+            quadrics[b].add(quadrics[a]);
+            removedTriangles += degenerate;
+            *result_error = std::max(*result_error, std::sqrt(collapse.error));
+            ++numCollapses;
+
+            // the triangles around a change, so their vertices sit out the rest of this pass
+            for (u32 i = adjacencyOffsets[a]; i < adjacencyOffsets[a + 1]; ++i) {
+                const u32 *triangle = &result[adjacency[i] * 3];
+                touched[triangle[0]] = true;
+                touched[triangle[1]] = true;
+                touched[triangle[2]] = true;
+            }
+        }
+
+        if (numCollapses == 0) {
+            break;
+        }
+
+        // apply collapses and drop triangles that lost their area
+        u32 write = 0;
+        for (u32 t = 0; t < result.size(); t += 3) {
+            u32 i0 = remap[result[t]];
+            u32 i1 = remap[result[t + 1]];
+            u32 i2 = remap[result[t + 2]];
+            if (positionIds[i0] == positionIds[i1] || positionIds[i1] == positionIds[i2] ||
+                positionIds[i2] == positionIds[i0]) {
+                continue;
+            }
+            result[write++] = i0;
+            result[write++] = i1;
+            result[write++] = i2;
+        }
+        result.resize(write);
+    }
+
+    return result;
+}
+
+void generate_lods(const std::vector<Vertex> &vertices, std::vector<u32> *indices, std::vector<MeshLod> *lods) {
+    lods->clear();
+    lods->push_back({0, (u32)indices->size(), 0.0f, 0, 0});
+
+    std::vector<u32> previous = *indices;
+    f32 error = 0.0f;
+    for (u32 level = 1; level < consts::MAX_MESH_LODS; ++level) {
+        u32 targetTriangles = (u32)(previous.size() / 3 * consts::MESH_LOD_REDUCTION);
+        if (targetTriangles < consts::MESH_LOD_MIN_TRIANGLES) {
+            break;
+        }
+
+        f32 levelError;
+        std::vector<u32> simplified = simplify(vertices, previous, targetTriangles * 3, FLT_MAX, &levelError);
+        if (simplified.size() > previous.size() * consts::MESH_LOD_MIN_REDUCTION) {
+            break;
+        }
+
+        // each level is simplified from the previous one, so their errors add up at most
+        error += levelError;
+        lods->push_back({(u32)indices->size(), (u32)simplified.size(), error, 0, 0});
+        indices->insert(indices->end(), simplified.begin(), simplified.end());
+        previous = std::move(simplified);
+    }
+
+    Log::debug("Generated %d levels of detail, coarsest has %d of %d triangles", lods->size(),
+               lods->back().numIndices / 3, lods->front().numIndices / 3);
+}
+
+}
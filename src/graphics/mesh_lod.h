@@ -0,0 +1,28 @@
+#ifndef ACORN_MESH_LOD_H
+#define ACORN_MESH_LOD_H
+
+#include "types.h"
+#include "vertex.h"
+#include "mesh.h"
+#include <vector>
+
+namespace mesh_lod {
+/// Simplify an indexed triangle list with quadric error metrics. Vertices are collapsed onto neighbouring vertices,
+/// so the result references the same vertex buffer. Vertices on open borders and on attribute seams (the same
+/// position with different normals or uvs) are locked, and collapses that flip triangles or merge vertices with
+/// differing normals are rejected
+/// \param target_num_indices Stop once the result has at most this many indices
+/// \param max_error Stop before a collapse would move the surface further than this, in object space
+/// \param result_error Largest error of the collapses that were done
+/// \return Simplified triangle list
+std::vector<u32> simplify(const std::vector<Vertex> &vertices, const std::vector<u32> &indices,
+                          u32 target_num_indices, f32 max_error, f32 *result_error);
+
+/// Append a chain of simplified levels of detail to a triangle list, each about consts::MESH_LOD_REDUCTION of the
+/// previous level. Stops early once simplification stalls on locked vertices
+/// \param indices Full detail triangle list, the levels are appended to it
+/// \param lods Receives the ranges of all levels, starting with the full detail one
+void generate_lods(const std::vector<Vertex> &vertices, std::vector<u32> *indices, std::vector<MeshLod> *lods);
+}
+
+#endif //ACORN_MESH_LOD_H
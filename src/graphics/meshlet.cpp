@@ -0,0 +1,333 @@
+#include "meshlet.h"
+#include "constants.h"
+#include "log.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define ACORN_MESHLET_SSE
+#include <emmintrin.h>
+#endif
+
+namespace meshlet {
+
+namespace {
+
+/// Add the bounding sphere and normal cone of the triangles [first_index, first_index + num_indices) of a meshlet
+void add_meshlet(const std::vector<Vertex> &vertices, const std::vector<u32> &indices, u32 first_index,
+                 u32 num_indices, Meshlets *meshlets) {
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+    for (u32 i = first_index; i < first_index + num_indices; ++i) {
+        min = glm::min(min, vertices[indices[i]].position);
+        max = glm::max(max, vertices[indices[i]].position);
+    }
+
+    glm::vec3 center = (min + max) * 0.5f;
+    f32 radiusSquared = 0.0f;
+    for (u32 i = first_index; i < first_index + num_indices; ++i) {
+        glm::vec3 offset = vertices[indices[i]].position - center;
+        radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+    }
+
+    // triangle normals face the same side as their vertex normals, in case the winding of a model is inconsistent
+    std::vector<glm::vec3> normals;
+    normals.reserve(num_indices / 3);
+    glm::vec3 normalSum = glm::vec3(0);
+    for (u32 i = first_index; i < first_index + num_indices; i += 3) {
+        const Vertex &v0 = vertices[indices[i]];
+        const Vertex &v1 = vertices[indices[i + 1]];
+        const Vertex &v2 = vertices[indices[i + 2]];
+        glm::vec3 normal = glm::cross(v1.position - v0.position, v2.position - v0.position);
+        f32 length = glm::length(normal);
+        if (length <= 0.0f) {
+            continue;
+        }
+
+        normal /= length;
+        if (glm::dot(normal, v0.normal + v1.normal + v2.normal) < 0.0f) {
+            normal = -normal;
+        }
+        normals.push_back(normal);
+        normalSum += normal;
+    }
+
+    glm::vec3 axis = glm::vec3(0, 0, 1);
+    f32 cutoff = 1.0f;
+    f32 sumLength = glm::length(normalSum);
+    if (sumLength > 0.0f) {
+        axis = normalSum / sumLength;
+
+        f32 minDot = 1.0f;
+        for (glm::vec3 normal : normals) {
+            minDot = std::min(minDot, glm::dot(normal, axis));
+        }
+
+        // cones wider than a hemisphere always have a triangle facing the camera
+        if (minDot > 0.0f) {
+            cutoff = std::sqrt(1.0f - minDot * minDot);
+        }
+    }
+
+    meshlets->firstIndex.push_back(first_index);
+    meshlets->numIndices.push_back(num_indices);
+    meshlets->centerX.push_back(center.x);
+    meshlets->centerY.push_back(center.y);
+    meshlets->centerZ.push_back(center.z);
+    meshlets->radius.push_back(std::sqrt(radiusSquared));
+    meshlets->coneX.push_back(axis.x);
+    meshlets->coneY.push_back(axis.y);
+    meshlets->coneZ.push_back(axis.z);
+    meshlets->coneCutoff.push_back(cutoff);
+}
+
+/// Split one level of detail into meshlets, greedily growing each one with the triangle that adds the fewest new
+/// vertices and is closest to its centroid
+void build_lod(const std::vector<Vertex> &vertices, std::vector<u32> *indices, MeshLod *lod, Meshlets *meshlets) {
+    u32 numTriangles = lod->numIndices / 3;
+    const u32 *lodIndices = indices->data() + lod->firstIndex;
+
+    // triangles around each vertex
+    std::vector<u32> adjacencyOffsets(vertices.size() + 1, 0);
+    for (u32 i = 0; i < lod->numIndices; ++i) {
+        ++adjacencyOffsets[lodIndices[i] + 1];
+    }
+    for (u32 v = 0; v < vertices.size(); ++v) {
+        adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+    }
+    std::vector<u32> adjacency(lod->numIndices);
+    std::vector<u32> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (u32 i = 0; i < lod->numIndices; ++i) {
+        adjacency[fill[lodIndices[i]]++] = i / 3;
+    }
+
+    std::vector<u32> reordered;
+    reordered.reserve(lod->numIndices);
+    std::vector<bool> emitted(numTriangles, false);
+    std::vector<u32> vertexMeshlet(vertices.size(), ~0u);
+    std::vector<u32> candidates;
+
+    lod->firstMeshlet = meshlets->size();
+    u32 seed = 0;
+    u32 meshletId = 0;
+
+    while (reordered.size() < lod->numIndices) {
+        while (emitted[seed]) {
+            ++seed;
+        }
+
+        u32 firstIndex = reordered.size();
+        u32 numMeshletVertices = 0;
+        u32 numMeshletTriangles = 0;
+        glm::vec3 centroidSum = glm::vec3(0);
+        candidates.clear();
+
+        u32 triangle = seed;
+        while (true) {
+            emitted[triangle] = true;
+            ++numMeshletTriangles;
+            for (u32 k = 0; k < 3; ++k) {
+                u32 v = lodIndices[triangle * 3 + k];
+                reordered.push_back(v);
+                centroidSum += vertices[v].position;
+
+                if (vertexMeshlet[v] != meshletId) {
+                    vertexMeshlet[v] = meshletId;
+                    ++numMeshletVertices;
+                    for (u32 i = adjacencyOffsets[v]; i < adjacencyOffsets[v + 1]; ++i) {
+                        if (!emitted[adjacency[i]]) {
+                            candidates.push_back(adjacency[i]);
+                        }
+                    }
+                }
+            }
+
+            if (numMeshletTriangles == consts::MESHLET_MAX_TRIANGLES) {
+                break;
+            }
+
+            glm::vec3 centroid = centroidSum / (3.0f * numMeshletTriangles);
+            u32 best = ~0u;
+            u32 bestNewVertices = 4;
+            f32 bestDistance = FLT_MAX;
+            u32 write = 0;
+            for (u32 candidate : candidates) {
+                if (emitted[candidate]) {
+                    continue;
+                }
+                candidates[write++] = candidate;
+
+                u32 newVertices = 0;
+                glm::vec3 triangleCentroid = glm::vec3(0);
+                for (u32 k = 0; k < 3; ++k) {
+                    u32 v = lodIndices[candidate * 3 + k];
+                    newVertices += vertexMeshlet[v] != meshletId;
+                    triangleCentroid += vertices[v].position;
+                }
+                if (numMeshletVertices + newVertices > consts::MESHLET_MAX_VERTICES) {
+                    continue;
+                }
+
+                glm::vec3 offset = triangleCentroid / 3.0f - centroid;
+                f32 distance = glm::dot(offset, offset);
+                if (newVertices < bestNewVertices || (newVertices == bestNewVertices && distance < bestDistance)) {
+                    best = candidate;
+                    bestNewVertices = newVertices;
+                    bestDistance = distance;
+                }
+            }
+            candidates.resize(write);
+
+            if (best == ~0u) {
+                break;
+            }
+            triangle = best;
+        }
+
+        add_meshlet(vertices, reordered, firstIndex, reordered.size() - firstIndex, meshlets);
+        ++meshletId;
+    }
+
+    // meshlet ranges are relative to the level, make them absolute
+    for (u32 m = lod->firstMeshlet; m < meshlets->size(); ++m) {
+        meshlets->firstIndex[m] += lod->firstIndex;
+    }
+    lod->numMeshlets = meshlets->size() - lod->firstMeshlet;
+    std::copy(reordered.begin(), reordered.end(), indices->begin() + lod->firstIndex);
+}
+
+bool is_visible(const Meshlets &meshlets, u32 m, const MeshletCullParams &params, bool cone_culling) {
+    glm::vec3 center = glm::vec3(meshlets.centerX[m], meshlets.centerY[m], meshlets.centerZ[m]);
+    f32 radius = meshlets.radius[m];
+
+    for (const glm::vec4 &plane : params.frustumPlanes) {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+            return false;
+        }
+    }
+
+    if (cone_culling) {
+        glm::vec3 view = center - params.cameraPosition;
+        glm::vec3 axis = glm::vec3(meshlets.coneX[m], meshlets.coneY[m], meshlets.coneZ[m]);
+        if (glm::dot(view, axis) >= meshlets.coneCutoff[m] * glm::length(view) + radius) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+}
+
+Meshlets build(const std::vector<Vertex> &vertices, std::vector<u32> *indices, std::vector<MeshLod> *lods) {
+    Meshlets meshlets;
+    for (MeshLod &lod : *lods) {
+        build_lod(vertices, indices, &lod, &meshlets);
+    }
+
+    Log::debug("Built %d meshlets for %d levels of detail", meshlets.size(), lods->size());
+    return meshlets;
+}
+
+MeshletCullParams get_cull_params(const glm::mat4 &view_projection, const glm::mat4 &model_matrix,
+                                  glm::vec3 camera_position) {
+    MeshletCullParams params = {};
+
+    // planes of the clip space cube, in object space since they are taken from the full transform
+    glm::mat4 transform = view_projection * model_matrix;
+    for (u32 i = 0; i < 3; ++i) {
+        glm::vec4 row = glm::vec4(transform[0][i], transform[1][i], transform[2][i], transform[3][i]);
+        glm::vec4 w = glm::vec4(transform[0][3], transform[1][3], transform[2][3], transform[3][3]);
+        params.frustumPlanes[i * 2] = w + row;
+        params.frustumPlanes[i * 2 + 1] = w - row;
+    }
+    for (glm::vec4 &plane : params.frustumPlanes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+
+    // which side of a triangle faces the camera doesn't change with an affine transform
+    params.cameraPosition = glm::vec3(glm::inverse(model_matrix) * glm::vec4(camera_position, 1));
+
+    return params;
+}
+
+u32 cull(const Meshlets &meshlets, u32 first, u32 count, const MeshletCullParams &params, bool cone_culling,
+         s32 *counts, const void **offsets, u32 *num_culled) {
+    u32 numRanges = 0;
+    u32 rangeEnd = ~0u;
+    *num_culled = 0;
+
+    auto emit = [&](u32 m) {
+        u32 firstIndex = meshlets.firstIndex[m];
+        if (numRanges > 0 && firstIndex == rangeEnd) {
+            counts[numRanges - 1] += meshlets.numIndices[m];
+        } else {
+            counts[numRanges] = meshlets.numIndices[m];
+            offsets[numRanges] = (const void *) ((uintptr_t) firstIndex * sizeof(u32));
+            ++numRanges;
+        }
+        rangeEnd = firstIndex + meshlets.numIndices[m];
+    };
+
+    u32 end = first + count;
+    u32 m = first;
+
+#ifdef ACORN_MESHLET_SSE
+    // 4 meshlets at a time
+    const __m128 camX = _mm_set1_ps(params.cameraPosition.x);
+    const __m128 camY = _mm_set1_ps(params.cameraPosition.y);
+    const __m128 camZ = _mm_set1_ps(params.cameraPosition.z);
+
+    for (; m + 4 <= end; m += 4) {
+        __m128 cx = _mm_loadu_ps(&meshlets.centerX[m]);
+        __m128 cy = _mm_loadu_ps(&meshlets.centerY[m]);
+        __m128 cz = _mm_loadu_ps(&meshlets.centerZ[m]);
+        __m128 r = _mm_loadu_ps(&meshlets.radius[m]);
+        __m128 negativeR = _mm_sub_ps(_mm_setzero_ps(), r);
+
+        __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const glm::vec4 &plane : params.frustumPlanes) {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.x)),
+                                                    _mm_mul_ps(cy, _mm_set1_ps(plane.y))),
+                                         _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+            visible = _mm_and_ps(visible, _mm_cmpge_ps(distance, negativeR));
+        }
+
+        if (cone_culling) {
+            __m128 vx = _mm_sub_ps(cx, camX);
+            __m128 vy = _mm_sub_ps(cy, camY);
+            __m128 vz = _mm_sub_ps(cz, camZ);
+            __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)),
+                                                   _mm_mul_ps(vz, vz)));
+            __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, _mm_loadu_ps(&meshlets.coneX[m])),
+                                               _mm_mul_ps(vy, _mm_loadu_ps(&meshlets.coneY[m]))),
+                                    _mm_mul_ps(vz, _mm_loadu_ps(&meshlets.coneZ[m])));
+            __m128 limit = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&meshlets.coneCutoff[m]), length), r);
+            visible = _mm_andnot_ps(_mm_cmpge_ps(dot, limit), visible);
+        }
+
+        u32 mask = _mm_movemask_ps(visible);
+        for (u32 lane = 0; lane < 4; ++lane) {
+            if (mask & (1u << lane)) {
+                emit(m + lane);
+            } else {
+                ++*num_culled;
+            }
+        }
+    }
+#endif
+
+    for (; m < end; ++m) {
+        if (is_visible(meshlets, m, params, cone_culling)) {
+            emit(m);
+        } else {
+            ++*num_culled;
+        }
+    }
+
+    return numRanges;
+}
+
+}
@@ -0,0 +1,38 @@
+#ifndef ACORN_MESHLET_H
+#define ACORN_MESHLET_H
+
+#include "types.h"
+#include "vertex.h"
+#include "mesh.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+/// What meshlets of one entity are tested against, in the object space of the entity
+struct MeshletCullParams {
+    glm::vec4 frustumPlanes[6]; // normalized, pointing inwards
+    glm::vec3 cameraPosition;
+};
+
+namespace meshlet {
+/// Split each level of detail into meshlets of neighbouring triangles, reordering the triangles of a level so that
+/// every meshlet is a contiguous range
+/// \param indices Triangle lists of all levels of detail
+/// \param lods Receive the meshlet ranges of their level
+/// \return Meshlets of all levels with their bounds
+Meshlets build(const std::vector<Vertex> &vertices, std::vector<u32> *indices, std::vector<MeshLod> *lods);
+
+/// Get cull parameters from the view projection and model matrix of an entity
+MeshletCullParams get_cull_params(const glm::mat4 &view_projection, const glm::mat4 &model_matrix,
+                                  glm::vec3 camera_position);
+
+/// Test meshlets against the frustum and, unless disabled, their normal cone against the camera. Neighbouring
+/// visible meshlets are merged into one range
+/// \param counts Receives the number of indices of each visible range, needs room for count ranges
+/// \param offsets Receives the byte offset into the index buffer of each visible range
+/// \param num_culled Receives how many meshlets were culled
+/// \return Number of visible ranges
+u32 cull(const Meshlets &meshlets, u32 first, u32 count, const MeshletCullParams &params, bool cone_culling,
+         s32 *counts, const void **offsets, u32 *num_culled);
+}
+
+#endif //ACORN_MESHLET_H
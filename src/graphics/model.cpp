@@ -1,35 +1,342 @@
 #include "model.h"
+#include "mesh_lod.h"
+#include "meshlet.h"
+#include "gltf.h"
+#include "obj.h"
 #include "texture.h"
 #include "log.h"
 #include "utils.h"
+#include "transform.h"
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include <assimp/pbrmaterial.h>
 
+#include <algorithm>
+#include <unordered_map>
+
 #undef min
 #undef max
 
-Model::Model(const std::string &path) {
+Model::Model(const std::string &path, const ModelImportOptions &options) {
     Log::debug("Model::Model(%s)", path.c_str());
-    init(path);
+    init(path, options);
+}
+
+/// A root node that places every mesh once, for models without a hierarchy
+static NodeData make_root_node(u32 num_meshes) {
+    NodeData root = {-1, glm::mat4(1), std::vector<u32>(num_meshes), ""};
+    for (u32 i = 0; i < num_meshes; ++i) {
+        root.meshes[i] = i;
+    }
+    return root;
 }
 
 Model::Model(std::vector<Mesh> &&meshes)
     : m_meshes(std::move(meshes)) {
-    Log::debug("Model::Model(%d meshes)", meshes.size());
+    Log::debug("Model::Model(%d meshes)", m_meshes.size());
+    setNodes({make_root_node(m_meshes.size())});
 }
 
 Model::~Model() {
     Log::debug("Model::~Model()");
 }
 
-void Model::init(const std::string &path) {
+void Model::calculateBounds() {
+    m_min = glm::vec3(INFINITY);
+    m_max = glm::vec3(-INFINITY);
+    for (u32 n = 0; n < getNumNodes(); ++n) {
+        for (u32 i = 0; i < m_nodeNumMeshes[n]; ++i) {
+            const Mesh &mesh = getNodeMesh(n, i);
+            glm::vec3 meshMin, meshMax;
+            transform_bounds(m_nodeTransforms[n], mesh.getMin(), mesh.getMax(), &meshMin, &meshMax);
+            m_min = glm::min(m_min, meshMin);
+            m_max = glm::max(m_max, meshMax);
+        }
+    }
+}
+
+void Model::setNodes(const std::vector<NodeData> &nodes) {
+    u32 numNodes = nodes.size();
+    m_nodeParents.resize(numNodes);
+    m_nodeLocalTransforms.resize(numNodes);
+    m_nodeTransforms.resize(numNodes);
+    m_nodeDirty.assign(numNodes, 1);
+    m_nodeFirstMesh.resize(numNodes);
+    m_nodeNumMeshes.resize(numNodes);
+    m_nodeMeshes.clear();
+
+    for (u32 n = 0; n < numNodes; ++n) {
+        const NodeData &node = nodes[n];
+        m_nodeParents[n] = node.parent >= 0 && (u32)node.parent < n ? node.parent : -1;
+        m_nodeLocalTransforms[n] = node.localTransform;
+        m_nodeFirstMesh[n] = m_nodeMeshes.size();
+        for (u32 mesh : node.meshes) {
+            if (mesh < m_meshes.size()) {
+                m_nodeMeshes.push_back(mesh);
+            }
+        }
+        m_nodeNumMeshes[n] = m_nodeMeshes.size() - m_nodeFirstMesh[n];
+    }
+
+    m_anyNodeDirty = true;
+    updateNodeTransforms();
+}
+
+void Model::setNodeLocalTransform(u32 node, const glm::mat4 &transform) {
+    m_nodeLocalTransforms[node] = transform;
+    m_nodeDirty[node] = 1;
+    m_anyNodeDirty = true;
+}
+
+void Model::updateNodeTransforms() {
+    if (!m_anyNodeDirty) {
+        return;
+    }
+
+    // parents are updated before their children, so a changed parent has passed its flag down by then
+    for (u32 n = 0; n < m_nodeParents.size(); ++n) {
+        s32 parent = m_nodeParents[n];
+        if (parent < 0) {
+            if (m_nodeDirty[n]) {
+                m_nodeTransforms[n] = m_nodeLocalTransforms[n];
+            }
+            continue;
+        }
+
+        m_nodeDirty[n] |= m_nodeDirty[parent];
+        if (m_nodeDirty[n]) {
+            m_nodeTransforms[n] = m_nodeTransforms[parent] * m_nodeLocalTransforms[n];
+        }
+    }
+
+    std::fill(m_nodeDirty.begin(), m_nodeDirty.end(), 0);
+    m_anyNodeDirty = false;
+    calculateBounds();
+    calculateLodErrors();
+}
+
+u32 Model::getNumLods() const {
+    u32 numLods = 1;
+    for (const Mesh &mesh : m_meshes) {
+        numLods = std::max(numLods, mesh.getNumLods());
+    }
+    return numLods;
+}
+
+f32 Model::getLodError(u32 lod) const {
+    if (m_lodErrors.empty()) {
+        return 0.0f;
+    }
+    return m_lodErrors[std::min<u32>(lod, m_lodErrors.size() - 1)];
+}
+
+void Model::calculateLodErrors() {
+    m_lodErrors.assign(getNumLods(), 0.0f);
+    for (u32 n = 0; n < getNumNodes(); ++n) {
+        // errors are in the space of the mesh, the node transform scales them into the space of the model
+        glm::mat3 basis = glm::mat3(m_nodeTransforms[n]);
+        f32 scale = glm::max(glm::length(basis[0]), glm::max(glm::length(basis[1]), glm::length(basis[2])));
+        for (u32 i = 0; i < m_nodeNumMeshes[n]; ++i) {
+            const Mesh &mesh = getNodeMesh(n, i);
+            for (u32 lod = 0; lod < m_lodErrors.size(); ++lod) {
+                f32 error = mesh.getLod(std::min(lod, mesh.getNumLods() - 1)).error * scale;
+                m_lodErrors[lod] = std::max(m_lodErrors[lod], error);
+            }
+        }
+    }
+}
+
+void Model::init(const std::string &path, const ModelImportOptions &options) {
+    std::vector<MeshData> meshes;
+    std::vector<NodeData> nodes;
+
+    // glTF and OBJ are read natively, everything else and files the loaders don't handle go through Assimp
+    if (obj::is_obj_path(path)) {
+        if (obj::load(path, &meshes)) {
+            nodes.push_back(make_root_node(meshes.size()));
+            addMeshes(&meshes, &nodes, options);
+            return;
+        }
+        Log::warn("Falling back to Assimp for '%s'", path.c_str());
+    } else if (gltf::is_gltf_path(path)) {
+        if (gltf::load(path, &meshes, &nodes)) {
+            addMeshes(&meshes, &nodes, options);
+            return;
+        }
+        Log::warn("Falling back to Assimp for '%s'", path.c_str());
+    }
+
+    loadAssimp(path, &meshes, &nodes);
+    addMeshes(&meshes, &nodes, options);
+}
+
+/// Transform the vertices of a mesh, mirroring transforms turn its winding and bi-tangents around
+static void transform_mesh(const glm::mat4 &transform, MeshData *mesh) {
+    if (transform == glm::mat4(1)) {
+        return;
+    }
+
+    glm::mat3 basis = glm::mat3(transform);
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(basis));
+    bool mirrored = glm::determinant(basis) < 0.0f;
+    for (Vertex &vertex : mesh->vertices) {
+        vertex.position = glm::vec3(transform * glm::vec4(vertex.position, 1.0f));
+        vertex.normal = glm::normalize(normalMatrix * vertex.normal);
+        glm::vec3 tangent = glm::normalize(basis * glm::vec3(vertex.tangent));
+        vertex.tangent = glm::vec4(tangent, mirrored ? -vertex.tangent.w : vertex.tangent.w);
+    }
+
+    if (mirrored) {
+        for (u32 i = 0; i + 2 < mesh->indices.size(); i += 3) {
+            std::swap(mesh->indices[i + 1], mesh->indices[i + 2]);
+        }
+    }
+}
+
+/// Move the meshes of nodes that can't be posed to a new root node, transforming them into the space of the model so
+/// they can be merged with the meshes of other nodes. Instanced meshes and posable nodes with their descendants keep
+/// their meshes
+static void bake_node_transforms(std::vector<MeshData> *meshes, std::vector<NodeData> *nodes,
+                                 const std::vector<u32> &num_references,
+                                 const std::vector<std::string> &posable_nodes) {
+    u32 numNodes = nodes->size();
+    std::vector<glm::mat4> transforms(numNodes);
+    std::vector<bool> posable(numNodes, false);
+    std::vector<u32> meshNodes(meshes->size(), 0);    // node whose transform a baked mesh gets
+    NodeData root = {-1, glm::mat4(1), {}, ""};
+
+    for (u32 n = 0; n < numNodes; ++n) {
+        NodeData &node = (*nodes)[n];
+        s32 parent = node.parent >= 0 && (u32)node.parent < n ? node.parent : -1;
+        transforms[n] = parent >= 0 ? transforms[parent] * node.localTransform : node.localTransform;
+        posable[n] = (parent >= 0 && posable[parent]) ||
+                     std::find(posable_nodes.begin(), posable_nodes.end(), node.name) != posable_nodes.end();
+        if (posable[n]) {
+            continue;
+        }
+
+        std::vector<u32> kept;
+        for (u32 m : node.meshes) {
+            if (m < meshes->size() && num_references[m] == 1) {
+                root.meshes.push_back(m);
+                meshNodes[m] = n;
+            } else {
+                kept.push_back(m);
+            }
+        }
+        node.meshes = std::move(kept);
+    }
+
+    if (root.meshes.empty()) {
+        return;
+    }
+
+    core->jobSystem.parallelFor(root.meshes.size(), 1, [&](u32 begin, u32 end) {
+        for (u32 i = begin; i < end; ++i) {
+            u32 m = root.meshes[i];
+            transform_mesh(transforms[meshNodes[m]], &(*meshes)[m]);
+        }
+    });
+
+    // parents still come before their children with the root at the end
+    nodes->push_back(std::move(root));
+}
+
+/// Merge meshes of a node that share a material into the first one of them, appending their vertices and triangles.
+/// Meshes of nodes that can't be posed are baked into one node first, so they are merged across nodes. Meshes placed
+/// by several nodes are instances and kept as they are, meshes no node places are dropped
+static void merge_meshes(std::vector<MeshData> *meshes, std::vector<NodeData> *nodes,
+                         const ModelImportOptions &options) {
+    std::vector<u32> numReferences(meshes->size(), 0);
+    for (const NodeData &node : *nodes) {
+        for (u32 mesh : node.meshes) {
+            if (mesh < meshes->size()) {
+                ++numReferences[mesh];
+            }
+        }
+    }
+
+    bake_node_transforms(meshes, nodes, numReferences, options.posableNodes);
+
+    const u32 UNMAPPED = ~0u;
+    std::vector<MeshData> merged;
+    std::vector<u32> instanceIndices(meshes->size(), UNMAPPED);
+    std::unordered_map<u32, u32> mergedByMaterial;
+    for (NodeData &node : *nodes) {
+        std::vector<u32> nodeMeshes;
+        mergedByMaterial.clear();
+        for (u32 m : node.meshes) {
+            if (m >= meshes->size()) {
+                continue;
+            }
+            MeshData &mesh = (*meshes)[m];
+
+            if (numReferences[m] > 1) {
+                if (instanceIndices[m] == UNMAPPED) {
+                    instanceIndices[m] = merged.size();
+                    merged.push_back(std::move(mesh));
+                }
+                nodeMeshes.push_back(instanceIndices[m]);
+                continue;
+            }
+
+            u32 materialId = core->resourceManager.getMaterialId(mesh.material);
+            auto inserted = mergedByMaterial.emplace(materialId, (u32)merged.size());
+            if (inserted.second) {
+                nodeMeshes.push_back(merged.size());
+                merged.push_back(std::move(mesh));
+                continue;
+            }
+
+            MeshData &target = merged[inserted.first->second];
+            u32 firstVertex = target.vertices.size();
+            target.vertices.insert(target.vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+            target.indices.reserve(target.indices.size() + mesh.indices.size());
+            for (u32 index : mesh.indices) {
+                target.indices.push_back(firstVertex + index);
+            }
+        }
+        node.meshes = std::move(nodeMeshes);
+    }
+
+    if (merged.size() < meshes->size()) {
+        Log::debug("Merged %d meshes into %d by material", (u32)meshes->size(), (u32)merged.size());
+    }
+    *meshes = std::move(merged);
+}
+
+void Model::addMeshes(std::vector<MeshData> *meshes, std::vector<NodeData> *nodes,
+                      const ModelImportOptions &options) {
+    if (options.mergeMeshes) {
+        merge_meshes(meshes, nodes, options);
+    }
+
+    std::vector<std::vector<MeshLod>> lods(meshes->size());
+    std::vector<Meshlets> meshlets(meshes->size());
+    core->jobSystem.parallelFor(meshes->size(), 1, [&](u32 begin, u32 end) {
+        for (u32 i = begin; i < end; ++i) {
+            MeshData &mesh = (*meshes)[i];
+            mesh_lod::generate_lods(mesh.vertices, &mesh.indices, &lods[i]);
+            meshlets[i] = meshlet::build(mesh.vertices, &mesh.indices, &lods[i]);
+        }
+    });
+
+    m_meshes.reserve(m_meshes.size() + meshes->size());
+    for (u32 i = 0; i < meshes->size(); ++i) {
+        const MeshData &mesh = (*meshes)[i];
+        m_meshes.emplace_back(mesh.vertices, mesh.indices, lods[i], std::move(meshlets[i]), mesh.material);
+    }
+
+    setNodes(*nodes);
+}
+
+void Model::loadAssimp(const std::string &path, std::vector<MeshData> *meshes, std::vector<NodeData> *nodes) {
     Assimp::Importer importer;
     const aiScene *scene = importer.ReadFile(path.c_str(),
-                                             aiProcess_CalcTangentSpace |
                                              aiProcess_Triangulate |
+                                             aiProcess_JoinIdenticalVertices |
                                              aiProcess_GenNormals |
                                              aiProcess_GenUVCoords);
 
@@ -39,19 +346,68 @@ void Model::init(const std::string &path) {
 
     std::string dir = path.substr(0, path.find_last_of('/') + 1);
 
-    // Process scene
-    for (u32 m = 0; m < scene->mNumMeshes; ++m) {
-        aiMesh *mesh = scene->mMeshes[m];
+    // Default material
+    Material defaultMaterial;
+    defaultMaterial.albedoTexture = core->resourceManager.getBuiltInTexture(BuiltInTextureEnum::WHITE);
+    defaultMaterial.normalTexture = core->resourceManager.getBuiltInTexture(BuiltInTextureEnum::NORMAL);
+    defaultMaterial.metallicTexture = core->resourceManager.getBuiltInTexture(BuiltInTextureEnum::WHITE);
+    defaultMaterial.metallicScale = 1.0f;
+    defaultMaterial.roughnessTexture = core->resourceManager.getBuiltInTexture(BuiltInTextureEnum::WHITE);
+    defaultMaterial.roughnessScale = 1.0f;
+
+    // Load materials up front, textures are created on this thread since it owns the context
+    std::vector<Material> materials(scene->mNumMaterials, defaultMaterial);
+    for (u32 m = 0; m < scene->mNumMaterials; ++m) {
+        aiMaterial *aiMat = scene->mMaterials[m];
+        Material &material = materials[m];
+
+        auto loadTexture = [&](aiTextureType type, Texture **location) {
+            if (aiMat->GetTextureCount(type) > 0) {
+                aiString texRelativePath;
+                aiMat->GetTexture(type, 0, &texRelativePath);
+                std::string texPath = dir + std::string(texRelativePath.C_Str());
+                std::replace(texPath.begin(), texPath.end(), '\\', '/');
+                *location = core->resourceManager.getTexture(texPath);
+            }
+        };
+
+        loadTexture(aiTextureType_DIFFUSE, &material.albedoTexture);
+        loadTexture(aiTextureType_NORMALS, &material.normalTexture);
+        loadTexture(aiTextureType_METALNESS, &material.metallicTexture);
+        loadTexture(aiTextureType_DIFFUSE_ROUGHNESS, &material.roughnessTexture);
 
-        // TODO: index buffer
+        // Special case where metallic and roughness are in same texture
+        aiString metalRoughPath;
+        if (aiMat->GetTexture(AI_MATKEY_GLTF_PBRMETALLICROUGHNESS_METALLICROUGHNESS_TEXTURE,
+                              &metalRoughPath) == aiReturn_SUCCESS) {
+            std::string texPath = dir + std::string(metalRoughPath.C_Str());
+            std::replace(texPath.begin(), texPath.end(), '\\', '/');
+
+            // Seems that usually this is occlusion, roughness, metallic (RGB respectively)?
+            // Sampled as one texture instead of splitting it, see MATERIAL_HAS_PACKED_ORM
+            material.metallicRoughnessTexture = core->resourceManager.getTexture(texPath);
+        }
 
-        std::vector<Vertex> vertices;
-        vertices.reserve(mesh->mNumFaces * 3);
-        for (u32 f = 0; f < mesh->mNumFaces; ++f) {
-            aiFace face = mesh->mFaces[f];
-            for (u32 i = 0; i < face.mNumIndices; ++i) {
-                u32 v = face.mIndices[i];
-                Vertex vertex = {};
+        aiMat->Get(AI_MATKEY_GLTF_PBRMETALLICROUGHNESS_METALLIC_FACTOR, material.metallicScale);
+        aiMat->Get(AI_MATKEY_GLTF_PBRMETALLICROUGHNESS_ROUGHNESS_FACTOR, material.roughnessScale);
+
+        s32 twoSided = 0;
+        if (aiMat->Get(AI_MATKEY_TWOSIDED, twoSided) == aiReturn_SUCCESS) {
+            material.doubleSided = twoSided != 0;
+        }
+    }
+
+    // Convert meshes in parallel, the scene is only read from
+    meshes->resize(scene->mNumMeshes);
+    core->jobSystem.parallelFor(scene->mNumMeshes, 1, [&](u32 begin, u32 end) {
+        for (u32 m = begin; m < end; ++m) {
+            const aiMesh *mesh = scene->mMeshes[m];
+            MeshData &data = (*meshes)[m];
+
+            data.vertices.resize(mesh->mNumVertices);
+            for (u32 v = 0; v < mesh->mNumVertices; ++v) {
+                Vertex &vertex = data.vertices[v];
+                vertex = {};
 
                 vertex.position = {
                     mesh->mVertices[v].x,
@@ -59,77 +415,71 @@ void Model::init(const std::string &path) {
                     mesh->mVertices[v].z
                 };
 
-                vertex.normal = {
-                    mesh->mNormals[v].x,
-                    mesh->mNormals[v].y,
-                    mesh->mNormals[v].z
-                };
+                if (mesh->HasNormals()) {
+                    vertex.normal = {
+                        mesh->mNormals[v].x,
+                        mesh->mNormals[v].y,
+                        mesh->mNormals[v].z
+                    };
+                }
 
-                vertex.uv = {
-                    mesh->mTextureCoords[0][v].x,
-                    mesh->mTextureCoords[0][v].y
-                };
+                if (mesh->HasTextureCoords(0)) {
+                    vertex.uv = {
+                        mesh->mTextureCoords[0][v].x,
+                        mesh->mTextureCoords[0][v].y
+                    };
+                }
+            }
 
-                vertex.tangent = {
-                    mesh->mTangents[v].x,
-                    mesh->mTangents[v].y,
-                    mesh->mTangents[v].z
-                };
+            data.indices.resize(mesh->mNumFaces * 3);
+            u32 numIndices = 0;
+            for (u32 f = 0; f < mesh->mNumFaces; ++f) {
+                const aiFace &face = mesh->mFaces[f];
+                if (face.mNumIndices != 3) {
+                    // Points and lines left over after triangulation
+                    continue;
+                }
+                std::copy(face.mIndices, face.mIndices + 3, &data.indices[numIndices]);
+                numIndices += 3;
+            }
+            data.indices.resize(numIndices);
 
-                vertex.biTangent = {
-                    mesh->mBitangents[v].x,
-                    mesh->mBitangents[v].y,
-                    mesh->mBitangents[v].z
-                };
+            // Tangents are generated the same way for every loader instead of by Assimp
+            utils::generate_tangents(&data.vertices, &data.indices);
 
-                vertices.emplace_back(vertex);
-            }
+            data.material = mesh->mMaterialIndex < materials.size() ? materials[mesh->mMaterialIndex]
+                                                                    : defaultMaterial;
         }
+    });
 
-        // Default material
-        Material material;
-        material.albedoTexture = core->resourceManager.getBuiltInTexture(BuiltInTextureEnum::WHITE);
-        material.normalTexture = core->resourceManager.getBuiltInTexture(BuiltInTextureEnum::NORMAL);
-        material.metallicTexture = core->resourceManager.getBuiltInTexture(BuiltInTextureEnum::WHITE);
-        material.metallicScale = 1.0f;
-        material.roughnessTexture = core->resourceManager.getBuiltInTexture(BuiltInTextureEnum::WHITE);
-        material.roughnessScale = 1.0f;
-
-        // Load material
-        if (mesh->mMaterialIndex >= 0) {
-            aiMaterial *aiMat = scene->mMaterials[mesh->mMaterialIndex];
-
-            auto loadTexture = [&](aiTextureType type, Texture **location) {
-                if (aiMat->GetTextureCount(type) > 0) {
-                    aiString texRelativePath;
-                    aiMat->GetTexture(type, 0, &texRelativePath);
-                    std::string texPath = dir + std::string(texRelativePath.C_Str());
-                    std::replace(texPath.begin(), texPath.end(), '\\', '/');
-                    *location = core->resourceManager.getTexture(texPath);
-                }
-            };
-
-            loadTexture(aiTextureType_DIFFUSE, &material.albedoTexture);
-            loadTexture(aiTextureType_NORMALS, &material.normalTexture);
-            loadTexture(aiTextureType_METALNESS, &material.metallicTexture);
-            loadTexture(aiTextureType_DIFFUSE_ROUGHNESS, &material.roughnessTexture);
-
-            // Special case where metallic and roughness are in same texture
-            aiString metalRoughPath;
-            if (aiMat->GetTexture(AI_MATKEY_GLTF_PBRMETALLICROUGHNESS_METALLICROUGHNESS_TEXTURE,
-                                  &metalRoughPath) == aiReturn_SUCCESS) {
-                std::string texPath = dir + std::string(metalRoughPath.C_Str());
-                std::replace(texPath.begin(), texPath.end(), '\\', '/');
+    if (!scene->mRootNode) {
+        nodes->push_back(make_root_node(scene->mNumMeshes));
+        return;
+    }
 
-                // Seems that usually this is occlusion, roughness, metallic (RGB respectively)?
-                core->resourceManager.getTextureSplitComponents(texPath, nullptr, &material.roughnessTexture,
-                                                                &material.metallicTexture, nullptr);
-            }
+    // Flatten the hierarchy depth first so parents come before their children, nodes refer to meshes by index so
+    // meshes used by several nodes are only converted once
+    std::vector<std::pair<const aiNode *, s32>> stack = {{scene->mRootNode, -1}};
+    while (!stack.empty()) {
+        const aiNode *node = stack.back().first;
+        s32 parent = stack.back().second;
+        stack.pop_back();
 
-            aiMat->Get(AI_MATKEY_GLTF_PBRMETALLICROUGHNESS_METALLIC_FACTOR, material.metallicScale);
-            aiMat->Get(AI_MATKEY_GLTF_PBRMETALLICROUGHNESS_ROUGHNESS_FACTOR, material.roughnessScale);
+        // Assimp matrices are row major
+        const aiMatrix4x4 &m = node->mTransformation;
+        glm::mat4 localTransform = glm::mat4(glm::vec4(m.a1, m.b1, m.c1, m.d1), glm::vec4(m.a2, m.b2, m.c2, m.d2),
+                                             glm::vec4(m.a3, m.b3, m.c3, m.d3), glm::vec4(m.a4, m.b4, m.c4, m.d4));
+
+        s32 index = nodes->size();
+        nodes->push_back(NodeData{parent, localTransform, {}, node->mName.C_Str()});
+        for (u32 i = 0; i < node->mNumMeshes; ++i) {
+            if (node->mMeshes[i] < scene->mNumMeshes) {
+                nodes->back().meshes.push_back(node->mMeshes[i]);
+            }
         }
 
-        m_meshes.emplace_back(vertices, material);
+        for (u32 c = node->mNumChildren; c > 0; --c) {
+            stack.emplace_back(node->mChildren[c - 1], index);
+        }
     }
 }
@@ -5,9 +5,22 @@
 #include <string>
 #include <vector>
 
+/// How a model is imported
+struct ModelImportOptions {
+    /// Merge meshes with the same material into one, so models made of many parts take fewer draws. Node transforms
+    /// are baked into the meshes, except for posable nodes, whose meshes are only merged within the node, and for
+    /// instanced meshes, which stay shared
+    bool mergeMeshes = true;
+
+    /// Names of nodes that keep their own transform when meshes are merged, so they and their descendants can be
+    /// posed after import
+    std::vector<std::string> posableNodes;
+};
+
 class Model {
 public:
-    explicit Model(const std::string &path);
+    explicit Model(const std::string &path, const ModelImportOptions &options = ModelImportOptions());
+    /// Create a model with one node that places all meshes
     explicit Model(std::vector<Mesh> &&meshes);
     ~Model();
 
@@ -15,10 +28,93 @@ public:
         return m_meshes;
     }
 
+    /// Get the number of nodes, parents come before their children
+    u32 getNumNodes() const {
+        return m_nodeParents.size();
+    }
+
+    /// Get the parent of a node, -1 for roots
+    s32 getNodeParent(u32 node) const {
+        return m_nodeParents[node];
+    }
+
+    /// Get the transform of a node relative to the model, as of the last call to updateNodeTransforms()
+    const glm::mat4 &getNodeTransform(u32 node) const {
+        return m_nodeTransforms[node];
+    }
+
+    /// Get the number of meshes a node places, meshes can be placed by several nodes
+    u32 getNodeNumMeshes(u32 node) const {
+        return m_nodeNumMeshes[node];
+    }
+
+    const Mesh &getNodeMesh(u32 node, u32 index) const {
+        return m_meshes[m_nodeMeshes[m_nodeFirstMesh[node] + index]];
+    }
+
+    /// Update the transforms of nodes that changed and their descendants and the bounds of the model. Nodes are
+    /// visited in one pass in order, which reaches parents before their children. Does nothing if none changed
+    void updateNodeTransforms();
+
+    /// Get the minimum corner of the bounding box of all meshes
+    glm::vec3 getMin() const {
+        return m_min;
+    }
+
+    /// Get the maximum corner of the bounding box of all meshes
+    glm::vec3 getMax() const {
+        return m_max;
+    }
+
+    /// Get the number of levels of detail of the mesh with the most of them
+    u32 getNumLods() const;
+
+    /// Get the largest error of all placed meshes at a level of detail in the space of the model, as of the last call
+    /// to updateNodeTransforms(). Meshes with fewer levels use their coarsest one
+    f32 getLodError(u32 lod) const;
+
 private:
-    void init(const std::string &path);
+    // nodes are moved through the scene, which invalidates the cached shadows of static entities using the model
+    friend class Scene;
+
+    /// Set the transform of a node relative to its parent, it and its descendants are updated by the next call to
+    /// updateNodeTransforms(). Models are shared by every entity that loads the same file, so the node moves on all
+    /// of them
+    void setNodeLocalTransform(u32 node, const glm::mat4 &transform);
+
+    void init(const std::string &path, const ModelImportOptions &options);
+
+    /// Import a model and its node hierarchy with Assimp, its meshes are converted in parallel
+    void loadAssimp(const std::string &path, std::vector<MeshData> *meshes, std::vector<NodeData> *nodes);
+
+    /// Generate the levels of detail and meshlets of meshes on the job system, then upload and add them on this
+    /// thread since it owns the context
+    void addMeshes(std::vector<MeshData> *meshes, std::vector<NodeData> *nodes, const ModelImportOptions &options);
+
+    /// Flatten the hierarchy into arrays and calculate the transforms of all nodes
+    void setNodes(const std::vector<NodeData> &nodes);
+
+    void calculateBounds();
+
+    /// Scale the errors of the levels of detail of placed meshes by their node transforms, see getLodError()
+    void calculateLodErrors();
 
     std::vector<Mesh> m_meshes;
+
+    // hierarchy, one element per node
+    std::vector<s32> m_nodeParents;
+    std::vector<glm::mat4> m_nodeLocalTransforms;
+    std::vector<glm::mat4> m_nodeTransforms;
+    std::vector<u8> m_nodeDirty;
+    std::vector<u32> m_nodeFirstMesh;   // range of m_nodeMeshes
+    std::vector<u32> m_nodeNumMeshes;
+    std::vector<u32> m_nodeMeshes;      // indices of m_meshes
+    bool m_anyNodeDirty = false;
+
+    std::vector<f32> m_lodErrors;   // largest error of each level of detail, in the space of the model
+
+    glm::vec3 m_min = glm::vec3(INFINITY);
+    glm::vec3 m_max = glm::vec3(-INFINITY);
 };
 
 #endif //ACORN_MODEL_H
@@ -0,0 +1,702 @@
+#include "obj.h"
+#include "core.h"
+#include "mapped_file.h"
+#include "log.h"
+#include "utils.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace obj {
+
+namespace {
+
+// files are split into about this many chunks per thread so uneven chunks still balance, unless they'd be tiny
+constexpr u32 CHUNKS_PER_THREAD = 4;
+constexpr u64 MIN_CHUNK_SIZE = 256 * 1024;
+
+// corners are sorted into this many hash buckets per thread, each bucket merges its vertices on its own
+constexpr u32 BUCKETS_PER_THREAD = 4;
+
+// component of a corner that the face doesn't have
+constexpr s32 MISSING = -1;
+
+// powers of ten that doubles represent exactly, so a mantissa scaled by them is rounded only once
+constexpr f64 POWERS_OF_TEN[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+constexpr s32 MAX_EXACT_POWER_OF_TEN = 22;
+
+/// Vertex data and triangles parsed from a range of whole lines
+struct Chunk {
+    const char *begin;
+    const char *end;
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::vec3> normals;
+
+    // position, uv and normal index of each triangle corner, MISSING if the face doesn't have one
+    std::vector<s32> corners;
+    // entries of corners that are relative to the first element of the chunk, because the face used negative indices
+    std::vector<u32> relativeCorners;
+
+    // material of each triangle, 0 continues the material of the previous chunk and i uses materialNames[i - 1].
+    // Replaced by indices into the material table of the file once all chunks are parsed
+    std::vector<u32> triangleMaterials;
+    std::vector<std::string> materialNames;
+    std::vector<std::string> materialLibraries;
+
+    // failure, with the line it happened on
+    const char *error = nullptr;
+    const char *errorLine = nullptr;
+
+    // position of the vertex data of the chunk in the whole file
+    u32 firstPosition = 0;
+    u32 firstUv = 0;
+    u32 firstNormal = 0;
+
+    std::vector<u32> materialIds;               // local material slot to material table index
+    std::vector<u32> materialTriangleCounts;    // triangles per material table index
+    std::vector<u32> materialFirstIndices;      // where the triangles of the chunk start in the index buffers
+    std::vector<std::vector<u32>> bucketCorners;    // corners of each hash bucket
+    std::vector<u32> cornerVertices;    // vertex of each corner, among the ones of its bucket and material
+};
+
+/// What makes two corners the same vertex
+struct VertexKey {
+    u32 material;
+    s32 position;
+    s32 uv;
+    s32 normal;
+
+    bool operator==(const VertexKey &other) const {
+        return material == other.material && position == other.position && uv == other.uv &&
+               normal == other.normal;
+    }
+};
+
+u64 hash_key(const VertexKey &key) {
+    u64 hash = (u64)(u32)key.position * 0x9e3779b97f4a7c15ull;
+    hash ^= (u64)(u32)key.uv * 0xc2b2ae3d27d4eb4full;
+    hash ^= (u64)(u32)key.normal * 0x165667b19e3779f9ull;
+    hash ^= (u64)key.material * 0x27d4eb2f165667c5ull;
+    return hash ^ (hash >> 29);
+}
+
+struct VertexKeyHash {
+    size_t operator()(const VertexKey &key) const {
+        return (size_t)hash_key(key);
+    }
+};
+
+/// Bucket of a corner, from the high bits of its hash so the maps of the buckets still get varied low bits
+u32 get_bucket(const VertexKey &key, u32 num_buckets) {
+    return (u32)((hash_key(key) >> 32) % num_buckets);
+}
+
+VertexKey get_key(const Chunk &chunk, u32 corner) {
+    return {
+        chunk.triangleMaterials[corner / 3],
+        chunk.corners[corner * 3],
+        chunk.corners[corner * 3 + 1],
+        chunk.corners[corner * 3 + 2]
+    };
+}
+
+bool is_space(char c) {
+    // the carriage return of windows line endings is trimmed like any trailing whitespace
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+const char *skip_spaces(const char *p, const char *end) {
+    while (p < end && is_space(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+/// Get the rest of a line without surrounding whitespace
+std::string get_rest_of_line(const char *p, const char *end) {
+    p = skip_spaces(p, end);
+    while (end > p && is_space(end[-1])) {
+        --end;
+    }
+    return std::string(p, end);
+}
+
+/// Parse a decimal number like "-1.25e-3". Digits update the mantissa and exponent through selects instead of
+/// branches, digits past what the mantissa holds only scale it
+/// \return End of the number, or null if there is none
+const char *parse_float(const char *p, const char *end, f32 *value) {
+    bool negative = p < end && *p == '-';
+    p += (p < end && (*p == '-' || *p == '+')) ? 1 : 0;
+
+    u64 mantissa = 0;
+    s32 exponent = 0;
+    u32 numDigits = 0;  // significant digits in the mantissa, 19 always fit into 64 bits
+    bool hasDigits = false;
+
+    while (p < end && (u32)(*p - '0') < 10) {
+        bool fits = numDigits < 19;
+        mantissa = fits ? mantissa * 10 + (u32)(*p - '0') : mantissa;
+        exponent += fits ? 0 : 1;
+        numDigits += (fits && mantissa != 0) ? 1 : 0;
+        hasDigits = true;
+        ++p;
+    }
+
+    if (p < end && *p == '.') {
+        ++p;
+        while (p < end && (u32)(*p - '0') < 10) {
+            bool fits = numDigits < 19;
+            mantissa = fits ? mantissa * 10 + (u32)(*p - '0') : mantissa;
+            exponent -= fits ? 1 : 0;
+            numDigits += (fits && mantissa != 0) ? 1 : 0;
+            hasDigits = true;
+            ++p;
+        }
+    }
+
+    if (!hasDigits) {
+        return nullptr;
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        ++p;
+        bool negativeExponent = p < end && *p == '-';
+        p += (p < end && (*p == '-' || *p == '+')) ? 1 : 0;
+        if (p == end || (u32)(*p - '0') >= 10) {
+            return nullptr;
+        }
+
+        s32 explicitExponent = 0;
+        while (p < end && (u32)(*p - '0') < 10) {
+            explicitExponent = std::min(explicitExponent * 10 + (s32)(*p - '0'), 100000);
+            ++p;
+        }
+        exponent += negativeExponent ? -explicitExponent : explicitExponent;
+    }
+
+    f64 result = (f64)mantissa;
+    if (exponent < 0) {
+        result /= -exponent <= MAX_EXACT_POWER_OF_TEN ? POWERS_OF_TEN[-exponent] : std::pow(10.0, -exponent);
+    } else if (exponent > 0) {
+        result *= exponent <= MAX_EXACT_POWER_OF_TEN ? POWERS_OF_TEN[exponent] : std::pow(10.0, exponent);
+    }
+    *value = (f32)(negative ? -result : result);
+    return p;
+}
+
+/// Parse a face index, which is 1-based or negative to count back from the last element
+/// \return End of the index, or null if there is none
+const char *parse_index(const char *p, const char *end, s32 *index) {
+    bool negative = p < end && *p == '-';
+    p += negative ? 1 : 0;
+    if (p == end || (u32)(*p - '0') >= 10) {
+        return nullptr;
+    }
+
+    s64 value = 0;
+    while (p < end && (u32)(*p - '0') < 10) {
+        value = std::min<s64>(value * 10 + (*p - '0'), INT32_MAX);
+        ++p;
+    }
+    *index = (s32)(negative ? -value : value);
+    return p;
+}
+
+/// Parse up to count floats separated by whitespace
+/// \return Number of floats that were parsed
+u32 parse_floats(const char *p, const char *end, f32 *values, u32 count) {
+    for (u32 i = 0; i < count; ++i) {
+        p = skip_spaces(p, end);
+        p = parse_float(p, end, &values[i]);
+        if (!p) {
+            return i;
+        }
+    }
+    return count;
+}
+
+/// Parse the corners of a face like "1/2/3 4//6 7/8", split it into a fan of triangles and add them to the chunk
+bool parse_face(Chunk *chunk, const char *p, const char *end, u32 material, std::vector<s32> *polygon) {
+    polygon->clear();
+    while (true) {
+        p = skip_spaces(p, end);
+        if (p == end) {
+            break;
+        }
+
+        // index 0 is invalid in the file, so it marks missing components until they are resolved
+        s32 corner[3] = {0, 0, 0};
+        p = parse_index(p, end, &corner[0]);
+        if (p && p < end && *p == '/') {
+            ++p;
+            if (p < end && *p != '/') {
+                p = parse_index(p, end, &corner[1]);
+            }
+            if (p && p < end && *p == '/') {
+                p = parse_index(p + 1, end, &corner[2]);
+            }
+        }
+        if (!p || (p < end && !is_space(*p)) || corner[0] == 0) {
+            chunk->error = "invalid face";
+            return false;
+        }
+        polygon->insert(polygon->end(), corner, corner + 3);
+    }
+
+    u32 numCorners = polygon->size() / 3;
+    if (numCorners < 3) {
+        // points and lines written as faces
+        return true;
+    }
+
+    // negative indices count back from the last element parsed so far, which is only known relative to the chunk
+    const u32 counts[3] = {
+        (u32)chunk->positions.size(), (u32)chunk->uvs.size(), (u32)chunk->normals.size()
+    };
+    auto addCorner = [&](u32 c) {
+        for (u32 k = 0; k < 3; ++k) {
+            s32 index = (*polygon)[c * 3 + k];
+            if (index < 0) {
+                chunk->relativeCorners.push_back(chunk->corners.size());
+                chunk->corners.push_back((s32)counts[k] + index);
+            } else {
+                chunk->corners.push_back(index - 1);
+            }
+        }
+    };
+
+    for (u32 c = 2; c < numCorners; ++c) {
+        addCorner(0);
+        addCorner(c - 1);
+        addCorner(c);
+        chunk->triangleMaterials.push_back(material);
+    }
+    return true;
+}
+
+void parse_chunk(Chunk *chunk) {
+    std::vector<s32> polygon;
+    u32 material = 0;
+
+    const char *line = chunk->begin;
+    while (line < chunk->end) {
+        const char *lineEnd = (const char *)std::memchr(line, '\n', chunk->end - line);
+        lineEnd = lineEnd ? lineEnd : chunk->end;
+
+        const char *p = skip_spaces(line, lineEnd);
+        u64 length = lineEnd - p;
+        bool ok = true;
+
+        // the statements are told apart by their first characters, anything else is ignored
+        if (length >= 2 && p[0] == 'v' && is_space(p[1])) {
+            glm::vec3 position;
+            ok = parse_floats(p + 2, lineEnd, &position.x, 3) == 3;
+            chunk->positions.push_back(position);
+        } else if (length >= 3 && p[0] == 'v' && p[1] == 'n' && is_space(p[2])) {
+            glm::vec3 normal;
+            ok = parse_floats(p + 3, lineEnd, &normal.x, 3) == 3;
+            chunk->normals.push_back(normal);
+        } else if (length >= 3 && p[0] == 'v' && p[1] == 't' && is_space(p[2])) {
+            // the second coordinate is optional for 1D textures
+            glm::vec2 uv(0.0f);
+            ok = parse_floats(p + 3, lineEnd, &uv.x, 2) >= 1;
+            chunk->uvs.push_back(uv);
+        } else if (length >= 2 && p[0] == 'f' && is_space(p[1])) {
+            ok = parse_face(chunk, p + 2, lineEnd, material, &polygon);
+        } else if (length >= 7 && std::memcmp(p, "usemtl", 6) == 0 && is_space(p[6])) {
+            chunk->materialNames.push_back(get_rest_of_line(p + 6, lineEnd));
+            material = chunk->materialNames.size();
+        } else if (length >= 7 && std::memcmp(p, "mtllib", 6) == 0 && is_space(p[6])) {
+            chunk->materialLibraries.push_back(get_rest_of_line(p + 6, lineEnd));
+        }
+
+        if (!ok) {
+            chunk->error = chunk->error ? chunk->error : "invalid vertex data";
+            chunk->errorLine = line;
+            return;
+        }
+        line = lineEnd + 1;
+    }
+}
+
+/// Split a file into chunks of whole lines
+std::vector<Chunk> split_into_chunks(const char *data, u64 size) {
+    u64 numChunks = std::max<u64>(1, std::min<u64>(core->jobSystem.getNumThreads() * CHUNKS_PER_THREAD,
+                                                   size / MIN_CHUNK_SIZE));
+    u64 chunkSize = size / numChunks;
+
+    std::vector<Chunk> chunks;
+    const char *end = data + size;
+    const char *begin = data;
+    for (u64 i = 0; i < numChunks && begin < end; ++i) {
+        const char *chunkEnd = end;
+        if (i + 1 < numChunks && begin + chunkSize < end) {
+            const char *newline = (const char *)std::memchr(begin + chunkSize, '\n', end - (begin + chunkSize));
+            chunkEnd = newline ? newline + 1 : end;
+        }
+
+        chunks.emplace_back();
+        chunks.back().begin = begin;
+        chunks.back().end = chunkEnd;
+        begin = chunkEnd;
+    }
+    return chunks;
+}
+
+Material get_default_material() {
+    Material material;
+    material.albedoTexture = core->resourceManager.getBuiltInTexture(BuiltInTextureEnum::WHITE);
+    material.normalTexture = core->resourceManager.getBuiltInTexture(BuiltInTextureEnum::NORMAL);
+    material.metallicTexture = core->resourceManager.getBuiltInTexture(BuiltInTextureEnum::WHITE);
+    material.metallicScale = 1.0f;
+    material.roughnessTexture = core->resourceManager.getBuiltInTexture(BuiltInTextureEnum::WHITE);
+    material.roughnessScale = 1.0f;
+    return material;
+}
+
+/// Load the materials of a .mtl file, the PBR extension's metallic and roughness are used next to the albedo and
+/// normal maps
+void load_material_library(const std::string &path, std::unordered_map<std::string, Material> *materials) {
+    std::vector<u8> bytes;
+    if (!utils::load_file_to_bytes(path, &bytes)) {
+        Log::warn("Failed to open material library '%s'", path.c_str());
+        return;
+    }
+
+    std::string dir = path.substr(0, path.find_last_of('/') + 1);
+    const char *line = (const char *)bytes.data();
+    const char *end = line + bytes.size();
+    Material *material = nullptr;
+
+    while (line < end) {
+        const char *lineEnd = (const char *)std::memchr(line, '\n', end - line);
+        lineEnd = lineEnd ? lineEnd : end;
+
+        const char *p = skip_spaces(line, lineEnd);
+        const char *keyEnd = p;
+        while (keyEnd < lineEnd && !is_space(*keyEnd)) {
+            ++keyEnd;
+        }
+        std::string key(p, keyEnd);
+        std::string value = get_rest_of_line(keyEnd, lineEnd);
+
+        if (key == "newmtl") {
+            material = &(*materials)[value];
+            *material = get_default_material();
+        } else if (material && !value.empty()) {
+            // texture options come before the file name
+            auto getTexture = [&]() {
+                std::string texPath = dir + value.substr(value.find_last_of(" \t") + 1);
+                std::replace(texPath.begin(), texPath.end(), '\\', '/');
+                return core->resourceManager.getTexture(texPath);
+            };
+
+            if (key == "map_Kd") {
+                material->albedoTexture = getTexture();
+            } else if (key == "norm" || key == "map_Kn") {
+                material->normalTexture = getTexture();
+            } else if (key == "map_Pm") {
+                material->metallicTexture = getTexture();
+            } else if (key == "map_Pr") {
+                material->roughnessTexture = getTexture();
+            } else if (key == "Pm") {
+                parse_float(value.c_str(), value.c_str() + value.size(), &material->metallicScale);
+            } else if (key == "Pr") {
+                parse_float(value.c_str(), value.c_str() + value.size(), &material->roughnessScale);
+            }
+        }
+
+        line = lineEnd + 1;
+    }
+}
+
+/// Smooth normals for the vertices the file didn't give one, weighted by the area of the triangles around them
+void generate_missing_normals(MeshData *mesh) {
+    std::vector<glm::vec3> normals(mesh->vertices.size(), glm::vec3(0));
+    bool anyMissing = false;
+    for (const Vertex &vertex : mesh->vertices) {
+        anyMissing |= vertex.normal == glm::vec3(0);
+    }
+    if (!anyMissing) {
+        return;
+    }
+
+    for (u32 i = 0; i + 2 < mesh->indices.size(); i += 3) {
+        const u32 *triangle = &mesh->indices[i];
+        glm::vec3 normal = glm::cross(mesh->vertices[triangle[1]].position - mesh->vertices[triangle[0]].position,
+                                      mesh->vertices[triangle[2]].position - mesh->vertices[triangle[0]].position);
+        for (u32 k = 0; k < 3; ++k) {
+            normals[triangle[k]] += normal;
+        }
+    }
+
+    for (u32 v = 0; v < mesh->vertices.size(); ++v) {
+        Vertex &vertex = mesh->vertices[v];
+        if (vertex.normal == glm::vec3(0)) {
+            f32 length = glm::length(normals[v]);
+            vertex.normal = length > 0.0f ? normals[v] / length : glm::vec3(0, 1, 0);
+        }
+    }
+}
+
+}
+
+bool is_obj_path(const std::string &path) {
+    return utils::has_extension(path, ".obj");
+}
+
+bool load(const std::string &path, std::vector<MeshData> *meshes) {
+    meshes->clear();
+
+    MappedFile file;
+    if (!file.open(path)) {
+        return false;
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    const char *data = (const char *)file.getData();
+    JobSystem &jobs = core->jobSystem;
+
+    // parse the chunks on their own, indices into vertex data of earlier chunks are resolved afterwards
+    std::vector<Chunk> chunks = split_into_chunks(data, file.getSize());
+    jobs.parallelFor(chunks.size(), 1, [&](u32 begin, u32 end) {
+        for (u32 c = begin; c < end; ++c) {
+            parse_chunk(&chunks[c]);
+        }
+    });
+
+    for (const Chunk &chunk : chunks) {
+        if (chunk.error) {
+            u64 line = std::count(data, chunk.errorLine ? chunk.errorLine : chunk.begin, '\n') + 1;
+            Log::warn("Failed to parse '%s' at line %d: %s", path.c_str(), (u32)line, chunk.error);
+            return false;
+        }
+    }
+
+    // place the vertex data of the chunks and map their material names onto one table, materials carry over into
+    // the following chunks until they are changed
+    u32 numPositions = 0;
+    u32 numUvs = 0;
+    u32 numNormals = 0;
+    std::vector<std::string> materialNames = {""};  // the default material is used until the first usemtl
+    std::unordered_map<std::string, u32> materialIds = {{"", 0}};
+    u32 currentMaterial = 0;
+    for (Chunk &chunk : chunks) {
+        chunk.firstPosition = numPositions;
+        chunk.firstUv = numUvs;
+        chunk.firstNormal = numNormals;
+        numPositions += chunk.positions.size();
+        numUvs += chunk.uvs.size();
+        numNormals += chunk.normals.size();
+
+        chunk.materialIds.push_back(currentMaterial);
+        for (const std::string &name : chunk.materialNames) {
+            auto inserted = materialIds.emplace(name, (u32)materialNames.size());
+            if (inserted.second) {
+                materialNames.push_back(name);
+            }
+            chunk.materialIds.push_back(inserted.first->second);
+        }
+        currentMaterial = chunk.materialIds.back();
+    }
+
+    u32 numMaterials = materialNames.size();
+    u32 numBuckets = jobs.getNumThreads() * BUCKETS_PER_THREAD;
+    std::vector<glm::vec3> positions(numPositions);
+    std::vector<glm::vec2> uvs(numUvs);
+    std::vector<glm::vec3> normals(numNormals);
+
+    // gather the vertex data, resolve indices and sort the corners of each chunk into buckets of their hash
+    jobs.parallelFor(chunks.size(), 1, [&](u32 begin, u32 end) {
+        for (u32 c = begin; c < end; ++c) {
+            Chunk &chunk = chunks[c];
+            std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.firstPosition);
+            std::copy(chunk.uvs.begin(), chunk.uvs.end(), uvs.begin() + chunk.firstUv);
+            std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.firstNormal);
+            std::vector<glm::vec3>().swap(chunk.positions);
+            std::vector<glm::vec2>().swap(chunk.uvs);
+            std::vector<glm::vec3>().swap(chunk.normals);
+
+            const u32 firsts[3] = {chunk.firstPosition, chunk.firstUv, chunk.firstNormal};
+            for (u32 slot : chunk.relativeCorners) {
+                chunk.corners[slot] += (s32)firsts[slot % 3];
+                if (chunk.corners[slot] < 0) {
+                    chunk.error = "face index out of range";
+                    return;
+                }
+            }
+
+            const u32 counts[3] = {numPositions, numUvs, numNormals};
+            for (u32 i = 0; i < chunk.corners.size(); ++i) {
+                if (chunk.corners[i] != MISSING && (u32)chunk.corners[i] >= counts[i % 3]) {
+                    chunk.error = "face index out of range";
+                    return;
+                }
+            }
+
+            chunk.materialTriangleCounts.assign(numMaterials, 0);
+            for (u32 &material : chunk.triangleMaterials) {
+                material = chunk.materialIds[material];
+                ++chunk.materialTriangleCounts[material];
+            }
+
+            u32 numCorners = chunk.triangleMaterials.size() * 3;
+            chunk.cornerVertices.resize(numCorners);
+            chunk.bucketCorners.resize(numBuckets);
+            for (std::vector<u32> &bucket : chunk.bucketCorners) {
+                bucket.reserve(numCorners / numBuckets + numCorners / (numBuckets * 8) + 1);
+            }
+            for (u32 corner = 0; corner < numCorners; ++corner) {
+                chunk.bucketCorners[get_bucket(get_key(chunk, corner), numBuckets)].push_back(corner);
+            }
+        }
+    });
+
+    for (const Chunk &chunk : chunks) {
+        if (chunk.error) {
+            Log::warn("Failed to parse '%s': %s", path.c_str(), chunk.error);
+            return false;
+        }
+    }
+
+    // merge identical corners into vertices, buckets don't share any so they are merged in parallel
+    std::vector<std::vector<std::vector<VertexKey>>> bucketVertices(numBuckets);
+    jobs.parallelFor(numBuckets, 1, [&](u32 begin, u32 end) {
+        for (u32 b = begin; b < end; ++b) {
+            std::vector<std::vector<VertexKey>> &vertices = bucketVertices[b];
+            vertices.resize(numMaterials);
+
+            u64 numCorners = 0;
+            for (const Chunk &chunk : chunks) {
+                numCorners += chunk.bucketCorners[b].size();
+            }
+            std::unordered_map<VertexKey, u32, VertexKeyHash> vertexIds;
+            vertexIds.reserve(numCorners / 2);
+
+            for (Chunk &chunk : chunks) {
+                for (u32 corner : chunk.bucketCorners[b]) {
+                    VertexKey key = get_key(chunk, corner);
+                    auto inserted = vertexIds.emplace(key, (u32)vertices[key.material].size());
+                    if (inserted.second) {
+                        vertices[key.material].push_back(key);
+                    }
+                    chunk.cornerVertices[corner] = inserted.first->second;
+                }
+                std::vector<u32>().swap(chunk.bucketCorners[b]);
+            }
+        }
+    });
+
+    // each material becomes a mesh, its vertices are laid out bucket after bucket and its triangles in file order
+    std::vector<u32> meshIds(numMaterials, ~0u);
+    std::vector<u32> vertexOffsets(numBuckets * numMaterials);
+    for (Chunk &chunk : chunks) {
+        chunk.materialFirstIndices.resize(numMaterials);
+    }
+    for (u32 m = 0; m < numMaterials; ++m) {
+        u32 numVertices = 0;
+        for (u32 b = 0; b < numBuckets; ++b) {
+            vertexOffsets[b * numMaterials + m] = numVertices;
+            numVertices += bucketVertices[b][m].size();
+        }
+
+        u32 numIndices = 0;
+        for (Chunk &chunk : chunks) {
+            chunk.materialFirstIndices[m] = numIndices;
+            numIndices += chunk.materialTriangleCounts[m] * 3;
+        }
+
+        if (numIndices > 0) {
+            meshIds[m] = meshes->size();
+            meshes->emplace_back();
+            meshes->back().vertices.resize(numVertices);
+            meshes->back().indices.resize(numIndices);
+        }
+    }
+
+    jobs.parallelFor(numBuckets, 1, [&](u32 begin, u32 end) {
+        for (u32 b = begin; b < end; ++b) {
+            for (u32 m = 0; m < numMaterials; ++m) {
+                if (meshIds[m] == ~0u) {
+                    continue;
+                }
+
+                Vertex *vertices = &(*meshes)[meshIds[m]].vertices[vertexOffsets[b * numMaterials + m]];
+                for (const VertexKey &key : bucketVertices[b][m]) {
+                    Vertex vertex = {};
+                    vertex.position = positions[key.position];
+                    vertex.uv = key.uv != MISSING ? uvs[key.uv] : glm::vec2(0);
+                    vertex.normal = key.normal != MISSING ? normals[key.normal] : glm::vec3(0);
+                    *vertices++ = vertex;
+                }
+            }
+        }
+    });
+
+    jobs.parallelFor(chunks.size(), 1, [&](u32 begin, u32 end) {
+        for (u32 c = begin; c < end; ++c) {
+            Chunk &chunk = chunks[c];
+            std::vector<u32> nextIndices = chunk.materialFirstIndices;
+            for (u32 corner = 0; corner < chunk.cornerVertices.size(); ++corner) {
+                VertexKey key = get_key(chunk, corner);
+                u32 vertexOffset = vertexOffsets[get_bucket(key, numBuckets) * numMaterials + key.material];
+                (*meshes)[meshIds[key.material]].indices[nextIndices[key.material]++] =
+                    vertexOffset + chunk.cornerVertices[corner];
+            }
+        }
+    });
+
+    std::chrono::duration<f32, std::milli> parseTime = std::chrono::steady_clock::now() - startTime;
+
+    jobs.parallelFor(meshes->size(), 1, [&](u32 begin, u32 end) {
+        for (u32 i = begin; i < end; ++i) {
+            generate_missing_normals(&(*meshes)[i]);
+            utils::generate_tangents(&(*meshes)[i].vertices, &(*meshes)[i].indices);
+        }
+    });
+
+    // textures are created on this thread, it owns the context
+    std::string dir = path.substr(0, path.find_last_of('/') + 1);
+    std::unordered_map<std::string, Material> materials;
+    for (const Chunk &chunk : chunks) {
+        for (const std::string &library : chunk.materialLibraries) {
+            load_material_library(dir + library, &materials);
+        }
+    }
+
+    Material defaultMaterial = get_default_material();
+    for (u32 m = 0; m < numMaterials; ++m) {
+        if (meshIds[m] == ~0u) {
+            continue;
+        }
+
+        auto material = materials.find(materialNames[m]);
+        if (material == materials.end() && m != 0) {
+            Log::warn("'%s' uses the undefined material '%s'", path.c_str(), materialNames[m].c_str());
+        }
+        (*meshes)[meshIds[m]].material = material != materials.end() ? material->second : defaultMaterial;
+    }
+
+    u32 numVertices = 0;
+    u32 numTriangles = 0;
+    for (const MeshData &mesh : *meshes) {
+        numVertices += mesh.vertices.size();
+        numTriangles += mesh.indices.size() / 3;
+    }
+
+    f32 megabytes = file.getSize() / (1024.0f * 1024.0f);
+    Log::info("Parsed '%s' with %d chunks: %.1f MB in %.1f ms, %.0f MB/s, %d vertices, %d triangles", path.c_str(),
+              (u32)chunks.size(), megabytes, parseTime.count(), megabytes / (parseTime.count() / 1000.0f),
+              numVertices, numTriangles);
+    return true;
+}
+
+}
@@ -0,0 +1,20 @@
+#ifndef ACORN_OBJ_H
+#define ACORN_OBJ_H
+
+#include "types.h"
+#include "mesh.h"
+#include <string>
+#include <vector>
+
+namespace obj {
+/// Whether a path has a .obj extension
+bool is_obj_path(const std::string &path);
+
+/// Load a Wavefront .obj file and the .mtl files it uses, with one mesh per material. The file is split into chunks
+/// of lines that are parsed on the job system, then corners that share a position, uv, normal and material are merged
+/// into one vertex in parallel. Parse throughput is logged
+/// \return Whether the file could be loaded, failures and unsupported statements are logged as warnings
+bool load(const std::string &path, std::vector<MeshData> *meshes);
+}
+
+#endif //ACORN_OBJ_H
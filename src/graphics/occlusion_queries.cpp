@@ -0,0 +1,222 @@
+#include "occlusion_queries.h"
+#include "render_context.h"
+#include "camera.h"
+#include "log.h"
+#include <algorithm>
+#include <cfloat>
+
+OcclusionQueries::OcclusionQueries()
+    : m_downsampleShader("../assets/shaders/fullscreen.vert", "../assets/shaders/hiz_downsample.frag"),
+      m_proxyShader("../assets/shaders/occlusion_proxy.vert", "../assets/shaders/occlusion_proxy.frag") {
+    Log::debug("OcclusionQueries::OcclusionQueries()");
+
+    // conservative queries may count samples that an exact one wouldn't, which lets them skip the exact coverage
+    // test, but they are only in 4.3 and later
+    m_queryTarget = gl3wIsSupported(4, 3) ? GL_ANY_SAMPLES_PASSED_CONSERVATIVE : GL_ANY_SAMPLES_PASSED;
+
+    for (u32 *queries : m_queries) {
+        glGenQueries(consts::OCCLUSION_MAX_QUERIES, queries);
+        if (queries[0] == 0) {
+            Log::fatal("Failed to create occlusion queries");
+        }
+    }
+
+    // proxies are generated from gl_VertexID, there are no attributes
+    glGenVertexArrays(1, &m_vao);
+    if (m_vao == 0) {
+        Log::fatal("Failed to generate occlusion proxy VAO");
+    }
+}
+
+OcclusionQueries::~OcclusionQueries() {
+    Log::debug("OcclusionQueries::~OcclusionQueries()");
+
+    for (u32 *queries : m_queries) {
+        glDeleteQueries(consts::OCCLUSION_MAX_QUERIES, queries);
+    }
+    glDeleteVertexArrays(1, &m_vao);
+}
+
+void OcclusionQueries::assignQueries(const Camera &camera, const std::vector<DrawEntity> &entities,
+                                     std::vector<DrawItem> *items) {
+    for (DrawItem &item : *items) {
+        item.occlusionQuery = 0;
+    }
+
+    // after a cut the boxes were tested against a view that has nothing to do with this one
+    const std::unordered_map<u64, Record> &records = m_records[m_previous];
+    if (records.empty() ||
+        glm::length(camera.getPosition() - m_cameraPosition) > consts::OCCLUSION_QUERY_MAX_CAMERA_MOVE ||
+        glm::dot(camera.getForward(), m_cameraForward) < consts::OCCLUSION_QUERY_MAX_CAMERA_TURN) {
+        return;
+    }
+
+    for (u32 i = 0; i < items->size(); ++i) {
+        DrawItem &item = (*items)[i];
+        auto it = records.find(get_record_key(entities[item.entityIndex], i));
+        if (it == records.end()) {
+            continue;
+        }
+
+        // a box that moved since it was tested could have moved out from behind the occluders
+        const Record &record = it->second;
+        if (record.boundsMin == item.boundsMin && record.boundsMax == item.boundsMax) {
+            item.occlusionQuery = record.query;
+        }
+    }
+}
+
+void OcclusionQueries::issueQueries(RenderContext &ctx, const Texture2D &depth, glm::uvec2 region,
+                                    const Camera &camera, const std::vector<DrawEntity> &entities,
+                                    const std::vector<DrawItem> &items) {
+    m_timer.begin();
+    buildHiZ(ctx, depth, region);
+
+    u32 current = 1 - m_previous;
+    std::unordered_map<u64, Record> &records = m_records[current];
+    records.clear();
+    m_numQueries = 0;
+
+    ctx.setColorRenderTarget(m_proxyTarget);
+    ctx.setState(RenderStateBuilder()
+                 .setDepthTest(false)
+                 .setDepthWrite(false)
+                 .setColorWrite(false)
+                 .build());
+
+    m_proxyShader.bind();
+    glBindVertexArray(m_vao);
+
+    glm::mat4 viewProjection = camera.getViewProjectionMatrix();
+    glm::vec2 regionSize = glm::vec2(region);
+    u32 boundLevel = ~0u;
+
+    for (u32 i = 0; i < items.size(); ++i) {
+        const DrawItem &item = items[i];
+        if (m_numQueries == consts::OCCLUSION_MAX_QUERIES) {
+            break;
+        }
+        if (item.numRanges == 0 || item.mesh->getNumIndices(item.lod) < consts::OCCLUSION_QUERY_MIN_TRIANGLES * 3) {
+            continue;
+        }
+
+        // screen space rectangle and nearest depth of the box
+        glm::vec2 minPixel = glm::vec2(FLT_MAX);
+        glm::vec2 maxPixel = glm::vec2(-FLT_MAX);
+        f32 nearestDepth = 1.0f;
+        bool crossesNearPlane = false;
+        for (u32 c = 0; c < 8 && !crossesNearPlane; ++c) {
+            glm::vec3 corner = glm::vec3(c & 1u ? item.boundsMax.x : item.boundsMin.x,
+                                         c & 2u ? item.boundsMax.y : item.boundsMin.y,
+                                         c & 4u ? item.boundsMax.z : item.boundsMin.z);
+            glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+            crossesNearPlane = clip.w <= camera.getNearPlane();
+
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            glm::vec2 pixel = (glm::vec2(ndc) * 0.5f + 0.5f) * regionSize;
+            minPixel = glm::min(minPixel, pixel);
+            maxPixel = glm::max(maxPixel, pixel);
+            nearestDepth = std::min(nearestDepth, ndc.z * 0.5f + 0.5f);
+        }
+
+        // boxes around the camera are always visible, boxes off screen are left to frustum culling. Neither gets a
+        // query, so they are drawn unconditionally
+        minPixel -= consts::OCCLUSION_PROXY_MARGIN_PIXELS;
+        maxPixel += consts::OCCLUSION_PROXY_MARGIN_PIXELS;
+        if (crossesNearPlane || maxPixel.x < 0.0f || maxPixel.y < 0.0f || minPixel.x >= regionSize.x ||
+            minPixel.y >= regionSize.y) {
+            continue;
+        }
+        glm::ivec2 firstPixel = glm::ivec2(glm::max(glm::floor(minPixel), glm::vec2(0.0f)));
+        glm::ivec2 lastPixel = glm::ivec2(glm::min(glm::floor(maxPixel), regionSize - 1.0f));
+
+        // a texel of level l covers 2^(l + 1) pixels on each axis
+        u32 level = 0;
+        glm::ivec2 firstTexel = firstPixel / 2;
+        glm::ivec2 lastTexel = lastPixel / 2;
+        while (level + 1 < consts::OCCLUSION_HIZ_LEVELS &&
+               (u32)std::max(lastTexel.x - firstTexel.x, lastTexel.y - firstTexel.y) >=
+               consts::OCCLUSION_PROXY_MAX_TEXELS) {
+            ++level;
+            firstTexel /= 2;
+            lastTexel /= 2;
+        }
+
+        if (level != boundLevel) {
+            boundLevel = level;
+            glm::uvec2 levelRegion = getHiZRegion(level);
+            ctx.setViewport(levelRegion.x, levelRegion.y);
+            m_proxyShader.setUniform("uHiZ", m_hiZLevels[level]);
+            m_proxyShader.setUniform("uLevelRegion", glm::vec2(levelRegion));
+        }
+        m_proxyShader.setUniform("uRectMin", glm::vec2(firstTexel));
+        m_proxyShader.setUniform("uRectMax", glm::vec2(lastTexel + 1));
+        m_proxyShader.setUniform("uDepth", glm::clamp(nearestDepth, 0.0f, 1.0f));
+
+        u32 query = m_queries[current][m_numQueries++];
+        glBeginQuery(m_queryTarget, query);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        glEndQuery(m_queryTarget);
+
+        records[get_record_key(entities[item.entityIndex], i)] = {query, item.boundsMin, item.boundsMax};
+    }
+
+    glBindVertexArray(0);
+    m_timer.end();
+
+    m_previous = current;
+    m_cameraPosition = camera.getPosition();
+    m_cameraForward = camera.getForward();
+}
+
+void OcclusionQueries::reset() {
+    m_records[0].clear();
+    m_records[1].clear();
+    m_numQueries = 0;
+}
+
+void OcclusionQueries::buildHiZ(RenderContext &ctx, const Texture2D &depth, glm::uvec2 region) {
+    // levels are sized for the whole depth texture, like the bloom pyramid they round up so odd sizes keep their
+    // last texels
+    if (m_depthSize != glm::uvec2(depth.getWidth(), depth.getHeight())) {
+        m_depthSize = glm::uvec2(depth.getWidth(), depth.getHeight());
+
+        glm::uvec2 size = m_depthSize;
+        for (Texture2D &level : m_hiZLevels) {
+            size = glm::max(glm::uvec2(1), (size + 1u) / 2u);
+            level.setImage(size.x, size.y, TextureFormatEnum::R32F);
+        }
+        m_proxyTarget.setImage(m_hiZLevels[0].getWidth(), m_hiZLevels[0].getHeight(), TextureFormatEnum::R8);
+    }
+    m_region = region;
+
+    ctx.setState(RenderStateBuilder()
+                 .setDepthTest(false)
+                 .build());
+
+    m_downsampleShader.bind();
+    glBindVertexArray(m_vao);
+    for (u32 level = 0; level < consts::OCCLUSION_HIZ_LEVELS; ++level) {
+        glm::uvec2 levelRegion = getHiZRegion(level);
+        ctx.setColorRenderTarget(m_hiZLevels[level]);
+        ctx.setViewport(levelRegion.x, levelRegion.y);
+
+        m_downsampleShader.setUniform("uSource", level == 0 ? depth : m_hiZLevels[level - 1]);
+        m_downsampleShader.setUniform("uSourceRegion", glm::vec2(level == 0 ? region : getHiZRegion(level - 1)));
+
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
+    glBindVertexArray(0);
+}
+
+glm::uvec2 OcclusionQueries::getHiZRegion(u32 level) const {
+    glm::uvec2 region = m_region;
+    for (u32 i = 0; i <= level; ++i) {
+        region = glm::max(glm::uvec2(1), (region + 1u) / 2u);
+    }
+    return region;
+}
+
+u64 OcclusionQueries::get_record_key(const DrawEntity &entity, u32 item_index) {
+    return ((u64)entity.sceneIndex << 32u) | (entity.sceneItemOffset + item_index - entity.firstItem);
+}
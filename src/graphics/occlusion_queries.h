@@ -0,0 +1,87 @@
+#ifndef ACORN_OCCLUSION_QUERIES_H
+#define ACORN_OCCLUSION_QUERIES_H
+
+#include "types.h"
+#include "texture.h"
+#include "shader.h"
+#include "gpu_timer.h"
+#include "draw_item.h"
+#include "constants.h"
+#include <glm/glm.hpp>
+#include <unordered_map>
+#include <vector>
+
+class Camera;
+class RenderContext;
+
+/// Tests the bounding boxes of large meshes against a hierarchical depth buffer of the frame with occlusion queries.
+/// Each box is drawn as a screen space rectangle at its nearest depth into the level of the pyramid it is a few
+/// texels large on, and samples only pass where the box could be in front of the depth. The queries are used by the
+/// next frame for conditional rendering, so neither the CPU nor the GPU waits for them. Results are dropped when the
+/// camera or the box moved too far in between, the draw is unconditional then
+class OcclusionQueries {
+public:
+    OcclusionQueries();
+    ~OcclusionQueries();
+
+    /// Give the draw items of a frame the queries that were issued for them last frame
+    /// \param items Receive their occlusion query, or 0 if they have to be drawn unconditionally
+    void assignQueries(const Camera &camera, const std::vector<DrawEntity> &entities, std::vector<DrawItem> *items);
+
+    /// Build the depth pyramid of the frame and issue queries for the large draw items that were drawn
+    /// \param depth Depth of the frame
+    /// \param region Size of the rendered part of the depth texture in texels
+    void issueQueries(RenderContext &ctx, const Texture2D &depth, glm::uvec2 region, const Camera &camera,
+                      const std::vector<DrawEntity> &entities, const std::vector<DrawItem> &items);
+
+    /// Forget the queries of the last frame, so that nothing is drawn conditionally
+    void reset();
+
+    /// Number of queries issued by the last issueQueries()
+    u32 getNumQueries() const {
+        return m_numQueries;
+    }
+
+    /// GPU time of building the pyramid and drawing the proxies
+    f32 getMilliseconds() {
+        return m_timer.getMilliseconds();
+    }
+
+private:
+    /// Query of a draw item, with the box it was tested with
+    struct Record {
+        u32 query;
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+    };
+
+    /// Downsample depth into the levels of the pyramid, each texel keeps the farthest depth it covers
+    void buildHiZ(RenderContext &ctx, const Texture2D &depth, glm::uvec2 region);
+
+    /// Size of the part of a pyramid level that covers the rendered region
+    glm::uvec2 getHiZRegion(u32 level) const;
+
+    /// Identifies the mesh of a scene entity across frames
+    static u64 get_record_key(const DrawEntity &entity, u32 item_index);
+
+    Shader m_downsampleShader;
+    Shader m_proxyShader;
+    Texture2D m_hiZLevels[consts::OCCLUSION_HIZ_LEVELS];
+    Texture2D m_proxyTarget;    // proxies only write to the queries, this is to make the framebuffer complete
+    glm::uvec2 m_depthSize = glm::uvec2(0);
+    glm::uvec2 m_region = glm::uvec2(0);    // rendered part of the depth texture
+    u32 m_vao = 0;
+
+    // queries are double buffered, the ones read this frame were issued last frame
+    u32 m_queryTarget;
+    u32 m_queries[2][consts::OCCLUSION_MAX_QUERIES] = {};
+    std::unordered_map<u64, Record> m_records[2];
+    u32 m_previous = 0;
+    u32 m_numQueries = 0;
+    glm::vec3 m_cameraPosition = glm::vec3(0);  // camera of the previous queries
+    glm::vec3 m_cameraForward = glm::vec3(0);
+
+    GpuTimer m_timer;
+};
+
+#endif //ACORN_OCCLUSION_QUERIES_H
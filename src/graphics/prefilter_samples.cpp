@@ -0,0 +1,75 @@
+#include "prefilter_samples.h"
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <cmath>
+
+// http://holger.dammertz.org/stuff/notes_HammersleyOnHemisphere.html
+static f32 radical_inverse_van_der_corput(u32 bits) {
+    bits = (bits << 16u) | (bits >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    return (f32)bits * 2.3283064365386963e-10f; // / 0x100000000
+}
+
+namespace prefilter {
+u32 get_sample_count(f32 roughness) {
+    if (roughness <= 0.0f) {
+        return 1;
+    }
+
+    return std::min(PREFILTER_MAX_SAMPLES, 16u + (u32)std::ceil(roughness * (PREFILTER_MAX_SAMPLES - 16u)));
+}
+
+PrefilterSamples generate_samples(f32 roughness, u32 env_map_side_length) {
+    PrefilterSamples result;
+
+    // A perfect mirror is just a copy of the base level
+    if (roughness <= 0.0f) {
+        result.samples[0] = glm::vec4(0, 0, 1, 0);
+        result.numSamples = 1;
+        result.invTotalWeight = 1.0f;
+        return result;
+    }
+
+    u32 numSamples = get_sample_count(roughness);
+    f32 a = roughness * roughness;
+    f32 a2 = a * a;
+
+    // solid angle of a texel of the base level
+    f32 texelSolidAngle = 4.0f * glm::pi<f32>() / (6.0f * env_map_side_length * env_map_side_length);
+
+    f32 totalWeight = 0;
+    for (u32 i = 0; i < numSamples; ++i) {
+        // importance sample GGX, this matches importance_sample_ggx() in env_map_prefilter.frag
+        f32 phi = 2.0f * glm::pi<f32>() * ((f32)i / numSamples);
+        f32 xi = radical_inverse_van_der_corput(i);
+        f32 cosTheta = std::sqrt((1.0f - xi) / (1.0f + (a2 - 1.0f) * xi));
+        f32 sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+        glm::vec3 H = glm::vec3(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta);
+
+        // with N = V = +z the reflection about H is the light direction
+        glm::vec3 L = 2.0f * H.z * H - glm::vec3(0, 0, 1);
+        if (L.z <= 0.0f) {
+            continue;
+        }
+
+        // pdf of L is D(NdotH) * NdotH / (4 * VdotH), which is D / 4 since N = V
+        f32 NdotH = H.z;
+        f32 d = NdotH * NdotH * (a2 - 1.0f) + 1.0f;
+        f32 D = a2 / (glm::pi<f32>() * d * d);
+        f32 pdf = D * 0.25f;
+
+        // pick the mip level where a texel covers about as much solid angle as the sample
+        f32 sampleSolidAngle = 1.0f / (numSamples * pdf + 0.0001f);
+        f32 mipLevel = std::max(0.0f, 0.5f * std::log2(sampleSolidAngle / texelSolidAngle) + 1.0f);
+
+        result.samples[result.numSamples++] = glm::vec4(L, mipLevel);
+        totalWeight += L.z;
+    }
+
+    result.invTotalWeight = totalWeight > 0.0f ? 1.0f / totalWeight : 0.0f;
+    return result;
+}
+}
@@ -0,0 +1,31 @@
+#ifndef ACORN_PREFILTER_SAMPLES_H
+#define ACORN_PREFILTER_SAMPLES_H
+
+#include "types.h"
+#include <glm/glm.hpp>
+
+/// Maximum number of samples per texel when prefiltering with filtered importance sampling, must match
+/// MAX_SAMPLES in env_map_prefilter_fis.frag
+constexpr u32 PREFILTER_MAX_SAMPLES = 64;
+
+/// Sample directions and weights for one roughness level, laid out as the std140 PrefilterSamples uniform block
+struct PrefilterSamples {
+    /// xyz: light direction in tangent space where the normal is +z, w: environment map mip level to sample.
+    /// The weight of each sample is its cosine, the z component
+    glm::vec4 samples[PREFILTER_MAX_SAMPLES];
+    s32 numSamples = 0;
+    f32 invTotalWeight = 0;
+    f32 padding[2] = {};
+};
+
+namespace prefilter {
+/// Number of GGX samples used at a roughness, narrow lobes converge with much fewer samples
+u32 get_sample_count(f32 roughness);
+
+/// Generate importance sampled GGX directions for a roughness along with the source mip level for each sample,
+/// chosen from the solid angle the sample covers (filtered importance sampling)
+/// \param env_map_side_length Side length of the base level of the environment map that is sampled
+PrefilterSamples generate_samples(f32 roughness, u32 env_map_side_length);
+}
+
+#endif //ACORN_PREFILTER_SAMPLES_H
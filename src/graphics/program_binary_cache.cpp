@@ -0,0 +1,113 @@
+#include "program_binary_cache.h"
+#include "constants.h"
+#include "utils.h"
+#include "log.h"
+#include <GL/gl3w.h>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Bump whenever the layout of the cache files changes
+constexpr u32 PROGRAM_BINARY_MAGIC = 0x42505341; // "ASPB"
+constexpr u32 PROGRAM_BINARY_VERSION = 1;
+
+struct ProgramBinaryHeader {
+    u32 magic;
+    u32 version;
+    u32 binaryFormat;
+    u32 padding;
+    u64 key;
+};
+
+static u64 hash_string(const char *str, u64 seed) {
+    return str ? utils::hash_bytes(str, std::strlen(str), seed) : seed;
+}
+
+ProgramBinaryCache::ProgramBinaryCache(const std::string &directory)
+    : m_directory(directory) {
+    Log::debug("ProgramBinaryCache::ProgramBinaryCache()");
+
+    // binaries can't be shared between drivers, or even versions of the same driver
+    m_driverHash = utils::hash_bytes(nullptr, 0);
+    m_driverHash = hash_string((const char *)glGetString(GL_VENDOR), m_driverHash);
+    m_driverHash = hash_string((const char *)glGetString(GL_RENDERER), m_driverHash);
+    m_driverHash = hash_string((const char *)glGetString(GL_VERSION), m_driverHash);
+
+    s32 numFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+    m_supported = numFormats > 0 && glGetProgramBinary && glProgramBinary && glProgramParameteri;
+    if (!m_supported) {
+        Log::info("Program binaries are not supported by the driver, shaders are compiled on every launch");
+        return;
+    }
+
+    utils::create_directory(consts::CACHE_DIRECTORY);
+    utils::create_directory(m_directory);
+}
+
+bool ProgramBinaryCache::load(u64 source_hash, u32 program) const {
+    if (!m_supported) {
+        return false;
+    }
+
+    u64 key = utils::hash_bytes(&source_hash, sizeof(source_hash), m_driverHash);
+
+    std::vector<u8> bytes;
+    if (!utils::load_file_to_bytes(getPath(key), &bytes)) {
+        return false;
+    }
+
+    ProgramBinaryHeader header = {};
+    if (bytes.size() <= sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (header.magic != PROGRAM_BINARY_MAGIC || header.version != PROGRAM_BINARY_VERSION || header.key != key) {
+        return false;
+    }
+
+    glProgramBinary(program, header.binaryFormat, bytes.data() + sizeof(header), bytes.size() - sizeof(header));
+
+    // the driver can reject binaries at any time, for example after it was updated without the version changing
+    s32 success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (success == GL_FALSE) {
+        Log::debug("Cached program binary '%s' was rejected, compiling instead", getPath(key).c_str());
+        return false;
+    }
+
+    return true;
+}
+
+void ProgramBinaryCache::store(u64 source_hash, u32 program) const {
+    if (!m_supported) {
+        return;
+    }
+
+    u64 key = utils::hash_bytes(&source_hash, sizeof(source_hash), m_driverHash);
+
+    s32 length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    std::vector<u8> bytes(sizeof(ProgramBinaryHeader) + length);
+    GLenum binaryFormat = 0;
+    glGetProgramBinary(program, length, &length, &binaryFormat, bytes.data() + sizeof(ProgramBinaryHeader));
+
+    ProgramBinaryHeader header = {PROGRAM_BINARY_MAGIC, PROGRAM_BINARY_VERSION, binaryFormat, 0, key};
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    bytes.resize(sizeof(header) + length);
+
+    if (!utils::write_bytes_to_file(getPath(key), bytes.data(), bytes.size())) {
+        Log::warn("Failed to write program binary '%s'", getPath(key).c_str());
+    }
+}
+
+std::string ProgramBinaryCache::getPath(u64 key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016" PRIx64 ".bin", key);
+    return m_directory + name;
+}
@@ -0,0 +1,34 @@
+#ifndef ACORN_PROGRAM_BINARY_CACHE_H
+#define ACORN_PROGRAM_BINARY_CACHE_H
+
+#include "types.h"
+#include <string>
+
+/// On-disk cache of linked program binaries, so shaders don't have to be compiled on every launch. Binaries are
+/// only valid for the driver that created them, so the driver is part of the key
+class ProgramBinaryCache {
+public:
+    explicit ProgramBinaryCache(const std::string &directory);
+
+    /// Try to load a cached binary into a program
+    /// \param source_hash Hash of the fully preprocessed sources of the program
+    /// \return Whether a binary was found and the driver accepted it, the program is linked if so
+    bool load(u64 source_hash, u32 program) const;
+
+    /// Write the binary of a successfully linked program to the cache
+    void store(u64 source_hash, u32 program) const;
+
+    /// Whether the driver supports program binaries at all
+    bool isSupported() const {
+        return m_supported;
+    }
+
+private:
+    std::string getPath(u64 key) const;
+
+    std::string m_directory;
+    u64 m_driverHash = 0;
+    bool m_supported = false;
+};
+
+#endif //ACORN_PROGRAM_BINARY_CACHE_H
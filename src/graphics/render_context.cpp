@@ -12,22 +12,52 @@ void RenderContext::setRenderTarget(const Texture2D &color) {
     m_targetFramebuffer.setViewport();
 }
 
+void RenderContext::setRenderTarget(const Texture2D &color, const Texture2D &depth) {
+    m_depthTextureFramebuffer.bind();
+    m_depthTextureFramebuffer.attachTextures(color, depth);
+    m_depthTextureFramebuffer.setViewport();
+}
+
 void RenderContext::setRenderTarget(const TextureCubemap &color, CubemapFaceEnum face, u32 mip_level) {
     m_targetFramebuffer.bind();
     m_targetFramebuffer.attachTexture(color, GL_TEXTURE_CUBE_MAP_POSITIVE_X + (u32)face, mip_level);
     m_targetFramebuffer.setViewport(mip_level);
 }
 
+void RenderContext::setColorRenderTarget(const Texture2D &color) {
+    m_colorFramebuffer.bind();
+    m_colorFramebuffer.attachColorTexture(color);
+    m_colorFramebuffer.setViewport();
+}
+
+void RenderContext::setDefaultRenderTarget(u32 width, u32 height) {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, width, height);
+}
+
+void RenderContext::setRenderTargetLayered(const TextureCubemap &color, u32 mip_level) {
+    m_targetFramebuffer.bind();
+    m_targetFramebuffer.attachTextureLayered(color, mip_level);
+    m_targetFramebuffer.setViewport(mip_level);
+}
+
+void RenderContext::setViewport(u32 width, u32 height) {
+    glViewport(0, 0, width, height);
+}
+
 void RenderContext::clear(u32 clear_flags) {
     GLbitfield bitfield = 0;
     if (clear_flags & ClearFlags::CLEAR_COLOR) {
         bitfield |= GL_COLOR_BUFFER_BIT;
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
     }
     if (clear_flags & ClearFlags::CLEAR_DEPTH) {
         bitfield |= GL_DEPTH_BUFFER_BIT;
+        glDepthMask(GL_TRUE);
     }
     if (clear_flags & ClearFlags::CLEAR_STENCIL) {
         bitfield |= GL_STENCIL_BUFFER_BIT;
+        glStencilMask(~0u);
     }
     glClear(bitfield);
 }
@@ -46,4 +76,32 @@ void RenderContext::setState(const RenderState &state) {
     }
 
     glDepthFunc(GL_NEVER + (u32)state.depthFunc);
+
+    GLboolean colorMask = state.colorWriteEnabled ? GL_TRUE : GL_FALSE;
+    glColorMask(colorMask, colorMask, colorMask, colorMask);
+
+    if (state.depthClampEnabled) {
+        glEnable(GL_DEPTH_CLAMP);
+    } else {
+        glDisable(GL_DEPTH_CLAMP);
+    }
+
+    switch (state.blendMode) {
+        case BlendModeEnum::NONE:
+            glDisable(GL_BLEND);
+            break;
+        case BlendModeEnum::ADDITIVE:
+            glEnable(GL_BLEND);
+            glBlendEquation(GL_FUNC_ADD);
+            glBlendFunc(GL_ONE, GL_ONE);
+            break;
+    }
+}
+
+void RenderContext::beginConditionalRender(u32 query) {
+    glBeginConditionalRender(query, GL_QUERY_WAIT);
+}
+
+void RenderContext::endConditionalRender() {
+    glEndConditionalRender();
 }
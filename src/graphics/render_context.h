@@ -17,11 +17,20 @@ enum class DepthFuncEnum : u32 {
     ALWAYS
 };
 
+/// Enum of ways fragments are combined with the render target
+enum class BlendModeEnum : u32 {
+    NONE = 0,   // replace
+    ADDITIVE    // add to the target
+};
+
 /// A struct with all render state options
 struct RenderState {
     bool depthTestEnabled = true;
     bool depthWriteEnabled = true;
     DepthFuncEnum depthFunc = DepthFuncEnum::LESS;
+    bool colorWriteEnabled = true;
+    bool depthClampEnabled = false;
+    BlendModeEnum blendMode = BlendModeEnum::NONE;
 };
 
 /// A utility class for building the render state
@@ -45,6 +54,24 @@ public:
         return *this;
     }
 
+    /// Set the color write state
+    RenderStateBuilder &setColorWrite(bool enabled) {
+        m_renderState.colorWriteEnabled = enabled;
+        return *this;
+    }
+
+    /// Set the depth clamp state, geometry in front of the near plane is clamped to it instead of being clipped
+    RenderStateBuilder &setDepthClamp(bool enabled) {
+        m_renderState.depthClampEnabled = enabled;
+        return *this;
+    }
+
+    /// Set how fragments are combined with the render target
+    RenderStateBuilder &setBlendMode(BlendModeEnum mode) {
+        m_renderState.blendMode = mode;
+        return *this;
+    }
+
     /// Finalize the built render state
     RenderState build() {
         return m_renderState;
@@ -75,18 +102,39 @@ public:
 
     void setRenderTarget(const Texture2D &color);
 
+    /// Render to a 2D texture with a depth texture instead of a depth renderbuffer
+    void setRenderTarget(const Texture2D &color, const Texture2D &depth);
+
     void setRenderTarget(const TextureCubemap &color, CubemapFaceEnum face, u32 mip_level = 0);
 
+    /// Render to a 2D texture without depth, attachments of the regular target are kept
+    void setColorRenderTarget(const Texture2D &color);
+
+    /// Render to the window
+    void setDefaultRenderTarget(u32 width, u32 height);
+
+    /// Render to all six faces of a cubemap mip level at once, faces are selected with gl_Layer
+    void setRenderTargetLayered(const TextureCubemap &color, u32 mip_level = 0);
+
+    /// Restrict rendering to the bottom left region of the current render target
+    void setViewport(u32 width, u32 height);
+
+    /// Clear buffers of the current render target. Writes to them are enabled first, since glClear obeys the masks
+    /// a previous state left behind
     void clear(u32 clear_flags);
 
     void setState(const RenderState &state);
 
-    const Framebuffer &getFramebuffer() const {
-        return m_targetFramebuffer;
-    }
+    /// Skip the following draws if no samples passed in an occlusion query. The GPU waits for the result instead of
+    /// the CPU, which costs nothing for queries that were issued a frame earlier
+    void beginConditionalRender(u32 query);
+
+    void endConditionalRender();
 
 private:
     Framebuffer m_targetFramebuffer;
+    Framebuffer m_colorFramebuffer;
+    Framebuffer m_depthTextureFramebuffer;
 };
 
 #endif //ACORN_RENDER_CONTEXT_H
@@ -4,23 +4,34 @@
 #include "core.h"
 #include "log.h"
 #include "constants.h"
-#include <stb_image.h>
+#include "spherical_harmonics.h"
+#include "prefilter_samples.h"
+#include "hdr_image.h"
+#include "meshlet.h"
 #include <GL/gl3w.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <thread>
 
 /*
  * GOAL: it should be clear (by looking at the code here) that the renderer has these stages/render passes:
  *
  * [PRECOMPUTE]
  * render to brdfLut2d
+ * (skipped along with UPDATE IBL PROBE when the results are found in the IBL cache)
  *
  * [UPDATE IBL PROBE]
- * load envMapCubemap from file or generate sky
- * use envMapCubemap -> render to diffuseIrradianceCubemap
- * use envMapCubemap -> render to prefilteredEnvCubemap
+ * (either blocking or time-sliced across frames within a GPU time budget, one work item is a face or face-mip)
+ * use envMapCubemap, sun direction -> render to skyCaptureCubemap
+ * read back a small skyCaptureCubemap mip, project it on worker threads -> irradianceSh uniform buffer
+ * use skyCaptureCubemap -> render to back prefilteredEnvCubemap (faces of a mip level in one layered draw)
+ * swap front and back prefilteredEnvCubemap once everything is done
  *
  * [RENDER FRAME]
- * use brdfLut, diffuseIrradianceCubemap, prefilteredEnvCubemap -> render to hdrTexture
- * use envMap -> render to hdrTexture
+ * use brdfLut, irradianceSh, front prefilteredEnvCubemap -> render to hdrTexture
+ * use envMap, sun direction -> render to hdrTexture
  * use hdrTexture -> render to ldrTexture
  */
 
@@ -40,21 +51,84 @@ GraphicsDebugLogger::GraphicsDebugLogger() {
     glDebugMessageCallback(opengl_debug_callback, nullptr);
 }
 
+constexpr u32 IRRADIANCE_SH_UNIFORM_BINDING = 0;
+constexpr u32 PREFILTER_SAMPLES_UNIFORM_BINDING = 1;
+
+// must match num_samples in env_map_prefilter.frag
+constexpr u32 REFERENCE_PREFILTER_SAMPLE_COUNT = 1024;
+
+// work items of a probe update, in order: capture each sky face, read back for SH, prefilter each face of each level
+constexpr u32 IBL_CAPTURE_ITEMS_BEGIN = 0;
+constexpr u32 IBL_READBACK_ITEM = IBL_CAPTURE_ITEMS_BEGIN + 6;
+constexpr u32 IBL_PREFILTER_ITEMS_BEGIN = IBL_READBACK_ITEM + 1;
+
+// initial guess for the GPU time of one unit of work item cost, refined with timer queries
+constexpr f32 IBL_INITIAL_MS_PER_COST = 1e-6f;
+
+// permutation key bit of depth.vert/.frag for materials that discard by albedo alpha
+constexpr u32 DEPTH_ALPHA_TEST = 1u << 0u;
+
+static const glm::vec3 SUN_DISK_RADIANCE = glm::vec3(50.0f);
+static const glm::vec3 SUN_ILLUMINANCE = glm::vec3(3.0f);
+
+static u32 get_num_ibl_work_items(u32 num_prefiltered_env_levels) {
+    return IBL_PREFILTER_ITEMS_BEGIN + 6 * num_prefiltered_env_levels;
+}
+
+static f32 get_prefilter_roughness(u32 level, u32 max_level) {
+    return (f32) level / (f32) max_level;
+}
+
+// TODO: don't hardcode skybox textures into renderer
+// a single equirectangular image is used if it exists, otherwise six cubemap faces
+static const char *ENVIRONMENT_MAP_EQUIRECTANGULAR_PATH = "../assets/env/environment.hdr";
+static const char *ENVIRONMENT_MAP_FACE_PATHS[6] = {
+    "../assets/env/px.hdr",
+    "../assets/env/nx.hdr",
+    "../assets/env/py.hdr",
+    "../assets/env/ny.hdr",
+    "../assets/env/pz.hdr",
+    "../assets/env/nz.hdr"
+};
+
 // TODO: load shaders from resource manager instead
 
 Renderer::Renderer()
-    : m_materialShader("../assets/shaders/material.vert", "../assets/shaders/material.frag"),
+    : m_depthShaders("../assets/shaders/depth.vert", "../assets/shaders/depth.frag", {"ALPHA_TEST"}),
+      m_materialShaders("../assets/shaders/material.vert", "../assets/shaders/material.frag",
+                        std::vector<std::string>(std::begin(MATERIAL_VARIANT_KEYWORDS),
+                                                 std::end(MATERIAL_VARIANT_KEYWORDS))),
       m_skyShader("../assets/shaders/cube.vert", "../assets/shaders/sky.frag"),
-      m_diffuseIrradianceShader("../assets/shaders/cube.vert", "../assets/shaders/diffuse_irradiance_convolution.frag"),
-      m_envMapPrefilterShader("../assets/shaders/cube.vert", "../assets/shaders/env_map_prefilter.frag"),
+      m_skyCaptureShader("../assets/shaders/fullscreen.vert", "../assets/shaders/cubemap_layered.geom",
+                         "../assets/shaders/sky.frag"),
+      m_envMapPrefilterShader("../assets/shaders/fullscreen.vert", "../assets/shaders/cubemap_layered.geom",
+                              "../assets/shaders/env_map_prefilter.frag"),
+      m_envMapPrefilterFisShader("../assets/shaders/fullscreen.vert", "../assets/shaders/cubemap_layered.geom",
+                                 "../assets/shaders/env_map_prefilter_fis.frag"),
+      m_prefilterSamplesBuffer(PREFILTER_SAMPLES_UNIFORM_BINDING),
       m_brdfLutShader("../assets/shaders/fullscreen.vert", "../assets/shaders/brdf_lut.frag"),
-      m_tonemapShader("../assets/shaders/fullscreen.vert", "../assets/shaders/tonemap.frag") {
+      m_tonemapShader("../assets/shaders/fullscreen.vert", "../assets/shaders/tonemap.frag"),
+      m_bloomDownsampleShader("../assets/shaders/fullscreen.vert", "../assets/shaders/bloom_downsample.frag"),
+      m_bloomUpsampleShader("../assets/shaders/fullscreen.vert", "../assets/shaders/bloom_upsample.frag"),
+      m_frameTimer(GpuTimerModeEnum::TIMESTAMPS),
+      m_iblCache(std::string(consts::CACHE_DIRECTORY) + "ibl.bin"),
+      m_irradianceShBuffer(IRRADIANCE_SH_UNIFORM_BINDING),
+      m_iblMsPerCost(IBL_INITIAL_MS_PER_COST),
+      m_irradianceShJobRunning(false) {
     Log::debug("Renderer::Renderer()");
     init();
 }
 
 Renderer::~Renderer() {
     Log::debug("Renderer::~Renderer()");
+
+    // the job writes to members of the renderer
+    waitForIrradianceShJob();
+
+    if (m_irradianceShReadbackFence) {
+        glDeleteSync(m_irradianceShReadbackFence);
+    }
+    glDeleteBuffers(1, &m_irradianceShReadbackPbo);
 }
 
 void Renderer::init() {
@@ -62,33 +136,43 @@ void Renderer::init() {
     // init textures
     //--------------
 
-    // TODO: don't hardcode skybox textures into renderer
-    stbi_set_flip_vertically_on_load(0);
-    s32 w, h;
-    void *data[6] = {
-        stbi_loadf("../assets/env/px.hdr", &w, &h, nullptr, 3),
-        stbi_loadf("../assets/env/nx.hdr", &w, &h, nullptr, 3),
-        stbi_loadf("../assets/env/py.hdr", &w, &h, nullptr, 3),
-        stbi_loadf("../assets/env/ny.hdr", &w, &h, nullptr, 3),
-        stbi_loadf("../assets/env/pz.hdr", &w, &h, nullptr, 3),
-        stbi_loadf("../assets/env/nz.hdr", &w, &h, nullptr, 3)
-    };
-    if (w != h) {
-        Log::fatal("skybox side textures are not square");
+    // decoded in parallel straight to half floats, so the upload doesn't need any conversion
+    HdrImage faces[6];
+    if (utils::file_exists(ENVIRONMENT_MAP_EQUIRECTANGULAR_PATH)) {
+        if (!hdr::load_equirectangular_as_cubemap(ENVIRONMENT_MAP_EQUIRECTANGULAR_PATH,
+                                                  consts::ENVIRONMENT_MAP_TEXTURE_SIZE, faces)) {
+            Log::fatal("Failed to load environment map '%s'", ENVIRONMENT_MAP_EQUIRECTANGULAR_PATH);
+        }
+    } else if (!hdr::load_cubemap_faces(ENVIRONMENT_MAP_FACE_PATHS, faces)) {
+        Log::fatal("Failed to load environment map faces");
     }
-    m_environmentMap.setImage(w, TextureFormatEnum::RGB16F, data);
-    for (int i = 0; i < 6; ++i) {
-        stbi_image_free(data[i]);
+
+    void *data[6];
+    for (u32 i = 0; i < 6; ++i) {
+        data[i] = faces[i].pixels.data();
     }
-    stbi_set_flip_vertically_on_load(1);
+    m_environmentMap.setImage(faces[0].width, TextureFormatEnum::RGB16F, data, PixelDataTypeEnum::HALF_FLOAT);
 
-    m_diffuseIrradianceCubemap.setImage(consts::DIFFUSE_IRRADIANCE_TEXTURE_SIZE, TextureFormatEnum::RGB16F);
-    m_prefilteredEnvCubemap.setImage(consts::PREFILTERED_ENVIRONMENT_MAP_TEXTURE_SIZE, TextureFormatEnum::RGB16F);
+    m_skyCaptureCubemap.setImage(consts::SKY_CAPTURE_TEXTURE_SIZE, TextureFormatEnum::RGB16F);
+    for (TextureCubemap &cubemap : m_prefilteredEnvCubemaps) {
+        cubemap.setImage(consts::PREFILTERED_ENVIRONMENT_MAP_TEXTURE_SIZE, TextureFormatEnum::RGB16F);
+    }
     m_brdfLut.setImage(consts::BRDF_LUT_TEXTURE_SIZE, consts::BRDF_LUT_TEXTURE_SIZE, TextureFormatEnum::RG16F);
-    m_hdrFrameTexture.setImage(core->gameState.renderOptions.width, core->gameState.renderOptions.height,
+    const RenderOptions &options = core->gameState.renderOptions;
+    m_hdrFrameTexture.setImage((u32)std::ceil(options.width * consts::MAX_RESOLUTION_SCALE),
+                               (u32)std::ceil(options.height * consts::MAX_RESOLUTION_SCALE),
                                TextureFormatEnum::RGB16F);
-    m_targetTexture.setImage(core->gameState.renderOptions.width, core->gameState.renderOptions.height,
-                             TextureFormatEnum::RGBA8);
+    m_hdrDepthTexture.setImage(m_hdrFrameTexture.getWidth(), m_hdrFrameTexture.getHeight(),
+                               TextureFormatEnum::DEPTH32F);
+
+    // each bloom level is half the size of the previous one, rounded up so odd sizes keep their last texels
+    u32 bloomWidth = m_hdrFrameTexture.getWidth();
+    u32 bloomHeight = m_hdrFrameTexture.getHeight();
+    for (Texture2D &mip : m_bloomMips) {
+        bloomWidth = std::max(1u, (bloomWidth + 1) / 2);
+        bloomHeight = std::max(1u, (bloomHeight + 1) / 2);
+        mip.setImage(bloomWidth, bloomHeight, TextureFormatEnum::R11F_G11F_B10F);
+    }
 
     //----------
     // dummy vao
@@ -99,15 +183,68 @@ void Renderer::init() {
         Log::fatal("Failed to generate dummy VAO");
     }
 
-    precompute();
-    updateIblProbe();
+    //---------------------------
+    // irradiance SH readback PBO
+    //---------------------------
+
+    u32 readbackSideLength = consts::IRRADIANCE_SH_READBACK_SIZE;
+    m_irradianceShReadbackData.resize(6 * readbackSideLength * readbackSideLength * 3);
+
+    glGenBuffers(1, &m_irradianceShReadbackPbo);
+    if (m_irradianceShReadbackPbo == 0) {
+        Log::fatal("Failed to generate irradiance SH readback PBO");
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, m_irradianceShReadbackPbo);
+    glBufferData(GL_PIXEL_PACK_BUFFER, m_irradianceShReadbackData.size() * sizeof(f32), nullptr, GL_STREAM_READ);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    //-------------------
+    // IBL precomputation
+    //-------------------
+
+    m_numPrefilteredEnvMipmapLevels = floor(log2(consts::PREFILTERED_ENVIRONMENT_MAP_TEXTURE_SIZE));
+
+    m_iblProbeSunDirection = core->gameState.scene.sunDirection;
+
+    u64 iblCacheKey = computeIblCacheKey();
+    ShCoefficients irradianceSh;
+    if (m_iblCache.load(iblCacheKey, m_brdfLut, m_prefilteredEnvCubemaps[m_frontProbe],
+                        m_numPrefilteredEnvMipmapLevels + 1, &irradianceSh)) {
+        setIrradianceSh(irradianceSh);
+    } else {
+        precompute();
+        updateIblProbe();
+
+        utils::create_directory(consts::CACHE_DIRECTORY);
+        m_iblCache.store(iblCacheKey, m_brdfLut, m_prefilteredEnvCubemaps[m_frontProbe],
+                         m_numPrefilteredEnvMipmapLevels + 1, m_irradianceSh);
+    }
 }
 
-void Renderer::render() {
-    renderFrame();
+void Renderer::render(f32 dt) {
+    core->shaderWatcher.update();
 
-    // blit rendered frame to default framebuffer
-    m_ctx.getFramebuffer().blitToDefaultFramebuffer(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    // the sky changed, so the probe has to follow
+    if (core->gameState.scene.sunDirection != m_iblProbeSunDirection) {
+        requestIblProbeUpdate();
+    }
+
+    if (m_iblUpdateRunning) {
+        stepIblProbeUpdate(core->gameState.renderOptions.iblUpdateBudgetMs, false);
+    }
+
+    // the frame timer encloses the timers of the passes, so it uses timestamps
+    const RenderOptions &options = core->gameState.renderOptions;
+    f32 gpuFrameMs;
+    u64 renderedWidth;
+    if (m_frameTimer.popResult(&gpuFrameMs, &renderedWidth)) {
+        m_dynamicResolution.addMeasurement(gpuFrameMs, (u32)renderedWidth, options);
+    }
+    m_dynamicResolution.update(options);
+
+    m_frameTimer.begin(m_dynamicResolution.getWidth());
+    renderFrame(dt);
+    m_frameTimer.end();
 
     // bind default framebuffer
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -117,12 +254,15 @@ void Renderer::render() {
 }
 
 void Renderer::reloadShaders() {
-    m_materialShader.reload();
+    m_materialShaders.reload();
     m_skyShader.reload();
-    m_diffuseIrradianceShader.reload();
+    m_skyCaptureShader.reload();
     m_envMapPrefilterShader.reload();
+    m_envMapPrefilterFisShader.reload();
     m_brdfLutShader.reload();
     m_tonemapShader.reload();
+    m_bloomDownsampleShader.reload();
+    m_bloomUpsampleShader.reload();
 }
 
 RenderStats Renderer::getStats() {
@@ -135,6 +275,50 @@ void Renderer::drawNVertices(u32 n) const {
     glBindVertexArray(0);
 }
 
+u64 Renderer::computeIblCacheKey() const {
+    // environment map images
+    u64 key = utils::hash_bytes(nullptr, 0);
+    std::vector<u8> bytes;
+    if (utils::load_file_to_bytes(ENVIRONMENT_MAP_EQUIRECTANGULAR_PATH, &bytes)) {
+        key = utils::hash_bytes(bytes.data(), bytes.size(), key);
+    }
+    for (const char *path : ENVIRONMENT_MAP_FACE_PATHS) {
+        if (utils::load_file_to_bytes(path, &bytes)) {
+            key = utils::hash_bytes(bytes.data(), bytes.size(), key);
+        }
+    }
+
+    // shaders used for precomputation
+    PrefilterModeEnum prefilterMode = core->gameState.renderOptions.prefilterMode;
+    u64 shaderHashes[3] = {
+        m_brdfLutShader.getSourceHash(),
+        m_skyCaptureShader.getSourceHash(),
+        prefilterMode == PrefilterModeEnum::REFERENCE ? m_envMapPrefilterShader.getSourceHash()
+        : m_envMapPrefilterFisShader.getSourceHash()
+    };
+    key = utils::hash_bytes(shaderHashes, sizeof(shaderHashes), key);
+    key = utils::hash_bytes(&prefilterMode, sizeof(prefilterMode), key);
+
+    // sky parameters
+    f32 sky[6] = {
+        m_iblProbeSunDirection.x, m_iblProbeSunDirection.y, m_iblProbeSunDirection.z,
+        SUN_DISK_RADIANCE.x, SUN_DISK_RADIANCE.y, SUN_DISK_RADIANCE.z
+    };
+    key = utils::hash_bytes(sky, sizeof(sky), key);
+
+    // intermediate and output texture sizes
+    u32 sizes[5] = {
+        consts::ENVIRONMENT_MAP_TEXTURE_SIZE,
+        consts::SKY_CAPTURE_TEXTURE_SIZE,
+        consts::IRRADIANCE_SH_READBACK_SIZE,
+        consts::PREFILTERED_ENVIRONMENT_MAP_TEXTURE_SIZE,
+        consts::BRDF_LUT_TEXTURE_SIZE
+    };
+    key = utils::hash_bytes(sizes, sizeof(sizes), key);
+
+    return key;
+}
+
 void Renderer::precompute() {
     // We want to render to the brdfLut texture
     m_ctx.setRenderTarget(m_brdfLut);
@@ -156,117 +340,745 @@ void Renderer::precompute() {
 }
 
 void Renderer::updateIblProbe() {
-    // view and projection matrices for cubemap rendering
-    glm::mat4 views[6] = {
-        glm::lookAt(glm::vec3(0, 0, 0), glm::vec3(1, 0, 0), glm::vec3(0, -1, 0)),
-        glm::lookAt(glm::vec3(0, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, -1, 0)),
-        glm::lookAt(glm::vec3(0, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, 0, 1)),
-        glm::lookAt(glm::vec3(0, 0, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, -1)),
-        glm::lookAt(glm::vec3(0, 0, 0), glm::vec3(0, 0, 1), glm::vec3(0, -1, 0)),
-        glm::lookAt(glm::vec3(0, 0, 0), glm::vec3(0, 0, -1), glm::vec3(0, -1, 0))
-    };
-    glm::mat4 proj = glm::perspective(glm::half_pi<f32>(), 1.0f, 0.01f, 10.0f);
+    // replaces a running time-sliced update, which would only produce an older result
+    beginIblProbeUpdate();
+    m_iblUpdateRestart = false;
+    stepIblProbeUpdate(0, true);
 
-    // TODO: convolution/prefiltering could be improved performance-wise
+    // this can be called outside of render(), so leave the default framebuffer bound like render() does
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
 
-    //-------------------------------
-    // diffuse irradiance convolution
-    //-------------------------------
+void Renderer::requestIblProbeUpdate() {
+    if (m_iblUpdateRunning) {
+        m_iblUpdateRestart = true;
+    } else {
+        beginIblProbeUpdate();
+    }
+}
 
-    m_ctx.setState(RenderStateBuilder()
-                   .setDepthTest(false)
-                   .build());
+f32 Renderer::getIblProbeUpdateProgress() const {
+    if (!m_iblUpdateRunning) {
+        return -1;
+    }
 
-    m_diffuseIrradianceShader.bind();
-    m_diffuseIrradianceShader.setUniform("uEnvMap", m_environmentMap);
+    // the last step waits for the SH projection
+    return (f32) m_iblUpdateItem / (f32) (get_num_ibl_work_items(m_numPrefilteredEnvMipmapLevels + 1) + 1);
+}
 
-    for (u32 face = 0; face < 6; ++face) {
-        // set current face as output color attachment
-        m_diffuseIrradianceShader.setUniform("uViewProjectionMatrix", proj * views[face]);
-        m_ctx.setRenderTarget(m_diffuseIrradianceCubemap, (RenderContext::CubemapFaceEnum)face);
-        m_ctx.clear(RenderContext::CLEAR_COLOR);
+void Renderer::beginIblProbeUpdate() {
+    // a job from an abandoned update could still be writing its result
+    waitForIrradianceShJob();
+    if (m_irradianceShReadbackFence) {
+        glDeleteSync(m_irradianceShReadbackFence);
+        m_irradianceShReadbackFence = nullptr;
+    }
 
-        // draw cube
-        drawNVertices(14);
+    // the sky stays the same for the whole update, even if the scene changes in the meantime
+    m_iblProbeSunDirection = core->gameState.scene.sunDirection;
+
+    m_iblUpdateRunning = true;
+    m_iblUpdateItem = 0;
+}
+
+bool Renderer::stepIblProbeUpdate(f32 budget_ms, bool blocking) {
+    if (!m_iblUpdateRunning) {
+        return true;
+    }
+
+    // refine the cost estimate with the timings of previous steps
+    f32 measuredMs;
+    u64 measuredCost;
+    if (m_iblUpdateTimer.popResult(&measuredMs, &measuredCost) && measuredCost > 0) {
+        m_iblMsPerCost = glm::mix(m_iblMsPerCost, measuredMs / measuredCost, 0.25f);
     }
 
-    // update mipmap for diffuse irradiance cubemap
-    m_diffuseIrradianceCubemap.generateMipmap();
+    // take as many work items as fit in the budget
+    u32 numItems = get_num_ibl_work_items(m_numPrefilteredEnvMipmapLevels + 1);
+    u32 begin = m_iblUpdateItem;
+    u32 end = begin;
+    u64 cost = 0;
+    while (end < numItems) {
+        u64 itemCost = getIblWorkItemCost(end);
+        if (!blocking && end > begin && (cost + itemCost) * m_iblMsPerCost > budget_ms) {
+            break;
+        }
+        cost += itemCost;
+        ++end;
+    }
 
-    //--------------------------
-    // prefilter environment map
-    //--------------------------
+    if (begin < end) {
+        m_ctx.setState(RenderStateBuilder()
+                       .setDepthTest(false)
+                       .build());
 
-    m_envMapPrefilterShader.bind();
-    m_envMapPrefilterShader.setUniform("uEnvMap", m_environmentMap);
+        if (!blocking) {
+            m_iblUpdateTimer.begin(cost);
+        }
 
-    // calculate mipmap levels
-    m_numPrefilteredEnvMipmapLevels = floor(log2(consts::PREFILTERED_ENVIRONMENT_MAP_TEXTURE_SIZE));
+        // consecutive faces of the same mip level are rendered with one draw
+        u32 item = begin;
+        while (item < end) {
+            if (item < IBL_READBACK_ITEM) {
+                u32 faceEnd = std::min(end, IBL_READBACK_ITEM);
+
+                m_skyCaptureShader.bind();
+                m_skyCaptureShader.setUniform("uEnvMap", m_environmentMap);
+                m_skyCaptureShader.setUniform("uSunDirection", m_iblProbeSunDirection);
+                m_skyCaptureShader.setUniform("uSunRadiance", SUN_DISK_RADIANCE);
+                renderCubemapLayered(m_skyCaptureShader, m_skyCaptureCubemap, 0, item - IBL_CAPTURE_ITEMS_BEGIN,
+                                     faceEnd - IBL_CAPTURE_ITEMS_BEGIN);
+
+                item = faceEnd;
+            } else if (item == IBL_READBACK_ITEM) {
+                // filtered importance sampling reads the mip levels, SH projection reads a small one
+                m_skyCaptureCubemap.generateMipmap();
+                startIrradianceShReadback();
 
-    for (u32 level = 0; level <= m_numPrefilteredEnvMipmapLevels; ++level) {
-        // set current roughness for prefilter
-        f32 roughness = (f32) level / (f32) (m_numPrefilteredEnvMipmapLevels);
-        m_envMapPrefilterShader.setUniform("uRoughness", roughness);
+                ++item;
+            } else {
+                u32 level = (item - IBL_PREFILTER_ITEMS_BEGIN) / 6;
+                u32 face = (item - IBL_PREFILTER_ITEMS_BEGIN) % 6;
+                u32 faceEnd = std::min(6u, face + (end - item));
 
-        for (u32 face = 0; face < 6; ++face) {
-            // set current face as output color attachment
-            m_envMapPrefilterShader.setUniform("uViewProjectionMatrix", proj * views[face]);
-            m_ctx.setRenderTarget(m_prefilteredEnvCubemap, (RenderContext::CubemapFaceEnum)face, level);
-            m_ctx.clear(RenderContext::CLEAR_COLOR);
+                Shader &shader = bindPrefilterShader(level);
+                renderCubemapLayered(shader, getBackPrefilteredEnvCubemap(), level, face, faceEnd);
 
-            // draw cube
-            drawNVertices(14);
+                item += faceEnd - face;
+            }
+        }
+
+        if (!blocking) {
+            m_iblUpdateTimer.end();
         }
+
+        m_iblUpdateItem = end;
+    }
+
+    if (m_iblUpdateItem < numItems || !finishIrradianceSh(blocking)) {
+        return false;
     }
+
+    // everything is ready, so shading switches to the new probe all at once
+    m_frontProbe = 1 - m_frontProbe;
+    setIrradianceSh(m_pendingIrradianceSh);
+    m_iblUpdateRunning = false;
+
+    if (m_iblUpdateRestart) {
+        m_iblUpdateRestart = false;
+        beginIblProbeUpdate();
+    }
+
+    return true;
 }
 
-void Renderer::renderFrame() {
-    m_ctx.setRenderTarget(m_hdrFrameTexture);
-    m_ctx.clear(RenderContext::CLEAR_COLOR | RenderContext::CLEAR_DEPTH);
+u64 Renderer::getIblWorkItemCost(u32 item) const {
+    u64 captureSideLength = m_skyCaptureCubemap.getSideLength();
 
-    // draw scene
-    {
-        m_renderStats = {};
+    if (item < IBL_READBACK_ITEM) {
+        return captureSideLength * captureSideLength;
+    }
 
-        m_ctx.setState(RenderStateBuilder()
-                       .setDepthTest(true)
-                       .build());
+    if (item == IBL_READBACK_ITEM) {
+        // mipmap generation touches every face
+        return 6 * captureSideLength * captureSideLength;
+    }
+
+    u32 level = (item - IBL_PREFILTER_ITEMS_BEGIN) / 6;
+    u64 sideLength = std::max(1u, getBackPrefilteredEnvCubemap().getSideLength() >> level);
+    u64 numSamples = REFERENCE_PREFILTER_SAMPLE_COUNT;
+    if (core->gameState.renderOptions.prefilterMode == PrefilterModeEnum::FILTERED_IMPORTANCE_SAMPLING) {
+        numSamples = prefilter::get_sample_count(get_prefilter_roughness(level, m_numPrefilteredEnvMipmapLevels));
+    }
+
+    return sideLength * sideLength * numSamples;
+}
+
+Shader &Renderer::bindPrefilterShader(u32 level) {
+    bool useFis = core->gameState.renderOptions.prefilterMode == PrefilterModeEnum::FILTERED_IMPORTANCE_SAMPLING;
+    Shader &shader = useFis ? m_envMapPrefilterFisShader : m_envMapPrefilterShader;
+    shader.bind();
+    shader.setUniform("uEnvMap", m_skyCaptureCubemap);
+
+    f32 roughness = get_prefilter_roughness(level, m_numPrefilteredEnvMipmapLevels);
+    if (useFis) {
+        PrefilterSamples samples = prefilter::generate_samples(roughness, m_skyCaptureCubemap.getSideLength());
+        m_prefilterSamplesBuffer.setData(&samples, sizeof(samples));
+        shader.setUniformBlock("PrefilterSamples", m_prefilterSamplesBuffer);
+    } else {
+        shader.setUniform("uRoughness", roughness);
+    }
+
+    return shader;
+}
+
+void Renderer::renderCubemapLayered(Shader &shader, const TextureCubemap &target, u32 level, u32 face_begin,
+                                    u32 face_end) {
+    m_ctx.setRenderTargetLayered(target, level);
+
+    // fullscreen quad, the geometry shader emits it once per face
+    shader.setUniform("uFaceBegin", (s32) face_begin);
+    shader.setUniform("uFaceEnd", (s32) face_end);
+    drawNVertices(4);
+}
+
+void Renderer::startIrradianceShReadback() {
+    u32 level = 0;
+    while ((m_skyCaptureCubemap.getSideLength() >> level) > consts::IRRADIANCE_SH_READBACK_SIZE) {
+        ++level;
+    }
+
+    // with a pack buffer bound, the data pointer is an offset into it
+    size_t faceSize = m_irradianceShReadbackData.size() / 6 * sizeof(f32);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, m_irradianceShReadbackPbo);
+    for (u32 face = 0; face < 6; ++face) {
+        m_skyCaptureCubemap.getFaceImage(face, level, TextureFormatEnum::RGB32F, (void *) (face * faceSize));
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    m_irradianceShReadbackFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    // make sure the fence gets to the GPU, polling it later doesn't flush
+    glFlush();
+}
+
+bool Renderer::finishIrradianceSh(bool blocking) {
+    if (m_irradianceShReadbackFence) {
+        GLenum result;
+        do {
+            result = glClientWaitSync(m_irradianceShReadbackFence, blocking ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+                                      blocking ? 1000000000 : 0);
+        } while (blocking && result == GL_TIMEOUT_EXPIRED);
+
+        if (result == GL_TIMEOUT_EXPIRED) {
+            return false;
+        }
+        if (result == GL_WAIT_FAILED) {
+            Log::warn("Failed to wait for irradiance SH readback");
+        }
+
+        glDeleteSync(m_irradianceShReadbackFence);
+        m_irradianceShReadbackFence = nullptr;
+
+        size_t size = m_irradianceShReadbackData.size() * sizeof(f32);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, m_irradianceShReadbackPbo);
+        void *mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+        if (mapped) {
+            std::memcpy(m_irradianceShReadbackData.data(), mapped, size);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        } else {
+            Log::warn("Failed to map irradiance SH readback PBO");
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        // project on a worker thread so the render thread can keep going
+        m_irradianceShJobRunning.store(true, std::memory_order_relaxed);
+        core->jobSystem.submit([this]() {
+            u32 sideLength = consts::IRRADIANCE_SH_READBACK_SIZE;
+            const f32 *faces[6];
+            for (u32 face = 0; face < 6; ++face) {
+                faces[face] = m_irradianceShReadbackData.data() + face * sideLength * sideLength * 3;
+            }
+
+            m_pendingIrradianceSh = sh::radiance_to_irradiance(sh::project_cubemap(faces, sideLength));
+            m_irradianceShJobRunning.store(false, std::memory_order_release);
+        });
+    }
+
+    if (blocking) {
+        waitForIrradianceShJob();
+    }
+
+    return !m_irradianceShJobRunning.load(std::memory_order_acquire);
+}
+
+void Renderer::waitForIrradianceShJob() {
+    while (m_irradianceShJobRunning.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+}
+
+void Renderer::setIrradianceSh(const ShCoefficients &irradiance_sh) {
+    m_irradianceSh = irradiance_sh;
+
+    // std140 pads each vec3 array element to a vec4
+    glm::vec4 packed[9];
+    for (u32 i = 0; i < 9; ++i) {
+        packed[i] = glm::vec4(m_irradianceSh.coefficients[i], 0);
+    }
+    m_irradianceShBuffer.setData(packed, sizeof(packed));
+}
+
+void Renderer::setMaterialFrameUniforms(Shader &shader, bool first_bind) {
+    shader.setUniformBlock("IrradianceSh", m_irradianceShBuffer);
+    shader.setUniform("uPrefilteredEnvironmentMap", getFrontPrefilteredEnvCubemap());
+    shader.setUniform("uBrdfLut", m_brdfLut);
+    m_clusteredLighting.bindTextures(shader);
+    m_shadowMaps.bindTextures(shader);
+
+    if (!first_bind) {
+        return;
+    }
+
+    m_clusteredLighting.setUniforms(shader, m_dynamicResolution.getWidth(), m_dynamicResolution.getHeight());
+    m_shadowMaps.setUniforms(shader);
+
+    shader.setUniform("uNumPrefilteredEnvMipmapLevels", m_numPrefilteredEnvMipmapLevels);
+    shader.setUniform("uSunDirection", core->gameState.scene.sunDirection);
+    shader.setUniform("uSunIlluminance", SUN_ILLUMINANCE);
+    shader.setUniform("uViewProjectionMatrix", core->gameState.camera.getViewProjectionMatrix());
+    shader.setUniform("uCameraPosition", core->gameState.camera.getPosition());
+}
+
+void Renderer::collectDrawItems() {
+    m_drawItems.clear();
+    m_drawEntities.clear();
+
+    const std::vector<Entity> &entities = core->gameState.scene.getEntities();
+    m_entityLods.resize(entities.size(), 0);
+
+    for (u32 e = 0; e < entities.size(); ++e) {
+        const Entity &entity = entities[e];
+        if (!entity.active) {
+            continue;
+        }
+
+        Model &model = *entity.model;
+        model.updateNodeTransforms();
+
+        // the level of detail is selected once for the whole model, so its parts switch together
+        DrawEntity drawEntity = {};
+        drawEntity.sceneIndex = e;
+        drawEntity.modelMatrix = transform_to_matrix(entity.transform);
+        drawEntity.isStatic = entity.isStatic;
+        drawEntity.castsShadows = entity.castsShadows;
+
+        transform_bounds(drawEntity.modelMatrix, model.getMin(), model.getMax(), &drawEntity.boundsMin,
+                         &drawEntity.boundsMax);
 
-        m_materialShader.bind();
-        m_materialShader.setUniform("uDiffuseIrradianceMap", m_diffuseIrradianceCubemap);
-        m_materialShader.setUniform("uPrefilteredEnvironmentMap", m_prefilteredEnvCubemap);
-        m_materialShader.setUniform("uNumPrefilteredEnvMipmapLevels", m_numPrefilteredEnvMipmapLevels);
-        m_materialShader.setUniform("uBrdfLut", m_brdfLut);
-        m_materialShader.setUniform("uSunDirection", core->gameState.scene.sunDirection);
-        m_materialShader.setUniform("uViewProjectionMatrix", core->gameState.camera.getViewProjectionMatrix());
-        m_materialShader.setUniform("uCameraPosition", core->gameState.camera.getPosition());
-
-        // render entities
-        for (const Entity &entity : core->gameState.scene.getEntities()) {
-            if (!entity.active) {
+        u32 lod = core->gameState.renderOptions.meshLods ? selectLod(model, drawEntity, m_entityLods[e]) : 0;
+        m_staticLodChanges += entity.isStatic && lod != m_entityLods[e];
+        m_entityLods[e] = lod;
+
+        // every node with meshes is drawn as its own entity, nodes that place the same mesh share its buffers
+        glm::mat4 entityMatrix = drawEntity.modelMatrix;
+        u32 sceneItemOffset = 0;
+        for (u32 n = 0; n < model.getNumNodes(); ++n) {
+            u32 numMeshes = model.getNodeNumMeshes(n);
+            if (numMeshes == 0) {
                 continue;
             }
 
-            glm::mat4 modelMatrix = transform_to_matrix(entity.transform);
-            m_materialShader.setUniform("uModelMatrix", modelMatrix);
-            m_materialShader.setUniform("uNormalMatrix", glm::transpose(glm::inverse(modelMatrix)));
+            drawEntity.modelMatrix = entityMatrix * model.getNodeTransform(n);
+            drawEntity.normalMatrix = glm::transpose(glm::inverse(glm::mat3(drawEntity.modelMatrix)));
+            drawEntity.boundsMin = glm::vec3(INFINITY);
+            drawEntity.boundsMax = glm::vec3(-INFINITY);
+            drawEntity.sceneItemOffset = sceneItemOffset;
+            drawEntity.firstItem = m_drawItems.size();
+            drawEntity.numItems = numMeshes;
+            sceneItemOffset += numMeshes;
+
+            u32 entityIndex = m_drawEntities.size();
+            for (u32 i = 0; i < numMeshes; ++i) {
+                const Mesh &mesh = model.getNodeMesh(n, i);
+                DrawItem item = {};
+                item.mesh = &mesh;
+                item.entityIndex = entityIndex;
+                item.lod = std::min(lod, mesh.getNumLods() - 1);
+                transform_bounds(drawEntity.modelMatrix, mesh.getMin(), mesh.getMax(), &item.boundsMin,
+                                 &item.boundsMax);
+                drawEntity.boundsMin = glm::min(drawEntity.boundsMin, item.boundsMin);
+                drawEntity.boundsMax = glm::max(drawEntity.boundsMax, item.boundsMax);
+                m_drawItems.push_back(item);
+                m_renderStats.reducedLodItems += item.lod > 0;
+            }
+            m_drawEntities.emplace_back(drawEntity);
+        }
+    }
+}
+
+u32 Renderer::selectLod(const Model &model, const DrawEntity &entity, u32 previous_lod) const {
+    u32 numLods = model.getNumLods();
+    if (numLods == 1) {
+        return 0;
+    }
+
+    const Camera &camera = core->gameState.camera;
+    const RenderOptions &options = core->gameState.renderOptions;
+
+    // model space errors, which include node scales, are scaled by the largest axis scale of the entity
+    glm::mat3 basis = glm::mat3(entity.modelMatrix);
+    f32 scale = glm::max(glm::length(basis[0]), glm::max(glm::length(basis[1]), glm::length(basis[2])));
+
+    // pixels per world unit at the closest point of the bounding sphere
+    glm::vec3 center = (entity.boundsMin + entity.boundsMax) * 0.5f;
+    f32 radius = glm::length(entity.boundsMax - center);
+    f32 distance = glm::max(glm::length(center - camera.getPosition()) - radius, camera.getNearPlane());
+    f32 pixelsPerUnit = m_dynamicResolution.getHeight() / (2.0f * std::tan(camera.getFov() * 0.5f) * distance);
+
+    // coarsest level that stays below the threshold, going coarser than last frame needs some margin so that
+    // entities at a level boundary don't switch back and forth
+    u32 lod = 0;
+    for (u32 i = 1; i < numLods; ++i) {
+        f32 threshold = options.lodErrorPixels * (i > previous_lod ? consts::LOD_HYSTERESIS : 1.0f);
+        if (model.getLodError(i) * scale * pixelsPerUnit > threshold) {
+            break;
+        }
+        lod = i;
+    }
+
+    return lod;
+}
+
+void Renderer::cullOccluded() {
+    if (!core->gameState.renderOptions.occlusionCulling) {
+        return;
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    m_softwareOcclusion.update(core->gameState.camera, m_drawEntities, m_drawItems);
 
-            // render each mesh in model
-            for (auto &mesh : entity.model->getMeshes()) {
-                m_materialShader.setUniform("uMaterial.albedo", *mesh.getMaterial().albedoTexture);
-                m_materialShader.setUniform("uMaterial.normal", *mesh.getMaterial().normalTexture);
-                m_materialShader.setUniform("uMaterial.metallic", *mesh.getMaterial().metallicTexture);
-                m_materialShader.setUniform("uMaterial.metallic_scale", mesh.getMaterial().metallicScale);
-                m_materialShader.setUniform("uMaterial.roughness", *mesh.getMaterial().roughnessTexture);
-                m_materialShader.setUniform("uMaterial.roughness_scale", mesh.getMaterial().roughnessScale);
+    // meshes of an entity are only tested on their own when the entity as a whole is visible
+    for (DrawEntity &entity : m_drawEntities) {
+        entity.occluded = m_softwareOcclusion.isOccluded(entity.boundsMin, entity.boundsMax);
 
-                mesh.draw();
+        for (u32 i = entity.firstItem; i < entity.firstItem + entity.numItems; ++i) {
+            DrawItem &item = m_drawItems[i];
+            item.occluded = entity.occluded ||
+                            (entity.numItems > 1 && m_softwareOcclusion.isOccluded(item.boundsMin, item.boundsMax));
+            m_renderStats.occludedItems += item.occluded;
+        }
+    }
+
+    m_renderStats.occluders = m_softwareOcclusion.getNumOccluders();
+    m_renderStats.occluderTriangles = m_softwareOcclusion.getNumTriangles();
+    m_renderStats.occluderRasterizationMs = m_softwareOcclusion.getUpdateMilliseconds();
+    std::chrono::duration<f32, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+    m_renderStats.occlusionCullingMs = elapsed.count();
+}
+
+void Renderer::cullMeshlets() {
+    auto startTime = std::chrono::steady_clock::now();
+    const RenderOptions &options = core->gameState.renderOptions;
+    const Camera &camera = core->gameState.camera;
+    glm::mat4 viewProjection = camera.getViewProjectionMatrix();
+
+    // every item gets room for as many ranges as it has meshlets, at least one for items without any
+    u32 numRanges = 0;
+    for (DrawItem &item : m_drawItems) {
+        item.firstRange = numRanges;
+        numRanges += std::max(item.mesh->getLod(item.lod).numMeshlets, 1u);
+    }
+    m_rangeCounts.resize(numRanges);
+    m_rangeOffsets.resize(numRanges);
+
+    std::atomic<u32> numTested(0);
+    std::atomic<u32> numCulled(0);
+    core->jobSystem.parallelFor(m_drawEntities.size(), consts::MESHLET_CULL_ENTITIES_PER_JOB, [&](u32 begin, u32 end) {
+        u32 tested = 0;
+        u32 culled = 0;
+
+        for (u32 e = begin; e < end; ++e) {
+            const DrawEntity &entity = m_drawEntities[e];
+            MeshletCullParams params = meshlet::get_cull_params(viewProjection, entity.modelMatrix,
+                                                                camera.getPosition());
+
+            for (u32 i = entity.firstItem; i < entity.firstItem + entity.numItems; ++i) {
+                DrawItem &item = m_drawItems[i];
+                const MeshLod &lod = item.mesh->getLod(item.lod);
+
+                if (item.occluded) {
+                    item.numRanges = 0;
+                    continue;
+                }
+
+                if (!options.meshletCulling || lod.numMeshlets == 0) {
+                    m_rangeCounts[item.firstRange] = lod.numIndices;
+                    m_rangeOffsets[item.firstRange] = (const void *) ((uintptr_t) lod.firstIndex * sizeof(u32));
+                    item.numRanges = 1;
+                    continue;
+                }
+
+                u32 itemCulled;
+                bool coneCulling = !item.mesh->getMaterial().doubleSided;
+                item.numRanges = meshlet::cull(item.mesh->getMeshlets(), lod.firstMeshlet, lod.numMeshlets, params,
+                                               coneCulling, &m_rangeCounts[item.firstRange],
+                                               &m_rangeOffsets[item.firstRange], &itemCulled);
+                tested += lod.numMeshlets;
+                culled += itemCulled;
+            }
+        }
+
+        numTested += tested;
+        numCulled += culled;
+    });
+
+    m_renderStats.meshletsTested = numTested;
+    m_renderStats.meshletsCulled = numCulled;
+    std::chrono::duration<f32, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+    m_renderStats.meshletCullingMs = elapsed.count();
+}
+
+void Renderer::renderDepthPrepass() {
+    m_ctx.setState(RenderStateBuilder()
+                   .setDepthTest(true)
+                   .setColorWrite(false)
+                   .build());
+
+    m_depthEntities.resize(m_drawEntities.size());
+    for (u32 i = 0; i < m_depthEntities.size(); ++i) {
+        m_depthEntities[i] = i;
+    }
+
+    renderDepth(core->gameState.camera.getViewProjectionMatrix(), m_depthEntities, true);
+}
+
+void Renderer::renderDepth(const glm::mat4 &view_projection, const std::vector<u32> &entities,
+                           bool visible_meshlets) {
+    // plain opaque meshes first, they only need positions and share a program
+    for (u32 key = 0; key <= DEPTH_ALPHA_TEST; key += DEPTH_ALPHA_TEST) {
+        Shader *shader = nullptr;
+
+        for (u32 entityIndex : entities) {
+            const DrawEntity &entity = m_drawEntities[entityIndex];
+            bool modelMatrixSet = false;
+
+            for (u32 i = entity.firstItem; i < entity.firstItem + entity.numItems; ++i) {
+                const DrawItem &item = m_drawItems[i];
+                const Mesh &mesh = *item.mesh;
+                bool alphaTested = (mesh.getMaterialVariantKey() & MATERIAL_HAS_ALBEDO_MAP) != 0;
+                if (alphaTested != (key == DEPTH_ALPHA_TEST) || (visible_meshlets && item.numRanges == 0)) {
+                    continue;
+                }
+
+                if (!shader) {
+                    shader = &m_depthShaders.get(key);
+                    shader->bind();
+                    shader->setUniform("uViewProjectionMatrix", view_projection);
+                    ++m_renderStats.shaderBinds;
+                }
+
+                if (!modelMatrixSet) {
+                    shader->setUniform("uModelMatrix", entity.modelMatrix);
+                    modelMatrixSet = true;
+                }
+
+                if (alphaTested) {
+                    shader->setUniform("uAlbedo", *mesh.getMaterial().albedoTexture);
+                }
+
+                if (visible_meshlets) {
+                    const s32 *counts = &m_rangeCounts[item.firstRange];
+                    const void *const *offsets = &m_rangeOffsets[item.firstRange];
+                    if (item.occlusionQuery != 0) {
+                        m_ctx.beginConditionalRender(item.occlusionQuery);
+                    }
+                    if (alphaTested) {
+                        mesh.drawRanges(counts, offsets, item.numRanges);
+                    } else {
+                        mesh.drawPositionRanges(counts, offsets, item.numRanges);
+                    }
+                    if (item.occlusionQuery != 0) {
+                        m_ctx.endConditionalRender();
+                    }
+                    for (u32 r = 0; r < item.numRanges; ++r) {
+                        m_renderStats.verticesRendered += counts[r];
+                    }
+                } else {
+                    if (alphaTested) {
+                        mesh.draw(item.lod);
+                    } else {
+                        mesh.drawPositions(item.lod);
+                    }
+                    m_renderStats.verticesRendered += mesh.getNumIndices(item.lod);
+                }
 
                 ++m_renderStats.drawCalls;
-                m_renderStats.verticesRendered += mesh.getNumVertices();
             }
         }
     }
+}
+
+void Renderer::renderShadowMaps() {
+    const RenderOptions &options = core->gameState.renderOptions;
+    // static casters are drawn at the level of detail picked for the camera, so changing it redraws cached cascades
+    m_shadowMaps.update(core->gameState.camera, core->gameState.scene.sunDirection, options, m_drawEntities,
+                        core->gameState.scene.getStaticVersion() + m_staticLodChanges);
+
+    const std::vector<ShadowPass> &passes = m_shadowMaps.getPasses();
+    if (passes.empty()) {
+        m_renderStats.shadowMs = 0;
+        return;
+    }
+
+    // casters between the sun and a cascade are clamped to its near plane instead of being clipped
+    m_ctx.setState(RenderStateBuilder()
+                   .setDepthTest(true)
+                   .setColorWrite(false)
+                   .setDepthClamp(true)
+                   .build());
+
+    m_shadowTimer.begin();
+    for (const ShadowPass &pass : passes) {
+        m_shadowMaps.beginPass(pass);
+        renderDepth(pass.viewProjection, pass.casters, false);
+    }
+    m_shadowTimer.end();
+
+    m_renderStats.shadowPasses = passes.size();
+    m_renderStats.shadowMs = m_shadowTimer.getMilliseconds();
+}
+
+void Renderer::renderMaterials() {
+    // each mesh is drawn with the permutation of material.frag that its material needs
+    Shader *shader = nullptr;
+    std::vector<Shader *> boundThisFrame;
+    u32 entityIndex = ~0u;
+    u32 materialId = ~0u;
+
+    // items keep their order within a material, so entities stay together there
+    m_materialDrawOrder.clear();
+    for (u32 i = 0; i < m_drawItems.size(); ++i) {
+        const Mesh &mesh = *m_drawItems[i].mesh;
+        if (m_drawItems[i].numRanges != 0) {
+            m_materialDrawOrder.push_back((u64)mesh.getMaterialVariantKey() << 56u |
+                                          (u64)(mesh.getMaterialId() & 0xffffffu) << 32u | i);
+        }
+    }
+    std::sort(m_materialDrawOrder.begin(), m_materialDrawOrder.end());
+
+    for (u64 key : m_materialDrawOrder) {
+        const DrawItem &item = m_drawItems[(u32)key];
+        const Mesh &mesh = *item.mesh;
+        u32 variantKey = mesh.getMaterialVariantKey();
+        Shader &variant = m_materialShaders.get(variantKey);
+        if (&variant != shader) {
+            shader = &variant;
+            shader->bind();
+            ++m_renderStats.shaderBinds;
+
+            bool firstBind = std::find(boundThisFrame.begin(), boundThisFrame.end(), shader) ==
+                             boundThisFrame.end();
+            if (firstBind) {
+                boundThisFrame.push_back(shader);
+            }
+            setMaterialFrameUniforms(*shader, firstBind);
+            entityIndex = ~0u;
+            materialId = ~0u;
+        }
+
+        if (item.entityIndex != entityIndex) {
+            entityIndex = item.entityIndex;
+            shader->setUniform("uModelMatrix", m_drawEntities[entityIndex].modelMatrix);
+            shader->setUniform("uNormalMatrix", m_drawEntities[entityIndex].normalMatrix);
+        }
+
+        // identical materials share an id, so their textures and scales are only set once
+        if (mesh.getMaterialId() != materialId) {
+            materialId = mesh.getMaterialId();
+            ++m_renderStats.materialBinds;
+
+            const Material &material = mesh.getMaterial();
+            if (variantKey & MATERIAL_HAS_ALBEDO_MAP) {
+                shader->setUniform("uMaterial.albedo", *material.albedoTexture);
+            }
+            if (variantKey & MATERIAL_HAS_NORMAL_MAP) {
+                shader->setUniform("uMaterial.normal", *material.normalTexture);
+            }
+            if (variantKey & MATERIAL_HAS_PACKED_ORM) {
+                shader->setUniform("uMaterial.metallic_roughness", *material.metallicRoughnessTexture);
+            } else {
+                if (!(variantKey & MATERIAL_METALLIC_CONST)) {
+                    shader->setUniform("uMaterial.metallic", *material.metallicTexture);
+                }
+                if (!(variantKey & MATERIAL_ROUGHNESS_CONST)) {
+                    shader->setUniform("uMaterial.roughness", *material.roughnessTexture);
+                }
+            }
+            shader->setUniform("uMaterial.metallic_scale", material.metallicScale);
+            shader->setUniform("uMaterial.roughness_scale", material.roughnessScale);
+        }
+
+        // the depth prepass waited on the same query, so both passes agree on what is drawn
+        if (item.occlusionQuery != 0) {
+            m_ctx.beginConditionalRender(item.occlusionQuery);
+            ++m_renderStats.conditionalDraws;
+        }
+        mesh.drawRanges(&m_rangeCounts[item.firstRange], &m_rangeOffsets[item.firstRange], item.numRanges);
+        if (item.occlusionQuery != 0) {
+            m_ctx.endConditionalRender();
+        }
+
+        ++m_renderStats.drawCalls;
+        for (u32 r = 0; r < item.numRanges; ++r) {
+            m_renderStats.verticesRendered += m_rangeCounts[item.firstRange + r];
+        }
+    }
+}
+
+void Renderer::renderFrame(f32 dt) {
+    m_renderStats = {};
+    collectDrawItems();
+    cullOccluded();
+    cullMeshlets();
+
+    // large meshes that were hidden last frame are skipped by the GPU
+    if (core->gameState.renderOptions.gpuOcclusionQueries) {
+        m_occlusionQueries.assignQueries(core->gameState.camera, m_drawEntities, &m_drawItems);
+    } else {
+        m_occlusionQueries.reset();
+    }
+
+    // shadow maps use their own render targets, so they go before the frame target is bound
+    renderShadowMaps();
+
+    // depth is a texture, so that the occlusion queries can build their depth pyramid from it
+    m_ctx.setRenderTarget(m_hdrFrameTexture, m_hdrDepthTexture);
+    m_ctx.setViewport(m_dynamicResolution.getWidth(), m_dynamicResolution.getHeight());
+    m_ctx.clear(RenderContext::CLEAR_COLOR | RenderContext::CLEAR_DEPTH);
+
+    // draw scene
+    {
+        m_clusteredLighting.update(core->gameState.camera, core->gameState.scene.lights);
+
+        if (core->gameState.renderOptions.depthPrepass) {
+            m_depthPrepassTimer.begin();
+            renderDepthPrepass();
+            m_depthPrepassTimer.end();
+
+            // depth is final already, only the visible fragment of each pixel gets shaded
+            m_ctx.setState(RenderStateBuilder()
+                           .setDepthTest(true)
+                           .setDepthWrite(false)
+                           .setDepthFunc(DepthFuncEnum::EQUAL)
+                           .build());
+        } else {
+            m_ctx.setState(RenderStateBuilder()
+                           .setDepthTest(true)
+                           .build());
+        }
+
+        m_shadingTimer.begin();
+        m_shadedSampleCounter.begin();
+        renderMaterials();
+        m_shadedSampleCounter.end();
+        m_shadingTimer.end();
+
+        const RenderOptions &options = core->gameState.renderOptions;
+        m_renderStats.depthPrepassMs = options.depthPrepass ? m_depthPrepassTimer.getMilliseconds() : 0.0f;
+        m_renderStats.shadingMs = m_shadingTimer.getMilliseconds();
+        m_renderStats.shadedSamples = m_shadedSampleCounter.getSamples();
+        u32 numPixels = m_dynamicResolution.getWidth() * m_dynamicResolution.getHeight();
+        m_renderStats.overdraw = (f32)m_renderStats.shadedSamples / (f32)numPixels;
+        m_renderStats.materialPermutations = m_materialShaders.getNumCompiled();
+        m_renderStats.lights = m_clusteredLighting.getNumLights();
+        m_renderStats.clusterLightIndices = m_clusteredLighting.getNumLightIndices();
+        m_renderStats.lightAssignmentMs = m_clusteredLighting.getUpdateMilliseconds();
+        m_renderStats.gpuFrameMs = m_dynamicResolution.getGpuFrameMs();
+        m_renderStats.resolutionScale = m_dynamicResolution.getScale();
+        m_renderStats.renderWidth = m_dynamicResolution.getWidth();
+        m_renderStats.renderHeight = m_dynamicResolution.getHeight();
+    }
 
     // draw sky
     {
@@ -282,21 +1094,165 @@ void Renderer::renderFrame() {
         m_skyShader.bind();
         m_skyShader.setUniform("uViewProjectionMatrix", skyboxCamera.getViewProjectionMatrix());
         m_skyShader.setUniform("uEnvMap", m_environmentMap);
+        m_skyShader.setUniform("uSunDirection", core->gameState.scene.sunDirection);
+        m_skyShader.setUniform("uSunRadiance", SUN_DISK_RADIANCE);
 
         drawNVertices(14);
     }
 
-    // tonemap
+    // test large meshes against the finished depth for the next frame
+    if (core->gameState.renderOptions.gpuOcclusionQueries) {
+        glm::uvec2 region = glm::uvec2(m_dynamicResolution.getWidth(), m_dynamicResolution.getHeight());
+        m_occlusionQueries.issueQueries(m_ctx, m_hdrDepthTexture, region, core->gameState.camera, m_drawEntities,
+                                        m_drawItems);
+
+        m_renderStats.occlusionQueries = m_occlusionQueries.getNumQueries();
+        m_renderStats.occlusionQueryMs = m_occlusionQueries.getMilliseconds();
+    }
+
+    // post processing
     {
-        m_ctx.setRenderTarget(m_targetTexture);
+        const RenderOptions &options = core->gameState.renderOptions;
+        glm::uvec2 region = glm::uvec2(m_dynamicResolution.getWidth(), m_dynamicResolution.getHeight());
+        f32 exposure = core->gameState.camera.getExposure();
+        if (options.autoExposure) {
+            m_autoExposure.update(m_ctx, m_hdrFrameTexture, region, dt, options);
+            exposure = m_autoExposure.getExposure();
+
+            m_renderStats.averageLuminance = m_autoExposure.getAverageLuminance();
+            m_renderStats.autoExposureMs = m_autoExposure.getMilliseconds();
+        }
+        m_renderStats.exposure = exposure;
+
+        if (options.bloom) {
+            renderBloom();
+        }
+        if (options.colorGrading) {
+            updateColorGradingLut();
+        }
+
+        m_ctx.setDefaultRenderTarget(options.width, options.height);
         m_ctx.setState(RenderStateBuilder()
                        .setDepthTest(false)
                        .build());
 
         m_tonemapShader.bind();
+        // the scene only covers part of the frame texture, it's upscaled to the window here
+        glm::vec2 imageSize = glm::vec2(m_hdrFrameTexture.getWidth(), m_hdrFrameTexture.getHeight());
         m_tonemapShader.setUniform("uImage", m_hdrFrameTexture);
-        m_tonemapShader.setUniform("uExposure", core->gameState.camera.getExposure());
+        m_tonemapShader.setUniform("uImageSize", imageSize);
+        m_tonemapShader.setUniform("uViewportSize", glm::vec2(region));
+        m_tonemapShader.setUniform("uExposure", exposure);
+
+        m_tonemapShader.setUniform("uBloom", (s32)options.bloom);
+        if (options.bloom) {
+            m_tonemapShader.setUniform("uBloomTexture", m_bloomMips[0]);
+            m_tonemapShader.setUniform("uBloomSize", glm::vec2(m_bloomMips[0].getWidth(), m_bloomMips[0].getHeight()));
+            m_tonemapShader.setUniform("uBloomRegion", glm::vec2(getBloomRegion(0)));
+            m_tonemapShader.setUniform("uBloomIntensity", options.bloomIntensity);
+        }
+
+        m_tonemapShader.setUniform("uColorGrading", (s32)options.colorGrading);
+        if (options.colorGrading) {
+            m_tonemapShader.setUniform("uColorGradingLut", m_colorGradingLut);
+            m_tonemapShader.setUniform("uColorGradingLutSize", (f32)m_colorGradingLut.getSideLength());
+        }
+
+        m_tonemapShader.setUniform("uDithering", (s32)options.dithering);
 
         drawNVertices(4);
     }
 }
+
+glm::uvec2 Renderer::getBloomRegion(u32 mip) const {
+    glm::uvec2 region = glm::uvec2(m_dynamicResolution.getWidth(), m_dynamicResolution.getHeight());
+    for (u32 i = 0; i <= mip; ++i) {
+        region = glm::max(glm::uvec2(1), (region + 1u) / 2u);
+    }
+    return region;
+}
+
+void Renderer::renderBloom() {
+    m_ctx.setState(RenderStateBuilder()
+                   .setDepthTest(false)
+                   .build());
+
+    // each downsample reads 4x4 texels of the level above with five bilinear taps
+    m_bloomDownsampleShader.bind();
+    for (u32 mip = 0; mip < consts::BLOOM_NUM_MIPS; ++mip) {
+        const Texture2D &source = mip == 0 ? m_hdrFrameTexture : m_bloomMips[mip - 1];
+        glm::uvec2 sourceRegion = mip == 0 ? glm::uvec2(m_dynamicResolution.getWidth(),
+                                                        m_dynamicResolution.getHeight())
+                                           : getBloomRegion(mip - 1);
+        glm::uvec2 region = getBloomRegion(mip);
+
+        m_ctx.setColorRenderTarget(m_bloomMips[mip]);
+        m_ctx.setViewport(region.x, region.y);
+
+        m_bloomDownsampleShader.setUniform("uSource", source);
+        m_bloomDownsampleShader.setUniform("uSourceSize", glm::vec2(source.getWidth(), source.getHeight()));
+        m_bloomDownsampleShader.setUniform("uSourceRegion", glm::vec2(sourceRegion));
+        m_bloomDownsampleShader.setUniform("uKarisAverage", (s32)(mip == 0));
+
+        drawNVertices(4);
+    }
+
+    // walk back up, adding each level onto the next larger one so the first level holds the sum of all of them
+    m_ctx.setState(RenderStateBuilder()
+                   .setDepthTest(false)
+                   .setBlendMode(BlendModeEnum::ADDITIVE)
+                   .build());
+
+    m_bloomUpsampleShader.bind();
+    for (u32 mip = consts::BLOOM_NUM_MIPS - 1; mip > 0; --mip) {
+        const Texture2D &source = m_bloomMips[mip];
+        glm::uvec2 region = getBloomRegion(mip - 1);
+
+        m_ctx.setColorRenderTarget(m_bloomMips[mip - 1]);
+        m_ctx.setViewport(region.x, region.y);
+
+        m_bloomUpsampleShader.setUniform("uSource", source);
+        m_bloomUpsampleShader.setUniform("uSourceSize", glm::vec2(source.getWidth(), source.getHeight()));
+        m_bloomUpsampleShader.setUniform("uSourceRegion", glm::vec2(getBloomRegion(mip)));
+
+        drawNVertices(4);
+    }
+}
+
+void Renderer::updateColorGradingLut() {
+    const ColorGrading &grading = core->gameState.renderOptions.grading;
+    if (m_colorGradingLutBaked && grading.saturation == m_bakedColorGrading.saturation &&
+        grading.contrast == m_bakedColorGrading.contrast && grading.temperature == m_bakedColorGrading.temperature) {
+        return;
+    }
+
+    m_bakedColorGrading = grading;
+    m_colorGradingLutBaked = true;
+
+    // a warmer white balance boosts red and cuts blue
+    glm::vec3 whiteBalance = glm::vec3(1.0f + 0.2f * grading.temperature, 1.0f, 1.0f - 0.2f * grading.temperature);
+    const glm::vec3 lumaWeights = glm::vec3(0.2126f, 0.7152f, 0.0722f);
+
+    u32 size = consts::COLOR_GRADING_LUT_SIZE;
+    std::vector<u8> texels(size * size * size * 4);
+    u8 *texel = texels.data();
+    for (u32 b = 0; b < size; ++b) {
+        for (u32 g = 0; g < size; ++g) {
+            for (u32 r = 0; r < size; ++r) {
+                glm::vec3 color = glm::vec3(r, g, b) / (f32)(size - 1);
+                color *= whiteBalance;
+                color = (color - 0.5f) * grading.contrast + 0.5f;
+                color = glm::mix(glm::vec3(glm::dot(color, lumaWeights)), color, grading.saturation);
+                color = glm::clamp(color, 0.0f, 1.0f);
+
+                texel[0] = (u8)std::lround(color.x * 255.0f);
+                texel[1] = (u8)std::lround(color.y * 255.0f);
+                texel[2] = (u8)std::lround(color.z * 255.0f);
+                texel[3] = 255;
+                texel += 4;
+            }
+        }
+    }
+
+    m_colorGradingLut.setImage(size, TextureFormatEnum::RGBA8, texels.data());
+}
@@ -6,13 +6,60 @@
 #include "constants.h"
 #include "texture.h"
 #include "shader.h"
+#include "shader_permutations.h"
 #include "render_context.h"
+#include "ibl_cache.h"
+#include "spherical_harmonics.h"
+#include "uniform_buffer.h"
+#include "gpu_timer.h"
+#include "gpu_sample_counter.h"
+#include "clustered_lighting.h"
+#include "cascaded_shadow_maps.h"
+#include "dynamic_resolution.h"
+#include "auto_exposure.h"
+#include "software_occlusion.h"
+#include "occlusion_queries.h"
+#include "draw_item.h"
+#include <atomic>
+#include <vector>
 
 struct RenderStats {
     u32 verticesRendered = 0;
     u32 drawCalls = 0;
+    u32 shaderBinds = 0;
+    u32 materialBinds = 0;
+    u32 materialPermutations = 0;
+    f32 depthPrepassMs = 0;
+    f32 shadingMs = 0;
+    u64 shadedSamples = 0;
+    f32 overdraw = 0;   // shaded samples per pixel of the frame
+    u32 lights = 0;
+    u32 clusterLightIndices = 0;
+    f32 lightAssignmentMs = 0;
+    u32 shadowPasses = 0;
+    f32 shadowMs = 0;
+    f32 gpuFrameMs = 0;
+    f32 resolutionScale = 1;
+    u32 renderWidth = 0;
+    u32 renderHeight = 0;
+    f32 exposure = 0;
+    f32 averageLuminance = 0;
+    f32 autoExposureMs = 0;
+    u32 reducedLodItems = 0;    // draw items below full detail
+    u32 meshletsTested = 0;
+    u32 meshletsCulled = 0;
+    f32 meshletCullingMs = 0;
+    u32 occluders = 0;
+    u32 occluderTriangles = 0;
+    f32 occluderRasterizationMs = 0;
+    u32 occludedItems = 0;
+    f32 occlusionCullingMs = 0;
+    u32 occlusionQueries = 0;
+    u32 conditionalDraws = 0;   // draws skipped by the GPU if their occlusion query passed no samples
+    f32 occlusionQueryMs = 0;
 };
 
+
 struct GraphicsDebugLogger {
     GraphicsDebugLogger();
 };
@@ -23,7 +70,8 @@ public:
     ~Renderer();
 
     /// Render scene to default framebuffer
-    void render();
+    /// \param dt Seconds since the last frame, for effects that adapt over time
+    void render(f32 dt);
 
     /// Reload all shaders
     void reloadShaders();
@@ -31,37 +79,179 @@ public:
     /// Get stats on most recent frame
     RenderStats getStats();
 
+    /// Capture the sky and update the IBL probe from it, blocking until done
+    void updateIblProbe();
+
+    /// Update the IBL probe over the next frames within RenderOptions::iblUpdateBudgetMs of GPU time per frame.
+    /// Shading keeps using the previous probe until the update is done. If an update is already running, another
+    /// one is started once it finishes
+    void requestIblProbeUpdate();
+
+    /// \return Progress of the running time-sliced IBL probe update in [0, 1], negative if none is running
+    f32 getIblProbeUpdateProgress() const;
+
 private:
     /// Setup textures, framebuffers, etc.
     void init();
 
     void drawNVertices(u32 n) const;
 
+    /// Render a fullscreen pass into faces [face_begin, face_end) of a cubemap mip level with a single draw.
+    /// The shader must be bound and use cubemap_layered.geom, which provides the direction through each texel
+    void renderCubemapLayered(Shader &shader, const TextureCubemap &target, u32 level, u32 face_begin = 0,
+                              u32 face_end = 6);
+
+    /// Bind the prefilter shader of the current prefilter mode and set it up for a mip level
+    Shader &bindPrefilterShader(u32 level);
+
+    /// Reset the probe update state and start from the first work item
+    void beginIblProbeUpdate();
+
+    /// Do work items of the running probe update
+    /// \param budget_ms GPU time to spend, at least one work item is done even if it goes over
+    /// \param blocking Ignore the budget and wait for the readback and SH projection instead of returning
+    /// \return Whether the update finished and the probes were swapped
+    bool stepIblProbeUpdate(f32 budget_ms, bool blocking);
+
+    /// Estimated GPU cost of a work item in arbitrary units, proportional to texels times samples
+    u64 getIblWorkItemCost(u32 item) const;
+
+    /// Start an asynchronous readback of a small mip level of the sky capture for the SH projection
+    void startIrradianceShReadback();
+
+    /// Hand finished readback data to a job that projects it onto SH
+    /// \return Whether the projection is done and m_pendingIrradianceSh can be used
+    bool finishIrradianceSh(bool blocking);
+
+    /// Wait until no SH projection job is using the renderer anymore
+    void waitForIrradianceShJob();
+
+    /// Hash everything that the results of precompute() and updateIblProbe() depend on
+    u64 computeIblCacheKey() const;
+
     void precompute();
-    void updateIblProbe();
-    void renderFrame();
+
+    /// Upload diffuse irradiance SH coefficients for shading
+    void setIrradianceSh(const ShCoefficients &irradiance_sh);
+
+    const TextureCubemap &getFrontPrefilteredEnvCubemap() const {
+        return m_prefilteredEnvCubemaps[m_frontProbe];
+    }
+
+    const TextureCubemap &getBackPrefilteredEnvCubemap() const {
+        return m_prefilteredEnvCubemaps[1 - m_frontProbe];
+    }
+
+    /// Set the material uniforms that are the same for the whole frame
+    /// \param first_bind Whether this is the first time the permutation is bound this frame. Textures are bound
+    /// every time since texture units are shared between programs, other uniforms are kept by the program
+    void setMaterialFrameUniforms(Shader &shader, bool first_bind);
+
+    /// Gather active entities and their meshes
+    void collectDrawItems();
+
+    /// Pick the level of detail of an entity from how large the error of its levels is on screen
+    /// \param previous_lod Level picked last frame, coarser levels need to be a margin below the threshold
+    u32 selectLod(const Model &model, const DrawEntity &entity, u32 previous_lod) const;
+
+    /// Rasterize occluders on the CPU and mark the draw entities and items behind them
+    void cullOccluded();
+
+    /// Cull the meshlets of all draw items on the job system and collect the index ranges of the visible ones for
+    /// passes from the camera
+    void cullMeshlets();
+
+    /// Render the shadow map layers that changed
+    void renderShadowMaps();
+
+    /// Draw the depth of entities with the depth-only shaders
+    /// \param visible_meshlets Only draw the meshlets that survived cullMeshlets(), for passes from the camera
+    void renderDepth(const glm::mat4 &view_projection, const std::vector<u32> &entities, bool visible_meshlets);
+
+    /// Draw depth of all draw items without shading
+    void renderDepthPrepass();
+
+    /// Draw all draw items with their material, sorted by shader variant and material so that consecutive draws
+    /// share as much state as possible
+    void renderMaterials();
+
+    /// Size of the part of a bloom pyramid level that covers the rendered region
+    glm::uvec2 getBloomRegion(u32 mip) const;
+
+    /// Downsample the rendered region into the bloom pyramid and accumulate it back up to the first level
+    void renderBloom();
+
+    /// Bake RenderOptions::grading into the lookup table if it changed
+    void updateColorGradingLut();
+
+    void renderFrame(f32 dt);
 
     GraphicsDebugLogger m_debugLogger;
 
     RenderContext m_ctx;
 
     // common
-    Texture2D m_targetTexture;
-    Texture2D m_hdrFrameTexture;
+    Texture2D m_hdrFrameTexture;    // sized for consts::MAX_RESOLUTION_SCALE, the scene covers the bottom left part
+    Texture2D m_hdrDepthTexture;
+    DynamicResolution m_dynamicResolution;
 
+    // post processing, the final pass tonemaps, composites bloom, grades and dithers straight into the window
     Shader m_tonemapShader;
+    Shader m_bloomDownsampleShader;
+    Shader m_bloomUpsampleShader;
+    Texture2D m_bloomMips[consts::BLOOM_NUM_MIPS];
+    Texture3D m_colorGradingLut;
+    ColorGrading m_bakedColorGrading;
+    bool m_colorGradingLutBaked = false;
+    AutoExposure m_autoExposure;
+
+    // GPU time of whole frames, which the dynamic resolution follows
+    GpuTimer m_frameTimer;
 
     // environment probe
     Shader m_skyShader;
-    Shader m_diffuseIrradianceShader;
+    Shader m_skyCaptureShader;
     Shader m_envMapPrefilterShader;
+    Shader m_envMapPrefilterFisShader;
+    UniformBuffer m_prefilterSamplesBuffer;
     TextureCubemap m_environmentMap;
-    TextureCubemap m_diffuseIrradianceCubemap;
-    TextureCubemap m_prefilteredEnvCubemap;
+    TextureCubemap m_skyCaptureCubemap;
+    TextureCubemap m_prefilteredEnvCubemaps[2]; // shading uses the front one while the back one is updated
+    u32 m_frontProbe = 0;
     s32 m_numPrefilteredEnvMipmapLevels;
+    IblCache m_iblCache;
+    ShCoefficients m_irradianceSh;
+    UniformBuffer m_irradianceShBuffer;
+
+    // time-sliced probe update, see stepIblProbeUpdate()
+    bool m_iblUpdateRunning = false;
+    bool m_iblUpdateRestart = false;
+    u32 m_iblUpdateItem = 0;
+    glm::vec3 m_iblProbeSunDirection = glm::vec3(0);
+    GpuTimer m_iblUpdateTimer;
+    f32 m_iblMsPerCost;
+    u32 m_irradianceShReadbackPbo = 0;
+    GLsync m_irradianceShReadbackFence = nullptr;
+    std::vector<f32> m_irradianceShReadbackData;
+    std::atomic<bool> m_irradianceShJobRunning;
+    ShCoefficients m_pendingIrradianceSh;
 
     // materials
-    Shader m_materialShader;
+    std::vector<DrawItem> m_drawItems;
+    std::vector<DrawEntity> m_drawEntities;
+    std::vector<u32> m_entityLods;  // level of detail of each scene entity last frame, for hysteresis
+    u32 m_staticLodChanges = 0;     // static entities that switched level of detail, their cached shadows are stale
+    std::vector<s32> m_rangeCounts; // index ranges of visible meshlets, in draw item order
+    std::vector<const void *> m_rangeOffsets;
+    std::vector<u64> m_materialDrawOrder;   // variant, material and index of the visible draw items, sorted
+    SoftwareOcclusion m_softwareOcclusion;
+    OcclusionQueries m_occlusionQueries;
+    ShaderPermutations m_depthShaders;
+    ShaderPermutations m_materialShaders;
+    ClusteredLighting m_clusteredLighting;
+    CascadedShadowMaps m_shadowMaps;
+    GpuTimer m_shadowTimer;
+    std::vector<u32> m_depthEntities;
     Shader m_brdfLutShader;
     Texture2D m_brdfLut;
 
@@ -70,6 +260,9 @@ private:
 
     // stats per frame
     RenderStats m_renderStats;
+    GpuTimer m_depthPrepassTimer;
+    GpuTimer m_shadingTimer;
+    GpuSampleCounter m_shadedSampleCounter;
 };
 
 #endif //ACORN_RENDERER_H
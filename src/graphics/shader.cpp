@@ -1,26 +1,61 @@
 #include "shader.h"
+#include "core.h"
 #include "utils.h"
 #include "log.h"
 #include <GL/gl3w.h>
 #include <vector>
 
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
 Shader::Shader(const std::string &vertex_path, const std::string &fragment_path)
     : m_vertexPath(vertex_path), m_fragmentPath(fragment_path) {
     Log::debug("Shader::Shader(%s, %s)", vertex_path.c_str(), fragment_path.c_str());
     init();
+    core->shaderWatcher.add(this);
+}
+
+Shader::Shader(const std::string &vertex_path, const std::string &geometry_path, const std::string &fragment_path)
+    : m_vertexPath(vertex_path), m_geometryPath(geometry_path), m_fragmentPath(fragment_path) {
+    Log::debug("Shader::Shader(%s, %s, %s)", vertex_path.c_str(), geometry_path.c_str(), fragment_path.c_str());
+    init();
+    core->shaderWatcher.add(this);
+}
+
+Shader::Shader(const std::string &vertex_path, const std::string &fragment_path,
+               const std::vector<std::string> &defines)
+    : m_vertexPath(vertex_path), m_fragmentPath(fragment_path) {
+    for (const std::string &define : defines) {
+        m_inject += "#define " + define + "\n";
+    }
+
+    Log::debug("Shader::Shader(%s, %s, %d defines)", vertex_path.c_str(), fragment_path.c_str(), defines.size());
+    init();
+    core->shaderWatcher.add(this);
+}
+
+Shader::Shader(const std::string &compute_path)
+    : m_computePath(compute_path) {
+    Log::debug("Shader::Shader(%s)", compute_path.c_str());
+    init();
+    core->shaderWatcher.add(this);
 }
 
 Shader::~Shader() {
     Log::debug("Shader::~Shader()");
+    core->shaderWatcher.remove(this);
+    discardReload();
     destroy();
 }
 
 void Shader::reload() {
-    destroy();
-    init();
+    startReload();
+    finishReload();
 }
 
 void Shader::bind() {
+    finishLink();
     glUseProgram(m_programId);
 }
 
@@ -48,62 +83,231 @@ void Shader::setUniform(const std::string &name, f32 value) {
     glUniform1f(getUniformLocation(name), value);
 }
 
+void Shader::setUniform(const std::string &name, glm::vec2 value) {
+    glUniform2f(getUniformLocation(name), value.x, value.y);
+}
+
 void Shader::setUniform(const std::string &name, glm::vec3 value) {
     glUniform3f(getUniformLocation(name), value.x, value.y, value.z);
 }
 
+void Shader::setUniform(const std::string &name, glm::mat3 value) {
+    glUniformMatrix3fv(getUniformLocation(name), 1, GL_FALSE, &value[0][0]);
+}
+
 void Shader::setUniform(const std::string &name, glm::mat4 value) {
     glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, &value[0][0]);
 }
 
+void Shader::setUniformBlock(const std::string &name, const UniformBuffer &buffer) {
+    finishLink();
+
+    auto it = m_uniformBlockIndices.find(name);
+    if (it == m_uniformBlockIndices.end()) {
+        it = m_uniformBlockIndices.emplace(name, glGetUniformBlockIndex(m_programId, name.c_str())).first;
+    }
+
+    if (it->second == GL_INVALID_INDEX) {
+        return;
+    }
+
+    glUniformBlockBinding(m_programId, it->second, buffer.getBinding());
+    buffer.bind();
+}
+
 void Shader::init() {
-    s32 previouslyBound;
-    glGetIntegerv(GL_CURRENT_PROGRAM, &previouslyBound);
+    m_linkPending = !createProgram(&m_programId, m_stageShaders, &m_sourceHash);
+}
 
-    u32 vert = 0, frag = 0;
-    m_programId = glCreateProgram();
-    if (m_programId == 0) {
+void Shader::finishLink() {
+    if (!m_linkPending) {
+        return;
+    }
+    m_linkPending = false;
+
+    if (checkProgram(m_programId, m_stageShaders)) {
+        core->programBinaryCache.store(m_sourceHash, m_programId);
+    }
+}
+
+void Shader::startReload() {
+    // a reload that is still running is superseded by this one
+    discardReload();
+    m_reloadLinkPending = !createProgram(&m_reloadProgramId, m_reloadStageShaders, &m_reloadSourceHash);
+}
+
+bool Shader::isReloadReady() const {
+    if (m_reloadProgramId == 0 || !m_reloadLinkPending || !core->shaderWatcher.isParallelCompileSupported()) {
+        return true;
+    }
+
+    s32 complete = GL_FALSE;
+    glGetProgramiv(m_reloadProgramId, GL_COMPLETION_STATUS_KHR, &complete);
+    return complete == GL_TRUE;
+}
+
+void Shader::finishReload() {
+    if (m_reloadProgramId == 0) {
+        return;
+    }
+
+    bool linked = m_reloadLinkPending;
+    bool success = !linked || checkProgram(m_reloadProgramId, m_reloadStageShaders);
+    m_reloadLinkPending = false;
+
+    if (!success) {
+        Log::warn("Keeping last working program for '%s'",
+                  m_computePath.empty() ? m_fragmentPath.c_str() : m_computePath.c_str());
+        discardReload();
+        return;
+    }
+
+    if (linked) {
+        core->programBinaryCache.store(m_reloadSourceHash, m_reloadProgramId);
+    }
+
+    // swap in the new program, locations and texture units have to be looked up again
+    destroy();
+    m_programId = m_reloadProgramId;
+    m_sourceHash = m_reloadSourceHash;
+    m_reloadProgramId = 0;
+}
+
+void Shader::destroy() {
+    for (u32 &shader : m_stageShaders) {
+        glDeleteShader(shader);
+        shader = 0;
+    }
+    m_linkPending = false;
+
+    glDeleteProgram(m_programId);
+    m_programId = 0;
+    m_uniformLocations.clear();
+    m_textureUnits.clear();
+    m_uniformBlockIndices.clear();
+}
+
+void Shader::discardReload() {
+    for (u32 &shader : m_reloadStageShaders) {
+        glDeleteShader(shader);
+        shader = 0;
+    }
+    m_reloadLinkPending = false;
+
+    glDeleteProgram(m_reloadProgramId);
+    m_reloadProgramId = 0;
+}
+
+bool Shader::createProgram(u32 *program, u32 stage_shaders[3], u64 *source_hash) {
+    if (!m_computePath.empty()) {
+        return createComputeProgram(program, stage_shaders, source_hash);
+    }
+
+    std::string vertexSrc = utils::load_shader_to_string(m_vertexPath.c_str(), m_inject);
+    std::string fragmentSrc = utils::load_shader_to_string(m_fragmentPath.c_str(), m_inject);
+
+    std::string geometrySrc;
+    if (!m_geometryPath.empty()) {
+        geometrySrc = utils::load_shader_to_string(m_geometryPath.c_str(), m_inject);
+    }
+
+    // includes may have changed, so dependencies are collected again on every load
+    m_dependencies.clear();
+    utils::get_shader_dependencies(m_vertexPath.c_str(), &m_dependencies);
+    if (!m_geometryPath.empty()) {
+        utils::get_shader_dependencies(m_geometryPath.c_str(), &m_dependencies);
+    }
+    utils::get_shader_dependencies(m_fragmentPath.c_str(), &m_dependencies);
+
+    *source_hash = utils::hash_bytes(vertexSrc.data(), vertexSrc.size());
+    *source_hash = utils::hash_bytes(geometrySrc.data(), geometrySrc.size(), *source_hash);
+    *source_hash = utils::hash_bytes(fragmentSrc.data(), fragmentSrc.size(), *source_hash);
+
+    *program = glCreateProgram();
+    if (*program == 0) {
         Log::fatal("Failed to create shader program");
     }
 
-    std::string vertexSrc = utils::load_shader_to_string(m_vertexPath.c_str());
-    std::string fragmentSrc = utils::load_shader_to_string(m_fragmentPath.c_str());
+    if (core->programBinaryCache.load(*source_hash, *program)) {
+        return true;
+    }
 
-    // Create and compile vertex and fragment shader
-    vert = compileAndAttach(GL_VERTEX_SHADER, vertexSrc.c_str(), m_vertexPath.c_str());
-    frag = compileAndAttach(GL_FRAGMENT_SHADER, fragmentSrc.c_str(), m_fragmentPath.c_str());
+    // Create and compile vertex, (optional) geometry and fragment shader. Results are only checked in checkProgram()
+    stage_shaders[0] = compileAndAttach(*program, GL_VERTEX_SHADER, vertexSrc.c_str(), m_vertexPath.c_str());
+    if (!m_geometryPath.empty()) {
+        stage_shaders[1] = compileAndAttach(*program, GL_GEOMETRY_SHADER, geometrySrc.c_str(),
+                                            m_geometryPath.c_str());
+    }
+    stage_shaders[2] = compileAndAttach(*program, GL_FRAGMENT_SHADER, fragmentSrc.c_str(), m_fragmentPath.c_str());
 
     // Link program
-    glLinkProgram(m_programId);
-    glDetachShader(m_programId, vert);
-    glDetachShader(m_programId, frag);
-    glDeleteShader(vert);
-    glDeleteShader(frag);
+    if (core->programBinaryCache.isSupported()) {
+        glProgramParameteri(*program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glLinkProgram(*program);
+
+    return false;
+}
+
+bool Shader::createComputeProgram(u32 *program, u32 stage_shaders[3], u64 *source_hash) {
+    std::string computeSrc = utils::load_shader_to_string(m_computePath.c_str(), m_inject);
+
+    m_dependencies.clear();
+    utils::get_shader_dependencies(m_computePath.c_str(), &m_dependencies);
+
+    *source_hash = utils::hash_bytes(computeSrc.data(), computeSrc.size());
+
+    *program = glCreateProgram();
+    if (*program == 0) {
+        Log::fatal("Failed to create shader program");
+    }
+
+    if (core->programBinaryCache.load(*source_hash, *program)) {
+        return true;
+    }
+
+    stage_shaders[0] = compileAndAttach(*program, GL_COMPUTE_SHADER, computeSrc.c_str(), m_computePath.c_str());
+
+    if (core->programBinaryCache.isSupported()) {
+        glProgramParameteri(*program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glLinkProgram(*program);
+
+    return false;
+}
+
+bool Shader::checkProgram(u32 program, u32 stage_shaders[3]) {
+    const std::string *stagePaths[3] = {m_computePath.empty() ? &m_vertexPath : &m_computePath, &m_geometryPath,
+                                        &m_fragmentPath};
+    for (u32 i = 0; i < 3; ++i) {
+        if (stage_shaders[i] == 0) {
+            continue;
+        }
+
+        checkCompileStatus(stage_shaders[i], stagePaths[i]->c_str());
+        glDetachShader(program, stage_shaders[i]);
+        glDeleteShader(stage_shaders[i]);
+        stage_shaders[i] = 0;
+    }
 
     // Check link status
     s32 success;
-    glGetProgramiv(m_programId, GL_LINK_STATUS, &success);
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
     if (success == GL_FALSE) {
         GLint length = 0;
-        glGetProgramiv(m_programId, GL_INFO_LOG_LENGTH, &length);
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
 
         std::vector<char> log(length);
-        glGetProgramInfoLog(m_programId, length, &length, log.data());
+        glGetProgramInfoLog(program, length, &length, log.data());
 
         Log::warn("Failed to link program:\n%s", log.data());
+        return false;
     }
 
-    glUseProgram(previouslyBound);
-}
-
-void Shader::destroy() {
-    glDeleteProgram(m_programId);
-    m_programId = 0;
-    m_uniformLocations.clear();
-    m_textureUnits.clear();
+    return true;
 }
 
-u32 Shader::compileAndAttach(u32 shader_type, const char *shader_src, const char *debug_shader_path) {
+u32 Shader::compileAndAttach(u32 program, u32 shader_type, const char *shader_src, const char *debug_shader_path) {
     u32 shader = glCreateShader(shader_type);
     if (shader == 0) {
         Log::fatal("Failed to create shader '%s'", debug_shader_path);
@@ -111,7 +315,12 @@ u32 Shader::compileAndAttach(u32 shader_type, const char *shader_src, const char
     glShaderSource(shader, 1, &shader_src, nullptr);
     glCompileShader(shader);
 
-    // Check compile status
+    glAttachShader(program, shader);
+
+    return shader;
+}
+
+void Shader::checkCompileStatus(u32 shader, const char *debug_shader_path) {
     s32 success;
     glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
     if (success == GL_FALSE) {
@@ -123,14 +332,11 @@ u32 Shader::compileAndAttach(u32 shader_type, const char *shader_src, const char
 
         Log::warn("Failed to compile shader '%s':\n%s", debug_shader_path, log.data());
     }
-
-    // Attach if successfully compiled
-    glAttachShader(m_programId, shader);
-
-    return shader;
 }
 
 u32 Shader::getUniformLocation(const std::string &name) {
+    finishLink();
+
     auto it = m_uniformLocations.find(name);
     if (it == m_uniformLocations.end()) {
         m_uniformLocations[name] = glGetUniformLocation(m_programId, name.c_str());
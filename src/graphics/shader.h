@@ -3,19 +3,40 @@
 
 #include "types.h"
 #include "texture.h"
+#include "uniform_buffer.h"
 #include <glm/glm.hpp>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
-/// OpenGL shader
+/// OpenGL shader. Programs are loaded from the program binary cache when possible. Otherwise compiling and linking
+/// only starts on construction and is finished on first use, so drivers with parallel shader compilation can work
+/// on all programs at once. Shaders register themselves with the shader watcher, which reloads them when one of
+/// their files changes
 class Shader {
 public:
     Shader(const std::string &vertex_path, const std::string &fragment_path);
+    Shader(const std::string &vertex_path, const std::string &geometry_path, const std::string &fragment_path);
+
+    /// \param defines Names that are defined at the '#inject' line of each stage
+    Shader(const std::string &vertex_path, const std::string &fragment_path, const std::vector<std::string> &defines);
+
+    /// Compute shader, only construct these if the context supports OpenGL 4.3
+    explicit Shader(const std::string &compute_path);
     ~Shader();
 
-    /// Reload shaders from files
+    /// Reload shaders from files, blocking until done. The current program is kept if the new one fails to build
     void reload();
 
+    /// Start reloading shaders from files. The current program stays in use until finishReload()
+    void startReload();
+
+    /// \return Whether a started reload is done compiling, so finishReload() won't block
+    bool isReloadReady() const;
+
+    /// Swap in the reloaded program if it compiled and linked, otherwise keep the current one
+    void finishReload();
+
     /// Bind shader for usage
     void bind();
 
@@ -28,28 +49,78 @@ public:
     /// Set float shader uniform
     void setUniform(const std::string &name, f32 value);
 
+    /// Set vec2 shader uniform
+    void setUniform(const std::string &name, glm::vec2 value);
+
     /// Set vec3 shader uniform
     void setUniform(const std::string &name, glm::vec3 value);
 
+    /// Set mat3 shader uniform
+    void setUniform(const std::string &name, glm::mat3 value);
+
     /// Set mat4 shader uniform
     void setUniform(const std::string &name, glm::mat4 value);
 
+    /// Bind a uniform buffer to a uniform block
+    void setUniformBlock(const std::string &name, const UniformBuffer &buffer);
+
+    /// Get a hash of the fully preprocessed shader sources
+    u64 getSourceHash() const {
+        return m_sourceHash;
+    }
+
+    /// Get every file that the sources of this shader are built from, including nested includes
+    const std::vector<std::string> &getDependencies() const {
+        return m_dependencies;
+    }
+
 private:
-    /// Load shaders from files
+    /// Load shaders from files and start compiling them if there is no cached binary
     void init();
 
+    /// Wait for linking that init() started, report errors and cache the binary
+    void finishLink();
+
     /// Cleanup shaders
     void destroy();
 
-    u32 compileAndAttach(u32 shader_type, const char *shader_src, const char *debug_shader_path);
+    /// Delete a reload that hasn't been swapped in
+    void discardReload();
+
+    /// Load shaders from files into a new program and start compiling and linking them
+    /// \return Whether the program was loaded from the binary cache and is already linked
+    bool createProgram(u32 *program, u32 stage_shaders[3], u64 *source_hash);
+
+    /// createProgram() for a compute shader, it goes into the first stage slot
+    bool createComputeProgram(u32 *program, u32 stage_shaders[3], u64 *source_hash);
+
+    /// Wait for compiling and linking of a program, report errors and delete its stage shaders
+    /// \return Whether the program linked successfully
+    bool checkProgram(u32 program, u32 stage_shaders[3]);
+
+    u32 compileAndAttach(u32 program, u32 shader_type, const char *shader_src, const char *debug_shader_path);
+
+    void checkCompileStatus(u32 shader, const char *debug_shader_path);
 
     u32 getUniformLocation(const std::string &name);
 
     u32 m_programId = 0;
+    u32 m_stageShaders[3] = {}; // vertex (or compute), geometry, fragment shaders while linking is pending
+    bool m_linkPending = false;
+    u64 m_sourceHash = 0;
+    u32 m_reloadProgramId = 0;
+    u32 m_reloadStageShaders[3] = {};
+    bool m_reloadLinkPending = false;
+    u64 m_reloadSourceHash = 0;
+    std::vector<std::string> m_dependencies;
     std::unordered_map<std::string, u32> m_uniformLocations;
     std::unordered_map<std::string, u32> m_textureUnits;
+    std::unordered_map<std::string, u32> m_uniformBlockIndices;
     std::string m_vertexPath;
+    std::string m_geometryPath;
     std::string m_fragmentPath;
+    std::string m_computePath;
+    std::string m_inject;
 };
 
 #endif //ACORN_SHADER_H
@@ -0,0 +1,34 @@
+#include "shader_permutations.h"
+#include "log.h"
+
+ShaderPermutations::ShaderPermutations(const std::string &vertex_path, const std::string &fragment_path,
+                                       std::vector<std::string> keywords)
+    : m_vertexPath(vertex_path), m_fragmentPath(fragment_path), m_keywords(std::move(keywords)) {
+    if (m_keywords.size() > 32) {
+        Log::fatal("Too many keywords for shader permutations of '%s'", fragment_path.c_str());
+    }
+}
+
+Shader &ShaderPermutations::get(u32 key) {
+    auto it = m_permutations.find(key);
+    if (it != m_permutations.end()) {
+        return *it->second;
+    }
+
+    std::vector<std::string> defines;
+    for (u32 i = 0; i < m_keywords.size(); ++i) {
+        if (key & (1u << i)) {
+            defines.emplace_back(m_keywords[i]);
+        }
+    }
+
+    Log::debug("Compiling permutation 0x%x of '%s'", key, m_fragmentPath.c_str());
+    it = m_permutations.emplace(key, std::unique_ptr<Shader>(new Shader(m_vertexPath, m_fragmentPath, defines))).first;
+    return *it->second;
+}
+
+void ShaderPermutations::reload() {
+    for (auto &permutation : m_permutations) {
+        permutation.second->reload();
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef ACORN_SHADER_PERMUTATIONS_H
+#define ACORN_SHADER_PERMUTATIONS_H
+
+#include "types.h"
+#include "shader.h"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// Permutations of a shader that differ by which keywords are defined. Each permutation is compiled the first time
+/// it's requested and kept around after that
+class ShaderPermutations {
+public:
+    /// \param keywords Keyword for each bit of a permutation key, the first keyword is bit 0
+    ShaderPermutations(const std::string &vertex_path, const std::string &fragment_path,
+                       std::vector<std::string> keywords);
+
+    /// Get the permutation where the keywords of the set bits in key are defined
+    Shader &get(u32 key);
+
+    /// Reload every compiled permutation
+    void reload();
+
+    u32 getNumCompiled() const {
+        return m_permutations.size();
+    }
+
+private:
+    std::string m_vertexPath;
+    std::string m_fragmentPath;
+    std::vector<std::string> m_keywords;
+    std::unordered_map<u32, std::unique_ptr<Shader>> m_permutations;
+};
+
+#endif //ACORN_SHADER_PERMUTATIONS_H
@@ -0,0 +1,183 @@
+#include "shader_watcher.h"
+#include "shader.h"
+#include "utils.h"
+#include "log.h"
+#include <algorithm>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+constexpr auto POLL_INTERVAL = std::chrono::milliseconds(500);
+
+static s64 get_modification_time(const std::string &file_path) {
+    struct stat info = {};
+    if (stat(file_path.c_str(), &info) != 0) {
+        return -1;
+    }
+    return info.st_mtime;
+}
+
+static std::string get_directory(const std::string &file_path) {
+    u64 lastSlash = file_path.find_last_of('/');
+    return lastSlash == std::string::npos ? "" : file_path.substr(0, lastSlash);
+}
+
+ShaderWatcher::ShaderWatcher() {
+    Log::debug("ShaderWatcher::ShaderWatcher()");
+
+    m_parallelCompile = utils::is_gl_extension_supported("GL_KHR_parallel_shader_compile") ||
+                        utils::is_gl_extension_supported("GL_ARB_parallel_shader_compile");
+
+#ifdef __linux__
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotifyFd < 0) {
+        Log::warn("Failed to initialize inotify, polling shader files for changes instead");
+    }
+#endif
+
+    m_lastPollTime = std::chrono::steady_clock::now();
+}
+
+ShaderWatcher::~ShaderWatcher() {
+    Log::debug("ShaderWatcher::~ShaderWatcher()");
+
+#ifdef __linux__
+    if (m_inotifyFd >= 0) {
+        close(m_inotifyFd);
+    }
+#endif
+}
+
+void ShaderWatcher::add(Shader *shader) {
+    m_shaders.emplace_back(shader);
+    watchDependencies(*shader);
+}
+
+void ShaderWatcher::remove(Shader *shader) {
+    m_shaders.erase(std::remove(m_shaders.begin(), m_shaders.end(), shader), m_shaders.end());
+    m_reloading.erase(std::remove(m_reloading.begin(), m_reloading.end(), shader), m_reloading.end());
+}
+
+void ShaderWatcher::update() {
+    std::vector<std::string> changedFiles;
+    collectChangedFiles(&changedFiles);
+
+    // only reload the shaders that are built from a changed file
+    if (!changedFiles.empty()) {
+        u32 numReloads = 0;
+        for (Shader *shader : m_shaders) {
+            const std::vector<std::string> &dependencies = shader->getDependencies();
+            bool affected = std::any_of(changedFiles.begin(), changedFiles.end(), [&](const std::string &file) {
+                return std::find(dependencies.begin(), dependencies.end(), file) != dependencies.end();
+            });
+            if (!affected) {
+                continue;
+            }
+
+            shader->startReload();
+            ++numReloads;
+
+            // includes may have been added
+            watchDependencies(*shader);
+            if (std::find(m_reloading.begin(), m_reloading.end(), shader) == m_reloading.end()) {
+                m_reloading.emplace_back(shader);
+            }
+        }
+
+        if (numReloads > 0) {
+            Log::info("Reloading %d shaders after '%s' changed", numReloads, changedFiles.front().c_str());
+        }
+    }
+
+    // swap in reloads that are done compiling, the others are checked again next frame
+    for (auto it = m_reloading.begin(); it != m_reloading.end();) {
+        if (!(*it)->isReloadReady()) {
+            ++it;
+            continue;
+        }
+
+        (*it)->finishReload();
+        it = m_reloading.erase(it);
+    }
+}
+
+void ShaderWatcher::watchDependencies(const Shader &shader) {
+    for (const std::string &file : shader.getDependencies()) {
+#ifdef __linux__
+        if (m_inotifyFd >= 0) {
+            std::string directory = get_directory(file);
+            bool watched = std::any_of(m_watchedDirectories.begin(), m_watchedDirectories.end(),
+                                       [&](const std::pair<const s32, std::string> &watch) {
+                                           return watch.second == directory;
+                                       });
+            if (watched) {
+                continue;
+            }
+
+            // editors often save by renaming a temporary file, so moves count as writes
+            s32 watch = inotify_add_watch(m_inotifyFd, directory.empty() ? "." : directory.c_str(),
+                                          IN_CLOSE_WRITE | IN_MOVED_TO);
+            if (watch < 0) {
+                Log::warn("Failed to watch shader directory '%s'", directory.c_str());
+                continue;
+            }
+            m_watchedDirectories[watch] = directory;
+            continue;
+        }
+#endif
+
+        if (m_modificationTimes.find(file) == m_modificationTimes.end()) {
+            m_modificationTimes[file] = get_modification_time(file);
+        }
+    }
+}
+
+void ShaderWatcher::collectChangedFiles(std::vector<std::string> *changed_files) {
+    auto add_changed_file = [&](const std::string &file) {
+        if (std::find(changed_files->begin(), changed_files->end(), file) == changed_files->end()) {
+            changed_files->emplace_back(file);
+        }
+    };
+
+#ifdef __linux__
+    if (m_inotifyFd >= 0) {
+        alignas(inotify_event) char buffer[4096];
+        while (true) {
+            ssize_t length = read(m_inotifyFd, buffer, sizeof(buffer));
+            if (length <= 0) {
+                break;
+            }
+
+            for (char *ptr = buffer; ptr < buffer + length;) {
+                const auto *event = reinterpret_cast<const inotify_event *>(ptr);
+                ptr += sizeof(inotify_event) + event->len;
+
+                auto it = m_watchedDirectories.find(event->wd);
+                if (event->len == 0 || it == m_watchedDirectories.end()) {
+                    continue;
+                }
+
+                add_changed_file(it->second.empty() ? event->name : it->second + "/" + event->name);
+            }
+        }
+        return;
+    }
+#endif
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - m_lastPollTime < POLL_INTERVAL) {
+        return;
+    }
+    m_lastPollTime = now;
+
+    for (auto &file : m_modificationTimes) {
+        s64 modificationTime = get_modification_time(file.first);
+        if (modificationTime != file.second) {
+            file.second = modificationTime;
+            add_changed_file(file.first);
+        }
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef ACORN_SHADER_WATCHER_H
+#define ACORN_SHADER_WATCHER_H
+
+#include "types.h"
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Shader;
+
+/// Watches the files of every shader and reloads the shaders whose files changed. Uses inotify where available and
+/// falls back to polling modification times. Reloads compile while the old program stays in use and are swapped in
+/// once the driver is done, a reload that fails to build keeps the last working program
+class ShaderWatcher {
+public:
+    ShaderWatcher();
+    ~ShaderWatcher();
+
+    /// Start watching the dependencies of a shader
+    void add(Shader *shader);
+
+    /// Stop watching a shader, also cancels its pending reload
+    void remove(Shader *shader);
+
+    /// Start reloading shaders whose files changed and swap in reloads that finished compiling. Call once per frame
+    void update();
+
+    /// Whether the driver compiles programs on its own threads, so reloads can be polled instead of waited on
+    bool isParallelCompileSupported() const {
+        return m_parallelCompile;
+    }
+
+private:
+    /// Make sure every dependency of a shader is being watched
+    void watchDependencies(const Shader &shader);
+
+    /// Collect files that changed since the last call
+    void collectChangedFiles(std::vector<std::string> *changed_files);
+
+    std::vector<Shader *> m_shaders;
+    std::vector<Shader *> m_reloading;
+    bool m_parallelCompile = false;
+
+    // inotify watches directories, so saving through a rename is noticed too
+    s32 m_inotifyFd = -1;
+    std::unordered_map<s32, std::string> m_watchedDirectories;
+
+    // polling fallback
+    std::unordered_map<std::string, s64> m_modificationTimes;
+    std::chrono::steady_clock::time_point m_lastPollTime;
+};
+
+#endif //ACORN_SHADER_WATCHER_H
@@ -0,0 +1,334 @@
+#include "software_occlusion.h"
+#include "core.h"
+#include "camera.h"
+#include "constants.h"
+#include "log.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define ACORN_OCCLUSION_SSE
+#include <emmintrin.h>
+#endif
+
+constexpr u32 NUM_BINS_X = consts::OCCLUSION_BUFFER_WIDTH / consts::OCCLUSION_BIN_WIDTH;
+constexpr u32 NUM_BINS_Y = consts::OCCLUSION_BUFFER_HEIGHT / consts::OCCLUSION_BIN_HEIGHT;
+constexpr u32 NUM_TILES_X = consts::OCCLUSION_BUFFER_WIDTH / consts::OCCLUSION_TILE_SIZE;
+constexpr u32 NUM_TILES_Y = consts::OCCLUSION_BUFFER_HEIGHT / consts::OCCLUSION_TILE_SIZE;
+static_assert(consts::OCCLUSION_BIN_WIDTH % consts::OCCLUSION_TILE_SIZE == 0 &&
+              consts::OCCLUSION_BIN_HEIGHT % consts::OCCLUSION_TILE_SIZE == 0, "Bins must be made of whole tiles");
+static_assert(consts::OCCLUSION_TILE_SIZE % 4 == 0, "Rows of a tile are rasterized 4 pixels at a time");
+
+SoftwareOcclusion::SoftwareOcclusion()
+    : m_bins(NUM_BINS_X * NUM_BINS_Y),
+      m_depth(consts::OCCLUSION_BUFFER_WIDTH * consts::OCCLUSION_BUFFER_HEIGHT, 0.0f),
+      m_hiZ(NUM_TILES_X * NUM_TILES_Y, 0.0f) {
+    Log::debug("SoftwareOcclusion::SoftwareOcclusion()");
+}
+
+void SoftwareOcclusion::update(const Camera &camera, const std::vector<DrawEntity> &entities,
+                               const std::vector<DrawItem> &items) {
+    auto startTime = std::chrono::steady_clock::now();
+
+    m_viewProjection = camera.getViewProjectionMatrix();
+    m_nearPlane = camera.getNearPlane();
+    f32 tanHalfFov = std::tan(camera.getFov() * 0.5f);
+    f32 pixelsPerUnit = consts::OCCLUSION_BUFFER_HEIGHT / (2.0f * tanHalfFov);  // at a distance of 1
+
+    // opaque meshes that cover a large part of the screen make good occluders
+    m_occluders.clear();
+    for (const DrawItem &item : items) {
+        const Mesh &mesh = *item.mesh;
+        bool hasCutout = (mesh.getMaterialVariantKey() & MATERIAL_HAS_ALBEDO_MAP) &&
+                         mesh.getMaterial().albedoTexture->hasCutout();
+        if (hasCutout || mesh.getIndices().empty()) {
+            continue;
+        }
+
+        glm::vec3 center = (item.boundsMin + item.boundsMax) * 0.5f;
+        f32 radius = glm::length(item.boundsMax - center);
+        f32 distance = std::max(glm::length(center - camera.getPosition()) - radius, m_nearPlane);
+        f32 screenSize = radius / (distance * tanHalfFov);
+        if (screenSize < consts::OCCLUDER_MIN_SCREEN_SIZE) {
+            continue;
+        }
+
+        // the coarsest level that looks the same in the buffer
+        const glm::mat4 &modelMatrix = entities[item.entityIndex].modelMatrix;
+        glm::mat3 basis = glm::mat3(modelMatrix);
+        f32 scale = glm::max(glm::length(basis[0]), glm::max(glm::length(basis[1]), glm::length(basis[2])));
+        u32 lod = 0;
+        while (lod + 1 < mesh.getNumLods() &&
+               mesh.getLod(lod + 1).error * scale * pixelsPerUnit / distance <= consts::OCCLUDER_LOD_ERROR_PIXELS) {
+            ++lod;
+        }
+
+        m_occluders.push_back({&mesh, &modelMatrix, lod, screenSize, 0, mesh.getNumIndices(lod) / 3});
+    }
+
+    // largest occluders first, as long as they fit in the triangle budget
+    std::sort(m_occluders.begin(), m_occluders.end(), [](const Occluder &lhs, const Occluder &rhs) {
+        return lhs.screenSize > rhs.screenSize;
+    });
+
+    u32 numTriangles = 0;
+    u32 numOccluders = 0;
+    for (Occluder &occluder : m_occluders) {
+        if (numTriangles + occluder.numTriangles > consts::OCCLUSION_MAX_TRIANGLES) {
+            continue;
+        }
+        occluder.firstTriangle = numTriangles;
+        numTriangles += occluder.numTriangles;
+        m_occluders[numOccluders++] = occluder;
+    }
+    m_occluders.resize(numOccluders);
+    m_triangles.resize(numTriangles);
+
+    core->jobSystem.parallelFor(m_occluders.size(), 1, [&](u32 begin, u32 end) {
+        for (u32 i = begin; i < end; ++i) {
+            setupTriangles(i);
+        }
+    });
+
+    // binning is cheap next to rasterization, it stays on this thread
+    for (std::vector<u32> &bin : m_bins) {
+        bin.clear();
+    }
+    m_numRasterizedTriangles = 0;
+    for (const Occluder &occluder : m_occluders) {
+        for (u32 t = occluder.firstTriangle; t < occluder.firstTriangle + occluder.numTriangles; ++t) {
+            const Triangle &triangle = m_triangles[t];
+            for (s32 y = triangle.minY / (s32)consts::OCCLUSION_BIN_HEIGHT;
+                 y <= triangle.maxY / (s32)consts::OCCLUSION_BIN_HEIGHT; ++y) {
+                for (s32 x = triangle.minX / (s32)consts::OCCLUSION_BIN_WIDTH;
+                     x <= triangle.maxX / (s32)consts::OCCLUSION_BIN_WIDTH; ++x) {
+                    m_bins[y * NUM_BINS_X + x].push_back(t);
+                }
+            }
+        }
+        m_numRasterizedTriangles += occluder.numTriangles;
+    }
+
+    core->jobSystem.parallelFor(m_bins.size(), 1, [&](u32 begin, u32 end) {
+        for (u32 i = begin; i < end; ++i) {
+            rasterizeBin(i);
+        }
+    });
+
+    std::chrono::duration<f32, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+    m_updateMilliseconds = elapsed.count();
+}
+
+bool SoftwareOcclusion::isOccluded(glm::vec3 bounds_min, glm::vec3 bounds_max) const {
+    // the point of a box closest to the camera is one of its corners
+    f32 nearestDepth = 0.0f;
+    glm::vec2 screenMin = glm::vec2(INFINITY);
+    glm::vec2 screenMax = glm::vec2(-INFINITY);
+    for (u32 i = 0; i < 8; ++i) {
+        glm::vec3 corner = glm::vec3(i & 1u ? bounds_max.x : bounds_min.x,
+                                     i & 2u ? bounds_max.y : bounds_min.y,
+                                     i & 4u ? bounds_max.z : bounds_min.z);
+        glm::vec4 clip = m_viewProjection * glm::vec4(corner, 1);
+        if (clip.w < m_nearPlane) {
+            return false;
+        }
+
+        f32 invW = 1.0f / clip.w;
+        glm::vec2 screen = glm::vec2((clip.x * invW * 0.5f + 0.5f) * consts::OCCLUSION_BUFFER_WIDTH,
+                                     (clip.y * invW * 0.5f + 0.5f) * consts::OCCLUSION_BUFFER_HEIGHT);
+        screenMin = glm::min(screenMin, screen);
+        screenMax = glm::max(screenMax, screen);
+        nearestDepth = std::max(nearestDepth, invW);
+    }
+
+    // every pixel the box touches has to be covered by something closer. Occluders cover pixels whose centers they
+    // contain, so they can cover up to half a pixel more than they really do. The pixels around the box are tested
+    // too, a box that shows past the edge of an occluder then reaches a pixel the occluder doesn't cover
+    s32 minX = std::max((s32)std::floor(screenMin.x) - 1, 0);
+    s32 minY = std::max((s32)std::floor(screenMin.y) - 1, 0);
+    s32 maxX = std::min((s32)std::floor(screenMax.x) + 1, (s32)consts::OCCLUSION_BUFFER_WIDTH - 1);
+    s32 maxY = std::min((s32)std::floor(screenMax.y) + 1, (s32)consts::OCCLUSION_BUFFER_HEIGHT - 1);
+    if (minX > maxX || minY > maxY) {
+        return false;
+    }
+
+    for (s32 tileY = minY / (s32)consts::OCCLUSION_TILE_SIZE; tileY <= maxY / (s32)consts::OCCLUSION_TILE_SIZE;
+         ++tileY) {
+        for (s32 tileX = minX / (s32)consts::OCCLUSION_TILE_SIZE; tileX <= maxX / (s32)consts::OCCLUSION_TILE_SIZE;
+             ++tileX) {
+            if (m_hiZ[tileY * NUM_TILES_X + tileX] > nearestDepth) {
+                continue;
+            }
+
+            s32 x0 = std::max(tileX * (s32)consts::OCCLUSION_TILE_SIZE, minX);
+            s32 y0 = std::max(tileY * (s32)consts::OCCLUSION_TILE_SIZE, minY);
+            s32 x1 = std::min((tileX + 1) * (s32)consts::OCCLUSION_TILE_SIZE - 1, maxX);
+            s32 y1 = std::min((tileY + 1) * (s32)consts::OCCLUSION_TILE_SIZE - 1, maxY);
+            for (s32 y = y0; y <= y1; ++y) {
+                for (s32 x = x0; x <= x1; ++x) {
+                    if (m_depth[y * consts::OCCLUSION_BUFFER_WIDTH + x] <= nearestDepth) {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+void SoftwareOcclusion::setupTriangles(u32 occluder_index) {
+    Occluder &occluder = m_occluders[occluder_index];
+    const std::vector<glm::vec3> &positions = occluder.mesh->getPositions();
+    const std::vector<u32> &indices = occluder.mesh->getIndices();
+    const MeshLod &lod = occluder.mesh->getLod(occluder.lod);
+    glm::mat4 transform = m_viewProjection * *occluder.modelMatrix;
+
+    u32 write = occluder.firstTriangle;
+    for (u32 i = lod.firstIndex; i < lod.firstIndex + lod.numIndices; i += 3) {
+        glm::vec2 screen[3];
+        f32 invW[3];
+        bool clipped = false;
+        for (u32 k = 0; k < 3; ++k) {
+            glm::vec4 clip = transform * glm::vec4(positions[indices[i + k]], 1);
+
+            // dropping part of an occluder is always safe, so triangles crossing the near plane aren't clipped
+            if (clip.w < m_nearPlane) {
+                clipped = true;
+                break;
+            }
+
+            invW[k] = 1.0f / clip.w;
+            screen[k] = glm::vec2((clip.x * invW[k] * 0.5f + 0.5f) * consts::OCCLUSION_BUFFER_WIDTH,
+                                  (clip.y * invW[k] * 0.5f + 0.5f) * consts::OCCLUSION_BUFFER_HEIGHT);
+        }
+        if (clipped) {
+            continue;
+        }
+
+        // pixels whose centers are inside the bounds
+        glm::vec2 screenMin = glm::min(screen[0], glm::min(screen[1], screen[2]));
+        glm::vec2 screenMax = glm::max(screen[0], glm::max(screen[1], screen[2]));
+        Triangle triangle = {};
+        triangle.minX = std::max((s32)std::ceil(screenMin.x - 0.5f), 0);
+        triangle.minY = std::max((s32)std::ceil(screenMin.y - 0.5f), 0);
+        triangle.maxX = std::min((s32)std::floor(screenMax.x - 0.5f), (s32)consts::OCCLUSION_BUFFER_WIDTH - 1);
+        triangle.maxY = std::min((s32)std::floor(screenMax.y - 0.5f), (s32)consts::OCCLUSION_BUFFER_HEIGHT - 1);
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+            continue;
+        }
+
+        f32 area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) -
+                   (screen[2].x - screen[0].x) * (screen[1].y - screen[0].y);
+        if (std::abs(area) < 1e-6f) {
+            continue;
+        }
+
+        // both sides of a surface occlude, clockwise triangles are flipped
+        if (area < 0.0f) {
+            std::swap(screen[1], screen[2]);
+            std::swap(invW[1], invW[2]);
+            area = -area;
+        }
+
+        for (u32 e = 0; e < 3; ++e) {
+            glm::vec2 a = screen[e];
+            glm::vec2 b = screen[(e + 1) % 3];
+            triangle.edgeA[e] = a.y - b.y;
+            triangle.edgeB[e] = b.x - a.x;
+            triangle.edgeC[e] = -(triangle.edgeA[e] * a.x + triangle.edgeB[e] * a.y);
+        }
+
+        f32 depth1 = invW[1] - invW[0];
+        f32 depth2 = invW[2] - invW[0];
+        triangle.depthX = (depth1 * (screen[2].y - screen[0].y) - depth2 * (screen[1].y - screen[0].y)) / area;
+        triangle.depthY = (depth2 * (screen[1].x - screen[0].x) - depth1 * (screen[2].x - screen[0].x)) / area;
+        triangle.depth0 = invW[0] - triangle.depthX * screen[0].x - triangle.depthY * screen[0].y;
+
+        // pixels store the farthest depth of the plane over their area instead of the depth at their center
+        triangle.depth0 -= 0.5f * (std::abs(triangle.depthX) + std::abs(triangle.depthY));
+
+        m_triangles[write++] = triangle;
+    }
+
+    occluder.numTriangles = write - occluder.firstTriangle;
+}
+
+void SoftwareOcclusion::rasterizeBin(u32 bin) {
+    s32 binX0 = (bin % NUM_BINS_X) * consts::OCCLUSION_BIN_WIDTH;
+    s32 binY0 = (bin / NUM_BINS_X) * consts::OCCLUSION_BIN_HEIGHT;
+    s32 binX1 = binX0 + consts::OCCLUSION_BIN_WIDTH - 1;
+    s32 binY1 = binY0 + consts::OCCLUSION_BIN_HEIGHT - 1;
+
+    for (s32 y = binY0; y <= binY1; ++y) {
+        std::fill_n(&m_depth[y * consts::OCCLUSION_BUFFER_WIDTH + binX0], consts::OCCLUSION_BIN_WIDTH, 0.0f);
+    }
+
+    for (u32 t : m_bins[bin]) {
+        const Triangle &triangle = m_triangles[t];
+
+        // rows start on a multiple of 4, bins are too, so the 4 pixels never reach into another bin
+        s32 minX = std::max(triangle.minX, binX0) & ~3;
+        s32 maxX = std::min(triangle.maxX, binX1);
+        s32 minY = std::max(triangle.minY, binY0);
+        s32 maxY = std::min(triangle.maxY, binY1);
+
+        for (s32 y = minY; y <= maxY; ++y) {
+            f32 *row = &m_depth[y * consts::OCCLUSION_BUFFER_WIDTH];
+            f32 pixelY = y + 0.5f;
+            s32 x = minX;
+
+#ifdef ACORN_OCCLUSION_SSE
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+            __m128 edgeA[3];
+            __m128 edgeRow[3];
+            for (u32 e = 0; e < 3; ++e) {
+                edgeA[e] = _mm_set1_ps(triangle.edgeA[e]);
+                edgeRow[e] = _mm_set1_ps(triangle.edgeB[e] * pixelY + triangle.edgeC[e]);
+            }
+            const __m128 depthX = _mm_set1_ps(triangle.depthX);
+            const __m128 depthRow = _mm_set1_ps(triangle.depthY * pixelY + triangle.depth0);
+
+            for (; x <= maxX; x += 4) {
+                __m128 pixelX = _mm_add_ps(_mm_set1_ps((f32)x), laneOffsets);
+                __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[0], pixelX), edgeRow[0]), zero);
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[1], pixelX), edgeRow[1]), zero));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[2], pixelX), edgeRow[2]), zero));
+
+                __m128 previous = _mm_loadu_ps(row + x);
+                __m128 depth = _mm_max_ps(previous, _mm_add_ps(_mm_mul_ps(depthX, pixelX), depthRow));
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, depth), _mm_andnot_ps(inside, previous)));
+            }
+#endif
+
+            for (; x <= maxX; ++x) {
+                f32 pixelX = x + 0.5f;
+                bool inside = true;
+                for (u32 e = 0; e < 3; ++e) {
+                    f32 edge = triangle.edgeA[e] * pixelX + triangle.edgeB[e] * pixelY + triangle.edgeC[e];
+                    inside = inside && edge >= 0.0f;
+                }
+                if (inside) {
+                    row[x] = std::max(row[x], triangle.depthX * pixelX + triangle.depthY * pixelY + triangle.depth0);
+                }
+            }
+        }
+    }
+
+    // farthest depth of each tile of the bin
+    for (s32 tileY = binY0; tileY < binY1; tileY += consts::OCCLUSION_TILE_SIZE) {
+        for (s32 tileX = binX0; tileX < binX1; tileX += consts::OCCLUSION_TILE_SIZE) {
+            f32 farthest = INFINITY;
+            for (s32 y = tileY; y < tileY + (s32)consts::OCCLUSION_TILE_SIZE; ++y) {
+                const f32 *row = &m_depth[y * consts::OCCLUSION_BUFFER_WIDTH];
+                for (s32 x = tileX; x < tileX + (s32)consts::OCCLUSION_TILE_SIZE; ++x) {
+                    farthest = std::min(farthest, row[x]);
+                }
+            }
+            u32 tile = (tileY / consts::OCCLUSION_TILE_SIZE) * NUM_TILES_X + tileX / consts::OCCLUSION_TILE_SIZE;
+            m_hiZ[tile] = farthest;
+        }
+    }
+}
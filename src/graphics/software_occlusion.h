@@ -0,0 +1,82 @@
+#ifndef ACORN_SOFTWARE_OCCLUSION_H
+#define ACORN_SOFTWARE_OCCLUSION_H
+
+#include "types.h"
+#include "draw_item.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+class Camera;
+
+/// Rasterizes the largest opaque meshes of the frame into a small depth buffer on the CPU and tests bounding boxes
+/// against it. Works without any GPU readback, so results are used in the same frame. Depth is 1/w, which is linear
+/// in screen space. Larger is closer and an empty pixel is 0
+class SoftwareOcclusion {
+public:
+    SoftwareOcclusion();
+
+    /// Pick occluders from the draw items of a frame and rasterize them on the job system
+    void update(const Camera &camera, const std::vector<DrawEntity> &entities, const std::vector<DrawItem> &items);
+
+    /// \return Whether a world space box is completely behind the occluders of the last update
+    bool isOccluded(glm::vec3 bounds_min, glm::vec3 bounds_max) const;
+
+    u32 getNumOccluders() const {
+        return m_occluders.size();
+    }
+
+    /// Number of occluder triangles that were rasterized in the last update
+    u32 getNumTriangles() const {
+        return m_numRasterizedTriangles;
+    }
+
+    /// CPU time of the last update
+    f32 getUpdateMilliseconds() const {
+        return m_updateMilliseconds;
+    }
+
+private:
+    struct Occluder {
+        const Mesh *mesh;
+        const glm::mat4 *modelMatrix;
+        u32 lod;
+        f32 screenSize;     // bounding sphere radius as a fraction of half the screen height
+        u32 firstTriangle;  // slice of m_triangles
+        u32 numTriangles;   // triangles of the slice that survived setup
+    };
+
+    /// A screen space triangle with counter-clockwise edge functions A * x + B * y + C that are >= 0 inside
+    struct Triangle {
+        f32 edgeA[3];
+        f32 edgeB[3];
+        f32 edgeC[3];
+        f32 depthX;         // plane of 1/w over the screen
+        f32 depthY;
+        f32 depth0;
+        s32 minX;           // pixel bounds, inclusive
+        s32 minY;
+        s32 maxX;
+        s32 maxY;
+    };
+
+    /// Transform and set up the triangles of an occluder into its slice of m_triangles
+    void setupTriangles(u32 occluder_index);
+
+    /// Rasterize the triangles of a bin, then update the hierarchical depth of its tiles
+    void rasterizeBin(u32 bin);
+
+    glm::mat4 m_viewProjection = glm::mat4(1);
+    f32 m_nearPlane = 0;
+
+    std::vector<Occluder> m_occluders;
+    std::vector<Triangle> m_triangles;
+    std::vector<std::vector<u32>> m_bins;   // triangles overlapping each bin
+
+    std::vector<f32> m_depth;   // rows from the bottom of the screen to the top
+    std::vector<f32> m_hiZ;     // farthest depth of each tile
+
+    u32 m_numRasterizedTriangles = 0;
+    f32 m_updateMilliseconds = 0;
+};
+
+#endif //ACORN_SOFTWARE_OCCLUSION_H
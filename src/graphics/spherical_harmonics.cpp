@@ -0,0 +1,195 @@
+#include "spherical_harmonics.h"
+#include "core.h"
+#include "utils.h"
+#include <glm/gtc/constants.hpp>
+#include <mutex>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define ACORN_SH_SSE
+#include <emmintrin.h>
+#endif
+
+// Number of rows of a face that are projected in a single job
+constexpr u32 ROWS_PER_JOB = 16;
+
+// Real spherical harmonics basis constants
+constexpr f32 SH_Y00 = 0.282095f;
+constexpr f32 SH_Y1 = 0.488603f;
+constexpr f32 SH_Y2 = 1.092548f;
+constexpr f32 SH_Y20 = 0.315392f;
+constexpr f32 SH_Y22 = 0.546274f;
+
+/// Accumulate a single texel with a weight into coefficients
+static void accumulate_texel(ShCoefficients *sh, glm::vec3 dir, glm::vec3 color, f32 weight) {
+    f32 basis[9] = {
+        SH_Y00,
+        SH_Y1 * dir.y,
+        SH_Y1 * dir.z,
+        SH_Y1 * dir.x,
+        SH_Y2 * dir.x * dir.y,
+        SH_Y2 * dir.y * dir.z,
+        SH_Y20 * (3.0f * dir.z * dir.z - 1.0f),
+        SH_Y2 * dir.x * dir.z,
+        SH_Y22 * (dir.x * dir.x - dir.y * dir.y)
+    };
+
+    for (u32 i = 0; i < 9; ++i) {
+        sh->coefficients[i] += color * (basis[i] * weight);
+    }
+}
+
+/// Accumulate a row of a face into coefficients. Returns the sum of the weights
+static f32 project_row(ShCoefficients *sh, const f32 *row, u32 face, f32 t, u32 side_length) {
+    f32 invSideLength = 1.0f / side_length;
+    f32 weightSum = 0;
+    u32 x = 0;
+
+#ifdef ACORN_SH_SSE
+    // The face axis and the signs of s and t in the direction only depend on the face, so work out which
+    // direction component each of them ends up in once and then process 4 texels at a time
+    glm::vec3 origin = utils::cubemap_face_direction(face, 0, t);
+    glm::vec3 sAxis = utils::cubemap_face_direction(face, 1, t) - origin;
+
+    __m128 accumulators[27];
+    for (auto &accumulator : accumulators) {
+        accumulator = _mm_setzero_ps();
+    }
+    __m128 weightAccumulator = _mm_setzero_ps();
+
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 three = _mm_set1_ps(3.0f);
+    const __m128 y00 = _mm_set1_ps(SH_Y00);
+    const __m128 y1 = _mm_set1_ps(SH_Y1);
+    const __m128 y2 = _mm_set1_ps(SH_Y2);
+    const __m128 y20 = _mm_set1_ps(SH_Y20);
+    const __m128 y22 = _mm_set1_ps(SH_Y22);
+    const __m128 lane = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 sScale = _mm_set1_ps(2.0f * invSideLength);
+
+    for (; x + 4 <= side_length; x += 4) {
+        __m128 s = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(_mm_set1_ps((f32)x), lane), sScale), one);
+
+        __m128 dx = _mm_add_ps(_mm_set1_ps(origin.x), _mm_mul_ps(_mm_set1_ps(sAxis.x), s));
+        __m128 dy = _mm_add_ps(_mm_set1_ps(origin.y), _mm_mul_ps(_mm_set1_ps(sAxis.y), s));
+        __m128 dz = _mm_add_ps(_mm_set1_ps(origin.z), _mm_mul_ps(_mm_set1_ps(sAxis.z), s));
+
+        // the unnormalized direction has a length of sqrt(1 + s^2 + t^2) and the solid angle of a texel is
+        // proportional to 1 / (1 + s^2 + t^2)^(3/2)
+        __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        __m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(lengthSquared));
+        __m128 weight = _mm_mul_ps(invLength, _mm_mul_ps(invLength, invLength));
+        weightAccumulator = _mm_add_ps(weightAccumulator, weight);
+
+        dx = _mm_mul_ps(dx, invLength);
+        dy = _mm_mul_ps(dy, invLength);
+        dz = _mm_mul_ps(dz, invLength);
+
+        __m128 basis[9] = {
+            y00,
+            _mm_mul_ps(y1, dy),
+            _mm_mul_ps(y1, dz),
+            _mm_mul_ps(y1, dx),
+            _mm_mul_ps(y2, _mm_mul_ps(dx, dy)),
+            _mm_mul_ps(y2, _mm_mul_ps(dy, dz)),
+            _mm_mul_ps(y20, _mm_sub_ps(_mm_mul_ps(three, _mm_mul_ps(dz, dz)), one)),
+            _mm_mul_ps(y2, _mm_mul_ps(dx, dz)),
+            _mm_mul_ps(y22, _mm_sub_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)))
+        };
+
+        const f32 *p = row + x * 3;
+        __m128 colors[3] = {
+            _mm_mul_ps(weight, _mm_setr_ps(p[0], p[3], p[6], p[9])),
+            _mm_mul_ps(weight, _mm_setr_ps(p[1], p[4], p[7], p[10])),
+            _mm_mul_ps(weight, _mm_setr_ps(p[2], p[5], p[8], p[11]))
+        };
+
+        for (u32 i = 0; i < 9; ++i) {
+            for (u32 c = 0; c < 3; ++c) {
+                accumulators[i * 3 + c] = _mm_add_ps(accumulators[i * 3 + c], _mm_mul_ps(basis[i], colors[c]));
+            }
+        }
+    }
+
+    // horizontal sums
+    alignas(16) f32 lanes[4];
+    for (u32 i = 0; i < 9; ++i) {
+        for (u32 c = 0; c < 3; ++c) {
+            _mm_store_ps(lanes, accumulators[i * 3 + c]);
+            sh->coefficients[i][c] += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        }
+    }
+    _mm_store_ps(lanes, weightAccumulator);
+    weightSum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+
+    // remaining texels
+    for (; x < side_length; ++x) {
+        f32 s = 2.0f * (x + 0.5f) * invSideLength - 1.0f;
+        glm::vec3 dir = utils::cubemap_face_direction(face, s, t);
+
+        f32 invLength = 1.0f / glm::length(dir);
+        f32 weight = invLength * invLength * invLength;
+        weightSum += weight;
+
+        const f32 *p = row + x * 3;
+        accumulate_texel(sh, dir * invLength, glm::vec3(p[0], p[1], p[2]), weight);
+    }
+
+    return weightSum;
+}
+
+namespace sh {
+ShCoefficients project_cubemap(const f32 *const faces[6], u32 side_length) {
+    ShCoefficients result;
+    f32 weightSum = 0;
+    std::mutex resultMutex;
+
+    // Split every face into blocks of rows
+    u32 rowBlocksPerFace = (side_length + ROWS_PER_JOB - 1) / ROWS_PER_JOB;
+    core->jobSystem.parallelFor(6 * rowBlocksPerFace, 1, [&](u32 begin, u32 end) {
+        ShCoefficients partial;
+        f32 partialWeightSum = 0;
+
+        for (u32 block = begin; block < end; ++block) {
+            u32 face = block / rowBlocksPerFace;
+            u32 firstRow = (block % rowBlocksPerFace) * ROWS_PER_JOB;
+            u32 lastRow = std::min(side_length, firstRow + ROWS_PER_JOB);
+
+            for (u32 y = firstRow; y < lastRow; ++y) {
+                f32 t = 2.0f * (y + 0.5f) / side_length - 1.0f;
+                const f32 *row = faces[face] + (u64)y * side_length * 3;
+                partialWeightSum += project_row(&partial, row, face, t, side_length);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(resultMutex);
+        for (u32 i = 0; i < 9; ++i) {
+            result.coefficients[i] += partial.coefficients[i];
+        }
+        weightSum += partialWeightSum;
+    });
+
+    // The weights over the whole sphere should add up to 4pi, normalizing by the sum corrects for the
+    // approximation of the solid angle of each texel
+    f32 normalization = 4.0f * glm::pi<f32>() / weightSum;
+    for (auto &coefficient : result.coefficients) {
+        coefficient *= normalization;
+    }
+
+    return result;
+}
+
+ShCoefficients radiance_to_irradiance(const ShCoefficients &radiance) {
+    // Ramamoorthi and Hanrahan, An Efficient Representation for Irradiance Environment Maps, 2001
+    // Band factors of the clamped cosine lobe (pi, 2pi/3, pi/4) divided by pi
+    const f32 bandFactors[3] = {1.0f, 2.0f / 3.0f, 0.25f};
+    const u32 bands[9] = {0, 1, 1, 1, 2, 2, 2, 2, 2};
+
+    ShCoefficients irradiance;
+    for (u32 i = 0; i < 9; ++i) {
+        irradiance.coefficients[i] = radiance.coefficients[i] * bandFactors[bands[i]];
+    }
+
+    return irradiance;
+}
+}
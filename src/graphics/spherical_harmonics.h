@@ -0,0 +1,23 @@
+#ifndef ACORN_SPHERICAL_HARMONICS_H
+#define ACORN_SPHERICAL_HARMONICS_H
+
+#include "types.h"
+#include <glm/glm.hpp>
+
+/// RGB coefficients of an L2 (9 coefficient) real spherical harmonics expansion
+struct ShCoefficients {
+    glm::vec3 coefficients[9] = {};
+};
+
+namespace sh {
+/// Project a cubemap onto spherical harmonics on the job system, weighting every texel by its solid angle
+/// \param faces Tightly packed RGB float data for each face, same order as GL_TEXTURE_CUBE_MAP_POSITIVE_X + face
+/// \param side_length Side length of each face in texels
+ShCoefficients project_cubemap(const f32 *const faces[6], u32 side_length);
+
+/// Convolve radiance with a clamped cosine lobe and divide by pi. The result can be evaluated in a direction to
+/// get the diffuse irradiance term that is multiplied with albedo in material.frag
+ShCoefficients radiance_to_irradiance(const ShCoefficients &radiance);
+}
+
+#endif //ACORN_SPHERICAL_HARMONICS_H
@@ -2,6 +2,7 @@
 #include "utils.h"
 #include "log.h"
 #include <GL/gl3w.h>
+#include <algorithm>
 
 Texture::Texture() {
     glGenTextures(1, &m_id);
@@ -12,12 +13,13 @@ Texture::Texture() {
 }
 
 Texture::Texture(Texture &&other) noexcept
-    : m_id(other.m_id) {
+    : m_id(other.m_id), m_hasCutout(other.m_hasCutout) {
     other.m_id = 0;
 }
 
 Texture &Texture::operator=(Texture &&other) noexcept {
     m_id = other.m_id;
+    m_hasCutout = other.m_hasCutout;
     other.m_id = 0;
     return *this;
 }
@@ -46,9 +48,32 @@ void Texture2D::setImage(int width, int height, TextureFormatEnum format, void *
     glTexImage2D(GL_TEXTURE_2D, 0, textureFormat, width, height, 0, dataFormat, dataType, data);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glGenerateMipmap(GL_TEXTURE_2D);
+
+    // depth is read texel by texel and has no use for mipmaps
+    if (format == TextureFormatEnum::DEPTH32F) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    } else {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, previouslyBound);
+}
+
+void Texture2D::getImage(TextureFormatEnum format, void *data, u32 level) const {
+    s32 previouslyBound;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &previouslyBound);
+
+    u32 textureFormat, dataFormat, dataType;
+    utils::get_format_info(format, &textureFormat, &dataFormat, &dataType);
+
+    glBindTexture(GL_TEXTURE_2D, getId());
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTexImage(GL_TEXTURE_2D, level, dataFormat, dataType, data);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
 
     glBindTexture(GL_TEXTURE_2D, previouslyBound);
 }
@@ -68,7 +93,7 @@ void TextureCubemap::bind(u32 unit) const {
     glBindTexture(GL_TEXTURE_CUBE_MAP, getId());
 }
 
-void TextureCubemap::setImage(int side_length, TextureFormatEnum format, void **data) {
+void TextureCubemap::setImage(int side_length, TextureFormatEnum format, void **data, PixelDataTypeEnum data_type) {
     m_sideLength = side_length;
 
     s32 previouslyBound;
@@ -76,6 +101,9 @@ void TextureCubemap::setImage(int side_length, TextureFormatEnum format, void **
 
     u32 textureFormat, dataFormat, dataType;
     utils::get_format_info(format, &textureFormat, &dataFormat, &dataType);
+    if (data_type == PixelDataTypeEnum::HALF_FLOAT) {
+        dataType = GL_HALF_FLOAT;
+    }
 
     glBindTexture(GL_TEXTURE_CUBE_MAP, getId());
     for (u32 i = 0; i < 6; ++i) {
@@ -92,6 +120,39 @@ void TextureCubemap::setImage(int side_length, TextureFormatEnum format, void **
     glBindTexture(GL_TEXTURE_CUBE_MAP, previouslyBound);
 }
 
+void TextureCubemap::setFaceImage(u32 face, u32 level, TextureFormatEnum format, const void *data) {
+    s32 previouslyBound;
+    glGetIntegerv(GL_TEXTURE_BINDING_CUBE_MAP, &previouslyBound);
+
+    u32 textureFormat, dataFormat, dataType;
+    utils::get_format_info(format, &textureFormat, &dataFormat, &dataType);
+
+    u32 levelSideLength = std::max(1u, m_sideLength >> level);
+
+    glBindTexture(GL_TEXTURE_CUBE_MAP, getId());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, 0, 0, levelSideLength, levelSideLength, dataFormat,
+                    dataType, data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glBindTexture(GL_TEXTURE_CUBE_MAP, previouslyBound);
+}
+
+void TextureCubemap::getFaceImage(u32 face, u32 level, TextureFormatEnum format, void *data) const {
+    s32 previouslyBound;
+    glGetIntegerv(GL_TEXTURE_BINDING_CUBE_MAP, &previouslyBound);
+
+    u32 textureFormat, dataFormat, dataType;
+    utils::get_format_info(format, &textureFormat, &dataFormat, &dataType);
+
+    glBindTexture(GL_TEXTURE_CUBE_MAP, getId());
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, dataFormat, dataType, data);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+    glBindTexture(GL_TEXTURE_CUBE_MAP, previouslyBound);
+}
+
 void TextureCubemap::generateMipmap() const {
     s32 previouslyBound;
     glGetIntegerv(GL_TEXTURE_BINDING_CUBE_MAP, &previouslyBound);
@@ -101,3 +162,108 @@ void TextureCubemap::generateMipmap() const {
 
     glBindTexture(GL_TEXTURE_CUBE_MAP, previouslyBound);
 }
+
+void Texture2DArray::bind(u32 unit) const {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, getId());
+}
+
+void Texture2DArray::setImage(int width, int height, int layers, TextureFormatEnum format) {
+    m_width = width;
+    m_height = height;
+    m_layers = layers;
+
+    s32 previouslyBound;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &previouslyBound);
+
+    u32 textureFormat, dataFormat, dataType;
+    utils::get_format_info(format, &textureFormat, &dataFormat, &dataType);
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, getId());
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, textureFormat, width, height, layers, 0, dataFormat, dataType, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+
+    if (format == TextureFormatEnum::DEPTH32F) {
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    }
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, previouslyBound);
+}
+
+void Texture3D::bind(u32 unit) const {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_3D, getId());
+}
+
+void Texture3D::setImage(int side_length, TextureFormatEnum format, const void *data) {
+    m_sideLength = side_length;
+
+    s32 previouslyBound;
+    glGetIntegerv(GL_TEXTURE_BINDING_3D, &previouslyBound);
+
+    u32 textureFormat, dataFormat, dataType;
+    utils::get_format_info(format, &textureFormat, &dataFormat, &dataType);
+
+    glBindTexture(GL_TEXTURE_3D, getId());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage3D(GL_TEXTURE_3D, 0, textureFormat, side_length, side_length, side_length, 0, dataFormat, dataType,
+                 data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, 0);
+
+    glBindTexture(GL_TEXTURE_3D, previouslyBound);
+}
+
+TextureBuffer::TextureBuffer() {
+    glGenBuffers(1, &m_bufferId);
+    if (m_bufferId == 0) {
+        Log::fatal("Failed to create buffer for TextureBuffer");
+    }
+    Log::debug("TextureBuffer::TextureBuffer() - #%d", getId());
+}
+
+TextureBuffer::~TextureBuffer() {
+    Log::debug("TextureBuffer::~TextureBuffer() - #%d", getId());
+    glDeleteBuffers(1, &m_bufferId);
+}
+
+void TextureBuffer::bind(u32 unit) const {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_BUFFER, getId());
+}
+
+void TextureBuffer::setData(TextureFormatEnum format, const void *data, u64 size) {
+    s32 previouslyBoundBuffer, previouslyBoundTexture;
+    glGetIntegerv(GL_TEXTURE_BINDING_BUFFER, &previouslyBoundTexture);
+    glGetIntegerv(GL_TEXTURE_BUFFER_BINDING, &previouslyBoundBuffer);
+
+    // grow geometrically, an empty buffer still gets storage so the texture can be sampled
+    if (size > m_capacity || m_capacity == 0) {
+        m_capacity = std::max<u64>(std::max<u64>(size, m_capacity + m_capacity / 2), 64);
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, m_bufferId);
+    glBufferData(GL_TEXTURE_BUFFER, m_capacity, nullptr, GL_STREAM_DRAW);
+    if (size > 0) {
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+    }
+
+    u32 textureFormat, dataFormat, dataType;
+    utils::get_format_info(format, &textureFormat, &dataFormat, &dataType);
+
+    glBindTexture(GL_TEXTURE_BUFFER, getId());
+    glTexBuffer(GL_TEXTURE_BUFFER, textureFormat, m_bufferId);
+
+    glBindTexture(GL_TEXTURE_BUFFER, previouslyBoundTexture);
+    glBindBuffer(GL_TEXTURE_BUFFER, previouslyBoundBuffer);
+}
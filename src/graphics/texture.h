@@ -6,7 +6,12 @@
 #include <string>
 
 enum class TextureFormatEnum {
-    R8, RGB8, RGBA8, RG16F, RGB16F, RGBA16F, RGB32F, RGBA32F
+    R8, RGB8, RGBA8, RG16F, RGB16F, RGBA16F, RGB32F, RGBA32F, R16UI, RG32UI, DEPTH32F, R11F_G11F_B10F, R16F, R32F
+};
+
+/// Type of the pixel data passed to a texture, float formats take 32-bit floats by default
+enum class PixelDataTypeEnum {
+    DEFAULT, HALF_FLOAT
 };
 
 class Texture {
@@ -22,8 +27,18 @@ public:
         return m_id;
     }
 
+    /// Whether alpha testing discards any texels, so surfaces with this albedo texture can have holes
+    bool hasCutout() const {
+        return m_hasCutout;
+    }
+
+    void setHasCutout(bool has_cutout) {
+        m_hasCutout = has_cutout;
+    }
+
 private:
     u32 m_id;
+    bool m_hasCutout = false;
 };
 
 class Texture2D : public Texture {
@@ -35,6 +50,9 @@ public:
 
     void setImage(int width, int height, TextureFormatEnum format, void *data = nullptr);
 
+    /// Read back a mipmap level into data, which must be large enough for the level
+    void getImage(TextureFormatEnum format, void *data, u32 level = 0) const;
+
     void generateMipmap() const;
 
     u32 getWidth() const {
@@ -57,7 +75,15 @@ public:
 
     void bind(u32 unit) const override;
 
-    void setImage(int side_length, TextureFormatEnum format, void *data[6] = nullptr);
+    void setImage(int side_length, TextureFormatEnum format, void *data[6] = nullptr,
+                  PixelDataTypeEnum data_type = PixelDataTypeEnum::DEFAULT);
+
+    /// Replace the contents of a single face and mipmap level of an already allocated cubemap
+    /// \param face Face index (0 is positive x, same order as GL_TEXTURE_CUBE_MAP_POSITIVE_X + face)
+    void setFaceImage(u32 face, u32 level, TextureFormatEnum format, const void *data);
+
+    /// Read back a single face and mipmap level into data, which must be large enough for the level
+    void getFaceImage(u32 face, u32 level, TextureFormatEnum format, void *data) const;
 
     void generateMipmap() const;
 
@@ -69,4 +95,68 @@ private:
     u32 m_sideLength;
 };
 
+class Texture2DArray : public Texture {
+public:
+    /// Inherit constructors
+    using Texture::Texture;
+
+    void bind(u32 unit) const override;
+
+    /// Allocate storage for all layers without mipmaps. Depth formats are set up for depth comparison, so they can
+    /// be sampled with sampler2DArrayShadow
+    void setImage(int width, int height, int layers, TextureFormatEnum format);
+
+    u32 getWidth() const {
+        return m_width;
+    }
+
+    u32 getHeight() const {
+        return m_height;
+    }
+
+    u32 getLayers() const {
+        return m_layers;
+    }
+
+private:
+    u32 m_width = 0;
+    u32 m_height = 0;
+    u32 m_layers = 0;
+};
+
+/// Cube of texels with linear filtering, for lookup tables over three inputs
+class Texture3D : public Texture {
+public:
+    /// Inherit constructors
+    using Texture::Texture;
+
+    void bind(u32 unit) const override;
+
+    void setImage(int side_length, TextureFormatEnum format, const void *data = nullptr);
+
+    u32 getSideLength() const {
+        return m_sideLength;
+    }
+
+private:
+    u32 m_sideLength = 0;
+};
+
+/// Texture that reads texels from a buffer object, for per-frame data that is too large for uniforms
+class TextureBuffer : public Texture {
+public:
+    TextureBuffer();
+    ~TextureBuffer() override;
+
+    void bind(u32 unit) const override;
+
+    /// Replace the contents of the buffer, the old contents are orphaned so this doesn't wait for the GPU
+    /// \param size Size of data in bytes
+    void setData(TextureFormatEnum format, const void *data, u64 size);
+
+private:
+    u32 m_bufferId = 0;
+    u64 m_capacity = 0;
+};
+
 #endif //ACORN_TEXTURE_H
@@ -0,0 +1,49 @@
+#include "uniform_buffer.h"
+#include "log.h"
+#include <GL/gl3w.h>
+
+UniformBuffer::UniformBuffer(u32 binding)
+    : m_binding(binding) {
+    glGenBuffers(1, &m_id);
+    if (m_id == 0) {
+        Log::fatal("Failed to create UniformBuffer");
+    }
+    Log::debug("UniformBuffer::UniformBuffer(%d) - #%d", binding, m_id);
+}
+
+UniformBuffer::UniformBuffer(UniformBuffer &&other) noexcept
+    : m_id(other.m_id), m_binding(other.m_binding), m_size(other.m_size) {
+    other.m_id = 0;
+}
+
+UniformBuffer &UniformBuffer::operator=(UniformBuffer &&other) noexcept {
+    m_id = other.m_id;
+    m_binding = other.m_binding;
+    m_size = other.m_size;
+    other.m_id = 0;
+    return *this;
+}
+
+UniformBuffer::~UniformBuffer() {
+    Log::debug("UniformBuffer::~UniformBuffer() - #%d", m_id);
+    glDeleteBuffers(1, &m_id);
+}
+
+void UniformBuffer::setData(const void *data, u32 size) {
+    s32 previouslyBound;
+    glGetIntegerv(GL_UNIFORM_BUFFER_BINDING, &previouslyBound);
+
+    glBindBuffer(GL_UNIFORM_BUFFER, m_id);
+    if (size != m_size) {
+        glBufferData(GL_UNIFORM_BUFFER, size, data, GL_DYNAMIC_DRAW);
+        m_size = size;
+    } else {
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, previouslyBound);
+}
+
+void UniformBuffer::bind() const {
+    glBindBufferBase(GL_UNIFORM_BUFFER, m_binding, m_id);
+}
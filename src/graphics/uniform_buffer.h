@@ -0,0 +1,30 @@
+#ifndef ACORN_UNIFORM_BUFFER_H
+#define ACORN_UNIFORM_BUFFER_H
+
+#include "types.h"
+
+/// OpenGL uniform buffer object that is bound to a fixed binding point
+class UniformBuffer {
+public:
+    explicit UniformBuffer(u32 binding);
+    UniformBuffer(UniformBuffer &&other) noexcept;
+    UniformBuffer &operator=(UniformBuffer &&other) noexcept;
+    ~UniformBuffer();
+
+    /// Upload data to the buffer, reallocating if the size changed. Data should follow the std140 layout rules
+    void setData(const void *data, u32 size);
+
+    /// Bind buffer to its binding point
+    void bind() const;
+
+    u32 getBinding() const {
+        return m_binding;
+    }
+
+private:
+    u32 m_id = 0;
+    u32 m_binding = 0;
+    u32 m_size = 0;
+};
+
+#endif //ACORN_UNIFORM_BUFFER_H
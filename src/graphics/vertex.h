@@ -7,8 +7,7 @@ struct Vertex {
     glm::vec3 position;
     glm::vec3 normal;
     glm::vec2 uv;
-    glm::vec3 tangent;
-    glm::vec3 biTangent;
+    glm::vec4 tangent;  // w is the sign of the bi-tangent, which is cross(normal, tangent) * w like in MikkTSpace
 };
 
 #endif //ACORN_VERTEX_H
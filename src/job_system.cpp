@@ -0,0 +1,109 @@
+#include "job_system.h"
+#include "log.h"
+
+JobSystem::JobSystem() {
+    u32 numWorkers = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    Log::debug("JobSystem::JobSystem() - %d workers", numWorkers);
+
+    m_workers.reserve(numWorkers);
+    for (u32 i = 0; i < numWorkers; ++i) {
+        m_workers.emplace_back(&JobSystem::workerLoop, this);
+    }
+}
+
+JobSystem::~JobSystem() {
+    Log::debug("JobSystem::~JobSystem()");
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_shuttingDown = true;
+    }
+    m_wakeCondition.notify_all();
+
+    for (auto &worker : m_workers) {
+        worker.join();
+    }
+}
+
+void JobSystem::parallelFor(u32 count, u32 grain_size, const std::function<void(u32, u32)> &func) {
+    if (count == 0) {
+        return;
+    }
+
+    grain_size = std::max(1u, grain_size);
+    u32 numRanges = (count + grain_size - 1) / grain_size;
+
+    // Not worth the synchronization
+    if (numRanges == 1 || m_workers.empty()) {
+        func(0, count);
+        return;
+    }
+
+    std::atomic<u32> remaining(numRanges);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (u32 begin = 0; begin < count; begin += grain_size) {
+            u32 end = std::min(count, begin + grain_size);
+            m_jobs.emplace_back([&func, &remaining, begin, end]() {
+                func(begin, end);
+                remaining.fetch_sub(1, std::memory_order_release);
+            });
+        }
+    }
+    m_wakeCondition.notify_all();
+
+    // Help out instead of idling while our ranges are processed
+    std::function<void()> job;
+    while (remaining.load(std::memory_order_acquire) > 0) {
+        if (tryPopJob(&job)) {
+            job();
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::submit(std::function<void()> job) {
+    if (m_workers.empty()) {
+        job();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.emplace_back(std::move(job));
+    }
+    m_wakeCondition.notify_one();
+}
+
+void JobSystem::workerLoop() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeCondition.wait(lock, [this]() {
+                return m_shuttingDown || !m_jobs.empty();
+            });
+
+            if (m_shuttingDown && m_jobs.empty()) {
+                return;
+            }
+
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+
+        job();
+    }
+}
+
+bool JobSystem::tryPopJob(std::function<void()> *job) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_jobs.empty()) {
+        return false;
+    }
+
+    *job = std::move(m_jobs.front());
+    m_jobs.pop_front();
+    return true;
+}
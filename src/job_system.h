@@ -0,0 +1,44 @@
+#ifndef ACORN_JOB_SYSTEM_H
+#define ACORN_JOB_SYSTEM_H
+
+#include "types.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Pool of worker threads that CPU heavy work can be split across
+class JobSystem {
+public:
+    JobSystem();
+    ~JobSystem();
+
+    /// Run func over [0, count) split into ranges of at most grain_size elements and wait until all are done.
+    /// The calling thread works on ranges too, so this is safe to call from inside of a job.
+    void parallelFor(u32 count, u32 grain_size, const std::function<void(u32 begin, u32 end)> &func);
+
+    /// Queue a job without waiting for it to finish
+    void submit(std::function<void()> job);
+
+    /// Number of threads that can work on jobs at the same time, including the calling thread
+    u32 getNumThreads() const {
+        return m_workers.size() + 1;
+    }
+
+private:
+    void workerLoop();
+
+    /// Pop a queued job if there is one
+    bool tryPopJob(std::function<void()> *job);
+
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()>> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeCondition;
+    bool m_shuttingDown = false;
+};
+
+#endif //ACORN_JOB_SYSTEM_H
@@ -0,0 +1,307 @@
+#include "json.h"
+#include "log.h"
+#include <cstdlib>
+#include <cstring>
+
+static const JsonValue NULL_VALUE;
+
+// deeper documents are rejected instead of running out of stack
+constexpr u32 MAX_DEPTH = 256;
+
+const JsonValue &JsonValue::operator[](u32 index) const {
+    if (m_type != Type::ARRAY || index >= m_elements.size()) {
+        return NULL_VALUE;
+    }
+    return m_elements[index];
+}
+
+const JsonValue &JsonValue::operator[](const char *key) const {
+    for (const auto &member : m_members) {
+        if (member.first == key) {
+            return member.second;
+        }
+    }
+    return NULL_VALUE;
+}
+
+bool JsonValue::has(const char *key) const {
+    for (const auto &member : m_members) {
+        if (member.first == key) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// Recursive descent parser, fails on the first error
+class JsonParser {
+public:
+    JsonParser(const char *text, u64 length)
+        : m_current(text), m_begin(text), m_end(text + length) {}
+
+    bool parseDocument(JsonValue *root) {
+        if (!parseValue(root, 0)) {
+            return false;
+        }
+        skipWhitespace();
+        return m_current == m_end || fail("unexpected text after the document");
+    }
+
+private:
+    bool fail(const char *error) {
+        Log::warn("Failed to parse JSON at offset %d: %s", (u32)(m_current - m_begin), error);
+        return false;
+    }
+
+    void skipWhitespace() {
+        while (m_current < m_end && (*m_current == ' ' || *m_current == '\t' || *m_current == '\n' ||
+                                     *m_current == '\r')) {
+            ++m_current;
+        }
+    }
+
+    bool consume(const char *literal) {
+        u64 length = std::strlen(literal);
+        if ((u64)(m_end - m_current) < length || std::memcmp(m_current, literal, length) != 0) {
+            return false;
+        }
+        m_current += length;
+        return true;
+    }
+
+    bool parseValue(JsonValue *value, u32 depth) {
+        if (depth > MAX_DEPTH) {
+            return fail("document is nested too deeply");
+        }
+
+        skipWhitespace();
+        if (m_current == m_end) {
+            return fail("unexpected end of document");
+        }
+
+        switch (*m_current) {
+            case '{':
+                return parseObject(value, depth);
+            case '[':
+                return parseArray(value, depth);
+            case '"':
+                value->m_type = JsonValue::Type::STRING;
+                return parseString(&value->m_string);
+            case 't':
+            case 'f':
+                value->m_type = JsonValue::Type::BOOLEAN;
+                value->m_bool = *m_current == 't';
+                return consume(value->m_bool ? "true" : "false") || fail("invalid literal");
+            case 'n':
+                value->m_type = JsonValue::Type::NUL;
+                return consume("null") || fail("invalid literal");
+            default:
+                return parseNumber(value);
+        }
+    }
+
+    bool parseObject(JsonValue *value, u32 depth) {
+        value->m_type = JsonValue::Type::OBJECT;
+        ++m_current;
+
+        skipWhitespace();
+        if (consume("}")) {
+            return true;
+        }
+
+        while (true) {
+            skipWhitespace();
+            std::string key;
+            if (m_current == m_end || *m_current != '"' || !parseString(&key)) {
+                return fail("expected a member name");
+            }
+
+            skipWhitespace();
+            if (!consume(":")) {
+                return fail("expected ':'");
+            }
+
+            value->m_members.emplace_back(std::move(key), JsonValue());
+            if (!parseValue(&value->m_members.back().second, depth + 1)) {
+                return false;
+            }
+
+            skipWhitespace();
+            if (consume("}")) {
+                return true;
+            }
+            if (!consume(",")) {
+                return fail("expected ',' or '}'");
+            }
+        }
+    }
+
+    bool parseArray(JsonValue *value, u32 depth) {
+        value->m_type = JsonValue::Type::ARRAY;
+        ++m_current;
+
+        skipWhitespace();
+        if (consume("]")) {
+            return true;
+        }
+
+        while (true) {
+            value->m_elements.emplace_back();
+            if (!parseValue(&value->m_elements.back(), depth + 1)) {
+                return false;
+            }
+
+            skipWhitespace();
+            if (consume("]")) {
+                return true;
+            }
+            if (!consume(",")) {
+                return fail("expected ',' or ']'");
+            }
+        }
+    }
+
+    bool parseHex4(u32 *code_unit) {
+        if (m_end - m_current < 4) {
+            return fail("truncated unicode escape");
+        }
+
+        *code_unit = 0;
+        for (u32 i = 0; i < 4; ++i) {
+            char c = *m_current++;
+            u32 digit;
+            if (c >= '0' && c <= '9') {
+                digit = c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                digit = c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                digit = c - 'A' + 10;
+            } else {
+                return fail("invalid unicode escape");
+            }
+            *code_unit = *code_unit * 16 + digit;
+        }
+        return true;
+    }
+
+    static void append_utf8(u32 code_point, std::string *string) {
+        if (code_point < 0x80) {
+            string->push_back((char)code_point);
+        } else if (code_point < 0x800) {
+            string->push_back((char)(0xc0 | (code_point >> 6)));
+            string->push_back((char)(0x80 | (code_point & 0x3f)));
+        } else if (code_point < 0x10000) {
+            string->push_back((char)(0xe0 | (code_point >> 12)));
+            string->push_back((char)(0x80 | ((code_point >> 6) & 0x3f)));
+            string->push_back((char)(0x80 | (code_point & 0x3f)));
+        } else {
+            string->push_back((char)(0xf0 | (code_point >> 18)));
+            string->push_back((char)(0x80 | ((code_point >> 12) & 0x3f)));
+            string->push_back((char)(0x80 | ((code_point >> 6) & 0x3f)));
+            string->push_back((char)(0x80 | (code_point & 0x3f)));
+        }
+    }
+
+    bool parseString(std::string *string) {
+        ++m_current;
+
+        while (true) {
+            // copy unescaped runs at once
+            const char *runBegin = m_current;
+            while (m_current < m_end && *m_current != '"' && *m_current != '\\') {
+                ++m_current;
+            }
+            string->append(runBegin, m_current);
+
+            if (m_current == m_end) {
+                return fail("unterminated string");
+            }
+            if (*m_current++ == '"') {
+                return true;
+            }
+
+            if (m_current == m_end) {
+                return fail("unterminated string");
+            }
+            char escape = *m_current++;
+            switch (escape) {
+                case '"':
+                case '\\':
+                case '/':
+                    string->push_back(escape);
+                    break;
+                case 'b':
+                    string->push_back('\b');
+                    break;
+                case 'f':
+                    string->push_back('\f');
+                    break;
+                case 'n':
+                    string->push_back('\n');
+                    break;
+                case 'r':
+                    string->push_back('\r');
+                    break;
+                case 't':
+                    string->push_back('\t');
+                    break;
+                case 'u': {
+                    u32 codePoint;
+                    if (!parseHex4(&codePoint)) {
+                        return false;
+                    }
+
+                    // characters outside the basic plane are escaped as a surrogate pair
+                    if (codePoint >= 0xd800 && codePoint < 0xdc00) {
+                        u32 low;
+                        if (!consume("\\u") || !parseHex4(&low) || low < 0xdc00 || low >= 0xe000) {
+                            return fail("invalid surrogate pair");
+                        }
+                        codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+                    }
+                    append_utf8(codePoint, string);
+                    break;
+                }
+                default:
+                    return fail("invalid escape");
+            }
+        }
+    }
+
+    static bool is_number_char(char c) {
+        return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+    }
+
+    bool parseNumber(JsonValue *value) {
+        const char *numberBegin = m_current;
+        while (m_current < m_end && is_number_char(*m_current)) {
+            ++m_current;
+        }
+
+        // strtod needs a terminated string, numbers are short
+        char buffer[64];
+        u64 length = m_current - numberBegin;
+        if (length == 0 || length >= sizeof(buffer)) {
+            return fail("invalid value");
+        }
+        std::memcpy(buffer, numberBegin, length);
+        buffer[length] = '\0';
+
+        char *parsedEnd;
+        value->m_type = JsonValue::Type::NUMBER;
+        value->m_number = std::strtod(buffer, &parsedEnd);
+        return parsedEnd == buffer + length || fail("invalid number");
+    }
+
+    const char *m_current;
+    const char *m_begin;
+    const char *m_end;
+};
+
+namespace json {
+bool parse(const char *text, u64 length, JsonValue *root) {
+    *root = JsonValue();
+    JsonParser parser(text, length);
+    return parser.parseDocument(root);
+}
+}
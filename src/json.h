@@ -0,0 +1,91 @@
+#ifndef ACORN_JSON_H
+#define ACORN_JSON_H
+
+#include "types.h"
+#include <string>
+#include <utility>
+#include <vector>
+
+/// A parsed JSON value. Looking up a missing member or element gives a null value, so lookups can be chained
+class JsonValue {
+public:
+    enum class Type {
+        NUL = 0,
+        BOOLEAN,
+        NUMBER,
+        STRING,
+        ARRAY,
+        OBJECT
+    };
+
+    Type getType() const {
+        return m_type;
+    }
+
+    bool isNull() const {
+        return m_type == Type::NUL;
+    }
+
+    bool isNumber() const {
+        return m_type == Type::NUMBER;
+    }
+
+    bool isString() const {
+        return m_type == Type::STRING;
+    }
+
+    bool isArray() const {
+        return m_type == Type::ARRAY;
+    }
+
+    bool isObject() const {
+        return m_type == Type::OBJECT;
+    }
+
+    /// \return The boolean, or fallback if this isn't one
+    bool getBool(bool fallback = false) const {
+        return m_type == Type::BOOLEAN ? m_bool : fallback;
+    }
+
+    /// \return The number, or fallback if this isn't one
+    f64 getNumber(f64 fallback = 0.0) const {
+        return m_type == Type::NUMBER ? m_number : fallback;
+    }
+
+    /// \return The string, empty if this isn't one
+    const std::string &getString() const {
+        return m_string;
+    }
+
+    /// Number of elements of an array or members of an object
+    u32 size() const {
+        return m_type == Type::OBJECT ? m_members.size() : m_elements.size();
+    }
+
+    /// Get an element of an array, null if out of range
+    const JsonValue &operator[](u32 index) const;
+
+    /// Get a member of an object, null if it doesn't exist
+    const JsonValue &operator[](const char *key) const;
+
+    /// Whether an object has a member
+    bool has(const char *key) const;
+
+private:
+    friend class JsonParser;
+
+    Type m_type = Type::NUL;
+    bool m_bool = false;
+    f64 m_number = 0.0;
+    std::string m_string;
+    std::vector<JsonValue> m_elements;
+    std::vector<std::pair<std::string, JsonValue>> m_members;
+};
+
+namespace json {
+/// Parse a JSON document
+/// \return Whether the text was valid JSON, errors are logged as warnings
+bool parse(const char *text, u64 length, JsonValue *root);
+}
+
+#endif //ACORN_JSON_H
@@ -0,0 +1,24 @@
+#ifndef ACORN_LIGHT_H
+#define ACORN_LIGHT_H
+
+#include "types.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+enum class LightTypeEnum : u32 {
+    POINT = 0,
+    SPOT
+};
+
+/// Punctual light, shaded through the clustered light lists
+struct Light {
+    LightTypeEnum type = LightTypeEnum::POINT;
+    glm::vec3 position = glm::vec3(0);
+    glm::vec3 direction = glm::vec3(0, -1, 0);      // spot lights only, unit vector the light shines along
+    glm::vec3 color = glm::vec3(1);                 // linear radiant intensity
+    f32 range = 10.0f;                              // distance at which the light has faded out completely
+    f32 innerConeAngle = 0.0f;                      // spot lights only, half angles in radians
+    f32 outerConeAngle = glm::quarter_pi<f32>();
+};
+
+#endif //ACORN_LIGHT_H
@@ -0,0 +1,67 @@
+#include "light_benchmark.h"
+#include "scene.h"
+#include "constants.h"
+#include "log.h"
+#include <glm/gtc/constants.hpp>
+#include <random>
+
+void LightBenchmark::setEnabled(Scene &scene, bool enabled) {
+    if (enabled == m_enabled) {
+        return;
+    }
+    m_enabled = enabled;
+
+    if (!enabled) {
+        scene.lights.erase(scene.lights.begin() + m_firstLight, scene.lights.end());
+        m_orbits.clear();
+        return;
+    }
+
+    // same lights on every run, so timings can be compared
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<f32> unit(0.0f, 1.0f);
+
+    m_firstLight = scene.lights.size();
+    m_orbits.resize(consts::LIGHT_BENCHMARK_NUM_LIGHTS);
+    for (u32 i = 0; i < consts::LIGHT_BENCHMARK_NUM_LIGHTS; ++i) {
+        Orbit &orbit = m_orbits[i];
+        orbit.center = glm::vec3((unit(rng) * 2 - 1) * consts::LIGHT_BENCHMARK_EXTENT,
+                                 0.2f + unit(rng) * 4.0f,
+                                 (unit(rng) * 2 - 1) * consts::LIGHT_BENCHMARK_EXTENT);
+        orbit.radius = 0.5f + unit(rng) * 2.0f;
+        orbit.angularSpeed = (unit(rng) * 2 - 1) * glm::pi<f32>();
+        orbit.phase = unit(rng) * glm::two_pi<f32>();
+
+        Light light;
+        light.color = glm::vec3(unit(rng), unit(rng), unit(rng)) * 2.0f;
+        light.range = 1.0f + unit(rng) * 2.0f;
+
+        // every fourth light is a spot light pointing down
+        if (i % 4 == 0) {
+            light.type = LightTypeEnum::SPOT;
+            light.direction = glm::vec3(0, -1, 0);
+            light.innerConeAngle = 0.2f;
+            light.outerConeAngle = 0.5f;
+            light.range *= 2.0f;
+            light.color *= 4.0f;
+        }
+
+        scene.lights.emplace_back(light);
+    }
+
+    Log::info("Added %d benchmark lights", consts::LIGHT_BENCHMARK_NUM_LIGHTS);
+}
+
+void LightBenchmark::update(Scene &scene, f32 dt) {
+    if (!m_enabled) {
+        return;
+    }
+    m_time += dt;
+
+    for (u32 i = 0; i < m_orbits.size(); ++i) {
+        const Orbit &orbit = m_orbits[i];
+        f32 angle = orbit.phase + orbit.angularSpeed * m_time;
+        scene.lights[m_firstLight + i].position =
+            orbit.center + glm::vec3(std::cos(angle), 0, std::sin(angle)) * orbit.radius;
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef ACORN_LIGHT_BENCHMARK_H
+#define ACORN_LIGHT_BENCHMARK_H
+
+#include "types.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+class Scene;
+
+/// Fills the scene with many moving point and spot lights for profiling clustered lighting
+class LightBenchmark {
+public:
+    /// Add the benchmark lights to a scene or remove them again
+    void setEnabled(Scene &scene, bool enabled);
+
+    bool isEnabled() const {
+        return m_enabled;
+    }
+
+    /// Move the benchmark lights along their orbits
+    void update(Scene &scene, f32 dt);
+
+private:
+    struct Orbit {
+        glm::vec3 center;
+        f32 radius;
+        f32 angularSpeed;
+        f32 phase;
+    };
+
+    std::vector<Orbit> m_orbits;
+    u32 m_firstLight = 0;
+    f32 m_time = 0;
+    bool m_enabled = false;
+};
+
+#endif //ACORN_LIGHT_BENCHMARK_H
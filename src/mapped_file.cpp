@@ -0,0 +1,136 @@
+#include "mapped_file.h"
+#include "log.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : m_data(other.m_data), m_size(other.m_size) {
+#ifdef _WIN32
+    m_file = other.m_file;
+    m_mapping = other.m_mapping;
+    other.m_file = nullptr;
+    other.m_mapping = nullptr;
+#endif
+    other.m_data = nullptr;
+    other.m_size = 0;
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+        close();
+        m_data = other.m_data;
+        m_size = other.m_size;
+#ifdef _WIN32
+        m_file = other.m_file;
+        m_mapping = other.m_mapping;
+        other.m_file = nullptr;
+        other.m_mapping = nullptr;
+#endif
+        other.m_data = nullptr;
+        other.m_size = 0;
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string &path) {
+    close();
+
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        Log::warn("Failed to open '%s' for mapping", path.c_str());
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        Log::warn("Failed to map '%s', it is empty or its size is unknown", path.c_str());
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void *data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!data) {
+        Log::warn("Failed to map '%s'", path.c_str());
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        return false;
+    }
+
+    m_file = file;
+    m_mapping = mapping;
+    m_data = (const u8 *)data;
+    m_size = (u64)size.QuadPart;
+    return true;
+}
+
+void MappedFile::close() {
+    if (m_data) {
+        UnmapViewOfFile(m_data);
+        CloseHandle(m_mapping);
+        CloseHandle(m_file);
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_file = nullptr;
+    m_mapping = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const std::string &path) {
+    close();
+
+    s32 file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        Log::warn("Failed to open '%s' for mapping", path.c_str());
+        return false;
+    }
+
+    struct stat info = {};
+    if (fstat(file, &info) != 0 || info.st_size == 0) {
+        Log::warn("Failed to map '%s', it is empty or its size is unknown", path.c_str());
+        ::close(file);
+        return false;
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    void *data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file);
+    if (data == MAP_FAILED) {
+        Log::warn("Failed to map '%s'", path.c_str());
+        return false;
+    }
+
+    m_data = (const u8 *)data;
+    m_size = (u64)info.st_size;
+    return true;
+}
+
+void MappedFile::close() {
+    if (m_data) {
+        munmap((void *)m_data, m_size);
+    }
+    m_data = nullptr;
+    m_size = 0;
+}
+
+#endif
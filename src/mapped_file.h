@@ -0,0 +1,42 @@
+#ifndef ACORN_MAPPED_FILE_H
+#define ACORN_MAPPED_FILE_H
+
+#include "types.h"
+#include <string>
+
+/// A whole file mapped read-only into memory, pages are loaded by the OS as they are touched
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    /// Map a file, replacing the previous one
+    /// \return Whether the file could be mapped, empty files can't be
+    bool open(const std::string &path);
+
+    /// Unmap the file
+    void close();
+
+    const u8 *getData() const {
+        return m_data;
+    }
+
+    u64 getSize() const {
+        return m_size;
+    }
+
+private:
+    const u8 *m_data = nullptr;
+    u64 m_size = 0;
+#ifdef _WIN32
+    void *m_file = nullptr;
+    void *m_mapping = nullptr;
+#endif
+};
+
+#endif //ACORN_MAPPED_FILE_H
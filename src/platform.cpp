@@ -102,6 +102,22 @@ void Platform::init() {
         Log::fatal("Failed to init gl3w");
     }
 
+    // let the driver compile shaders on its own threads, programs are only checked when they are first used
+    const char *parallelCompileFunction = nullptr;
+    if (utils::is_gl_extension_supported("GL_KHR_parallel_shader_compile")) {
+        parallelCompileFunction = "glMaxShaderCompilerThreadsKHR";
+    } else if (utils::is_gl_extension_supported("GL_ARB_parallel_shader_compile")) {
+        parallelCompileFunction = "glMaxShaderCompilerThreadsARB";
+    }
+    if (parallelCompileFunction) {
+        auto maxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)gl3wGetProcAddress(
+            parallelCompileFunction);
+        if (maxShaderCompilerThreads) {
+            maxShaderCompilerThreads(0xFFFFFFFFu);
+            Log::debug("Parallel shader compilation enabled");
+        }
+    }
+
     glfwSwapInterval(core->gameState.renderOptions.vsyncNumSwapFrames);
 
     m_currentTime = glfwGetTime();
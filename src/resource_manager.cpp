@@ -17,7 +17,7 @@ ResourceManager::~ResourceManager() {
     destroy();
 }
 
-Model *ResourceManager::getModel(const std::string &path) {
+Model *ResourceManager::getModel(const std::string &path, const ModelImportOptions &options) {
     // See if model is already loaded
     auto it = m_models.find(path);
     if (it != m_models.end()) {
@@ -25,7 +25,7 @@ Model *ResourceManager::getModel(const std::string &path) {
     }
 
     // Try to load model
-    Model *model = new Model(path);
+    Model *model = new Model(path, options);
     m_models.emplace(path, model);
     return model;
 }
@@ -51,6 +51,14 @@ Texture *ResourceManager::getTexture(const std::string &path) {
     texture->setImage(width, height, TextureFormatEnum::RGBA8, data);
     m_textures.emplace(path, texture);
 
+    // alpha tests discard at 0.1, filtering can't go below the smallest texel
+    for (s32 i = 0; i < width * height; ++i) {
+        if (data[i * 4 + 3] <= 25) {
+            texture->setHasCutout(true);
+            break;
+        }
+    }
+
     stbi_image_free(data);
 
     return texture;
@@ -113,6 +121,30 @@ void ResourceManager::getTextureSplitComponents(const std::string &path, Texture
     stbi_image_free(data);
 }
 
+u32 ResourceManager::getMaterialId(const Material &material) {
+    // fields are hashed one by one, padding between them is undefined
+    u64 hash = utils::hash_bytes(&material.albedoTexture, sizeof(material.albedoTexture));
+    hash = utils::hash_bytes(&material.normalTexture, sizeof(material.normalTexture), hash);
+    hash = utils::hash_bytes(&material.metallicTexture, sizeof(material.metallicTexture), hash);
+    hash = utils::hash_bytes(&material.metallicScale, sizeof(material.metallicScale), hash);
+    hash = utils::hash_bytes(&material.roughnessTexture, sizeof(material.roughnessTexture), hash);
+    hash = utils::hash_bytes(&material.roughnessScale, sizeof(material.roughnessScale), hash);
+    hash = utils::hash_bytes(&material.metallicRoughnessTexture, sizeof(material.metallicRoughnessTexture), hash);
+    hash = utils::hash_bytes(&material.doubleSided, sizeof(material.doubleSided), hash);
+
+    std::vector<u32> &ids = m_materialIds[hash];
+    for (u32 id : ids) {
+        if (m_materials[id] == material) {
+            return id;
+        }
+    }
+
+    u32 id = m_materials.size();
+    m_materials.push_back(material);
+    ids.push_back(id);
+    return id;
+}
+
 Texture *ResourceManager::getBuiltInTexture(BuiltInTextureEnum tex) {
     switch (tex) {
         case BuiltInTextureEnum::BLACK:
@@ -164,34 +196,30 @@ void ResourceManager::init() {
         glm::vec3(-1, 0, -1), // position
         norm, // normal
         glm::vec2(0, 0), // uv
-        glm::vec3(0), glm::vec3(0) // tangent and bi-tangent will be calculated later
+        glm::vec4(0) // tangent will be calculated later
     };
     Vertex v2 = {
         glm::vec3(1, 0, -1), // position
         norm, // normal
         glm::vec2(1, 0), // uv
-        glm::vec3(0), glm::vec3(0) // tangent and bi-tangent will be calculated later
+        glm::vec4(0) // tangent will be calculated later
     };
     Vertex v3 = {
         glm::vec3(1, 0, 1), // position
         norm, // normal
         glm::vec2(1, 1), // uv
-        glm::vec3(0), glm::vec3(0) // tangent and bi-tangent will be calculated later
+        glm::vec4(0) // tangent will be calculated later
     };
     Vertex v4 = {
         glm::vec3(-1, 0, 1), // position
         norm, // normal
         glm::vec2(0, 1), // uv
-        glm::vec3(0), glm::vec3(0) // tangent and bi-tangent will be calculated later
+        glm::vec4(0) // tangent will be calculated later
     };
 
-    std::vector<Vertex> vertices = {v1, v2, v3, v1, v3, v4};
-    utils::calculate_tangent_and_bi_tangent(vertices[0],
-                                            vertices[1],
-                                            vertices[2]);
-    utils::calculate_tangent_and_bi_tangent(vertices[3],
-                                            vertices[4],
-                                            vertices[5]);
+    std::vector<Vertex> vertices = {v1, v2, v3, v4};
+    std::vector<u32> indices = {0, 1, 2, 0, 2, 3};
+    utils::generate_tangents(&vertices, &indices);
 
     // TODO: texture 'reference' for materials?
     Material material;
@@ -203,7 +231,8 @@ void ResourceManager::init() {
     material.roughnessScale = 1;
 
     std::vector<Mesh> m;
-    m.emplace_back(vertices, material);
+    m.emplace_back(vertices, indices, std::vector<MeshLod>{{0, (u32)indices.size(), 0.0f, 0, 0}}, Meshlets(),
+                   material);
     m_modelPlane = new Model(std::move(m));
 }
 
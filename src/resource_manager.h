@@ -4,8 +4,11 @@
 #include "types.h"
 #include "graphics/model.h"
 #include "graphics/texture.h"
+#include "graphics/material.h"
+#include <deque>
 #include <unordered_map>
 #include <string>
+#include <vector>
 
 enum class BuiltInTextureEnum {
     MISSING, BLACK, WHITE, NORMAL
@@ -21,7 +24,8 @@ public:
     ~ResourceManager();
 
     /// Get a model and if not loaded, load
-    Model *getModel(const std::string &path);
+    /// \param options Only used if the model isn't loaded yet
+    Model *getModel(const std::string &path, const ModelImportOptions &options = ModelImportOptions());
 
     /// Get a texture and if not loaded, load
     Texture *getTexture(const std::string &path);
@@ -30,6 +34,19 @@ public:
     void getTextureSplitComponents(const std::string &path, Texture **texture_red, Texture **texture_green,
                                    Texture **texture_blue, Texture **texture_alpha);
 
+    /// Intern a material, identical materials get the same id for as long as the resource manager lives
+    u32 getMaterialId(const Material &material);
+
+    /// Get an interned material
+    const Material &getMaterial(u32 id) const {
+        return m_materials[id];
+    }
+
+    /// Number of distinct materials interned so far
+    u32 getNumMaterials() const {
+        return m_materials.size();
+    }
+
     /// Get a built in texture
     Texture *getBuiltInTexture(BuiltInTextureEnum tex);
 
@@ -44,6 +61,8 @@ private:
     // TODO: remove unnecessary pointers
     std::unordered_map<std::string, Model *> m_models;
     std::unordered_map<std::string, Texture *> m_textures;
+    std::deque<Material> m_materials;   // a deque so references stay valid while materials are added
+    std::unordered_map<u64, std::vector<u32>> m_materialIds;    // ids of the materials with a hash
     Texture2D m_textureBlack;   // (0, 0, 0)
     Texture2D m_textureWhite;   // (255, 255, 255)
     Texture2D m_textureNormal;  // (127, 127, 255)
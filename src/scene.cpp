@@ -1,6 +1,10 @@
 #include "scene.h"
 
 u32 Scene::addEntity(Entity entity) {
+    if (entity.isStatic) {
+        ++m_staticVersion;
+    }
+
     u32 handle;
     if (!m_unusedIndices.empty()) {
         handle = m_unusedIndices.back();
@@ -14,14 +18,31 @@ u32 Scene::addEntity(Entity entity) {
 }
 
 void Scene::removeEntity(entityHandle_t handle) {
+    if (m_entities[handle].isStatic) {
+        ++m_staticVersion;
+    }
     m_entities[handle].active = false;
     m_unusedIndices.emplace_back(handle);
 }
 
 void Scene::updateEntity(entityHandle_t handle, Entity entity) {
+    if (entity.isStatic || m_entities[handle].isStatic) {
+        ++m_staticVersion;
+    }
     m_entities[handle] = entity;
 }
 
+void Scene::setModelNodeTransform(Model *model, u32 node, const glm::mat4 &local_transform) {
+    model->setNodeLocalTransform(node, local_transform);
+
+    for (const Entity &entity : m_entities) {
+        if (entity.active && entity.isStatic && entity.model == model) {
+            ++m_staticVersion;
+            break;
+        }
+    }
+}
+
 const std::vector<Entity> &Scene::getEntities() const {
     return m_entities;
 }
@@ -3,6 +3,7 @@
 
 #include "types.h"
 #include "entity.h"
+#include "light.h"
 #include <unordered_map>
 
 class Scene {
@@ -16,16 +17,30 @@ public:
 
     const std::vector<Entity> &getEntities() const;
 
+    /// Set the transform of a node of a model relative to its parent. Models are shared, so the node moves on every
+    /// entity that uses the model. Merged meshes only move with nodes named in ModelImportOptions::posableNodes
+    void setModelNodeTransform(Model *model, u32 node, const glm::mat4 &local_transform);
+
+    /// Get a counter that changes whenever a static entity is added, removed, updated or its model is posed
+    u32 getStaticVersion() const {
+        return m_staticVersion;
+    }
+
     // TODO: scene "globaL" properties
 
     // unit vector pointing towards the sun
     glm::vec3 sunDirection = glm::vec3(0, 1, 0);
 
+    // point and spot lights
+    std::vector<Light> lights;
+
 private:
     // TODO: spacial partitioning
     std::vector<Entity> m_entities;
 
     std::vector<entityHandle_t> m_unusedIndices;
+
+    u32 m_staticVersion = 0;
 };
 
 #endif //ACORN_SCENE_H
@@ -1,6 +1,7 @@
 #ifndef ACORN_TRANSFORM_H
 #define ACORN_TRANSFORM_H
 
+#include "types.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 
@@ -18,4 +19,17 @@ inline glm::mat4 transform_to_matrix(const Transform &transform) {
     return t * r * s;
 }
 
+/// Get the box around a box transformed by a matrix
+inline void transform_bounds(const glm::mat4 &matrix, glm::vec3 bounds_min, glm::vec3 bounds_max,
+                             glm::vec3 *transformed_min, glm::vec3 *transformed_max) {
+    glm::vec3 center = glm::vec3(matrix * glm::vec4((bounds_min + bounds_max) * 0.5f, 1));
+    glm::mat3 absMatrix = glm::mat3(matrix);
+    for (u32 i = 0; i < 3; ++i) {
+        absMatrix[i] = glm::abs(absMatrix[i]);
+    }
+    glm::vec3 extent = absMatrix * ((bounds_max - bounds_min) * 0.5f);
+    *transformed_min = center - extent;
+    *transformed_max = center + extent;
+}
+
 #endif //ACORN_TRANSFORM_H
@@ -8,12 +8,20 @@
 
 #include <stb_include.h>
 
+#include <algorithm>
+#include <cctype>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
 
 namespace utils {
-std::string load_shader_to_string(const char *file_path) {
+std::string load_shader_to_string(const char *file_path, const std::string &inject) {
     // find last slash in filepath for directory
     u32 lastSlash = 0;
     const char *current = file_path;
@@ -27,8 +35,7 @@ std::string load_shader_to_string(const char *file_path) {
     std::string directory = std::string(file_path).substr(0, lastSlash);
 
     char error[256];
-    const char *inject = "";
-    char *str = stb_include_file(const_cast<char *>(file_path), const_cast<char *>(inject),
+    char *str = stb_include_file(const_cast<char *>(file_path), const_cast<char *>(inject.c_str()),
                                  const_cast<char *>(directory.c_str()), error);
     if (!str) {
         Log::warn("Failed to load/preprocess shader: %s", error);
@@ -38,6 +45,40 @@ std::string load_shader_to_string(const char *file_path) {
     return str;
 }
 
+// stb_include resolves nested includes relative to the directory of the top level file
+static void get_shader_dependencies(const std::string &file_path, const std::string &directory,
+                                    std::vector<std::string> *dependencies) {
+    if (std::find(dependencies->begin(), dependencies->end(), file_path) != dependencies->end()) {
+        return;
+    }
+    dependencies->emplace_back(file_path);
+
+    std::ifstream file(file_path);
+    std::string line;
+    while (std::getline(file, line)) {
+        u64 start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line.compare(start, 8, "#include") != 0) {
+            continue;
+        }
+
+        u64 open = line.find('"', start);
+        u64 close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+        if (close == std::string::npos) {
+            continue;
+        }
+
+        get_shader_dependencies(directory + "/" + line.substr(open + 1, close - open - 1), directory, dependencies);
+    }
+}
+
+void get_shader_dependencies(const char *file_path, std::vector<std::string> *dependencies) {
+    std::string path = file_path;
+    u64 lastSlash = path.find_last_of('/');
+    std::string directory = lastSlash == std::string::npos ? "" : path.substr(0, lastSlash);
+
+    get_shader_dependencies(path, directory, dependencies);
+}
+
 std::string get_date_time_as_string() {
     auto t = std::time(nullptr);
     auto tm = *std::localtime(&t);
@@ -47,26 +88,151 @@ std::string get_date_time_as_string() {
     return os.str();
 }
 
-void calculate_tangent_and_bi_tangent(Vertex &v1, Vertex &v2, Vertex &v3) {
-    glm::vec3 deltaPos1 = v2.position - v1.position;
-    glm::vec3 deltaPos2 = v3.position - v1.position;
+// tangents are generated in ranges of this many triangles or vertices per job
+constexpr u32 TANGENT_ELEMENTS_PER_JOB = 4096;
+
+/// Make a tangent orthogonal to a normal, any perpendicular direction will do if there is nothing left of it
+static glm::vec3 orthogonalize_tangent(const glm::vec3 &tangent, const glm::vec3 &normal) {
+    glm::vec3 orthogonal = tangent - normal * glm::dot(normal, tangent);
+    if (glm::dot(orthogonal, orthogonal) < 1e-12f) {
+        glm::vec3 axis = std::abs(normal.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+        orthogonal = glm::cross(normal, axis);
+    }
+    return glm::normalize(orthogonal);
+}
 
-    glm::vec2 deltaUv1 = v2.uv - v1.uv;
-    glm::vec2 deltaUv2 = v3.uv - v1.uv;
+/// Angle of a triangle corner in the tangent plane of its vertex
+static f32 get_corner_angle(const glm::vec3 &to_next, const glm::vec3 &to_previous, const glm::vec3 &normal) {
+    glm::vec3 a = to_next - normal * glm::dot(normal, to_next);
+    glm::vec3 b = to_previous - normal * glm::dot(normal, to_previous);
+    f32 lengths = glm::length(a) * glm::length(b);
+    if (lengths <= 0.0f) {
+        return 0.0f;
+    }
+    return std::acos(glm::clamp(glm::dot(a, b) / lengths, -1.0f, 1.0f));
+}
 
-    float r = 1.0f / (deltaUv1.x * deltaUv2.y - deltaUv1.y * deltaUv2.x);
-    glm::vec3 tangent = (deltaPos1 * deltaUv2.y - deltaPos2 * deltaUv1.y) * r;
-    glm::vec3 biTangent = (deltaPos2 * deltaUv1.x - deltaPos1 * deltaUv2.x) * r;
+// Follows MikkTSpace: each triangle gets the normalized direction in which u increases, which every corner projects
+// onto the tangent plane of its vertex and weights by its angle. Triangles with mirrored uvs are summed apart from
+// the others, and vertices that are used by both get split so each keeps the sign of its triangles
+void generate_tangents(std::vector<Vertex> *vertices, std::vector<u32> *indices) {
+    u32 numTriangles = indices->size() / 3;
+    u32 numVertices = vertices->size();
 
-    // make tangent orthogonal to normal
-    v1.tangent = glm::normalize(tangent - v1.normal * glm::dot(v1.normal, tangent));
-    v1.biTangent = biTangent;
+    // the weighted tangent of each corner, and whether the uvs of its triangle are mirrored
+    std::vector<glm::vec3> cornerTangents(numTriangles * 3, glm::vec3(0));
+    std::vector<u8> mirrored(numTriangles, 0);
+    core->jobSystem.parallelFor(numTriangles, TANGENT_ELEMENTS_PER_JOB, [&](u32 begin, u32 end) {
+        for (u32 t = begin; t < end; ++t) {
+            const u32 *triangle = &(*indices)[t * 3];
+            const Vertex *corners[3] = {
+                &(*vertices)[triangle[0]], &(*vertices)[triangle[1]], &(*vertices)[triangle[2]]
+            };
 
-    v2.tangent = glm::normalize(tangent - v2.normal * glm::dot(v2.normal, tangent));
-    v2.biTangent = biTangent;
+            glm::vec3 edge1 = corners[1]->position - corners[0]->position;
+            glm::vec3 edge2 = corners[2]->position - corners[0]->position;
+            glm::vec2 deltaUv1 = corners[1]->uv - corners[0]->uv;
+            glm::vec2 deltaUv2 = corners[2]->uv - corners[0]->uv;
+            f32 signedArea = deltaUv1.x * deltaUv2.y - deltaUv2.x * deltaUv1.y;
+            if (std::abs(signedArea) < 1e-12f) {
+                // no uv direction to follow, the triangle takes the tangents of its neighbours
+                continue;
+            }
 
-    v3.tangent = glm::normalize(tangent - v3.normal * glm::dot(v3.normal, tangent));
-    v3.biTangent = biTangent;
+            f32 orientation = signedArea > 0.0f ? 1.0f : -1.0f;
+            glm::vec3 tangent = (edge1 * deltaUv2.y - edge2 * deltaUv1.y) * orientation;
+            glm::vec3 biTangent = (edge2 * deltaUv1.x - edge1 * deltaUv2.x) * orientation;
+            if (glm::dot(tangent, tangent) < 1e-20f) {
+                continue;
+            }
+            tangent = glm::normalize(tangent);
+
+            // the sign is taken against the normals instead of the winding, so meshes wound either way agree
+            glm::vec3 normal = corners[0]->normal + corners[1]->normal + corners[2]->normal;
+            mirrored[t] = glm::dot(glm::cross(normal, tangent), biTangent) < 0.0f;
+
+            for (u32 k = 0; k < 3; ++k) {
+                const Vertex &corner = *corners[k];
+                f32 angle = get_corner_angle(corners[(k + 1) % 3]->position - corner.position,
+                                             corners[(k + 2) % 3]->position - corner.position, corner.normal);
+                glm::vec3 projected = tangent - corner.normal * glm::dot(corner.normal, tangent);
+                f32 length = glm::length(projected);
+                if (length > 0.0f) {
+                    cornerTangents[t * 3 + k] = projected * (angle / length);
+                }
+            }
+        }
+    });
+
+    // corners around each vertex, so vertices gather their tangents instead of triangles contending to scatter them
+    std::vector<u32> firstCorners(numVertices + 1, 0);
+    for (u32 c = 0; c < numTriangles * 3; ++c) {
+        ++firstCorners[(*indices)[c] + 1];
+    }
+    for (u32 v = 0; v < numVertices; ++v) {
+        firstCorners[v + 1] += firstCorners[v];
+    }
+    std::vector<u32> vertexCorners(numTriangles * 3);
+    std::vector<u32> nextCorners(firstCorners.begin(), firstCorners.end() - 1);
+    for (u32 c = 0; c < numTriangles * 3; ++c) {
+        vertexCorners[nextCorners[(*indices)[c]]++] = c;
+    }
+
+    // vertices used by triangles of both signs keep the unmirrored tangent, the mirrored one goes to a copy
+    std::vector<glm::vec3> mirroredTangents(numVertices);
+    std::vector<u8> split(numVertices, 0);
+    core->jobSystem.parallelFor(numVertices, TANGENT_ELEMENTS_PER_JOB, [&](u32 begin, u32 end) {
+        for (u32 v = begin; v < end; ++v) {
+            glm::vec3 sums[2] = {glm::vec3(0), glm::vec3(0)};
+            bool used[2] = {false, false};
+            for (u32 i = firstCorners[v]; i < firstCorners[v + 1]; ++i) {
+                u32 corner = vertexCorners[i];
+                const glm::vec3 &tangent = cornerTangents[corner];
+                if (tangent != glm::vec3(0)) {
+                    u32 sign = mirrored[corner / 3];
+                    sums[sign] += tangent;
+                    used[sign] = true;
+                }
+            }
+
+            Vertex &vertex = (*vertices)[v];
+            u32 sign = used[0] || !used[1] ? 0 : 1;
+            vertex.tangent = glm::vec4(orthogonalize_tangent(sums[sign], vertex.normal), sign ? -1.0f : 1.0f);
+            if (used[0] && used[1]) {
+                mirroredTangents[v] = orthogonalize_tangent(sums[1], vertex.normal);
+                split[v] = 1;
+            }
+        }
+    });
+
+    for (u32 v = 0; v < numVertices; ++v) {
+        if (!split[v]) {
+            continue;
+        }
+
+        u32 copy = vertices->size();
+        Vertex vertex = (*vertices)[v];
+        vertex.tangent = glm::vec4(mirroredTangents[v], -1.0f);
+        vertices->push_back(vertex);
+
+        for (u32 i = firstCorners[v]; i < firstCorners[v + 1]; ++i) {
+            u32 corner = vertexCorners[i];
+            if (mirrored[corner / 3] && cornerTangents[corner] != glm::vec3(0)) {
+                (*indices)[corner] = copy;
+            }
+        }
+    }
+}
+
+bool is_gl_extension_supported(const char *name) {
+    s32 numExtensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+    for (s32 i = 0; i < numExtensions; ++i) {
+        if (std::strcmp((const char *)glGetStringi(GL_EXTENSIONS, i), name) == 0) {
+            return true;
+        }
+    }
+    return false;
 }
 
 void get_format_info(TextureFormatEnum format, u32 *texture_format, u32 *data_format, u32 *data_type) {
@@ -115,8 +281,143 @@ void get_format_info(TextureFormatEnum format, u32 *texture_format, u32 *data_fo
             *data_format = GL_RGBA;
             *data_type = GL_FLOAT;
             break;
+        case TextureFormatEnum::R16UI:
+            *texture_format = GL_R16UI;
+            *data_format = GL_RED_INTEGER;
+            *data_type = GL_UNSIGNED_SHORT;
+            break;
+        case TextureFormatEnum::RG32UI:
+            *texture_format = GL_RG32UI;
+            *data_format = GL_RG_INTEGER;
+            *data_type = GL_UNSIGNED_INT;
+            break;
+        case TextureFormatEnum::DEPTH32F:
+            *texture_format = GL_DEPTH_COMPONENT32F;
+            *data_format = GL_DEPTH_COMPONENT;
+            *data_type = GL_FLOAT;
+            break;
+        case TextureFormatEnum::R11F_G11F_B10F:
+            *texture_format = GL_R11F_G11F_B10F;
+            *data_format = GL_RGB;
+            *data_type = GL_FLOAT;
+            break;
+        case TextureFormatEnum::R16F:
+            *texture_format = GL_R16F;
+            *data_format = GL_RED;
+            *data_type = GL_FLOAT;
+            break;
+        case TextureFormatEnum::R32F:
+            *texture_format = GL_R32F;
+            *data_format = GL_RED;
+            *data_type = GL_FLOAT;
+            break;
         default:
             Log::fatal("Tried to get info for unknown format: %d", (u32)format);
     }
 }
+
+u32 get_format_pixel_size(TextureFormatEnum format) {
+    switch (format) {
+        case TextureFormatEnum::R8:
+            return 1;
+        case TextureFormatEnum::RGB8:
+            return 3;
+        case TextureFormatEnum::RGBA8:
+            return 4;
+        case TextureFormatEnum::RG16F:
+            return 2 * sizeof(f32);
+        case TextureFormatEnum::RGB16F:
+        case TextureFormatEnum::RGB32F:
+        case TextureFormatEnum::R11F_G11F_B10F:
+            return 3 * sizeof(f32);
+        case TextureFormatEnum::RGBA16F:
+        case TextureFormatEnum::RGBA32F:
+            return 4 * sizeof(f32);
+        case TextureFormatEnum::R16UI:
+            return sizeof(u16);
+        case TextureFormatEnum::RG32UI:
+            return 2 * sizeof(u32);
+        case TextureFormatEnum::DEPTH32F:
+        case TextureFormatEnum::R16F:
+        case TextureFormatEnum::R32F:
+            return sizeof(f32);
+        default:
+            Log::fatal("Tried to get pixel size for unknown format: %d", (u32)format);
+    }
+}
+
+u64 hash_bytes(const void *data, u64 size, u64 seed) {
+    const u8 *bytes = (const u8 *)data;
+    u64 hash = seed;
+    for (u64 i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+bool load_file_to_bytes(const std::string &file_path, std::vector<u8> *bytes) {
+    std::ifstream file(file_path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        return false;
+    }
+
+    std::streamsize size = file.tellg();
+    file.seekg(0, std::ios::beg);
+
+    bytes->resize(size);
+    return (bool)file.read((char *)bytes->data(), size);
+}
+
+bool write_bytes_to_file(const std::string &file_path, const void *data, u64 size) {
+    std::ofstream file(file_path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+
+    return (bool)file.write((const char *)data, size);
+}
+
+bool has_extension(const std::string &path, const char *extension) {
+    u64 length = std::strlen(extension);
+    if (path.size() < length) {
+        return false;
+    }
+    for (u64 i = 0; i < length; ++i) {
+        if (std::tolower(path[path.size() - length + i]) != extension[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool file_exists(const std::string &file_path) {
+    struct stat info = {};
+    return stat(file_path.c_str(), &info) == 0;
+}
+
+void create_directory(const std::string &directory_path) {
+#ifdef _WIN32
+    _mkdir(directory_path.c_str());
+#else
+    mkdir(directory_path.c_str(), 0755);
+#endif
+}
+
+glm::vec3 cubemap_face_direction(u32 face, f32 s, f32 t) {
+    switch (face) {
+        case 0:
+            return glm::vec3(1, -t, -s);
+        case 1:
+            return glm::vec3(-1, -t, s);
+        case 2:
+            return glm::vec3(s, 1, t);
+        case 3:
+            return glm::vec3(s, -1, -t);
+        case 4:
+            return glm::vec3(s, -t, 1);
+        default:
+            return glm::vec3(-s, -t, -1);
+    }
+}
 }
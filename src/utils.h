@@ -4,21 +4,57 @@
 #include "types.h"
 #include "graphics/vertex.h"
 #include <string>
+#include <vector>
 
 enum class TextureFormatEnum;
 
 namespace utils {
 /// Try to load and preprocess a shader from a file
-std::string load_shader_to_string(const char *file_path);
+/// \param inject Text that replaces an '#inject' line in the shader, used for defines
+std::string load_shader_to_string(const char *file_path, const std::string &inject = "");
+
+/// Collect a shader file and every file it includes, nested includes are resolved like load_shader_to_string does
+/// \param dependencies Files that aren't in here yet get appended
+void get_shader_dependencies(const char *file_path, std::vector<std::string> *dependencies);
 
 /// Get date and time as string
 std::string get_date_time_as_string();
 
-/// Generate bi-tangent and tangent vectors for vertices of a triangle
-void calculate_tangent_and_bi_tangent(Vertex &v1, Vertex &v2, Vertex &v3);
+/// Generate MikkTSpace style tangents of an indexed triangle list from its uvs, with the sign of the bi-tangent in w.
+/// Vertices shared by triangles with mirrored and unmirrored uvs are split, which appends vertices and remaps indices
+void generate_tangents(std::vector<Vertex> *vertices, std::vector<u32> *indices);
+
+/// Check whether the OpenGL context supports an extension
+bool is_gl_extension_supported(const char *name);
 
 /// Get OpenGL information for a format
 void get_format_info(TextureFormatEnum format, u32 *texture_format, u32 *data_format, u32 *data_type);
+
+/// Get the size in bytes of a single pixel when transferring data for a format
+u32 get_format_pixel_size(TextureFormatEnum format);
+
+/// Hash bytes with 64-bit FNV-1a, pass a previous hash as the seed to combine hashes
+u64 hash_bytes(const void *data, u64 size, u64 seed = 0xcbf29ce484222325ull);
+
+/// Try to load a whole file into a byte buffer
+bool load_file_to_bytes(const std::string &file_path, std::vector<u8> *bytes);
+
+/// Try to write a byte buffer to a file, replacing it if it exists
+bool write_bytes_to_file(const std::string &file_path, const void *data, u64 size);
+
+/// Check whether a path ends with an extension, ignoring the case of the path
+/// \param extension Lower case, with the dot
+bool has_extension(const std::string &path, const char *extension);
+
+/// Check whether a file exists
+bool file_exists(const std::string &file_path);
+
+/// Create a directory if it doesn't exist yet
+void create_directory(const std::string &directory_path);
+
+/// Get the unnormalized direction through a point on a cubemap face, where s and t are in [-1, 1]
+/// \param face Face index, same order as GL_TEXTURE_CUBE_MAP_POSITIVE_X + face
+glm::vec3 cubemap_face_direction(u32 face, f32 s, f32 t);
 }
 
 #endif //ACORN_UTILS_H